@@ -0,0 +1,111 @@
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/make_shared.hpp>
+#include <boost/program_options.hpp>
+
+#include "Tools/WebServer/WebServer.h"
+
+#include "AcceptBenchmark.h"
+#include "HelloService.h"
+#include "LoadGenerator.h"
+
+namespace po = boost::program_options;
+
+namespace
+{
+
+//-------------------------------------------------------------------------------------------------
+LoadGenerator::Result measure(LoadGenerator::Settings settings, std::size_t acceptors, std::size_t httpThreads)
+{
+    // the limit is above the connections of the load generator, none is refused
+    Tools::WebServer::WebServer server("127.0.0.1", settings.endpoint.port(), httpThreads, 60u,
+                                       settings.connections * 2u, 4u);
+    server.setAcceptorCount(acceptors);
+    server.addService("/bench/hello", boost::make_shared<HelloService>());
+    server.start();
+
+    LoadGenerator::Result result;
+    {
+        LoadGenerator loadGenerator(settings);
+        result = loadGenerator.run();
+    }
+    server.stop();
+    return result;
+}
+
+}
+
+//-------------------------------------------------------------------------------------------------
+int runAcceptBenchmark(int argc, char **argv)
+{
+    LoadGenerator::Settings settings;
+    unsigned short port = 0u;
+    std::vector<std::size_t> acceptorCounts;
+    std::size_t httpThreads = 0u;
+
+    settings.keepAlive = false;
+    settings.connections = 256u;
+    settings.threads = 4u;
+    settings.warmup = 2u;
+    settings.duration = 10u;
+
+    po::options_description optionsDescription("Accept benchmark options");
+    optionsDescription.add_options()
+        ("help,h", "Display the options and exit")
+        ("port", po::value<unsigned short>(&port)->default_value(30002u), "Port of the in-process server")
+        ("acceptors", po::value<std::vector<std::size_t> >(&acceptorCounts)->multitoken(),
+            "Acceptors of the server, 1 2 4 8 by default; more than one needs SO_REUSEPORT")
+        ("httpthreads", po::value<std::size_t>(&httpThreads)->default_value(4u), "I/O threads of the server")
+        ("connections", po::value<std::size_t>(&settings.connections)->default_value(settings.connections),
+            "Concurrent requests, each one on a new connection")
+        ("threads", po::value<unsigned>(&settings.threads)->default_value(settings.threads), "Client I/O threads")
+        ("warmup", po::value<unsigned>(&settings.warmup)->default_value(settings.warmup),
+            "Seconds before the measurement")
+        ("duration", po::value<unsigned>(&settings.duration)->default_value(settings.duration),
+            "Seconds of the measurement");
+
+    po::variables_map options;
+    po::store(po::command_line_parser(argc, argv).options(optionsDescription).run(), options);
+    if (options.count("help"))
+    {
+        std::cerr << optionsDescription << std::endl;
+        return EXIT_SUCCESS;
+    }
+    po::notify(options);
+
+    if (acceptorCounts.empty())
+    {
+        acceptorCounts.push_back(1u);
+        acceptorCounts.push_back(2u);
+        acceptorCounts.push_back(4u);
+        acceptorCounts.push_back(8u);
+    }
+    settings.endpoint = boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string("127.0.0.1"), port);
+
+    std::cout << settings.connections << " connections, keep-alive off, " << httpThreads << " http threads, "
+        << settings.duration << " s per run" << std::endl;
+
+    bool isFailed = false;
+    for (std::size_t i = 0u; i < acceptorCounts.size(); ++i)
+    {
+        if (acceptorCounts[i] == 0u)
+        {
+            throw std::invalid_argument("At least one acceptor is required");
+        }
+
+        const LoadGenerator::Result result = measure(settings, acceptorCounts[i], httpThreads);
+        std::cout << std::setw(2) << acceptorCounts[i] << (acceptorCounts[i] == 1u ? " acceptor " : " acceptors")
+            << std::fixed << std::setprecision(0)
+            << std::setw(12) << static_cast<double>(result.requests) / result.seconds << " connections/s"
+            << std::setprecision(3)
+            << "   latency (ms): p50 " << static_cast<double>(result.latency.getPercentile(50.0)) / 1000.0
+            << ", p99 " << static_cast<double>(result.latency.getPercentile(99.0)) / 1000.0
+            << "   errors " << result.errors << std::endl;
+        isFailed = isFailed || result.errors != 0u;
+    }
+    return isFailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
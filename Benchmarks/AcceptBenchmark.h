@@ -0,0 +1,5 @@
+#pragma once
+
+// New connections per second of an in-process server with 1, 2, 4 and 8 acceptors:
+// every request of the load generator opens a connection of its own.
+int runAcceptBenchmark(int argc, char **argv);
@@ -0,0 +1,111 @@
+#include <cstdlib>
+#include <new>
+
+#include <boost/atomic.hpp>
+
+#include "AllocationCounter.h"
+
+namespace
+{
+
+// zero before any dynamic initialization, so the allocations of static constructors are counted too
+boost::atomic<boost::uint64_t> s_allocations(0u);
+boost::atomic<boost::uint64_t> s_allocatedBytes(0u);
+
+void *allocate(std::size_t size)
+{
+    AllocationCounter::add(size);
+    return std::malloc(size != 0u ? size : 1u);
+}
+
+}
+
+//-------------------------------------------------------------------------------------------------
+void AllocationCounter::add(std::size_t size)
+{
+    s_allocations.fetch_add(1u, boost::memory_order_relaxed);
+    s_allocatedBytes.fetch_add(size, boost::memory_order_relaxed);
+}
+
+//-------------------------------------------------------------------------------------------------
+boost::uint64_t AllocationCounter::getAllocations()
+{
+    return s_allocations.load(boost::memory_order_relaxed);
+}
+
+//-------------------------------------------------------------------------------------------------
+boost::uint64_t AllocationCounter::getAllocatedBytes()
+{
+    return s_allocatedBytes.load(boost::memory_order_relaxed);
+}
+
+//-------------------------------------------------------------------------------------------------
+void *operator new(std::size_t size)
+{
+    void *p = allocate(size);
+    if (p == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+//-------------------------------------------------------------------------------------------------
+void *operator new[](std::size_t size)
+{
+    void *p = allocate(size);
+    if (p == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+//-------------------------------------------------------------------------------------------------
+void *operator new(std::size_t size, const std::nothrow_t &) throw()
+{
+    return allocate(size);
+}
+
+//-------------------------------------------------------------------------------------------------
+void *operator new[](std::size_t size, const std::nothrow_t &) throw()
+{
+    return allocate(size);
+}
+
+//-------------------------------------------------------------------------------------------------
+void operator delete(void *p) throw()
+{
+    std::free(p);
+}
+
+//-------------------------------------------------------------------------------------------------
+void operator delete[](void *p) throw()
+{
+    std::free(p);
+}
+
+//-------------------------------------------------------------------------------------------------
+void operator delete(void *p, const std::nothrow_t &) throw()
+{
+    std::free(p);
+}
+
+//-------------------------------------------------------------------------------------------------
+void operator delete[](void *p, const std::nothrow_t &) throw()
+{
+    std::free(p);
+}
+
+//-------------------------------------------------------------------------------------------------
+// the sized forms are called instead of the unsized ones since C++14
+void operator delete(void *p, std::size_t) throw()
+{
+    ::operator delete(p);
+}
+
+//-------------------------------------------------------------------------------------------------
+void operator delete[](void *p, std::size_t) throw()
+{
+    ::operator delete[](p);
+}
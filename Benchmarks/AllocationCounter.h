@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+
+#include <boost/cstdint.hpp>
+
+// Counts the calls of the global operator new of the process,
+// allocations made by malloc() directly are not seen.
+class AllocationCounter
+{
+public:
+    static void add(std::size_t size);
+
+    static boost::uint64_t getAllocations();
+    static boost::uint64_t getAllocatedBytes();
+};
@@ -0,0 +1,48 @@
+#include <boost/make_shared.hpp>
+
+#include "WebServices/ControllerAPIWebService.h"
+
+#include "BenchmarkWebSvc.h"
+#include "CountersService.h"
+#include "HelloService.h"
+
+//-------------------------------------------------------------------------------------------------
+BenchmarkWebSvc::BenchmarkWebSvc() : Tools::WebSvcApp::WebSvcApp("benchmarks", "1.0", "0")
+{
+}
+
+//-------------------------------------------------------------------------------------------------
+BenchmarkWebSvc::~BenchmarkWebSvc()
+{
+}
+
+//-------------------------------------------------------------------------------------------------
+void BenchmarkWebSvc::initialize(WebServiceRegistrar &webServiceRegistrar, Tools::WebServer::IStatPtr statPtr)
+{
+    webServiceRegistrar.registerService("/bench/hello",
+        boost::make_shared<HelloService>(),
+        Tools::WebServer::ServiceOptions(Tools::WebServer::EL_INTERACTIVE));
+
+    // read before and after a run, must not wait behind the measured requests
+    Tools::WebServer::ServiceOptions countersOptions(Tools::WebServer::EL_BULK);
+    countersOptions.adaptiveLimit = false;
+    countersOptions.queueDelayShedding = false;
+    webServiceRegistrar.registerService("/bench/counters", boost::make_shared<CountersService>(), countersOptions);
+
+    if (getConf().exists("serviceconfig.controller"))
+    {
+        m_controller.reset(new Controller(getConf().branch("serviceconfig.controller"), statPtr));
+
+        boost::shared_ptr<ControllerAPIWebService> servicePtr(new ControllerAPIWebService(m_controller));
+
+        // the same options as the controller service, coalescing is measured only when asked for
+        Tools::WebServer::ServiceOptions options(Tools::WebServer::EL_INTERACTIVE);
+        options.cacheTtl = boost::posix_time::milliseconds(getConf().get<long>("serviceconfig.controller.cachettl", 1000));
+        options.cacheVersionPtr = servicePtr->getCacheVersion();
+        options.coalesceRequests = getConf().get<bool>("serviceconfig.controller.coalesce", false);
+        options.coalesceWindow = boost::posix_time::milliseconds(
+            getConf().get<long>("serviceconfig.controller.coalescewindow", 20));
+
+        webServiceRegistrar.registerService("/api/controller", servicePtr, options);
+    }
+}
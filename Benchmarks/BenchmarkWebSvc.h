@@ -0,0 +1,26 @@
+#pragma once
+
+#include <boost/shared_ptr.hpp>
+
+#include "Tools/WebSvcApp/WebSvcApp.h"
+
+#include "Controller/Controller.h"
+
+// The benchmark server: run.httpserver is configured as for the controller service, so every
+// server setting can be compared. Serves
+//   /bench/hello    - HelloService
+//   /bench/counters - CountersService
+//   /api/controller - ControllerAPIWebService of a controller whose processes are never started
+//                     (serviceconfig.controller, optional)
+class BenchmarkWebSvc :
+    public Tools::WebSvcApp::WebSvcApp
+{
+public:
+    BenchmarkWebSvc();
+    virtual ~BenchmarkWebSvc();
+
+private:
+    void initialize(WebServiceRegistrar &webServiceRegistrar, Tools::WebServer::IStatPtr statPtr) override;
+
+    ControllerPtr m_controller;
+};
@@ -0,0 +1,131 @@
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <boost/atomic.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/program_options.hpp>
+
+#include "Tools/WebServer/WebServer.h"
+
+#include "CoalescerBenchmark.h"
+#include "HelloService.h"
+#include "LoadGenerator.h"
+
+namespace po = boost::program_options;
+
+namespace
+{
+
+// counts the requests which reach the service
+class CountingService :
+    public HelloService
+{
+public:
+    CountingService() :
+        m_calls(0u)
+    {
+    }
+
+    void operator()(Tools::WebServer::ConnectionContextPtr contextPtr) override
+    {
+        m_calls.fetch_add(1u, boost::memory_order_relaxed);
+        HelloService::operator()(contextPtr);
+    }
+
+    boost::uint64_t getCalls() const
+    {
+        return m_calls.load(boost::memory_order_relaxed);
+    }
+
+private:
+    boost::atomic<boost::uint64_t> m_calls;
+};
+
+//-------------------------------------------------------------------------------------------------
+// false when a request failed
+bool measure(const LoadGenerator::Settings &settings, std::size_t workers, long window, bool isCoalescing)
+{
+    const boost::shared_ptr<CountingService> servicePtr = boost::make_shared<CountingService>();
+
+    Tools::WebServer::ServiceOptions options;
+    options.coalesceRequests = isCoalescing;
+    options.coalesceWindow = boost::posix_time::milliseconds(window);
+
+    // the limit is above the connections of the load generator, none is refused
+    Tools::WebServer::WebServer server("127.0.0.1", settings.endpoint.port(), 4u, 60u,
+                                       settings.connections * 2u, workers);
+    server.addService("/bench/hello", servicePtr, options);
+    server.start();
+
+    LoadGenerator::Result result;
+    {
+        LoadGenerator loadGenerator(settings);
+        result = loadGenerator.run();
+    }
+    server.stop();
+
+    // the warm up is counted by the service too
+    std::cout << "coalescing " << (isCoalescing ? "on " : "off") << std::fixed << std::setprecision(0)
+        << std::setw(12) << static_cast<double>(result.requests) / result.seconds << " req/s"
+        << std::setprecision(3)
+        << "   latency (ms): p50 " << static_cast<double>(result.latency.getPercentile(50.0)) / 1000.0
+        << ", p99 " << static_cast<double>(result.latency.getPercentile(99.0)) / 1000.0
+        << "   service calls per request " << (result.completedRequests != 0u
+            ? static_cast<double>(servicePtr->getCalls()) / static_cast<double>(result.completedRequests) : 0.0)
+        << "   errors " << result.errors << std::endl;
+    return result.errors == 0u;
+}
+
+}
+
+//-------------------------------------------------------------------------------------------------
+int runCoalescerBenchmark(int argc, char **argv)
+{
+    LoadGenerator::Settings settings;
+    unsigned short port = 0u;
+    unsigned spin = 0u;
+    std::size_t workers = 0u;
+    long window = 0;
+
+    settings.connections = 256u;
+    settings.threads = 4u;
+    settings.warmup = 2u;
+    settings.duration = 10u;
+
+    po::options_description optionsDescription("Coalescer benchmark options");
+    optionsDescription.add_options()
+        ("help,h", "Display the options and exit")
+        ("port", po::value<unsigned short>(&port)->default_value(30004u), "Port of the in-process server")
+        ("spin", po::value<unsigned>(&spin)->default_value(2000u), "Service time of a request in us")
+        ("workers", po::value<std::size_t>(&workers)->default_value(4u), "Worker threads of the server")
+        ("window", po::value<long>(&window)->default_value(20),
+            "Milliseconds a completed response is shared after its flight")
+        ("connections", po::value<std::size_t>(&settings.connections)->default_value(settings.connections),
+            "Concurrent keep-alive connections")
+        ("threads", po::value<unsigned>(&settings.threads)->default_value(settings.threads), "Client I/O threads")
+        ("warmup", po::value<unsigned>(&settings.warmup)->default_value(settings.warmup),
+            "Seconds before the measurement")
+        ("duration", po::value<unsigned>(&settings.duration)->default_value(settings.duration),
+            "Seconds of the measurement");
+
+    po::variables_map options;
+    po::store(po::command_line_parser(argc, argv).options(optionsDescription).run(), options);
+    if (options.count("help"))
+    {
+        std::cerr << optionsDescription << std::endl;
+        return EXIT_SUCCESS;
+    }
+    po::notify(options);
+
+    settings.endpoint = boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string("127.0.0.1"), port);
+    settings.resource = "/bench/hello?spin=" + boost::lexical_cast<std::string>(spin);
+
+    std::cout << settings.connections << " keep-alive connections, GET " << settings.resource << ", "
+        << workers << " workers, " << settings.duration << " s per run" << std::endl;
+
+    const bool isSucceeded = measure(settings, workers, window, false);
+    return measure(settings, workers, window, true) && isSucceeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
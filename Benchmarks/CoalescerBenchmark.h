@@ -0,0 +1,6 @@
+#pragma once
+
+// Identical GET requests of a slow resource against an in-process server with the
+// request coalescing off and on: requests per second, p99 latency and the calls of
+// the service per request.
+int runCoalescerBenchmark(int argc, char **argv);
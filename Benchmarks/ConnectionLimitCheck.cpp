@@ -0,0 +1,127 @@
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/program_options.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "Tools/WebServer/WebServer.h"
+
+#include "ConnectionLimitCheck.h"
+#include "HelloService.h"
+
+namespace po = boost::program_options;
+
+namespace
+{
+
+typedef boost::shared_ptr<boost::asio::ip::tcp::socket> SocketPtr;
+
+//-------------------------------------------------------------------------------------------------
+// a refused connection is closed by the server without a response
+bool isAnswered(boost::asio::ip::tcp::socket &socket, const std::string &request)
+{
+    boost::system::error_code error;
+    boost::asio::write(socket, boost::asio::buffer(request), error);
+    if (error)
+    {
+        return false;
+    }
+
+    std::string response;
+    char buffer[4096];
+    while (true)
+    {
+        const std::size_t length = socket.read_some(boost::asio::buffer(buffer), error);
+        if (error)
+        {
+            break;
+        }
+        response.append(buffer, length);
+    }
+    return response.compare(0u, 12u, "HTTP/1.1 200") == 0;
+}
+
+}
+
+//-------------------------------------------------------------------------------------------------
+int runConnectionLimitCheck(int argc, char **argv)
+{
+    unsigned short port = 0u;
+    std::size_t connectionLimit = 0u;
+    std::size_t extraConnections = 0u;
+    std::size_t acceptors = 0u;
+
+    po::options_description optionsDescription("Connection limit check options");
+    optionsDescription.add_options()
+        ("help,h", "Display the options and exit")
+        ("port", po::value<unsigned short>(&port)->default_value(30001u), "Port of the in-process server")
+        ("limit", po::value<std::size_t>(&connectionLimit)->default_value(64u), "Connection limit of the server")
+        ("extra", po::value<std::size_t>(&extraConnections)->default_value(16u),
+            "Connections opened above the limit")
+        ("acceptors", po::value<std::size_t>(&acceptors)->default_value(1u),
+            "Acceptors of the server, more than one needs SO_REUSEPORT");
+
+    po::variables_map options;
+    po::store(po::command_line_parser(argc, argv).options(optionsDescription).run(), options);
+    if (options.count("help"))
+    {
+        std::cerr << optionsDescription << std::endl;
+        return EXIT_SUCCESS;
+    }
+    po::notify(options);
+
+    if (connectionLimit == 0u)
+    {
+        throw std::invalid_argument("The connection limit must not be 0");
+    }
+
+    // the new connections wait for their requests longer than the check takes
+    Tools::WebServer::WebServer server("127.0.0.1", port, 2u, 60u, connectionLimit, 2u);
+    server.setAcceptorCount(acceptors);
+    server.addService("/bench/hello", boost::make_shared<HelloService>());
+    server.start();
+
+    boost::asio::io_service ioService;
+    const boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::address::from_string("127.0.0.1"), port);
+    std::vector<SocketPtr> sockets;
+    for (std::size_t i = 0u; i < connectionLimit + extraConnections; ++i)
+    {
+        SocketPtr socketPtr(new boost::asio::ip::tcp::socket(ioService));
+        socketPtr->connect(endpoint);
+        sockets.push_back(socketPtr);
+    }
+
+    // the server admits or refuses every connection when it is accepted
+    boost::this_thread::sleep(boost::posix_time::milliseconds(500));
+
+    const std::string request = "GET /bench/hello HTTP/1.1\r\nHost: 127.0.0.1:" + boost::lexical_cast<std::string>(port)
+        + "\r\nConnection: close\r\n\r\n";
+    std::size_t admitted = 0u;
+    for (std::size_t i = 0u; i < sockets.size(); ++i)
+    {
+        if (isAnswered(*sockets[i], request))
+        {
+            ++admitted;
+        }
+    }
+    sockets.clear();
+    server.stop();
+
+    std::cout << admitted << " of " << connectionLimit + extraConnections << " connections admitted, limit "
+        << connectionLimit << ", " << acceptors << (acceptors == 1u ? " acceptor" : " acceptors") << std::endl;
+    if (admitted != connectionLimit)
+    {
+        std::cout << "FAILED: the server must admit exactly the connection limit" << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+// Opens more connections than the connection limit of an in-process server and
+// checks that exactly the limit is admitted. Exits with 1 when it is not.
+int runConnectionLimitCheck(int argc, char **argv);
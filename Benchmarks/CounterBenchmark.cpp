@@ -0,0 +1,160 @@
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/chrono/system_clocks.hpp>
+#include <boost/function.hpp>
+#include <boost/program_options.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/thread/barrier.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "Tools/WebServer/StatService.h"
+
+#include "CounterBenchmark.h"
+
+namespace po = boost::program_options;
+
+namespace
+{
+
+typedef boost::function<void (std::size_t)> IncrementLoop;
+
+static const char s_parameterName[] = "requests";
+
+//-------------------------------------------------------------------------------------------------
+void incrementByName(Tools::WebServer::IStat &stat, std::size_t increments)
+{
+    for (std::size_t i = 0u; i < increments; ++i)
+    {
+        stat.increment(s_parameterName, 1);
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+void incrementByHandle(const Tools::WebServer::CounterHandle &handle, std::size_t increments)
+{
+    for (std::size_t i = 0u; i < increments; ++i)
+    {
+        handle.increment(1);
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+void incrementRate(const Tools::WebServer::RateHandle &handle, std::size_t increments)
+{
+    for (std::size_t i = 0u; i < increments; ++i)
+    {
+        handle.increment(1);
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+void incrementShared(boost::atomic<long> &counter, std::size_t increments)
+{
+    for (std::size_t i = 0u; i < increments; ++i)
+    {
+        counter.fetch_add(1, boost::memory_order_relaxed);
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+long getShared(const boost::atomic<long> &counter)
+{
+    return counter.load();
+}
+
+//-------------------------------------------------------------------------------------------------
+void runLoop(boost::barrier &barrier, const IncrementLoop &loop, std::size_t increments)
+{
+    barrier.wait();
+    loop(increments);
+}
+
+//-------------------------------------------------------------------------------------------------
+void measure(const std::string &title,
+             const IncrementLoop &loop,
+             const boost::function<long ()> &getValue,
+             std::size_t threadCount,
+             std::size_t increments)
+{
+    const long initialValue = getValue();
+
+    // the clock starts when all threads are ready
+    boost::barrier barrier(static_cast<unsigned>(threadCount + 1u));
+    boost::ptr_vector<boost::thread> threads;
+    for (std::size_t i = 0u; i < threadCount; ++i)
+    {
+        threads.push_back(new boost::thread(boost::bind(&runLoop, boost::ref(barrier), loop, increments)));
+    }
+
+    barrier.wait();
+    const boost::chrono::steady_clock::time_point start = boost::chrono::steady_clock::now();
+    for (std::size_t i = 0u; i < threads.size(); ++i)
+    {
+        threads[i].join();
+    }
+    const double seconds = boost::chrono::duration<double>(boost::chrono::steady_clock::now() - start).count();
+
+    const double total = static_cast<double>(threadCount) * static_cast<double>(increments);
+    const long counted = getValue() - initialValue;
+    std::cout << std::left << std::setw(32) << title << std::right << std::fixed
+        << std::setprecision(2) << std::setw(10) << seconds * 1e9 * threadCount / total << " ns/increment"
+        << std::setw(12) << total / seconds / 1e6 << " M increments/s"
+        << (static_cast<double>(counted) == total ? "" : " (counted values differ)") << std::endl;
+}
+
+}
+
+//-------------------------------------------------------------------------------------------------
+int runCounterBenchmark(int argc, char **argv)
+{
+    std::size_t threadCount = 16u;
+    std::size_t increments = 10000000u;
+
+    po::options_description optionsDescription("Counter benchmark options");
+    optionsDescription.add_options()
+        ("help,h", "Display the options and exit")
+        ("threads", po::value<std::size_t>(&threadCount)->default_value(threadCount), "Incrementing threads")
+        ("increments", po::value<std::size_t>(&increments)->default_value(increments), "Increments per thread");
+
+    po::variables_map options;
+    po::store(po::command_line_parser(argc, argv).options(optionsDescription).run(), options);
+    if (options.count("help"))
+    {
+        std::cerr << optionsDescription << std::endl;
+        return EXIT_SUCCESS;
+    }
+    po::notify(options);
+
+    Tools::WebServer::StatService stat("benchmarks", "/stat", "1.0", "0");
+    const Tools::WebServer::CounterHandle handle = stat.registerParameter(s_parameterName);
+    const Tools::WebServer::RateHandle rateHandle = stat.registerRate(s_parameterName);
+    stat.start();
+
+    boost::atomic<long> sharedCounter(0);
+
+    std::cout << threadCount << " threads, " << increments << " increments each" << std::endl;
+    measure("IStat::increment(name), sharded",
+        boost::bind(&incrementByName, boost::ref(stat), _1),
+        boost::bind(&Tools::WebServer::CounterHandle::get, &handle),
+        threadCount, increments);
+    measure("CounterHandle",
+        boost::bind(&incrementByHandle, boost::cref(handle), _1),
+        boost::bind(&Tools::WebServer::CounterHandle::get, &handle),
+        threadCount, increments);
+    measure("RateHandle",
+        boost::bind(&incrementRate, boost::cref(rateHandle), _1),
+        boost::bind(&Tools::WebServer::RateHandle::get, &rateHandle),
+        threadCount, increments);
+    measure("shared atomic",
+        boost::bind(&incrementShared, boost::ref(sharedCounter), _1),
+        boost::bind(&getShared, boost::cref(sharedCounter)),
+        threadCount, increments);
+
+    stat.stop();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+// 16 threads (by default) incrementing the same stat parameter: by name through
+// IStat::increment, through a CounterHandle, through a RateHandle and through
+// a single shared atomic.
+int runCounterBenchmark(int argc, char **argv);
@@ -0,0 +1,49 @@
+#include <sstream>
+
+#include <boost/chrono/process_cpu_clocks.hpp>
+
+#include <pion/http/response.hpp>
+#include <pion/http/types.hpp>
+
+#include "AllocationCounter.h"
+#include "CountersService.h"
+
+//-------------------------------------------------------------------------------------------------
+CountersService::CountersService()
+{
+}
+
+//-------------------------------------------------------------------------------------------------
+CountersService::~CountersService()
+{
+}
+
+//-------------------------------------------------------------------------------------------------
+void CountersService::operator()(Tools::WebServer::ConnectionContextPtr contextPtr)
+{
+    const boost::chrono::process_cpu_clock::times cpuTimes =
+        boost::chrono::process_cpu_clock::now().time_since_epoch().count();
+
+    std::ostringstream counters;
+    counters << "allocations=" << AllocationCounter::getAllocations() << "\n"
+        << "allocated_bytes=" << AllocationCounter::getAllocatedBytes() << "\n"
+        << "user_cpu_us=" << cpuTimes.user / 1000 << "\n"
+        << "system_cpu_us=" << cpuTimes.system / 1000 << "\n";
+
+    pion::http::response_ptr responsePtr(new pion::http::response(*contextPtr->getRequest()));
+    responsePtr->set_status_code(pion::http::types::RESPONSE_CODE_OK);
+    responsePtr->set_status_message(pion::http::types::RESPONSE_MESSAGE_OK);
+    responsePtr->set_content_type("text/plain;charset=UTF-8");
+    responsePtr->set_content(counters.str());
+    contextPtr->sendResponse(responsePtr);
+}
+
+//-------------------------------------------------------------------------------------------------
+void CountersService::start(void)
+{
+}
+
+//-------------------------------------------------------------------------------------------------
+void CountersService::stop(void)
+{
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "Tools/WebServer/IWebService.h"
+
+// Process counters of the benchmark server as "name=value" lines: operator new calls,
+// allocated bytes, user and system CPU time in microseconds.
+// The load generator divides their growth during a run by the number of requests.
+class CountersService :
+    public Tools::WebServer::IWebService
+{
+public:
+    CountersService();
+    virtual ~CountersService();
+
+    // Tools::WebServer::IWebService implementation
+    void operator()(Tools::WebServer::ConnectionContextPtr contextPtr) override;
+
+    void start(void) override;
+
+    void stop(void) override;
+};
@@ -0,0 +1,56 @@
+#include <boost/lexical_cast.hpp>
+
+#include <pion/http/response.hpp>
+#include <pion/http/types.hpp>
+
+#include "Tools/WebServer/Histogram.h"
+
+#include "HelloService.h"
+
+static const char s_helloContent[] = "{\"hello\":\"world\"}";
+
+//-------------------------------------------------------------------------------------------------
+HelloService::HelloService()
+{
+}
+
+//-------------------------------------------------------------------------------------------------
+HelloService::~HelloService()
+{
+}
+
+//-------------------------------------------------------------------------------------------------
+void HelloService::operator()(Tools::WebServer::ConnectionContextPtr contextPtr)
+{
+    const std::string &spin = contextPtr->getRequest()->get_query("spin");
+    if (!spin.empty())
+    {
+        spinFor(boost::lexical_cast<boost::uint64_t>(spin));
+    }
+
+    pion::http::response_ptr responsePtr(new pion::http::response(*contextPtr->getRequest()));
+    responsePtr->set_status_code(pion::http::types::RESPONSE_CODE_OK);
+    responsePtr->set_status_message(pion::http::types::RESPONSE_MESSAGE_OK);
+    responsePtr->set_content_type("application/json;charset=UTF-8");
+    responsePtr->set_content(s_helloContent);
+    contextPtr->sendResponse(responsePtr);
+}
+
+//-------------------------------------------------------------------------------------------------
+void HelloService::spinFor(boost::uint64_t us)
+{
+    const boost::uint64_t end = Tools::WebServer::getTimestampNs() + us * 1000u;
+    while (Tools::WebServer::getTimestampNs() < end)
+    {
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+void HelloService::start(void)
+{
+}
+
+//-------------------------------------------------------------------------------------------------
+void HelloService::stop(void)
+{
+}
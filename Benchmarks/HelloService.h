@@ -0,0 +1,26 @@
+#pragma once
+
+#include <boost/cstdint.hpp>
+
+#include "Tools/WebServer/IWebService.h"
+
+// The smallest possible service: every request gets the same short JSON document,
+// so the measured time is the time of the server itself. ?spin=N keeps the worker
+// busy for N us before the answer, a fixed service time for the overload runs.
+class HelloService :
+    public Tools::WebServer::IWebService
+{
+public:
+    HelloService();
+    virtual ~HelloService();
+
+    // Tools::WebServer::IWebService implementation
+    void operator()(Tools::WebServer::ConnectionContextPtr contextPtr) override;
+
+    void start(void) override;
+
+    void stop(void) override;
+
+private:
+    static void spinFor(boost::uint64_t us);
+};
@@ -0,0 +1,6 @@
+#pragma once
+
+// Small GET requests against an in-process server with 1, 4, 8 and 16 http threads,
+// each with one shared io_service and with an io_service per thread: requests per
+// second and p99 latency.
+int runIoShardingBenchmark(int argc, char **argv);
@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+#include "LatencyHistogram.h"
+
+namespace
+{
+
+const std::size_t INDEX_COUNT = LatencyHistogram::SUB_BUCKETS
+        + (LatencyHistogram::BUCKETS - 1) * LatencyHistogram::HALF_SUB_BUCKETS;
+
+// the percentile steps halve with every halving of the distance to 100%
+const unsigned PERCENTILE_TICKS_PER_HALF_DISTANCE = 5u;
+
+unsigned getHighestBit(boost::uint64_t value)
+{
+    unsigned bit = 0u;
+    while (value >>= 1u)
+    {
+        ++bit;
+    }
+    return bit;
+}
+
+}
+
+const boost::uint64_t LatencyHistogram::MAX_VALUE;
+
+//-------------------------------------------------------------------------------------------------
+LatencyHistogram::LatencyHistogram() :
+    m_counts(INDEX_COUNT, 0u),
+    m_count(0u),
+    m_max(0u)
+{
+}
+
+//-------------------------------------------------------------------------------------------------
+void LatencyHistogram::record(boost::uint64_t value)
+{
+    value = std::min(value, MAX_VALUE);
+    ++m_counts[getIndex(value)];
+    ++m_count;
+    m_max = std::max(m_max, value);
+}
+
+//-------------------------------------------------------------------------------------------------
+void LatencyHistogram::add(const LatencyHistogram &histogram)
+{
+    for (std::size_t i = 0u; i < m_counts.size(); ++i)
+    {
+        m_counts[i] += histogram.m_counts[i];
+    }
+    m_count += histogram.m_count;
+    m_max = std::max(m_max, histogram.m_max);
+}
+
+//-------------------------------------------------------------------------------------------------
+void LatencyHistogram::clear()
+{
+    std::fill(m_counts.begin(), m_counts.end(), 0u);
+    m_count = 0u;
+    m_max = 0u;
+}
+
+//-------------------------------------------------------------------------------------------------
+boost::uint64_t LatencyHistogram::getCount() const
+{
+    return m_count;
+}
+
+//-------------------------------------------------------------------------------------------------
+boost::uint64_t LatencyHistogram::getMax() const
+{
+    return m_max;
+}
+
+//-------------------------------------------------------------------------------------------------
+double LatencyHistogram::getMean() const
+{
+    if (m_count == 0u)
+    {
+        return 0.0;
+    }
+
+    double sum = 0.0;
+    for (std::size_t i = 0u; i < m_counts.size(); ++i)
+    {
+        sum += static_cast<double>(m_counts[i]) * static_cast<double>(getMedianEquivalentValue(i));
+    }
+    return sum / static_cast<double>(m_count);
+}
+
+//-------------------------------------------------------------------------------------------------
+double LatencyHistogram::getStdDeviation() const
+{
+    if (m_count == 0u)
+    {
+        return 0.0;
+    }
+
+    const double mean = getMean();
+    double sum = 0.0;
+    for (std::size_t i = 0u; i < m_counts.size(); ++i)
+    {
+        const double deviation = static_cast<double>(getMedianEquivalentValue(i)) - mean;
+        sum += static_cast<double>(m_counts[i]) * deviation * deviation;
+    }
+    return std::sqrt(sum / static_cast<double>(m_count));
+}
+
+//-------------------------------------------------------------------------------------------------
+boost::uint64_t LatencyHistogram::getPercentile(double percentile) const
+{
+    if (m_count == 0u)
+    {
+        return 0u;
+    }
+
+    percentile = std::min(std::max(percentile, 0.0), 100.0);
+    const boost::uint64_t rank = std::max<boost::uint64_t>(
+        static_cast<boost::uint64_t>(std::ceil(percentile / 100.0 * static_cast<double>(m_count))), 1u);
+
+    boost::uint64_t count = 0u;
+    for (std::size_t i = 0u; i < m_counts.size(); ++i)
+    {
+        count += m_counts[i];
+        if (count >= rank)
+        {
+            return std::min(getHighestEquivalentValue(i), m_max);
+        }
+    }
+    return m_max;
+}
+
+//-------------------------------------------------------------------------------------------------
+void LatencyHistogram::writePercentileDistribution(std::ostream &stream, double unitRatio) const
+{
+    stream << std::setw(12) << "Value" << " " << std::setw(14) << "Percentile" << " "
+        << std::setw(10) << "TotalCount" << " " << std::setw(14) << "1/(1-Percentile)" << "\n\n";
+    stream << std::fixed;
+
+    double percentileToReport = 0.0;
+    boost::uint64_t count = 0u;
+    for (std::size_t i = 0u; i < m_counts.size() && m_count != 0u; ++i)
+    {
+        if (m_counts[i] == 0u)
+        {
+            continue;
+        }
+
+        count += m_counts[i];
+        const double percentile = 100.0 * static_cast<double>(count) / static_cast<double>(m_count);
+        const double value = static_cast<double>(std::min(getHighestEquivalentValue(i), m_max)) / unitRatio;
+        while (percentileToReport <= percentile && percentileToReport < 100.0)
+        {
+            stream << std::setw(12) << std::setprecision(3) << value << " "
+                << std::setw(14) << std::setprecision(12) << percentileToReport / 100.0 << " "
+                << std::setw(10) << count << " "
+                << std::setw(14) << std::setprecision(2) << 100.0 / (100.0 - percentileToReport) << "\n";
+
+            const double halfDistance = std::pow(2.0, std::floor(std::log(100.0 / (100.0 - percentileToReport))
+                                                                 / std::log(2.0)) + 1.0);
+            percentileToReport += 100.0 / (halfDistance * PERCENTILE_TICKS_PER_HALF_DISTANCE);
+
+            // the steps get shorter and shorter near 100%, the rest is the max line
+            if (count == m_count)
+            {
+                break;
+            }
+        }
+    }
+
+    // the last line has no finite 1/(1-Percentile)
+    stream << std::setw(12) << std::setprecision(3) << static_cast<double>(m_max) / unitRatio << " "
+        << std::setw(14) << std::setprecision(12) << 1.0 << " "
+        << std::setw(10) << m_count << "\n";
+
+    stream << "#[Mean    = " << std::setw(12) << std::setprecision(3) << getMean() / unitRatio
+        << ", StdDeviation   = " << std::setw(12) << getStdDeviation() / unitRatio << "]\n"
+        << "#[Max     = " << std::setw(12) << static_cast<double>(m_max) / unitRatio
+        << ", Total count    = " << std::setw(12) << m_count << "]\n"
+        << "#[Buckets = " << std::setw(12) << BUCKETS
+        << ", SubBuckets     = " << std::setw(12) << SUB_BUCKETS << "]\n";
+}
+
+//-------------------------------------------------------------------------------------------------
+std::size_t LatencyHistogram::getIndex(boost::uint64_t value)
+{
+    if (value < SUB_BUCKETS)
+    {
+        return static_cast<std::size_t>(value);
+    }
+
+    const unsigned bucket = getHighestBit(value) - SUB_BUCKET_BITS + 1u;
+    const std::size_t subBucket = static_cast<std::size_t>(value >> bucket);
+    return SUB_BUCKETS + (bucket - 1u) * HALF_SUB_BUCKETS + (subBucket - HALF_SUB_BUCKETS);
+}
+
+//-------------------------------------------------------------------------------------------------
+boost::uint64_t LatencyHistogram::getHighestEquivalentValue(std::size_t index)
+{
+    if (index < SUB_BUCKETS)
+    {
+        return index;
+    }
+
+    const unsigned bucket = static_cast<unsigned>((index - SUB_BUCKETS) / HALF_SUB_BUCKETS) + 1u;
+    const boost::uint64_t subBucket = (index - SUB_BUCKETS) % HALF_SUB_BUCKETS + HALF_SUB_BUCKETS;
+    return (subBucket << bucket) + (static_cast<boost::uint64_t>(1) << bucket) - 1u;
+}
+
+//-------------------------------------------------------------------------------------------------
+boost::uint64_t LatencyHistogram::getMedianEquivalentValue(std::size_t index)
+{
+    if (index < SUB_BUCKETS)
+    {
+        return index;
+    }
+
+    const unsigned bucket = static_cast<unsigned>((index - SUB_BUCKETS) / HALF_SUB_BUCKETS) + 1u;
+    const boost::uint64_t subBucket = (index - SUB_BUCKETS) % HALF_SUB_BUCKETS + HALF_SUB_BUCKETS;
+    return (subBucket << bucket) + (static_cast<boost::uint64_t>(1) << (bucket - 1u));
+}
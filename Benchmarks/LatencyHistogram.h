@@ -0,0 +1,51 @@
+#pragma once
+
+#include <ostream>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+
+// HDR histogram of latencies in microseconds: values are kept with three significant digits
+// up to LatencyHistogram::MAX_VALUE, larger ones are counted as MAX_VALUE.
+// Not thread safe.
+class LatencyHistogram
+{
+public:
+    enum
+    {
+        SUB_BUCKET_BITS = 11,
+        SUB_BUCKETS = 1 << SUB_BUCKET_BITS,
+        HALF_SUB_BUCKETS = SUB_BUCKETS / 2,
+        // up to 2^40 us, about 12 days
+        BUCKETS = 40 - SUB_BUCKET_BITS + 1
+    };
+
+    static const boost::uint64_t MAX_VALUE = (static_cast<boost::uint64_t>(1) << 40) - 1u;
+
+    LatencyHistogram();
+
+    void record(boost::uint64_t value);
+    void add(const LatencyHistogram &histogram);
+    void clear();
+
+    boost::uint64_t getCount() const;
+    boost::uint64_t getMax() const;
+    double getMean() const;
+    double getStdDeviation() const;
+    // percentile is in [0, 100]
+    boost::uint64_t getPercentile(double percentile) const;
+
+    // the percentile distribution in the HdrHistogram text format (.hgrm),
+    // values are divided by unitRatio
+    void writePercentileDistribution(std::ostream &stream, double unitRatio) const;
+
+private:
+    static std::size_t getIndex(boost::uint64_t value);
+    // the largest value counted by the same index
+    static boost::uint64_t getHighestEquivalentValue(std::size_t index);
+    static boost::uint64_t getMedianEquivalentValue(std::size_t index);
+
+    std::vector<boost::uint64_t> m_counts;
+    boost::uint64_t m_count;
+    boost::uint64_t m_max;
+};
@@ -0,0 +1,272 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/thread/locks.hpp>
+
+#include <pion/http/request.hpp>
+#include <pion/http/types.hpp>
+
+#include "Tools/AsyncHttpClient/ConnectionPool.h"
+#include "Tools/WebServer/Histogram.h"
+
+#include "LoadGenerator.h"
+
+using Tools::WebServer::getTimestampNs;
+
+namespace
+{
+
+const boost::uint64_t NS_PER_SECOND = 1000000000u;
+const boost::uint64_t NS_PER_US = 1000u;
+
+// how often the due requests of the open loop are sent, the later ones are counted as waiting
+const long TIMER_INTERVAL_MS = 1;
+// how often the end of the run is checked while waiting for it
+const long FINISH_CHECK_INTERVAL_MS = 100;
+
+}
+
+//-------------------------------------------------------------------------------------------------
+LoadGenerator::Settings::Settings() :
+    endpoint(boost::asio::ip::address_v4::loopback(), 30000u),
+    method(pion::http::types::REQUEST_METHOD_GET),
+    resource("/bench/hello"),
+    mode(Mode::ClosedLoop),
+    rate(1000.0),
+    connections(64u),
+    keepAlive(true),
+    threads(2u),
+    warmup(5u),
+    duration(30u),
+    timeout(10000u)
+{
+}
+
+//-------------------------------------------------------------------------------------------------
+LoadGenerator::Result::Result() :
+    requests(0u),
+    completedRequests(0u),
+    errors(0u),
+    statusErrors(0u),
+    seconds(0.0)
+{
+}
+
+//-------------------------------------------------------------------------------------------------
+LoadGenerator::LoadGenerator(const Settings &settings) :
+    m_settings(settings),
+    m_schedulerPtr(new pion::single_service_scheduler()),
+    m_timer(m_schedulerPtr->get_io_service()),
+    m_startNs(0u),
+    m_measureFromNs(0u),
+    m_endNs(0u),
+    m_scheduled(0u),
+    m_activeRequests(0u)
+{
+    if (m_settings.connections == 0u)
+    {
+        throw std::invalid_argument("At least one connection is required");
+    }
+    if (m_settings.mode == Mode::OpenLoop && m_settings.rate <= 0.0)
+    {
+        throw std::invalid_argument("The request rate must be positive");
+    }
+
+    m_schedulerPtr->set_num_threads(std::max(m_settings.threads, 1u));
+    m_schedulerPtr->add_active_user();
+
+    Tools::AsyncHttpClient::IConnectionPoolPtr connPoolPtr(
+        new Tools::AsyncHttpClient::ConnectionPool(m_settings.connections, m_schedulerPtr));
+    m_clientPtr.reset(new Tools::AsyncHttpClient::AsyncHttpClient(connPoolPtr, m_schedulerPtr));
+}
+
+//-------------------------------------------------------------------------------------------------
+LoadGenerator::~LoadGenerator()
+{
+    boost::system::error_code ec;
+    m_timer.cancel(ec);
+
+    m_schedulerPtr->remove_active_user();
+    m_schedulerPtr->shutdown();
+    m_schedulerPtr->join();
+}
+
+//-------------------------------------------------------------------------------------------------
+LoadGenerator::Result LoadGenerator::run()
+{
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+
+    m_result = Result();
+    m_scheduled = 0u;
+    m_backlog.clear();
+    m_startNs = getTimestampNs();
+    m_measureFromNs = m_startNs + m_settings.warmup * NS_PER_SECOND;
+    m_endNs = m_measureFromNs + m_settings.duration * NS_PER_SECOND;
+
+    if (m_settings.mode == Mode::ClosedLoop)
+    {
+        for (std::size_t i = 0u; i < m_settings.connections; ++i)
+        {
+            sendRequest(m_startNs);
+        }
+    }
+    else
+    {
+        m_timer.expires_from_now(boost::posix_time::milliseconds(0));
+        m_timer.async_wait(boost::bind(&LoadGenerator::onTimer, this, _1));
+    }
+
+    // the requests of the run are waited for, the late ones are given their timeout
+    while (getTimestampNs() < m_endNs || m_activeRequests != 0u || !m_backlog.empty())
+    {
+        m_finished.timed_wait(lock, boost::posix_time::milliseconds(FINISH_CHECK_INTERVAL_MS));
+    }
+
+    m_result.seconds = static_cast<double>(m_settings.duration);
+    return m_result;
+}
+
+//-------------------------------------------------------------------------------------------------
+std::string LoadGenerator::get(const std::string &resource)
+{
+    Tools::AsyncHttpClient::SingleRequestFuture future = m_clientPtr->createFuture(
+        Tools::AsyncHttpClient::RequestDesc(createRequest(resource), m_settings.endpoint, false),
+        boost::posix_time::milliseconds(m_settings.timeout));
+
+    const Tools::AsyncHttpClient::RequestResult result = future.get();
+    const boost::system::error_code &error = result.get<3>();
+    const pion::http::response_ptr &responsePtr = result.get<2>();
+    if (error || !responsePtr)
+    {
+        throw std::runtime_error("Request of " + resource + " failed: " + error.message());
+    }
+    if (responsePtr->get_status_code() != pion::http::types::RESPONSE_CODE_OK)
+    {
+        throw std::runtime_error("Request of " + resource + " failed: " + responsePtr->get_status_message());
+    }
+
+    return std::string(responsePtr->get_content(), responsePtr->get_content_length());
+}
+
+//-------------------------------------------------------------------------------------------------
+void LoadGenerator::onTimer(const boost::system::error_code &error)
+{
+    if (error)
+    {
+        return;
+    }
+
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+
+    const boost::uint64_t now = getTimestampNs();
+    for (;;)
+    {
+        const boost::uint64_t dueNs = m_startNs
+            + static_cast<boost::uint64_t>(static_cast<double>(m_scheduled) * NS_PER_SECOND / m_settings.rate);
+        if (dueNs > now || dueNs >= m_endNs)
+        {
+            break;
+        }
+
+        if (m_activeRequests < m_settings.connections)
+        {
+            sendRequest(dueNs);
+        }
+        else
+        {
+            m_backlog.push_back(dueNs);
+        }
+        ++m_scheduled;
+    }
+
+    if (now < m_endNs)
+    {
+        m_timer.expires_from_now(boost::posix_time::milliseconds(TIMER_INTERVAL_MS));
+        m_timer.async_wait(boost::bind(&LoadGenerator::onTimer, this, _1));
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+void LoadGenerator::sendRequest(boost::uint64_t dueNs)
+{
+    ++m_activeRequests;
+
+    // the client may call the handler at once, so the request is started without the lock
+    m_schedulerPtr->post(boost::bind(&LoadGenerator::startRequest, this, dueNs));
+}
+
+//-------------------------------------------------------------------------------------------------
+void LoadGenerator::startRequest(boost::uint64_t dueNs)
+{
+    const boost::uint64_t sentNs = getTimestampNs();
+    m_clientPtr->createRequest(
+        Tools::AsyncHttpClient::RequestDesc(createRequest(m_settings.resource), m_settings.endpoint, m_settings.keepAlive),
+        boost::bind(&LoadGenerator::onResponse, this, dueNs, sentNs, _1),
+        boost::posix_time::milliseconds(m_settings.timeout));
+}
+
+//-------------------------------------------------------------------------------------------------
+void LoadGenerator::onResponse(boost::uint64_t dueNs,
+                               boost::uint64_t sentNs,
+                               const Tools::AsyncHttpClient::RequestResult &result)
+{
+    const boost::uint64_t now = getTimestampNs();
+
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+
+    ++m_result.completedRequests;
+    if (dueNs >= m_measureFromNs && dueNs < m_endNs)
+    {
+        ++m_result.requests;
+
+        const pion::http::response_ptr &responsePtr = result.get<2>();
+        if (result.get<3>() || !responsePtr)
+        {
+            ++m_result.errors;
+        }
+        else if (responsePtr->get_status_code() < 200u || responsePtr->get_status_code() >= 300u)
+        {
+            ++m_result.statusErrors;
+        }
+
+        // failed requests are counted too, a timeout is a latency as well
+        m_result.latency.record((now - dueNs) / NS_PER_US);
+        m_result.serviceTime.record((now - sentNs) / NS_PER_US);
+    }
+
+    --m_activeRequests;
+    if (m_settings.mode == Mode::ClosedLoop)
+    {
+        if (now < m_endNs)
+        {
+            sendRequest(now);
+        }
+    }
+    else if (!m_backlog.empty())
+    {
+        sendRequest(m_backlog.front());
+        m_backlog.pop_front();
+    }
+
+    if (m_activeRequests == 0u)
+    {
+        m_finished.notify_all();
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+pion::http::request_ptr LoadGenerator::createRequest(const std::string &resource) const
+{
+    pion::http::request_ptr requestPtr(new pion::http::request());
+    requestPtr->set_method(m_settings.method);
+
+    const std::string::size_type queryPos = resource.find('?');
+    requestPtr->set_resource(resource.substr(0u, queryPos));
+    if (queryPos != std::string::npos)
+    {
+        requestPtr->set_query_string(resource.substr(queryPos + 1u));
+    }
+    return requestPtr;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <deque>
+#include <string>
+
+#include <boost/asio/deadline_timer.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include <pion/scheduler.hpp>
+
+#include "Tools/AsyncHttpClient/AsyncHttpClient.h"
+
+#include "LatencyHistogram.h"
+
+// HTTP load on a single resource through Tools::AsyncHttpClient.
+//
+// Closed loop: every connection sends its next request as soon as the previous one is answered.
+// Open loop: requests are due at a constant rate whatever the server does. When all connections
+// are busy the due requests wait, and their latency is counted from the moment they were due,
+// so a stalled server is not hidden by the load generator slowing down (coordinated omission).
+class LoadGenerator : private boost::noncopyable
+{
+public:
+    enum class Mode { ClosedLoop, OpenLoop };
+
+    struct Settings
+    {
+        Settings();
+
+        boost::asio::ip::tcp::endpoint endpoint;
+        std::string method;
+        // with the query string
+        std::string resource;
+        Mode mode;
+        // requests per second, open loop only
+        double rate;
+        std::size_t connections;
+        bool keepAlive;
+        unsigned threads;
+        // seconds
+        unsigned warmup;
+        unsigned duration;
+        // milliseconds
+        unsigned timeout;
+    };
+
+    struct Result
+    {
+        Result();
+
+        // requests due after the warm up and before the end of the run
+        boost::uint64_t requests;
+        // all requests including the warm up ones
+        boost::uint64_t completedRequests;
+        // failed connections and timeouts
+        boost::uint64_t errors;
+        // answered with a status other than 2xx
+        boost::uint64_t statusErrors;
+        double seconds;
+        // from the moment the request was due
+        LatencyHistogram latency;
+        // from the moment the request was sent
+        LatencyHistogram serviceTime;
+    };
+
+    explicit LoadGenerator(const Settings &settings);
+    ~LoadGenerator();
+
+    // blocks for the warm up and the duration of the run
+    Result run();
+
+    // a single request outside of the measurement, the content of the response is returned
+    std::string get(const std::string &resource);
+
+private:
+    void onTimer(const boost::system::error_code &error);
+    // m_mutex must be locked
+    void sendRequest(boost::uint64_t dueNs);
+    void startRequest(boost::uint64_t dueNs);
+    void onResponse(boost::uint64_t dueNs, boost::uint64_t sentNs, const Tools::AsyncHttpClient::RequestResult &result);
+    pion::http::request_ptr createRequest(const std::string &resource) const;
+
+    Settings m_settings;
+
+    boost::shared_ptr<pion::scheduler> m_schedulerPtr;
+    Tools::AsyncHttpClient::AsyncHttpClientPtr m_clientPtr;
+    boost::asio::deadline_timer m_timer;
+
+    boost::mutex m_mutex;
+    boost::condition_variable m_finished;
+    boost::uint64_t m_startNs;
+    boost::uint64_t m_measureFromNs;
+    boost::uint64_t m_endNs;
+    // open loop: the number of requests which were due so far
+    boost::uint64_t m_scheduled;
+    std::size_t m_activeRequests;
+    // open loop: due times of the requests waiting for a connection
+    std::deque<boost::uint64_t> m_backlog;
+    Result m_result;
+};
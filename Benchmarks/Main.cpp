@@ -0,0 +1,374 @@
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/program_options.hpp>
+
+#include "AcceptBenchmark.h"
+#include "BenchmarkWebSvc.h"
+#include "CoalescerBenchmark.h"
+#include "ConnectionLimitCheck.h"
+#include "CounterBenchmark.h"
+#include "IoShardingBenchmark.h"
+#include "LoadGenerator.h"
+#include "PoolBenchmark.h"
+#include "SchedulerBenchmark.h"
+#include "SchedulerResizeCheck.h"
+#include "StatRenderBenchmark.h"
+#include "TimerBenchmark.h"
+
+namespace po = boost::program_options;
+
+typedef std::map<std::string, double> ServerCounters;
+
+//-------------------------------------------------------------------------------------------------
+void printUsage(const char *programName)
+{
+    std::cerr << "Usage: " << programName << " server --config=configuration-file" << std::endl
+        << "       " << programName << " loadgen [options]" << std::endl
+        << "       " << programName << " counters [options]" << std::endl
+        << "       " << programName << " statrender [options]" << std::endl
+        << "       " << programName << " pools [options]" << std::endl
+        << "       " << programName << " schedulers [options]" << std::endl
+        << "       " << programName << " timers [options]" << std::endl
+        << "       " << programName << " connlimit [options]" << std::endl
+        << "       " << programName << " resizecheck [options]" << std::endl
+        << "       " << programName << " accepts [options]" << std::endl
+        << "       " << programName << " iosharding [options]" << std::endl
+        << "       " << programName << " coalescer [options]" << std::endl << std::endl
+        << "Run \"" << programName << " loadgen --help\" for the load generator options." << std::endl;
+}
+
+//-------------------------------------------------------------------------------------------------
+ServerCounters parseServerCounters(const std::string &content)
+{
+    ServerCounters counters;
+
+    std::istringstream lines(content);
+    std::string line;
+    while (std::getline(lines, line))
+    {
+        const std::string::size_type pos = line.find('=');
+        if (pos == std::string::npos)
+        {
+            continue;
+        }
+        counters[boost::algorithm::trim_copy(line.substr(0u, pos))] =
+            boost::lexical_cast<double>(boost::algorithm::trim_copy(line.substr(pos + 1u)));
+    }
+    return counters;
+}
+
+//-------------------------------------------------------------------------------------------------
+void printLatency(const std::string &title, const LatencyHistogram &histogram)
+{
+    static const double percentiles[] = { 50.0, 90.0, 99.0, 99.9, 99.99 };
+    static const char *const percentileNames[] = { "p50", "p90", "p99", "p999", "p9999" };
+
+    std::cout << title << " (ms):" << std::endl << std::fixed << std::setprecision(3);
+    for (std::size_t i = 0u; i < sizeof(percentiles) / sizeof(percentiles[0]); ++i)
+    {
+        std::cout << "  " << std::setw(7) << std::left << percentileNames[i] << std::right
+            << std::setw(12) << static_cast<double>(histogram.getPercentile(percentiles[i])) / 1000.0 << std::endl;
+    }
+    std::cout << "  " << std::setw(7) << std::left << "max" << std::right
+        << std::setw(12) << static_cast<double>(histogram.getMax()) / 1000.0 << std::endl
+        << "  " << std::setw(7) << std::left << "mean" << std::right
+        << std::setw(12) << histogram.getMean() / 1000.0 << std::endl;
+}
+
+//-------------------------------------------------------------------------------------------------
+void printResult(const LoadGenerator::Settings &settings, const LoadGenerator::Result &result)
+{
+    std::cout << std::fixed << std::setprecision(1)
+        << (settings.mode == LoadGenerator::Mode::OpenLoop ? "open loop at " : "closed loop");
+    if (settings.mode == LoadGenerator::Mode::OpenLoop)
+    {
+        std::cout << settings.rate << " req/s";
+    }
+    std::cout << ", " << settings.connections << " connections, keep-alive "
+        << (settings.keepAlive ? "on" : "off") << ", " << settings.method << " " << settings.resource << std::endl
+        << "requests:   " << result.requests << " in " << result.seconds << " s ("
+        << result.errors << " errors, " << result.statusErrors << " non-2xx)" << std::endl
+        << "throughput: " << static_cast<double>(result.requests) / result.seconds << " req/s";
+    if (!settings.keepAlive)
+    {
+        std::cout << " (= connections/s)";
+    }
+    std::cout << std::endl;
+
+    printLatency("latency from the due time", result.latency);
+    printLatency("latency from the send time", result.serviceTime);
+}
+
+//-------------------------------------------------------------------------------------------------
+void printServerCounters(const ServerCounters &before, const ServerCounters &after, boost::uint64_t requests)
+{
+    std::cout << "server counters per request:" << std::endl << std::fixed << std::setprecision(2);
+    for (ServerCounters::const_iterator i = after.begin(); i != after.end(); ++i)
+    {
+        ServerCounters::const_iterator j = before.find(i->first);
+        const double delta = i->second - (j != before.end() ? j->second : 0.0);
+        std::cout << "  " << std::setw(16) << std::left << i->first << std::right
+            << std::setw(12) << (requests != 0u ? delta / static_cast<double>(requests) : 0.0) << std::endl;
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+int runLoadGenerator(int argc, char **argv)
+{
+    LoadGenerator::Settings settings;
+    std::string host;
+    unsigned short port = 0u;
+    std::string mode;
+    std::string histogramFile;
+    std::string serverCounters;
+
+    po::options_description optionsDescription("Load generator options");
+    optionsDescription.add_options()
+        ("help,h", "Display the options and exit")
+        ("host", po::value<std::string>(&host)->default_value("127.0.0.1"), "Server address")
+        ("port", po::value<unsigned short>(&port)->default_value(30000u), "Server port")
+        ("method", po::value<std::string>(&settings.method)->default_value(settings.method), "Request method")
+        ("resource", po::value<std::string>(&settings.resource)->default_value(settings.resource),
+            "Requested resource with the query string")
+        ("mode", po::value<std::string>(&mode)->default_value("closed"),
+            "closed: the next request is sent when the previous one is answered, "
+            "open: requests are due at --rate whatever the server does")
+        ("rate", po::value<double>(&settings.rate)->default_value(settings.rate), "Requests per second of the open loop")
+        ("connections", po::value<std::size_t>(&settings.connections)->default_value(settings.connections),
+            "Concurrent requests")
+        ("keepalive", po::value<bool>(&settings.keepAlive)->default_value(settings.keepAlive),
+            "Reuse connections, every request opens a new one when off")
+        ("threads", po::value<unsigned>(&settings.threads)->default_value(settings.threads), "Client I/O threads")
+        ("warmup", po::value<unsigned>(&settings.warmup)->default_value(settings.warmup),
+            "Seconds before the measurement")
+        ("duration", po::value<unsigned>(&settings.duration)->default_value(settings.duration),
+            "Seconds of the measurement")
+        ("timeout", po::value<unsigned>(&settings.timeout)->default_value(settings.timeout),
+            "Request timeout in milliseconds")
+        ("histogram-file", po::value<std::string>(&histogramFile),
+            "Percentile distribution of the latency from the due time (HdrHistogram .hgrm format)")
+        ("server-counters", po::value<std::string>(&serverCounters),
+            "Resource of the server counters (/bench/counters) to report them per request");
+
+    po::variables_map options;
+    po::store(po::command_line_parser(argc, argv).options(optionsDescription).run(), options);
+    if (options.count("help"))
+    {
+        std::cerr << optionsDescription << std::endl;
+        return EXIT_SUCCESS;
+    }
+    po::notify(options);
+
+    if (mode == "open")
+    {
+        settings.mode = LoadGenerator::Mode::OpenLoop;
+    }
+    else if (mode != "closed")
+    {
+        throw po::validation_error(po::validation_error::invalid_option_value, "mode", mode);
+    }
+    settings.endpoint = boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string(host), port);
+
+    LoadGenerator loadGenerator(settings);
+
+    ServerCounters countersBefore;
+    if (!serverCounters.empty())
+    {
+        countersBefore = parseServerCounters(loadGenerator.get(serverCounters));
+    }
+
+    const LoadGenerator::Result result = loadGenerator.run();
+    printResult(settings, result);
+
+    if (!serverCounters.empty())
+    {
+        // the server counts the warm up too
+        printServerCounters(countersBefore,
+            parseServerCounters(loadGenerator.get(serverCounters)),
+            result.completedRequests);
+    }
+
+    if (!histogramFile.empty())
+    {
+        std::ofstream stream(histogramFile.c_str());
+        result.latency.writePercentileDistribution(stream, 1000.0);
+        if (!stream)
+        {
+            std::cerr << "Can't write " << histogramFile << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    return result.errors == 0u ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+//-------------------------------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const std::string command = argv[1];
+    if (command == "server")
+    {
+        BenchmarkWebSvc webSvc;
+        return webSvc.run(argc - 1, argv + 1);
+    }
+
+    if (command == "loadgen")
+    {
+        try
+        {
+            return runLoadGenerator(argc - 1, argv + 1);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Load generator failed: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (command == "counters")
+    {
+        try
+        {
+            return runCounterBenchmark(argc - 1, argv + 1);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Counter benchmark failed: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (command == "statrender")
+    {
+        try
+        {
+            return runStatRenderBenchmark(argc - 1, argv + 1);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Stat render benchmark failed: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (command == "pools")
+    {
+        try
+        {
+            return runPoolBenchmark(argc - 1, argv + 1);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Pool benchmark failed: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (command == "schedulers")
+    {
+        try
+        {
+            return runSchedulerBenchmark(argc - 1, argv + 1);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Scheduler benchmark failed: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (command == "timers")
+    {
+        try
+        {
+            return runTimerBenchmark(argc - 1, argv + 1);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Timer benchmark failed: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (command == "connlimit")
+    {
+        try
+        {
+            return runConnectionLimitCheck(argc - 1, argv + 1);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Connection limit check failed: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (command == "resizecheck")
+    {
+        try
+        {
+            return runSchedulerResizeCheck(argc - 1, argv + 1);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Scheduler resize check failed: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (command == "accepts")
+    {
+        try
+        {
+            return runAcceptBenchmark(argc - 1, argv + 1);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Accept benchmark failed: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (command == "iosharding")
+    {
+        try
+        {
+            return runIoShardingBenchmark(argc - 1, argv + 1);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "I/O sharding benchmark failed: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (command == "coalescer")
+    {
+        try
+        {
+            return runCoalescerBenchmark(argc - 1, argv + 1);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Coalescer benchmark failed: " << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    printUsage(argv[0]);
+    return EXIT_FAILURE;
+}
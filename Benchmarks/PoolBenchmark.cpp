@@ -0,0 +1,122 @@
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/lockfree/spsc_queue.hpp>
+#include <boost/program_options.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "Tools/WebServer/RequestArena.h"
+
+#include "AllocationCounter.h"
+#include "PoolBenchmark.h"
+
+namespace po = boost::program_options;
+
+namespace
+{
+
+typedef boost::lockfree::spsc_queue<Tools::WebServer::RequestArena *, boost::lockfree::capacity<1024> > Handoff;
+typedef std::map<std::string, boost::uint64_t> ArenaCounters;
+
+//-------------------------------------------------------------------------------------------------
+void startRequests(Handoff &handoff, std::size_t requests, std::size_t bytes)
+{
+    for (std::size_t i = 0u; i < requests; ++i)
+    {
+        Tools::WebServer::RequestArena *arenaPtr = Tools::WebServer::RequestArena::acquire();
+        arenaPtr->allocate(bytes);
+        while (!handoff.push(arenaPtr))
+        {
+            boost::this_thread::yield();
+        }
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+void finishRequests(Handoff &handoff, std::size_t requests)
+{
+    for (std::size_t i = 0u; i < requests; )
+    {
+        Tools::WebServer::RequestArena *arenaPtr = NULL;
+        if (handoff.pop(arenaPtr))
+        {
+            Tools::WebServer::RequestArena::release(arenaPtr);
+            ++i;
+        }
+        else
+        {
+            boost::this_thread::yield();
+        }
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+ArenaCounters getArenaCounters()
+{
+    Tools::WebServer::IStat::Parameters parameters;
+    Tools::WebServer::RequestArena::getStatistics(parameters);
+
+    ArenaCounters counters;
+    for (Tools::WebServer::IStat::Parameters::const_iterator i = parameters.begin(); i != parameters.end(); ++i)
+    {
+        counters[i->first] = boost::lexical_cast<boost::uint64_t>(i->second);
+    }
+    return counters;
+}
+
+}
+
+//-------------------------------------------------------------------------------------------------
+int runPoolBenchmark(int argc, char **argv)
+{
+    std::size_t requests = 1000000u;
+    std::size_t bytes = 1024u;
+
+    po::options_description optionsDescription("Pool benchmark options");
+    optionsDescription.add_options()
+        ("help,h", "Display the options and exit")
+        ("requests", po::value<std::size_t>(&requests)->default_value(requests), "Arenas handed over")
+        ("bytes", po::value<std::size_t>(&bytes)->default_value(bytes), "Bytes allocated from every arena");
+
+    po::variables_map options;
+    po::store(po::command_line_parser(argc, argv).options(optionsDescription).run(), options);
+    if (options.count("help"))
+    {
+        std::cerr << optionsDescription << std::endl;
+        return EXIT_SUCCESS;
+    }
+    po::notify(options);
+
+    if (requests == 0u)
+    {
+        throw std::invalid_argument("At least one request is required");
+    }
+
+    Handoff handoff;
+    const ArenaCounters before = getArenaCounters();
+    const boost::uint64_t allocationsBefore = AllocationCounter::getAllocations();
+
+    boost::thread finisher(boost::bind(&finishRequests, boost::ref(handoff), requests));
+    startRequests(handoff, requests, bytes);
+    finisher.join();
+
+    const ArenaCounters after = getArenaCounters();
+    const double count = static_cast<double>(requests);
+    std::cout << requests << " requests started and finished on different threads" << std::endl
+        << std::fixed << std::setprecision(4)
+        << "operator new per request:    "
+        << static_cast<double>(AllocationCounter::getAllocations() - allocationsBefore) / count << std::endl;
+    for (ArenaCounters::const_iterator i = after.begin(); i != after.end(); ++i)
+    {
+        std::cout << std::left << std::setw(36) << "arena " + i->first + " per request:" << std::right
+            << static_cast<double>(i->second - before.find(i->first)->second) / count << std::endl;
+    }
+    return EXIT_SUCCESS;
+}
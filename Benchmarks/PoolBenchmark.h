@@ -0,0 +1,5 @@
+#pragma once
+
+// Request arenas acquired on one thread and released on another, as the I/O thread
+// and the worker of a request do. Reports the heap allocations per request.
+int runPoolBenchmark(int argc, char **argv);
@@ -0,0 +1,150 @@
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/program_options.hpp>
+#include <boost/ptr_container/ptr_vector.hpp>
+#include <boost/thread/barrier.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "Tools/WebServer/Histogram.h"
+#include "Tools/WebServer/Scheduler.h"
+#include "Tools/WebServer/WorkStealingScheduler.h"
+
+#include "LatencyHistogram.h"
+#include "SchedulerBenchmark.h"
+
+namespace po = boost::program_options;
+
+namespace
+{
+
+// shared by the handlers of one run
+struct Run
+{
+    explicit Run(std::size_t handlers) :
+        delays(handlers),
+        started(0u)
+    {
+    }
+
+    // ns from execute() to the start, one slot per handler
+    std::vector<boost::uint64_t> delays;
+    boost::atomic<std::size_t> started;
+};
+
+//-------------------------------------------------------------------------------------------------
+void runHandler(Run &run, boost::uint64_t enqueueTime)
+{
+    const boost::uint64_t now = Tools::WebServer::getTimestampNs();
+    run.delays[run.started.fetch_add(1u, boost::memory_order_relaxed)] = now - enqueueTime;
+}
+
+//-------------------------------------------------------------------------------------------------
+void produce(Tools::WebServer::IScheduler &scheduler, Run &run, boost::barrier &barrier, std::size_t handlers)
+{
+    barrier.wait();
+    for (std::size_t i = 0u; i < handlers; ++i)
+    {
+        scheduler.execute(boost::bind(&runHandler, boost::ref(run), Tools::WebServer::getTimestampNs()));
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+void measure(const std::string &title,
+             Tools::WebServer::IWorkScheduler &scheduler,
+             std::size_t producerCount,
+             std::size_t handlers)
+{
+    const std::size_t total = producerCount * handlers;
+    Run run(total);
+
+    scheduler.start();
+
+    // the clock starts when all producers are ready
+    boost::barrier barrier(static_cast<unsigned>(producerCount + 1u));
+    boost::ptr_vector<boost::thread> producers;
+    for (std::size_t i = 0u; i < producerCount; ++i)
+    {
+        producers.push_back(new boost::thread(boost::bind(&produce,
+                                                          boost::ref(scheduler),
+                                                          boost::ref(run),
+                                                          boost::ref(barrier),
+                                                          handlers)));
+    }
+
+    barrier.wait();
+    const boost::uint64_t start = Tools::WebServer::getTimestampNs();
+    for (std::size_t i = 0u; i < producers.size(); ++i)
+    {
+        producers[i].join();
+    }
+    while (run.started.load(boost::memory_order_relaxed) < total)
+    {
+        boost::this_thread::yield();
+    }
+    const double seconds = static_cast<double>(Tools::WebServer::getTimestampNs() - start) / 1e9;
+
+    scheduler.stop();
+
+    LatencyHistogram histogram;
+    for (std::size_t i = 0u; i < total; ++i)
+    {
+        histogram.record(run.delays[i]);
+    }
+
+    std::cout << std::left << std::setw(16) << title << std::right << std::fixed << std::setprecision(2)
+        << std::setw(10) << static_cast<double>(total) / seconds / 1e6 << " M handlers/s"
+        << "   execute to start (us): p50 " << static_cast<double>(histogram.getPercentile(50.0)) / 1000.0
+        << ", p99 " << static_cast<double>(histogram.getPercentile(99.0)) / 1000.0
+        << ", p999 " << static_cast<double>(histogram.getPercentile(99.9)) / 1000.0
+        << ", max " << static_cast<double>(histogram.getMax()) / 1000.0 << std::endl;
+}
+
+}
+
+//-------------------------------------------------------------------------------------------------
+int runSchedulerBenchmark(int argc, char **argv)
+{
+    std::size_t threadCount = 8u;
+    std::size_t producerCount = 4u;
+    std::size_t handlers = 1000000u;
+
+    po::options_description optionsDescription("Scheduler benchmark options");
+    optionsDescription.add_options()
+        ("help,h", "Display the options and exit")
+        ("threads", po::value<std::size_t>(&threadCount)->default_value(threadCount), "Worker threads")
+        ("producers", po::value<std::size_t>(&producerCount)->default_value(producerCount),
+            "Threads calling execute(), as the I/O threads do")
+        ("handlers", po::value<std::size_t>(&handlers)->default_value(handlers), "Handlers per producer");
+
+    po::variables_map options;
+    po::store(po::command_line_parser(argc, argv).options(optionsDescription).run(), options);
+    if (options.count("help"))
+    {
+        std::cerr << optionsDescription << std::endl;
+        return EXIT_SUCCESS;
+    }
+    po::notify(options);
+
+    if (threadCount == 0u || producerCount == 0u || handlers == 0u)
+    {
+        throw std::invalid_argument("Threads, producers and handlers must be positive");
+    }
+
+    std::cout << threadCount << " workers, " << producerCount << " producers, "
+        << handlers << " handlers each" << std::endl;
+
+    // the same fixed number of threads for both
+    Tools::WebServer::Scheduler asioScheduler(threadCount, threadCount);
+    measure("asio", asioScheduler, producerCount, handlers);
+
+    Tools::WebServer::WorkStealingScheduler workStealingScheduler(threadCount);
+    measure("work stealing", workStealingScheduler, producerCount, handlers);
+    return EXIT_SUCCESS;
+}
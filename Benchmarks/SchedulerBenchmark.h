@@ -0,0 +1,5 @@
+#pragma once
+
+// Small handlers executed by the asio scheduler and by the work-stealing scheduler.
+// Reports the throughput and the delay from execute() to the start of a handler.
+int runSchedulerBenchmark(int argc, char **argv);
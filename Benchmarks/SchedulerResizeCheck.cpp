@@ -0,0 +1,161 @@
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/program_options.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "Tools/WebServer/Scheduler.h"
+
+#include "SchedulerResizeCheck.h"
+
+namespace po = boost::program_options;
+
+namespace
+{
+
+// handlers run by the scheduler
+class Handlers
+{
+public:
+    Handlers() :
+        m_executed(0u)
+    {
+    }
+
+    void fail()
+    {
+        throw std::runtime_error("worker killed by the check");
+    }
+
+    void count()
+    {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        ++m_executed;
+        m_condition.notify_all();
+    }
+
+    // false when the handlers were not executed in time
+    bool waitFor(std::size_t executed, const boost::posix_time::time_duration &timeout)
+    {
+        const boost::system_time deadline = boost::get_system_time() + timeout;
+        boost::unique_lock<boost::mutex> lock(m_mutex);
+        while (m_executed < executed)
+        {
+            if (!m_condition.timed_wait(lock, deadline))
+            {
+                return m_executed >= executed;
+            }
+        }
+        return true;
+    }
+
+private:
+    boost::mutex m_mutex;
+    boost::condition_variable m_condition;
+    std::size_t m_executed;
+};
+
+//-------------------------------------------------------------------------------------------------
+std::size_t getThreadsCount(const Tools::WebServer::Scheduler &scheduler)
+{
+    Tools::WebServer::IStat::Parameters parameters;
+    scheduler.getStatistics(parameters);
+    for (std::size_t i = 0u; i < parameters.size(); ++i)
+    {
+        if (parameters[i].first == "threads")
+        {
+            return boost::lexical_cast<std::size_t>(parameters[i].second);
+        }
+    }
+    return 0u;
+}
+
+}
+
+//-------------------------------------------------------------------------------------------------
+int runSchedulerResizeCheck(int argc, char **argv)
+{
+    std::size_t threadCount = 0u;
+    std::size_t minThreads = 0u;
+    std::size_t rounds = 0u;
+
+    po::options_description optionsDescription("Scheduler resize check options");
+    optionsDescription.add_options()
+        ("help,h", "Display the options and exit")
+        ("threads", po::value<std::size_t>(&threadCount)->default_value(8u), "Workers before the shrink")
+        ("min", po::value<std::size_t>(&minThreads)->default_value(2u), "Workers after the shrink")
+        ("rounds", po::value<std::size_t>(&rounds)->default_value(20u), "Shrinks checked");
+
+    po::variables_map options;
+    po::store(po::command_line_parser(argc, argv).options(optionsDescription).run(), options);
+    if (options.count("help"))
+    {
+        std::cerr << optionsDescription << std::endl;
+        return EXIT_SUCCESS;
+    }
+    po::notify(options);
+
+    if (minThreads == 0u || threadCount <= minThreads)
+    {
+        throw std::invalid_argument("The workers must be more than the minimum, the minimum more than 0");
+    }
+
+    // the controller reacts at once, the threads retire at their next handler
+    Tools::WebServer::Scheduler::ResizePolicy policy;
+    policy.samplingInterval = boost::posix_time::milliseconds(10);
+    policy.cooldown = boost::posix_time::time_duration();
+    policy.minThreadLifetime = boost::posix_time::time_duration();
+
+    const boost::posix_time::time_duration timeout = boost::posix_time::seconds(5);
+    for (std::size_t round = 0u; round < rounds; ++round)
+    {
+        // a failed check can leave the resize controller running, it is not stopped then
+        Tools::WebServer::Scheduler *pScheduler = new Tools::WebServer::Scheduler(threadCount, threadCount, policy);
+        pScheduler->start();
+
+        // more workers die than are left after the pending retirements: the controller
+        // requests them within a sample, the workers take one of them per sample
+        Handlers handlers;
+        pScheduler->setThreadLimits(minThreads, minThreads);
+        boost::this_thread::sleep(policy.samplingInterval * 2);
+        for (std::size_t i = 0u; i + 1u < threadCount; ++i)
+        {
+            pScheduler->execute(boost::bind(&Handlers::fail, &handlers));
+        }
+
+        // every handler may retire its worker, the controller must replace them
+        bool isRunning = true;
+        for (std::size_t i = 1u; isRunning && i <= threadCount * 2u; ++i)
+        {
+            pScheduler->execute(boost::bind(&Handlers::count, &handlers));
+            isRunning = handlers.waitFor(i, timeout);
+        }
+
+        const boost::system_time deadline = boost::get_system_time() + timeout;
+        while (isRunning && getThreadsCount(*pScheduler) != minThreads && boost::get_system_time() < deadline)
+        {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+        }
+        const std::size_t threads = getThreadsCount(*pScheduler);
+        if (!isRunning || threads != minThreads)
+        {
+            std::cout << "FAILED in round " << round + 1u << ": "
+                << (isRunning ? "" : "handlers are not executed, ") << threads << " workers, expected "
+                << minThreads << std::endl;
+            return EXIT_FAILURE;
+        }
+
+        delete pScheduler;
+    }
+
+    std::cout << rounds << " shrinks from " << threadCount << " to " << minThreads
+        << " workers with failed handlers passed" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+// Shrinks the asio scheduler and kills its workers by failing handlers while the
+// retirements are pending. The scheduler must keep the minimal number of workers
+// and run handlers; exits with 1 when it does not.
+int runSchedulerResizeCheck(int argc, char **argv);
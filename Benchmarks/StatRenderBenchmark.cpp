@@ -0,0 +1,156 @@
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include <boost/chrono/system_clocks.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/program_options.hpp>
+
+#include "Tools/WebServer/StatService.h"
+
+#include "StatRenderBenchmark.h"
+
+namespace po = boost::program_options;
+
+namespace
+{
+
+static const char *const s_formatNames[Tools::WebServer::SF_COUNT] = { "xml", "prometheus", "openmetrics", "json" };
+
+//-------------------------------------------------------------------------------------------------
+void registerSeries(Tools::WebServer::StatService &stat, std::size_t series, std::size_t processes)
+{
+    // every process has the same parameters of its resources, as the controller would register them
+    const std::size_t resources = (series + processes - 1u) / processes;
+    for (std::size_t i = 0u; i < series; ++i)
+    {
+        Tools::WebServer::IStat::Labels labels;
+        labels.push_back(std::make_pair(std::string("process"), "process_" + boost::lexical_cast<std::string>(i / resources)));
+        labels.push_back(std::make_pair(std::string("resource"), "/api/resource_" + boost::lexical_cast<std::string>(i % resources)));
+
+        const Tools::WebServer::CounterHandle handle = stat.registerParameter("requests", labels);
+        handle.increment(static_cast<long>(i * 7919u % 100000u));
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+bool expect(const std::string &output, const std::string &text, std::size_t count)
+{
+    std::size_t found = 0u;
+    for (std::size_t i = output.find(text); i != std::string::npos; i = output.find(text, i + text.size()))
+    {
+        ++found;
+    }
+    if (found != count)
+    {
+        std::cerr << "Expected " << count << " of " << text << ", found " << found << " in:\n" << output << std::endl;
+        return false;
+    }
+    return true;
+}
+
+//-------------------------------------------------------------------------------------------------
+// the metrics of the services are one family labeled by the service, the values of the labels are escaped
+bool checkExposition()
+{
+    Tools::WebServer::StatService stat("benchmarks", "/stat", "1.0", "0");
+
+    const char *const services[] = { "/hello", "/a\"b\\c\nd" };
+    for (std::size_t i = 0u; i < sizeof(services) / sizeof(services[0]); ++i)
+    {
+        const Tools::WebServer::IStat::Labels labels(1u, std::make_pair(std::string("service"), std::string(services[i])));
+        stat.registerTimer("service_handler_time", labels, Tools::WebServer::StatHistogram::DEFAULT_PRECISION).record(100u);
+        stat.registerRate("service_requests", labels).increment(3);
+    }
+
+    std::string prometheus;
+    stat.render(Tools::WebServer::SF_PROMETHEUS, prometheus);
+    std::string openMetrics;
+    stat.render(Tools::WebServer::SF_OPENMETRICS, openMetrics);
+
+    return expect(prometheus, "# TYPE service_handler_time_us summary\n", 1u)
+        && expect(prometheus, "# TYPE service_handler_time_us_max gauge\n", 1u)
+        && expect(prometheus, "# TYPE service_requests counter\n", 1u)
+        && expect(prometheus, "# TYPE service_requests_rate gauge\n", 1u)
+        && expect(prometheus, "service_handler_time_us{service=\"/hello\",quantile=\"0.5\"} ", 1u)
+        && expect(prometheus, "service_handler_time_us_count{service=\"/a\\\"b\\\\c\\nd\"} 1\n", 1u)
+        && expect(prometheus, "service_requests{service=\"/a\\\"b\\\\c\\nd\"} 3\n", 1u)
+        && expect(prometheus, "service_requests_rate{service=\"/hello\",window=\"1s\"} ", 1u)
+        && expect(prometheus, "\nd\"", 0u)
+        && expect(openMetrics, "service_requests_total{service=\"/hello\"} 3\n", 1u)
+        && expect(openMetrics, "# TYPE service_requests counter\n", 1u);
+}
+
+//-------------------------------------------------------------------------------------------------
+void measure(Tools::WebServer::StatService &stat, Tools::WebServer::StatFormat format, std::size_t renders)
+{
+    std::string output;
+    // the first render grows the string
+    stat.render(format, output);
+
+    std::size_t bytes = 0u;
+    const boost::chrono::steady_clock::time_point start = boost::chrono::steady_clock::now();
+    for (std::size_t i = 0u; i < renders; ++i)
+    {
+        output.clear();
+        stat.render(format, output);
+        bytes += output.size();
+    }
+    const double seconds = boost::chrono::duration<double>(boost::chrono::steady_clock::now() - start).count();
+
+    std::cout << std::left << std::setw(16) << s_formatNames[format] << std::right << std::fixed
+        << std::setprecision(1) << std::setw(12) << seconds * 1e6 / renders << " us/render"
+        << std::setw(12) << bytes / renders << " bytes"
+        << std::setw(10) << seconds * 1e9 / renders / output.size() << " ns/byte" << std::endl;
+}
+
+}
+
+//-------------------------------------------------------------------------------------------------
+int runStatRenderBenchmark(int argc, char **argv)
+{
+    std::size_t series = 10000u;
+    std::size_t processes = 100u;
+    std::size_t renders = 100u;
+
+    po::options_description optionsDescription("Stat render benchmark options");
+    optionsDescription.add_options()
+        ("help,h", "Display the options and exit")
+        ("series", po::value<std::size_t>(&series)->default_value(series), "Labeled parameters")
+        ("processes", po::value<std::size_t>(&processes)->default_value(processes), "Values of the process label")
+        ("renders", po::value<std::size_t>(&renders)->default_value(renders), "Renders of every format");
+
+    po::variables_map options;
+    po::store(po::command_line_parser(argc, argv).options(optionsDescription).run(), options);
+    if (options.count("help"))
+    {
+        std::cerr << optionsDescription << std::endl;
+        return EXIT_SUCCESS;
+    }
+    po::notify(options);
+
+    if (processes == 0u || renders == 0u)
+    {
+        throw std::invalid_argument("At least one process and one render are required");
+    }
+
+    if (!checkExposition())
+    {
+        return EXIT_FAILURE;
+    }
+
+    Tools::WebServer::StatService stat("benchmarks", "/stat", "1.0", "0");
+    registerSeries(stat, series, processes);
+    stat.start();
+
+    std::cout << series << " series, " << renders << " renders of every format" << std::endl;
+    for (std::size_t i = 0u; i < Tools::WebServer::SF_COUNT; ++i)
+    {
+        measure(stat, static_cast<Tools::WebServer::StatFormat>(i), renders);
+    }
+
+    stat.stop();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,5 @@
+#pragma once
+
+// Rendering of the stat document with 10000 (by default) labeled parameters
+// in every format of the stat service.
+int runStatRenderBenchmark(int argc, char **argv);
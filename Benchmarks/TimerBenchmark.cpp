@@ -0,0 +1,242 @@
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/asio/deadline_timer.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/program_options.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "Tools/WebServer/Histogram.h"
+#include "Tools/WebServer/TimerWheel.h"
+
+#include "LatencyHistogram.h"
+#include "TimerBenchmark.h"
+
+namespace po = boost::program_options;
+
+namespace
+{
+
+typedef boost::shared_ptr<boost::asio::deadline_timer> DeadlineTimerPtr;
+
+// runs the expired handlers on the tick thread, nothing but the wheel is measured
+class InlineExecutor : public Tools::WebServer::IScheduler
+{
+public:
+    void execute(Tools::WebServer::SchedulerHandler handler, Tools::WebServer::ExecutionLane) override
+    {
+        handler();
+    }
+};
+
+// the timers of one run, the handlers are called on a single thread
+struct Run
+{
+    Run() :
+        fired(0u),
+        cancelled(0u)
+    {
+    }
+
+    LatencyHistogram lateness;
+    boost::atomic<std::size_t> fired;
+    boost::atomic<std::size_t> cancelled;
+};
+
+struct Result
+{
+    double armNs;
+    double cancelNs;
+    LatencyHistogram lateness;
+};
+
+// outstanding timers expire after the run, the firing ones within a second
+const long OUTSTANDING_MS = 60000;
+const long FIRING_MS = 1000;
+
+//-------------------------------------------------------------------------------------------------
+boost::posix_time::time_duration getDelay(std::size_t i, std::size_t count, long spreadMs, long baseMs)
+{
+    return boost::posix_time::milliseconds(baseMs + static_cast<long>(i * spreadMs / count));
+}
+
+//-------------------------------------------------------------------------------------------------
+void onTimer(Run &run, boost::uint64_t due, const boost::system::error_code &error)
+{
+    if (error)
+    {
+        run.cancelled.fetch_add(1u, boost::memory_order_relaxed);
+        return;
+    }
+
+    const boost::uint64_t now = Tools::WebServer::getTimestampNs();
+    run.lateness.record(now > due ? (now - due) / 1000u : 0u);
+    run.fired.fetch_add(1u, boost::memory_order_release);
+}
+
+//-------------------------------------------------------------------------------------------------
+void waitFor(const boost::atomic<std::size_t> &counter, std::size_t count)
+{
+    while (counter.load(boost::memory_order_acquire) < count)
+    {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    }
+}
+
+//-------------------------------------------------------------------------------------------------
+Result measureWheel(std::size_t count)
+{
+    InlineExecutor executor;
+    Tools::WebServer::TimerWheel wheel(executor);
+    wheel.start();
+
+    Result result;
+    {
+        Run run;
+        std::vector<Tools::WebServer::TimerHandle> handles(count);
+        const boost::uint64_t start = Tools::WebServer::getTimestampNs();
+        for (std::size_t i = 0u; i < count; ++i)
+        {
+            handles[i] = wheel.executeOnTimer(boost::bind(&onTimer, boost::ref(run), 0u, _1),
+                                              getDelay(i, count, OUTSTANDING_MS, OUTSTANDING_MS));
+        }
+        const boost::uint64_t armed = Tools::WebServer::getTimestampNs();
+        for (std::size_t i = 0u; i < count; ++i)
+        {
+            wheel.cancelTimer(handles[i]);
+        }
+        const boost::uint64_t cancelled = Tools::WebServer::getTimestampNs();
+        waitFor(run.cancelled, count);
+
+        result.armNs = static_cast<double>(armed - start) / static_cast<double>(count);
+        result.cancelNs = static_cast<double>(cancelled - armed) / static_cast<double>(count);
+    }
+
+    Run run;
+    for (std::size_t i = 0u; i < count; ++i)
+    {
+        const boost::posix_time::time_duration delay = getDelay(i, count, FIRING_MS, 0);
+        wheel.executeOnTimer(boost::bind(&onTimer,
+                                         boost::ref(run),
+                                         Tools::WebServer::getTimestampNs() + delay.total_microseconds() * 1000u,
+                                         _1),
+                             delay);
+    }
+    waitFor(run.fired, count);
+    result.lateness = run.lateness;
+
+    wheel.stop();
+    return result;
+}
+
+//-------------------------------------------------------------------------------------------------
+Result measureAsio(std::size_t count)
+{
+    boost::asio::io_service ioService;
+    boost::scoped_ptr<boost::asio::io_service::work> workPtr(new boost::asio::io_service::work(ioService));
+    boost::thread ioThread(boost::bind(&boost::asio::io_service::run, &ioService));
+
+    Result result;
+    {
+        Run run;
+        std::vector<DeadlineTimerPtr> timers(count);
+        const boost::uint64_t start = Tools::WebServer::getTimestampNs();
+        for (std::size_t i = 0u; i < count; ++i)
+        {
+            // as the schedulers did before the wheel: a timer object per call
+            timers[i].reset(new boost::asio::deadline_timer(ioService,
+                                                            getDelay(i, count, OUTSTANDING_MS, OUTSTANDING_MS)));
+            timers[i]->async_wait(boost::bind(&onTimer, boost::ref(run), 0u, _1));
+        }
+        const boost::uint64_t armed = Tools::WebServer::getTimestampNs();
+        for (std::size_t i = 0u; i < count; ++i)
+        {
+            timers[i]->cancel();
+        }
+        const boost::uint64_t cancelled = Tools::WebServer::getTimestampNs();
+        waitFor(run.cancelled, count);
+
+        result.armNs = static_cast<double>(armed - start) / static_cast<double>(count);
+        result.cancelNs = static_cast<double>(cancelled - armed) / static_cast<double>(count);
+    }
+
+    Run run;
+    std::vector<DeadlineTimerPtr> timers(count);
+    for (std::size_t i = 0u; i < count; ++i)
+    {
+        const boost::posix_time::time_duration delay = getDelay(i, count, FIRING_MS, 0);
+        timers[i].reset(new boost::asio::deadline_timer(ioService, delay));
+        timers[i]->async_wait(boost::bind(&onTimer,
+                                          boost::ref(run),
+                                          Tools::WebServer::getTimestampNs() + delay.total_microseconds() * 1000u,
+                                          _1));
+    }
+    waitFor(run.fired, count);
+    result.lateness = run.lateness;
+
+    workPtr.reset();
+    ioThread.join();
+    return result;
+}
+
+//-------------------------------------------------------------------------------------------------
+void printResult(const std::string &title, const Result &result)
+{
+    std::cout << "  " << std::left << std::setw(8) << title << std::right << std::fixed << std::setprecision(1)
+        << std::setw(10) << result.armNs << " ns/arm"
+        << std::setw(10) << result.cancelNs << " ns/cancel"
+        << "   late (us): p50 " << result.lateness.getPercentile(50.0)
+        << ", p99 " << result.lateness.getPercentile(99.0)
+        << ", max " << result.lateness.getMax() << std::endl;
+}
+
+}
+
+//-------------------------------------------------------------------------------------------------
+int runTimerBenchmark(int argc, char **argv)
+{
+    std::vector<std::size_t> counts;
+
+    po::options_description optionsDescription("Timer benchmark options");
+    optionsDescription.add_options()
+        ("help,h", "Display the options and exit")
+        ("timers", po::value<std::vector<std::size_t> >(&counts)->multitoken(),
+            "Outstanding timers, 10000 100000 1000000 by default");
+
+    po::variables_map options;
+    po::store(po::command_line_parser(argc, argv).options(optionsDescription).run(), options);
+    if (options.count("help"))
+    {
+        std::cerr << optionsDescription << std::endl;
+        return EXIT_SUCCESS;
+    }
+    po::notify(options);
+
+    if (counts.empty())
+    {
+        counts.push_back(10000u);
+        counts.push_back(100000u);
+        counts.push_back(1000000u);
+    }
+
+    for (std::size_t i = 0u; i < counts.size(); ++i)
+    {
+        if (counts[i] == 0u)
+        {
+            throw std::invalid_argument("At least one timer is required");
+        }
+
+        std::cout << counts[i] << " timers" << std::endl;
+        printResult("wheel", measureWheel(counts[i]));
+        printResult("asio", measureAsio(counts[i]));
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+// The timer wheel against a boost::asio::deadline_timer per timer, with 10k, 100k
+// and 1M outstanding timers: the cost of arming and cancelling a timer and how late
+// the timers fire.
+int runTimerBenchmark(int argc, char **argv);
@@ -0,0 +1,81 @@
+#ifndef ADAPTIVECONCURRENCYLIMITER_H_
+#define ADAPTIVECONCURRENCYLIMITER_H_
+
+// C++
+#include <string>
+#include <stddef.h>
+
+// BOOST
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "Tools/WebServer/Histogram.h"
+#include "Tools/WebServer/IStat.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+// Gradient concurrency limit: once per window of samples the limit is scaled
+// by tolerance * noLoadLatency / windowLatency (clamped to [0.5, 1]) and a queue
+// allowance of sqrt(limit) is added. The limit grows while latency stays flat
+// and shrinks as soon as requests start queueing.
+class AdaptiveConcurrencyLimiter : boost::noncopyable
+{
+public:
+    struct Settings
+    {
+        Settings();
+
+        std::size_t initialLimit;
+        std::size_t minLimit;
+        std::size_t maxLimit;
+        // finished requests per limit update
+        std::size_t windowSamples;
+        // window latency may exceed the no-load one by this factor before the limit shrinks
+        double tolerance;
+        // weight of a new limit estimate, (0, 1]
+        double smoothing;
+    };
+
+    explicit AdaptiveConcurrencyLimiter(const Settings &settings = Settings());
+
+    // false when the request must be shed
+    bool tryAcquire();
+    // completes a request admitted by tryAcquire
+    void release(boost::uint64_t latencyNs);
+
+    std::size_t getLimit() const;
+    std::size_t getInFlight() const;
+    boost::uint64_t getRejected() const;
+    void getStatistics(const std::string &prefix, IStat::Parameters &parameters) const;
+
+private:
+    void updateLimit(double shortLatency, boost::uint64_t now);
+
+    Settings m_settings;
+    boost::atomic<std::size_t> m_limit;
+    boost::atomic<std::size_t> m_inFlight;
+    boost::atomic<boost::uint64_t> m_rejected;
+
+    // guards the window state
+    boost::mutex m_mutex;
+    double m_estimatedLimit;
+    double m_noLoadLatency;
+    boost::uint64_t m_lastUpdateTime;
+    double m_windowLatencySum;
+    std::size_t m_windowSamples;
+    std::size_t m_windowMaxInFlight;
+};
+
+typedef boost::shared_ptr<AdaptiveConcurrencyLimiter> AdaptiveConcurrencyLimiterPtr;
+
+} /* namespace WebServer */
+} /* namespace Tools */
+
+#endif /* ADAPTIVECONCURRENCYLIMITER_H_ */
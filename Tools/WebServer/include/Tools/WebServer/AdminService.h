@@ -0,0 +1,51 @@
+#ifndef ADMINSERVICE_H_
+#define ADMINSERVICE_H_
+
+// C++
+#include <map>
+#include <string>
+
+#include "Tools/WebServer/IWebService.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+class WebServer;
+
+// Settings of the running server which are changed without a restart.
+// GET lists them, POST applies the ones given as query or form parameters:
+// httpthreads, workerthreads, minworkerthreads and connectionlimit.
+// The service is not authenticated, it answers the clients of the local host
+// only unless isRemoteAllowed is set.
+class AdminService : public Tools::WebServer::IWebService
+{
+public:
+    AdminService(WebServer &webServer, bool isRemoteAllowed);
+    virtual ~AdminService();
+
+    // IWebService overloads
+    virtual void operator()(ConnectionContextPtr contextPtr);
+    virtual void start(void);
+    virtual void stop(void);
+
+private:
+    // all or nothing
+    void apply(const std::map<std::string, std::size_t> &values);
+    void set(const std::string &name, std::size_t value);
+    std::string getSettings() const;
+    static bool isLocal(const pion::tcp::connection_ptr &tcpConnPtr);
+    static void sendResponse(ConnectionContextPtr contextPtr,
+                             unsigned statusCode,
+                             const std::string &statusMessage,
+                             const std::string &content);
+
+    WebServer &m_webServer;
+    bool m_isRemoteAllowed;
+};
+
+} /* namespace WebServer */
+} /* namespace Tools */
+
+#endif /* ADMINSERVICE_H_ */
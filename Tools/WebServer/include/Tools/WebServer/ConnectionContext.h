@@ -1,51 +1,129 @@
 #ifndef CONNECTIONCONTEXT_H_
 #define CONNECTIONCONTEXT_H_
 
+// C++
+#include <vector>
+
 // BOOST
 #include <boost/atomic.hpp>
 #include <boost/enable_shared_from_this.hpp>
+#include <boost/function.hpp>
 #include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/system/error_code.hpp>
 
 // PION
 #include <pion/http/request.hpp>
 #include <pion/http/response.hpp>
+#include <pion/http/response_writer.hpp>
 #include <pion/tcp/connection.hpp>
 
 #include "Tools/WebServer/IStat.h"
+#include "Tools/WebServer/RequestArena.h"
+#include "Tools/WebServer/ResponseBody.h"
 
 namespace Tools
 {
 namespace WebServer
 {
 
+class ConnectionContext;
+typedef boost::shared_ptr<ConnectionContext> ConnectionContextPtr;
+
 class ConnectionContext :
         public boost::enable_shared_from_this<ConnectionContext>,
         private boost::noncopyable
 {
 public:
+    typedef boost::function<void()> FinishHandler;
+    // the body is empty when the content is set in the response
+    typedef boost::function<void(pion::http::response &, const ResponseBody &)> ResponseHandler;
+    typedef boost::function<void(const boost::system::error_code &)> WriteHandler;
+
     ConnectionContext(pion::http::request_ptr requestPtr,
                       pion::tcp::connection_ptr tcpConnPtr,
                       Tools::WebServer::IStatPtr statPtr,
-                      boost::atomic_int32_t &activeRequestsCount);
+                      boost::atomic_int32_t &activeRequestsCount,
+                      const boost::atomic<bool> &isDraining,
+                      ResponseBodyCounters &responseBodyCounters);
     virtual ~ConnectionContext();
 
+    // the memory of finished contexts is reused by the thread that creates the next ones
+    static ConnectionContextPtr create(pion::http::request_ptr requestPtr,
+                                       pion::tcp::connection_ptr tcpConnPtr,
+                                       Tools::WebServer::IStatPtr statPtr,
+                                       boost::atomic_int32_t &activeRequestsCount,
+                                       const boost::atomic<bool> &isDraining,
+                                       ResponseBodyCounters &responseBodyCounters);
+    static void getPoolStatistics(IStat::Parameters &parameters);
+
     pion::http::request_ptr getRequest();
     pion::tcp::connection_ptr getTcpConn();
     Tools::WebServer::IStatPtr getStat();
+    // scratch memory which lives as long as the request, see ArenaAllocator
+    RequestArena &getArena();
     void sendResponse(pion::http::response_ptr responsePtr);
+    // the body buffers are written as they are, the content of the response must be empty
+    void sendResponse(pion::http::response_ptr responsePtr, ResponseBodyPtr bodyPtr);
+    // for responses sent in several parts, the last one must be sent with writer->send()
+    // which finishes the connection; the unshared handlers are called instead of the
+    // response handlers
+    pion::http::response_writer_ptr createResponseWriter(pion::http::response_ptr responsePtr);
+
+    // Chunked response: the headers go out with the first chunk. The body is gzipped
+    // on the fly when compress is set and the client accepts gzip.
+    // The response handlers get the sent body once the last chunk is written, or the
+    // unshared handlers are called as soon as the body is too large to keep.
+    void beginResponse(pion::http::response_ptr responsePtr, bool compress = false);
+    // only one chunk may be in flight, the next one should be written from the handler
+    void writeChunk(const std::string &data, const WriteHandler &handler);
+    void finishResponse();
     bool isResponseSet() const;
+    // called when the request is done, that is when the context is destroyed
+    void addFinishHandler(const FinishHandler &finishHandler);
+    // called with the response before it is sent
+    void addResponseHandler(const ResponseHandler &responseHandler);
+    // called when the response handlers will not get the response body
+    void addUnsharedHandler(const FinishHandler &unsharedHandler);
 
 private:
+    struct ChunkedResponse;
+
+    struct ArenaHolder : boost::noncopyable
+    {
+        ArenaHolder();
+        ~ArenaHolder();
+
+        RequestArena *arenaPtr;
+    };
+
+    typedef ArenaVector<FinishHandler>::type FinishHandlers;
+    typedef ArenaVector<ResponseHandler>::type ResponseHandlers;
+
+    void onChunkWritten(WriteHandler handler, const boost::system::error_code &error);
+    void onLastChunkWritten(const boost::system::error_code &error);
+    void keepSentData(ChunkedResponse &response);
+    void callResponseHandlers(pion::http::response &response, const ResponseBody &body);
+    void callUnsharedHandlers();
+    ChunkedResponse &getChunkedResponse();
+    void closeIfDraining();
+
     pion::http::request_ptr m_requestPtr;
     pion::tcp::connection_ptr m_tcpConnPtr;
     Tools::WebServer::IStatPtr m_statPtr;
     bool m_responseSet;
     boost::atomic_int32_t &m_activeRequestsCount;
+    const boost::atomic<bool> &m_isDraining;
+    ResponseBodyCounters &m_responseBodyCounters;
+    // released after the handlers allocated from it
+    ArenaHolder m_arena;
+    FinishHandlers m_finishHandlers;
+    ResponseHandlers m_responseHandlers;
+    FinishHandlers m_unsharedHandlers;
+    boost::scoped_ptr<ChunkedResponse> m_chunkedResponsePtr;
 };
 
-typedef boost::shared_ptr<ConnectionContext> ConnectionContextPtr;
-
 } /* namespace WebServer */
 } /* namespace Tools */
 #endif /* CONNECTIONCONTEXT_H_ */
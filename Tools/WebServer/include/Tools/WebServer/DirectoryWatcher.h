@@ -0,0 +1,49 @@
+#ifndef DIRECTORYWATCHER_H_
+#define DIRECTORYWATCHER_H_
+
+// BOOST
+#include <boost/atomic.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace Tools
+{
+namespace WebServer
+{
+
+// Reports changes of the files under a directory and its subdirectories:
+// ReadDirectoryChangesW on Windows, inotify on Linux. The handler is called
+// on the watcher thread, the changed files are not reported.
+class DirectoryWatcher : boost::noncopyable
+{
+public:
+    typedef boost::function<void()> ChangeHandler;
+
+    DirectoryWatcher(const boost::filesystem::path &directory, const ChangeHandler &changeHandler);
+    ~DirectoryWatcher();
+
+    // false when the directory cannot be watched, e.g. on other platforms
+    bool start();
+    void stop();
+    // false once watching failed, the changes are not reported any more
+    bool isWatching() const;
+
+private:
+    struct Impl;
+
+    void run();
+
+    boost::filesystem::path m_directory;
+    ChangeHandler m_changeHandler;
+    boost::scoped_ptr<Impl> m_implPtr;
+    boost::thread m_thread;
+    boost::atomic<bool> m_isWatching;
+};
+
+} /* namespace WebServer */
+} /* namespace Tools */
+
+#endif /* DIRECTORYWATCHER_H_ */
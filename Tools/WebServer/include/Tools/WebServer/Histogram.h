@@ -0,0 +1,79 @@
+#ifndef HISTOGRAM_H_
+#define HISTOGRAM_H_
+
+// C++
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+// BOOST
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+
+#include "Tools/WebServer/IStat.h"
+#include "Tools/WebServer/StatHistogram.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+// Log-linear histogram: every power of two is split into 8 linear buckets,
+// so a recorded value is known within 12.5%.
+// Written by a single thread, may be read concurrently, see StatHistogram for several writers.
+class Histogram : boost::noncopyable
+{
+public:
+    enum
+    {
+        SUB_BUCKET_BITS = 3,
+        SUB_BUCKETS = 1 << SUB_BUCKET_BITS,
+        BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS
+    };
+
+    Histogram();
+
+    void record(boost::uint64_t value)
+    {
+        boost::atomic<boost::uint64_t> &counter = m_counts[getBucket(value)];
+        counter.store(counter.load(boost::memory_order_relaxed) + 1u, boost::memory_order_relaxed);
+    }
+
+    boost::uint64_t getBucketCount(std::size_t bucket) const;
+    // must be called by the writing thread
+    void add(const Histogram &histogram);
+
+    static std::size_t getBucket(boost::uint64_t value);
+    // middle of the bucket range
+    static boost::uint64_t getBucketValue(std::size_t bucket);
+
+private:
+    boost::atomic<boost::uint64_t> m_counts[BUCKETS];
+};
+
+// Sum of several histograms
+class HistogramSnapshot
+{
+public:
+    HistogramSnapshot();
+
+    void add(const Histogram &histogram);
+    void clear();
+    boost::uint64_t getCount() const;
+    // percentile is in [0, 100]
+    boost::uint64_t getPercentile(double percentile) const;
+    // <prefix>_count and <prefix>_p50<suffix> .. <prefix>_p999<suffix>
+    void getStatistics(const std::string &prefix,
+                       const std::string &suffix,
+                       IStat::Parameters &parameters) const;
+
+private:
+    std::vector<boost::uint64_t> m_counts;
+    boost::uint64_t m_count;
+};
+
+} /* namespace WebServer */
+} /* namespace Tools */
+
+#endif /* HISTOGRAM_H_ */
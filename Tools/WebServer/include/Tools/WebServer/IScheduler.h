@@ -1,11 +1,17 @@
 #ifndef ISCHEDULER_H_
 #define ISCHEDULER_H_
 
+// C++
+#include <stddef.h>
+
 // BOOST
-#include <boost/asio/deadline_timer.hpp>
+#include <boost/cstdint.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/function.hpp>
+#include <boost/system/error_code.hpp>
+
+#include "Tools/WebServer/IStat.h"
 
 namespace Tools
 {
@@ -14,7 +20,12 @@ namespace WebServer
 
 typedef boost::function<void()> SchedulerHandler;
 typedef boost::function<void(const boost::system::error_code &)> SchedulerTimerHandler;
-typedef boost::shared_ptr<boost::asio::deadline_timer> DeadlineTimerPtr;
+
+// Dispatch priority of a handler, lower value is more urgent
+enum ExecutionLane
+{
+    EL_INTERACTIVE, EL_NORMAL, EL_BULK, EL_COUNT
+};
 
 class IScheduler
 {
@@ -22,23 +33,79 @@ public:
     virtual ~IScheduler()
     {}
 
-    virtual void execute(SchedulerHandler handler) = 0;
+    virtual void execute(SchedulerHandler handler, ExecutionLane lane = EL_NORMAL) = 0;
 };
 
 typedef boost::shared_ptr<IScheduler> ISchedulerPtr;
 
+// Identifies a timer scheduled with ITimerScheduler::executeOnTimer.
+// Stays valid for cancelTimer after the timer fired, cancelling it is then a no-op.
+class TimerHandle
+{
+public:
+    TimerHandle() :
+            m_index(0xffffffffu),
+            m_generation(0u)
+    {
+    }
+
+    TimerHandle(boost::uint32_t index, boost::uint32_t generation) :
+            m_index(index),
+            m_generation(generation)
+    {
+    }
+
+    bool isValid() const
+    {
+        return m_index != 0xffffffffu;
+    }
+
+    boost::uint32_t getIndex() const
+    {
+        return m_index;
+    }
+
+    boost::uint32_t getGeneration() const
+    {
+        return m_generation;
+    }
+
+private:
+    boost::uint32_t m_index;
+    boost::uint32_t m_generation;
+};
+
 class ITimerScheduler : public IScheduler
 {
 public:
     virtual ~ITimerScheduler()
     {}
 
-    virtual DeadlineTimerPtr executeOnTimer(SchedulerTimerHandler handler,
-                                            const boost::posix_time::time_duration &timeDuration) = 0;
+    virtual TimerHandle executeOnTimer(SchedulerTimerHandler handler,
+                                       const boost::posix_time::time_duration &timeDuration) = 0;
+    // the handler of a cancelled timer is executed with boost::asio::error::operation_aborted
+    virtual bool cancelTimer(const TimerHandle &timerHandle) = 0;
 };
 
 typedef boost::shared_ptr<ITimerScheduler> ITimerSchedulerPtr;
 
+class IWorkScheduler : public ITimerScheduler
+{
+public:
+    virtual ~IWorkScheduler()
+    {}
+
+    virtual void start() = 0;
+    virtual void stop() = 0;
+    virtual bool isRunning() const = 0;
+    virtual void getStatistics(IStat::Parameters &parameters) const = 0;
+    // the running scheduler adds or retires threads to fit the limits,
+    // false when its thread count is fixed
+    virtual bool setThreadLimits(std::size_t minThreads, std::size_t maxThreads) = 0;
+};
+
+typedef boost::shared_ptr<IWorkScheduler> IWorkSchedulerPtr;
+
 } /* namespace WebServer */
 } /* namespace Tools */
 
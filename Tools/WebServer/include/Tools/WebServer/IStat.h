@@ -3,30 +3,182 @@
 
 // C++
 #include <string>
+#include <utility>
+#include <vector>
 
 // BOOST
 #include <boost/cstdint.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+
+#include "Tools/WebServer/ShardedCounter.h"
+#include "Tools/WebServer/StatHistogram.h"
+#include "Tools/WebServer/StatRate.h"
 
 namespace Tools
 {
 namespace WebServer
 {
 
+// Registered parameter updated without the lookup by name.
+// An empty handle ignores the updates.
+class CounterHandle
+{
+public:
+    CounterHandle()
+    {
+    }
+
+    explicit CounterHandle(const ShardedCounterPtr &counterPtr) :
+            m_counterPtr(counterPtr)
+    {
+    }
+
+    void increment(long value) const
+    {
+        if (m_counterPtr)
+        {
+            m_counterPtr->add(value);
+        }
+    }
+
+    void set(long value) const
+    {
+        if (m_counterPtr)
+        {
+            m_counterPtr->set(value);
+        }
+    }
+
+    long get() const
+    {
+        return m_counterPtr ? m_counterPtr->get() : 0;
+    }
+
+private:
+    ShardedCounterPtr m_counterPtr;
+};
+
+// Registered histogram or timer.
+// An empty handle ignores the values.
+class HistogramHandle
+{
+public:
+    HistogramHandle()
+    {
+    }
+
+    explicit HistogramHandle(const StatHistogramPtr &histogramPtr) :
+            m_histogramPtr(histogramPtr)
+    {
+    }
+
+    void record(boost::uint64_t value) const
+    {
+        if (m_histogramPtr)
+        {
+            m_histogramPtr->record(value);
+        }
+    }
+
+    bool empty() const
+    {
+        return !m_histogramPtr;
+    }
+
+private:
+    StatHistogramPtr m_histogramPtr;
+};
+
+// Registered rate or EWMA, counted without the lookup by name.
+// An empty handle ignores the updates.
+class RateHandle
+{
+public:
+    RateHandle()
+    {
+    }
+
+    explicit RateHandle(const StatRatePtr &ratePtr) :
+            m_ratePtr(ratePtr)
+    {
+    }
+
+    void increment(long value) const
+    {
+        if (m_ratePtr)
+        {
+            m_ratePtr->add(value);
+        }
+    }
+
+    long get() const
+    {
+        return m_ratePtr ? m_ratePtr->get() : 0;
+    }
+
+private:
+    StatRatePtr m_ratePtr;
+};
+
+// Records its lifetime into a timer in microseconds.
+class ScopedTimer : boost::noncopyable
+{
+public:
+    explicit ScopedTimer(const HistogramHandle &timer) :
+            m_timer(timer),
+            m_startTime(timer.empty() ? 0u : getTimestampNs())
+    {
+    }
+
+    ~ScopedTimer()
+    {
+        if (!m_timer.empty())
+        {
+            m_timer.record((getTimestampNs() - m_startTime) / 1000u);
+        }
+    }
+
+private:
+    const HistogramHandle m_timer;
+    const boost::uint64_t m_startTime;
+};
+
 class IStat
 {
 public:
     typedef std::pair<std::string, std::string> Parameter;
     typedef std::vector<Parameter> Parameters;
     typedef boost::function<void (Parameters&)> ParametersProvider;
+    // name and value, e.g. the process name or the service resource
+    typedef std::vector<std::pair<std::string, std::string> > Labels;
 
 public:
     virtual ~IStat() {}
 
-    virtual void registerParameter(const std::string &name) = 0;
+    virtual CounterHandle registerParameter(const std::string &name) = 0;
+    // parameters of the same name differ by their labels,
+    // set() and increment() by name find the one without labels
+    virtual CounterHandle registerParameter(const std::string &name, const Labels &labels) = 0;
     virtual void set(const std::string &name, const long value) = 0;
     virtual void increment(const std::string &name, const long value) = 0;
+    // precision is StatHistogram::MIN_PRECISION .. MAX_PRECISION,
+    // registering a name again returns the same histogram
+    virtual HistogramHandle registerHistogram(const std::string &name, unsigned precision) = 0;
+    // histogram of microseconds for ScopedTimer
+    virtual HistogramHandle registerTimer(const std::string &name, unsigned precision) = 0;
+    // counter with its rates per second over 1, 10 and 60 seconds,
+    // registering a name again returns the same counter
+    virtual RateHandle registerRate(const std::string &name) = 0;
+    // as registerRate, the rates are exponentially weighted moving averages
+    virtual RateHandle registerEwma(const std::string &name) = 0;
+    // histograms and rates of the same name differ by their labels as the parameters do,
+    // e.g. one family of a metric with a label of every service
+    virtual HistogramHandle registerHistogram(const std::string &name, const Labels &labels, unsigned precision) = 0;
+    virtual HistogramHandle registerTimer(const std::string &name, const Labels &labels, unsigned precision) = 0;
+    virtual RateHandle registerRate(const std::string &name, const Labels &labels) = 0;
+    virtual RateHandle registerEwma(const std::string &name, const Labels &labels) = 0;
     virtual void registerParametersProvider(const std::string &name,
     		                                const ParametersProvider &parametersProvider) = 0;
     virtual void unregisterParametersProvider(const std::string &name) = 0;
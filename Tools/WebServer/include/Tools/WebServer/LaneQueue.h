@@ -0,0 +1,93 @@
+#ifndef LANEQUEUE_H_
+#define LANEQUEUE_H_
+
+// C++
+#include <deque>
+#include <stddef.h>
+
+// BOOST
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "Tools/WebServer/IScheduler.h"
+#include "Tools/WebServer/IStat.h"
+
+// Queue wait and execution time of every handler are recorded into histograms
+// and the lane statistics unless TOOLS_WEBSERVER_NO_HANDLER_TIMINGS is defined
+#ifndef TOOLS_WEBSERVER_NO_HANDLER_TIMINGS
+#define TOOLS_WEBSERVER_HANDLER_TIMINGS
+#endif
+
+namespace Tools
+{
+namespace WebServer
+{
+
+enum LanePolicy
+{
+    // lower lanes are served only when all upper lanes are empty
+    LP_STRICT,
+    // lanes are served in proportion to their weights
+    LP_WEIGHTED
+};
+
+const char *getLaneName(ExecutionLane lane);
+
+// Per-lane counters shared by all queues of a scheduler
+class LaneStatistics : boost::noncopyable
+{
+public:
+    LaneStatistics();
+
+    void onPush(ExecutionLane lane);
+    void onPop(ExecutionLane lane, boost::uint64_t waitMicroseconds);
+    void onClear(ExecutionLane lane, std::size_t count);
+    void getStatistics(IStat::Parameters &parameters) const;
+
+private:
+    boost::atomic<std::size_t> m_depth[EL_COUNT];
+    boost::atomic<boost::uint64_t> m_dispatched[EL_COUNT];
+    boost::atomic<boost::uint64_t> m_totalWait[EL_COUNT];
+    boost::atomic<boost::uint64_t> m_maxWait[EL_COUNT];
+};
+
+class LaneQueue : boost::noncopyable
+{
+public:
+    LaneQueue(LanePolicy policy, LaneStatistics &statistics);
+
+    void push(const SchedulerHandler &handler, ExecutionLane lane);
+    bool pop(SchedulerHandler &handler);
+    // waitNs is the time the handler spent in the queue, 0 without the handler timings
+    bool pop(SchedulerHandler &handler, boost::uint64_t &waitNs);
+    // does not wait if the queue is locked by another thread
+    bool tryPop(SchedulerHandler &handler);
+    void clear();
+
+private:
+    struct Item
+    {
+        SchedulerHandler handler;
+#ifdef TOOLS_WEBSERVER_HANDLER_TIMINGS
+        // getTimestampNs() of the push
+        boost::uint64_t enqueueTime;
+#endif
+    };
+
+    bool popLocked(SchedulerHandler &handler, boost::uint64_t &waitNs);
+    int selectLane();
+
+    LanePolicy m_policy;
+    LaneStatistics &m_statistics;
+    boost::mutex m_mutex;
+    std::deque<Item> m_items[EL_COUNT];
+    unsigned m_credits[EL_COUNT];
+};
+
+} /* namespace WebServer */
+} /* namespace Tools */
+
+#endif /* LANEQUEUE_H_ */
@@ -1,10 +1,25 @@
 #ifndef PIONWEBSERVERCORE_H_
 #define PIONWEBSERVERCORE_H_
 
+// C++
+#include <list>
+#include <set>
+#include <vector>
+
+// BOOST
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+#include <boost/weak_ptr.hpp>
 
 #include <pion/http/plugin_server.hpp>
 
+#include "Tools/WebServer/IStat.h"
+
 namespace Tools
 {
 namespace WebServer
@@ -12,17 +27,34 @@ namespace WebServer
 namespace Detail
 {
 
+// Keeps the number of connections within the limit: when a new connection
+// exceeds it the keep-alive connections idle for the longest time are closed,
+// the new connection is refused only if there is no idle one left.
 class PionWebServerCore : public pion::http::plugin_server
 {
 public:
     PionWebServerCore(pion::scheduler &scheduler,
                       const boost::asio::ip::tcp::endpoint &endpoint,
                       std::size_t timeout,
-                      std::size_t connectionLimit);
+                      std::size_t connectionLimit,
+                      std::size_t idleTimeout);
     virtual ~PionWebServerCore();
 
     std::size_t getConnectionLimit() const;
+    // a lowered limit is reached by evicting idle connections as new ones come
+    void setConnectionLimit(std::size_t connectionLimit);
     std::size_t getTimeout() const;
+    std::size_t getIdleTimeout() const;
+
+    // Listens with own sockets bound with SO_REUSEPORT instead of the pion acceptor,
+    // one socket per io_service. Connections accepted by a socket stay on its io_service.
+    void startAcceptors(const std::vector<boost::asio::io_service *> &ioServices);
+    void stopAcceptors();
+    // new connections are refused, idle keep-alive ones are closed
+    // and the active ones get Connection: close with the next response
+    void beginDrain();
+
+    void getStatistics(IStat::Parameters &parameters) const;
 
 protected:
     virtual void handle_connection(pion::tcp::connection_ptr &tcpConnPtr);
@@ -31,8 +63,59 @@ protected:
                         pion::tcp::connection_ptr tcp_conn, 
                         const boost::system::error_code& ec);
 private:
+    struct IdleConnection
+    {
+        pion::tcp::connection *key;
+        boost::weak_ptr<pion::tcp::connection> connection;
+    };
+
+    // the oldest first
+    typedef std::list<IdleConnection> IdleConnections;
+    typedef boost::unordered_map<pion::tcp::connection *, IdleConnections::iterator> IdleIndex;
+    // evicted but not yet released by their readers
+    typedef boost::unordered_set<pion::tcp::connection *> ClosingConnections;
+
+    struct Acceptor
+    {
+        explicit Acceptor(boost::asio::io_service &ioService):
+            ioService(ioService),
+            acceptor(ioService)
+        {
+        }
+
+        boost::asio::io_service &ioService;
+        boost::asio::ip::tcp::acceptor acceptor;
+    };
+
+    typedef boost::shared_ptr<Acceptor> AcceptorPtr;
+
+    void accept(AcceptorPtr acceptorPtr);
+    void onAccepted(AcceptorPtr acceptorPtr,
+                    pion::tcp::connection_ptr tcpConnPtr,
+                    const boost::system::error_code &ec);
+    void finishConnection(pion::tcp::connection_ptr tcpConnPtr);
+    std::size_t getConnections() const;
+    bool acceptConnection();
+
     std::size_t m_timeout;
-    std::size_t m_connectionLimit;
+    boost::atomic<std::size_t> m_connectionLimit;
+    std::size_t m_idleTimeout;
+
+    mutable boost::mutex m_idleMutex;
+    IdleConnections m_idleConnections;
+    IdleIndex m_idleIndex;
+    ClosingConnections m_closingConnections;
+
+    // connections of the own acceptors
+    std::vector<AcceptorPtr> m_acceptors;
+    boost::atomic<bool> m_isAccepting;
+    boost::atomic<bool> m_isDraining;
+    mutable boost::mutex m_connectionsMutex;
+    boost::condition_variable m_noConnections;
+    std::set<pion::tcp::connection_ptr> m_connections;
+
+    boost::atomic<boost::uint64_t> m_evicted;
+    boost::atomic<boost::uint64_t> m_refused;
 };
 
 typedef boost::shared_ptr<PionWebServerCore> PionWebServerCorePtr;
@@ -0,0 +1,58 @@
+#ifndef QUEUEDELAYSHEDDER_H_
+#define QUEUEDELAYSHEDDER_H_
+
+// BOOST
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "Tools/WebServer/IStat.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+// CoDel-style admission control on the time requests wait for a worker.
+// The server is overloaded while the minimal wait over the last interval
+// exceeds the target. Then every request that waited longer than the target
+// is dropped, otherwise only requests that waited longer than the interval.
+class QueueDelayShedder : boost::noncopyable
+{
+public:
+    struct Settings
+    {
+        Settings();
+
+        boost::posix_time::time_duration target;
+        boost::posix_time::time_duration interval;
+    };
+
+    explicit QueueDelayShedder(const Settings &settings = Settings());
+
+    // called when a worker picks the request up, true if it must be dropped
+    bool shouldDrop(boost::uint64_t sojournNs);
+
+    bool isOverloaded() const;
+    boost::uint64_t getDropped() const;
+    void getStatistics(IStat::Parameters &parameters) const;
+
+private:
+    boost::uint64_t m_targetNs;
+    boost::uint64_t m_intervalNs;
+
+    boost::atomic<boost::uint64_t> m_intervalStart;
+    boost::atomic<boost::uint64_t> m_minDelay;
+    boost::atomic<boost::uint64_t> m_lastMinDelay;
+    boost::atomic<bool> m_isOverloaded;
+    boost::atomic<boost::uint64_t> m_dropped;
+};
+
+typedef boost::shared_ptr<QueueDelayShedder> QueueDelayShedderPtr;
+
+} /* namespace WebServer */
+} /* namespace Tools */
+
+#endif /* QUEUEDELAYSHEDDER_H_ */
@@ -0,0 +1,167 @@
+#ifndef REQUESTARENA_H_
+#define REQUESTARENA_H_
+
+// C++
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <string>
+#include <vector>
+
+// BOOST
+#include <boost/noncopyable.hpp>
+
+#include "Tools/WebServer/IStat.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+// Monotonic memory of a request: allocations are released all at once when
+// the arena goes back to the pool. The pool is a lock-free stack shared by all
+// threads, as a request is started by an I/O thread and usually finished by
+// a worker. Arenas keep their first block, so a typical request does not
+// touch the heap.
+class RequestArena : boost::noncopyable
+{
+public:
+    enum
+    {
+        BLOCK_SIZE = 4096,
+        ALIGNMENT = 16,
+        // arenas kept for reuse
+        MAX_POOLED = 1024
+    };
+
+    static RequestArena *acquire();
+    // the memory of the arena must not be used afterwards
+    static void release(RequestArena *arenaPtr);
+    static void getStatistics(IStat::Parameters &parameters);
+
+    void *allocate(std::size_t size);
+    // memory is released with the whole arena
+    void deallocate(void *, std::size_t) {}
+    std::size_t getAllocated() const;
+
+private:
+    struct Pool;
+
+    struct Block
+    {
+        Block *next;
+        std::size_t size;
+    };
+
+    RequestArena();
+    ~RequestArena();
+
+    void *allocateBlock(std::size_t size);
+    void reset();
+
+    static Pool s_pool;
+
+    Block *m_blocks;
+    char *m_current;
+    char *m_end;
+    std::size_t m_allocated;
+};
+
+// Allocator for standard containers over a request arena
+template <typename T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+    typedef T *pointer;
+    typedef const T *const_pointer;
+    typedef T &reference;
+    typedef const T &const_reference;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    template <typename U>
+    struct rebind
+    {
+        typedef ArenaAllocator<U> other;
+    };
+
+    explicit ArenaAllocator(RequestArena &arena) :
+            m_arenaPtr(&arena)
+    {
+    }
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) :
+            m_arenaPtr(other.getArena())
+    {
+    }
+
+    pointer allocate(size_type n, const void * = 0)
+    {
+        return static_cast<pointer>(m_arenaPtr->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(pointer p, size_type n)
+    {
+        m_arenaPtr->deallocate(p, n * sizeof(T));
+    }
+
+    void construct(pointer p, const T &value)
+    {
+        new (static_cast<void *>(p)) T(value);
+    }
+
+    void destroy(pointer p)
+    {
+        p->~T();
+    }
+
+    pointer address(reference value) const
+    {
+        return &value;
+    }
+
+    const_pointer address(const_reference value) const
+    {
+        return &value;
+    }
+
+    size_type max_size() const
+    {
+        return std::numeric_limits<size_type>::max() / sizeof(T);
+    }
+
+    RequestArena *getArena() const
+    {
+        return m_arenaPtr;
+    }
+
+private:
+    RequestArena *m_arenaPtr;
+};
+
+template <typename T, typename U>
+inline bool operator==(const ArenaAllocator<T> &left, const ArenaAllocator<U> &right)
+{
+    return left.getArena() == right.getArena();
+}
+
+template <typename T, typename U>
+inline bool operator!=(const ArenaAllocator<T> &left, const ArenaAllocator<U> &right)
+{
+    return left.getArena() != right.getArena();
+}
+
+typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char> > ArenaString;
+
+template <typename T>
+struct ArenaVector
+{
+    typedef std::vector<T, ArenaAllocator<T> > type;
+};
+
+} /* namespace WebServer */
+} /* namespace Tools */
+
+#endif /* REQUESTARENA_H_ */
@@ -0,0 +1,116 @@
+#ifndef REQUESTCOALESCER_H_
+#define REQUESTCOALESCER_H_
+
+// C++
+#include <list>
+#include <string>
+#include <utility>
+#include <vector>
+
+// BOOST
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+// PION
+#include <pion/http/request.hpp>
+#include <pion/http/response.hpp>
+#include <pion/tcp/connection.hpp>
+
+#include "Tools/WebServer/IStat.h"
+#include "Tools/WebServer/ResponseBody.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+// Single-flight for identical GET requests (same resource, query and Accept-Encoding):
+// the first one is handled by the service, the ones arriving while it is in flight
+// or within the grace window after it get the same encoded response. A request
+// under another CacheVersion than the flight's starts a new flight.
+class RequestCoalescer : boost::noncopyable
+{
+public:
+    struct Flight;
+    typedef boost::shared_ptr<Flight> FlightPtr;
+    typedef std::pair<pion::http::request_ptr, pion::tcp::connection_ptr> Waiter;
+    typedef std::vector<Waiter> Waiters;
+    typedef boost::function<void(pion::tcp::connection_ptr,
+                                 pion::http::response_ptr,
+                                 boost::shared_ptr<const ResponseBody>)> Sender;
+
+    // the responses of the waiters are written by sender
+    RequestCoalescer(const boost::posix_time::time_duration &window, const Sender &sender);
+
+    // empty when the request is answered or waits for the flight in progress,
+    // otherwise the new flight the caller has to handle
+    FlightPtr join(const std::string &key,
+                   boost::uint64_t version,
+                   pion::http::request_ptr &requestPtr,
+                   pion::tcp::connection_ptr &tcpConnPtr);
+    // sends the response to the waiters; responses other than 200 OK are not shared,
+    // the body is copied from the response content when it is empty; chunked responses
+    // are completed with the whole body once the last chunk is written
+    void complete(FlightPtr flightPtr, pion::http::response &response, const ResponseBody &body);
+    // the waiters of a flight which finished without a shared response, they should be
+    // handled one by one
+    Waiters abandon(FlightPtr flightPtr);
+    void getStatistics(const std::string &prefix, IStat::Parameters &parameters) const;
+
+private:
+    typedef std::vector<std::pair<std::string, std::string> > Headers;
+    typedef boost::unordered_map<std::string, FlightPtr> Flights;
+    // completed flights in the order they expire
+    typedef std::list<FlightPtr> Expiring;
+
+    void send(const Flight &flight, const Waiter &waiter);
+    void eraseExpired(boost::uint64_t now);
+
+    boost::uint64_t m_window;
+    Sender m_sender;
+
+    boost::mutex m_mutex;
+    Flights m_flights;
+    Expiring m_expiring;
+
+    boost::atomic<boost::uint64_t> m_flightCount;
+    boost::atomic<boost::uint64_t> m_coalesced;
+    // flights which completed with a response for the waiters
+    boost::atomic<boost::uint64_t> m_shared;
+    boost::atomic<boost::uint64_t> m_fallbacks;
+};
+
+typedef boost::shared_ptr<RequestCoalescer> RequestCoalescerPtr;
+
+struct RequestCoalescer::Flight
+{
+    Flight() :
+            version(0u),
+            isCompleted(false),
+            expires(0u),
+            statusCode(0u)
+    {
+    }
+
+    std::string key;
+    // CacheVersion of the service when the flight started
+    boost::uint64_t version;
+    bool isCompleted;
+    Waiters waiters;
+    boost::uint64_t expires;
+    unsigned statusCode;
+    std::string statusMessage;
+    Headers headers;
+    boost::shared_ptr<const ResponseBody> bodyPtr;
+};
+
+} /* namespace WebServer */
+} /* namespace Tools */
+
+#endif /* REQUESTCOALESCER_H_ */
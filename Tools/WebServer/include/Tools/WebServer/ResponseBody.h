@@ -0,0 +1,106 @@
+#ifndef RESPONSEBODY_H_
+#define RESPONSEBODY_H_
+
+// C++
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+// BOOST
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+// PION
+#include <pion/http/response.hpp>
+#include <pion/http/response_writer.hpp>
+#include <pion/tcp/connection.hpp>
+
+#include "Tools/WebServer/IStat.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+// Response body as a list of buffers shared with their owners. The buffers
+// are handed to the writer as they are and go out by one vectored write.
+class ResponseBody
+{
+public:
+    typedef boost::shared_ptr<const std::string> Buffer;
+
+    ResponseBody();
+
+    // the data must outlive the body, e.g. string literals
+    void appendStatic(const char *data, std::size_t size);
+    // shared without copying, e.g. a cached body
+    void append(const Buffer &buffer);
+    // the content of data is taken over, data is left empty
+    void append(std::string &data);
+    void append(const ResponseBody &body);
+    void appendCopy(const char *data, std::size_t size);
+
+    bool empty() const;
+    std::size_t getSize() const;
+    std::size_t getSegmentCount() const;
+    // buffers allocated and bytes copied while the body was built
+    std::size_t getAllocations() const;
+    std::size_t getCopiedBytes() const;
+    std::string toString() const;
+
+    typedef boost::function<void()> SentHandler;
+
+    // sends the response with the body, the body is kept until the write completes;
+    // sentHandler is called then, before the connection is finished
+    static void send(pion::tcp::connection_ptr tcpConnPtr,
+                     pion::http::response_ptr responsePtr,
+                     const boost::shared_ptr<const ResponseBody> &bodyPtr,
+                     const SentHandler &sentHandler = SentHandler());
+
+private:
+    struct Segment
+    {
+        // empty for static data
+        Buffer buffer;
+        const char *data;
+        std::size_t size;
+    };
+
+    static void onSent(pion::tcp::connection_ptr tcpConnPtr,
+                       boost::shared_ptr<const ResponseBody> bodyPtr,
+                       SentHandler sentHandler);
+
+    std::vector<Segment> m_segments;
+    std::size_t m_size;
+    std::size_t m_allocations;
+    std::size_t m_copiedBytes;
+};
+
+typedef boost::shared_ptr<ResponseBody> ResponseBodyPtr;
+
+// Totals of the sent bodies, responses with the content set
+// by pion::http::response::set_content() are counted as copied
+class ResponseBodyCounters : boost::noncopyable
+{
+public:
+    ResponseBodyCounters();
+
+    void add(const ResponseBody &body);
+    void addCopied(std::size_t size);
+    void getStatistics(const std::string &prefix, IStat::Parameters &parameters) const;
+
+private:
+    boost::atomic<boost::uint64_t> m_responses;
+    boost::atomic<boost::uint64_t> m_bytes;
+    boost::atomic<boost::uint64_t> m_segments;
+    boost::atomic<boost::uint64_t> m_allocations;
+    boost::atomic<boost::uint64_t> m_copiedBytes;
+};
+
+} /* namespace WebServer */
+} /* namespace Tools */
+
+#endif /* RESPONSEBODY_H_ */
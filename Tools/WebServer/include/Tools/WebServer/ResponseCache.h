@@ -0,0 +1,122 @@
+#ifndef RESPONSECACHE_H_
+#define RESPONSECACHE_H_
+
+// C++
+#include <list>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stddef.h>
+
+// BOOST
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+
+// PION
+#include <pion/http/request.hpp>
+#include <pion/http/response.hpp>
+
+#include "Tools/WebServer/IStat.h"
+#include "Tools/WebServer/ResponseBody.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+// Version token of the data behind a service. Cached responses filled
+// under an older version are not served after the service bumps it.
+class CacheVersion : boost::noncopyable
+{
+public:
+    CacheVersion();
+
+    void bump();
+    boost::uint64_t get() const;
+
+private:
+    boost::atomic<boost::uint64_t> m_version;
+};
+
+typedef boost::shared_ptr<CacheVersion> CacheVersionPtr;
+
+// Final (already encoded) GET responses keyed by resource, query and Accept-Encoding.
+// Entries expire by TTL or by version, the least recently used ones are evicted
+// when the cache grows over its size limit.
+class ResponseCache : boost::noncopyable
+{
+public:
+    struct Settings
+    {
+        Settings();
+
+        // approximate limit for headers and bodies of all entries
+        std::size_t maxSize;
+    };
+
+    explicit ResponseCache(const Settings &settings = Settings());
+
+    static bool isCacheable(const pion::http::request &request);
+    static std::string getKey(const pion::http::request &request);
+
+    // a fresh copy of the cached response headers for the request, empty if there is none;
+    // the body is shared with the cache
+    pion::http::response_ptr find(const std::string &key,
+                                  boost::uint64_t version,
+                                  const pion::http::request &request,
+                                  boost::shared_ptr<const ResponseBody> &bodyPtr);
+    // responses other than 200 OK are ignored, the body is copied from
+    // the response content when it is empty
+    void insert(const std::string &key,
+                boost::uint64_t version,
+                const boost::posix_time::time_duration &ttl,
+                pion::http::response &response,
+                const ResponseBody &body);
+    void clear();
+    void getStatistics(IStat::Parameters &parameters) const;
+
+private:
+    typedef std::vector<std::pair<std::string, std::string> > Headers;
+
+    struct Entry
+    {
+        std::string key;
+        boost::uint64_t version;
+        boost::uint64_t expires;
+        unsigned statusCode;
+        std::string statusMessage;
+        Headers headers;
+        boost::shared_ptr<const ResponseBody> bodyPtr;
+        std::size_t size;
+    };
+
+    // most recently used first
+    typedef std::list<Entry> Entries;
+    typedef boost::unordered_map<std::string, Entries::iterator> Index;
+
+    void erase(Index::iterator i);
+
+    std::size_t m_maxSize;
+
+    mutable boost::mutex m_mutex;
+    Entries m_entries;
+    Index m_index;
+    std::size_t m_size;
+
+    boost::atomic<boost::uint64_t> m_hits;
+    boost::atomic<boost::uint64_t> m_misses;
+    boost::atomic<boost::uint64_t> m_expired;
+    boost::atomic<boost::uint64_t> m_evicted;
+};
+
+typedef boost::shared_ptr<ResponseCache> ResponseCachePtr;
+
+} /* namespace WebServer */
+} /* namespace Tools */
+
+#endif /* RESPONSECACHE_H_ */
@@ -7,63 +7,76 @@
 
 // BOOST
 #include <boost/asio/io_service.hpp>
+#include <boost/atomic.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/thread.hpp>
 
+#include "Tools/WebServer/Histogram.h"
 #include "Tools/WebServer/IScheduler.h"
+#include "Tools/WebServer/LaneQueue.h"
+#include "Tools/WebServer/TimerWheel.h"
 
 namespace Tools
 {
 namespace WebServer
 {
 
-class Scheduler : public ITimerScheduler, boost::noncopyable
+class Scheduler : public IWorkScheduler, boost::noncopyable
 {
 public:
-    Scheduler(const std::size_t minThreads, const std::size_t maxThreads);
+    // Parameters of the background thread count controller
+    struct ResizePolicy
+    {
+        ResizePolicy();
+
+        // interval between load samples
+        boost::posix_time::time_duration samplingInterval;
+        // consecutive overloaded samples required to add a thread
+        std::size_t growSamples;
+        // consecutive underloaded samples required to retire a thread
+        std::size_t shrinkSamples;
+        // minimal interval between two resize decisions
+        boost::posix_time::time_duration cooldown;
+        // threads younger than this are never retired
+        boost::posix_time::time_duration minThreadLifetime;
+    };
+
+    Scheduler(const std::size_t minThreads,
+              const std::size_t maxThreads,
+              const ResizePolicy &resizePolicy = ResizePolicy(),
+              LanePolicy lanePolicy = LP_WEIGHTED);
     virtual ~Scheduler();
 
-    void start();
-    void stop();
+    // IWorkScheduler
+    virtual void start();
+    virtual void stop();
+    virtual bool isRunning() const;
+    virtual void getStatistics(IStat::Parameters &parameters) const;
+    virtual bool setThreadLimits(std::size_t minThreads, std::size_t maxThreads);
 
     // IScheduler
-    virtual void execute(SchedulerHandler handler);
+    virtual void execute(SchedulerHandler handler, ExecutionLane lane = EL_NORMAL);
     // ITimerScheduler
-    virtual DeadlineTimerPtr executeOnTimer(SchedulerTimerHandler handler,
-                                    const boost::posix_time::time_duration &timeDuration);
-
-    bool isRunning() const;
+    virtual TimerHandle executeOnTimer(SchedulerTimerHandler handler,
+                                       const boost::posix_time::time_duration &timeDuration);
+    virtual bool cancelTimer(const TimerHandle &timerHandle);
 
 public:
     //types
 
-    class TerminateException : public std::exception
+    enum ThreadState
     {
-    public:
-        TerminateException()
-        {
-            m_message = "Terminate thread request";
-        }
-
-        virtual ~TerminateException() 
-        {
-        }
-
-        virtual const char* what() const 
-        {
-            return m_message.c_str();
-        }
-
-    private:
-        std::string m_message;
+        TS_IDLE, TS_BUSY, TS_ZOMBIE
     };
 
-    enum ThreadState
+    // handler timings of a thread, nanoseconds
+    struct HandlerTimings : boost::noncopyable
     {
-        TS_IDLE, TS_BUSY, TS_ZOMBIE
+        Histogram queueWait;
+        Histogram execTime;
     };
 
     class ThreadInfo
@@ -72,7 +85,9 @@ public:
 
         ThreadInfo(boost::shared_ptr<boost::thread> threadPtr, ThreadState state) :
                         m_threadPtr(threadPtr),
-                        m_threadState(state)
+                        m_threadState(state),
+                        m_startTime(boost::posix_time::microsec_clock::universal_time()),
+                        m_timingsPtr(new HandlerTimings())
         {
         }
 
@@ -91,6 +106,8 @@ public:
             {
                 m_threadPtr = rhs.m_threadPtr;
                 m_threadState = rhs.m_threadState;
+                m_startTime = rhs.m_startTime;
+                m_timingsPtr = rhs.m_timingsPtr;
             }
             return *this;
         }
@@ -125,9 +142,21 @@ public:
             m_threadState = state;
         }
 
+        const boost::posix_time::ptime &getStartTime() const
+        {
+            return m_startTime;
+        }
+
+        HandlerTimings &getTimings() const
+        {
+            return *m_timingsPtr;
+        }
+
     private:
         boost::shared_ptr<boost::thread> m_threadPtr;
-        ThreadState m_threadState;
+        volatile ThreadState m_threadState;
+        boost::posix_time::ptime m_startTime;
+        boost::shared_ptr<HandlerTimings> m_timingsPtr;
     };
 
 private:
@@ -137,7 +166,11 @@ private:
     {
     public:
         explicit BaseHandlerWrapper(Scheduler *pExecutor) :
-                m_pExecutor(pExecutor)
+                m_pExecutor(pExecutor),
+                m_pThreadInfo(NULL)
+#ifdef TOOLS_WEBSERVER_HANDLER_TIMINGS
+                , m_startTime(0u)
+#endif
         {
         }
 
@@ -151,6 +184,10 @@ private:
             if (this != &rhs)
             {
                 m_pExecutor = rhs.m_pExecutor;
+                m_pThreadInfo = rhs.m_pThreadInfo;
+#ifdef TOOLS_WEBSERVER_HANDLER_TIMINGS
+                m_startTime = rhs.m_startTime;
+#endif
             }
             return *this;
         }
@@ -163,12 +200,20 @@ private:
 
         void beforeExecute()
         {
-            m_pExecutor->getThreadInfo()->startHandler();
+            m_pThreadInfo = m_pExecutor->getThreadInfo().get();
+            m_pThreadInfo->startHandler();
+            m_pExecutor->onStartExec();
+#ifdef TOOLS_WEBSERVER_HANDLER_TIMINGS
+            m_startTime = getTimestampNs();
+#endif
         }
 
         void afterExecute()
         {
-            m_pExecutor->getThreadInfo()->finishHandler();
+#ifdef TOOLS_WEBSERVER_HANDLER_TIMINGS
+            m_pThreadInfo->getTimings().execTime.record(getTimestampNs() - m_startTime);
+#endif
+            m_pThreadInfo->finishHandler();
             m_pExecutor->onFinishExec();
         }
 
@@ -191,6 +236,10 @@ private:
         friend class ExecutionLock;
 
         Scheduler *m_pExecutor;
+        ThreadInfo *m_pThreadInfo;
+#ifdef TOOLS_WEBSERVER_HANDLER_TIMINGS
+        boost::uint64_t m_startTime;
+#endif
 
     public:
         void executeHandler(SchedulerHandler handler)
@@ -216,48 +265,62 @@ private:
         SchedulerHandler m_handler;
     };
 
-    class TimerHandlerWrapper : public BaseHandlerWrapper
-    {
-    public:
-        TimerHandlerWrapper(Scheduler *pExecutor,
-                            SchedulerTimerHandler handler);
-        TimerHandlerWrapper(const TimerHandlerWrapper &rhs);
-        TimerHandlerWrapper &operator=(const TimerHandlerWrapper &rhs);
-        virtual ~TimerHandlerWrapper()
-        {
-        }
-
-        void operator()(const boost::system::error_code &error);
-
-    private:
-        SchedulerTimerHandler m_handler;
-    };
-
 private:
     //members
 
     void setRunning(bool running);
     void addThread();
-    void killThread();
-    void deleteThread(const boost::thread::id &id);
+    void retireThread();
+    // threads without a pending retire request
+    std::size_t getLiveThreadsCount() const;
+    void reapZombies();
+    void resizeController();
     void checkThreads();
+    void onStartExec();
     void onFinishExec();
     void iosRunner(ThreadInfo *pThreadInfo);
+    void dispatchNext();
+    bool shouldRetire(const ThreadInfo *pThreadInfo);
     void markThreadAsZombie();
+    void retireTimings(const ThreadInfo &threadInfo);
     boost::thread_specific_ptr<ThreadInfo> &getThreadInfo();
 
-    std::size_t m_minThreads;
-    std::size_t m_maxThreads;
+    // may be changed while running
+    boost::atomic<std::size_t> m_minThreads;
+    boost::atomic<std::size_t> m_maxThreads;
+    ResizePolicy m_resizePolicy;
     boost::asio::io_service m_ioService;
     boost::scoped_ptr<boost::asio::io_service::work> m_pWork;
 
+    // handlers wait here, every posted dispatch token runs the next one chosen by the lane policy
+    LaneStatistics m_laneStatistics;
+    LaneQueue m_lanes;
+
+    // expired timers are executed as regular handlers
+    TimerWheel m_timerWheel;
+
     typedef std::map<boost::thread::id, boost::shared_ptr<ThreadInfo> > Threads;
     Threads m_threads;
-    volatile bool m_isRunning;
-
-    boost::mutex m_mutex;
-    volatile std::size_t m_pendingRequests;
-    volatile std::size_t m_threadsCount;
+    boost::atomic<bool> m_isRunning;
+
+    // guards m_threads, touched by start/stop and the resize controller only
+    mutable boost::mutex m_mutex;
+    boost::atomic<std::size_t> m_pendingRequests;
+    boost::atomic<std::size_t> m_busyThreads;
+    boost::atomic<std::size_t> m_threadsCount;
+    boost::atomic<std::size_t> m_threadsToRetire;
+    boost::atomic<std::size_t> m_threadsCreated;
+    boost::atomic<std::size_t> m_threadsDestroyed;
+    // timings of the joined threads, guarded by m_mutex
+    HandlerTimings m_retiredTimings;
+
+    // resize controller state
+    boost::shared_ptr<boost::thread> m_controllerThreadPtr;
+    boost::mutex m_controllerMutex;
+    boost::condition_variable m_controllerCondition;
+    std::size_t m_overloadedSamples;
+    std::size_t m_underloadedSamples;
+    boost::posix_time::ptime m_lastResizeTime;
 
     boost::thread_specific_ptr<ThreadInfo> m_threadInfo;
 };
@@ -13,9 +13,14 @@
 #include <pion/tcp/connection.hpp>
 
 #include "Tools/Logger/Logger.h"
+#include "Tools/WebServer/AdaptiveConcurrencyLimiter.h"
 #include "Tools/WebServer/ConnectionContext.h"
 #include "Tools/WebServer/IWebService.h"
 #include "Tools/WebServer/IScheduler.h"
+#include "Tools/WebServer/QueueDelayShedder.h"
+#include "Tools/WebServer/RequestCoalescer.h"
+#include "Tools/WebServer/ResponseCache.h"
+#include "Tools/WebServer/ServiceOptions.h"
 
 namespace Tools
 {
@@ -25,35 +30,73 @@ namespace WebServer
 class ServiceHandler : boost::noncopyable
 {
 public:
+    // reports a failed request, the response is sent by the service handler
     typedef boost::function<void(pion::http::request_ptr, pion::tcp::connection_ptr, const std::exception &)> ErrorHandler;
 
     ServiceHandler(IWebServicePtr servicePtr,
+                   const ServiceOptions &options,
                    ISchedulerPtr schedulerPtr,
                    IStatPtr statPtr,
                    ErrorHandler errorHandler,
+                   const HistogramHandle &handlerTimer,
+                   const RateHandle &requestRate,
+                   const RateHandle &errorRate,
                    boost::int32_t maxActiveRequests,
-                   boost::atomic_int32_t &activeRequestsCount);
+                   boost::atomic_int32_t &activeRequestsCount,
+                   const boost::atomic<bool> &isDraining,
+                   AdaptiveConcurrencyLimiterPtr limiterPtr = AdaptiveConcurrencyLimiterPtr(),
+                   QueueDelayShedderPtr shedderPtr = QueueDelayShedderPtr(),
+                   ResponseCachePtr cachePtr = ResponseCachePtr());
 
     virtual ~ServiceHandler();
 
     void operator()(pion::http::request_ptr &requestPtr, pion::tcp::connection_ptr &tcpConnPtr);
 
-    void invokeHandler(ConnectionContextPtr contextPtr);
+    void invokeHandler(ConnectionContextPtr contextPtr, boost::uint64_t admissionTime);
 
     inline boost::int32_t getMaxActiveRequests() const;
+    void setMaxActiveRequests(boost::int32_t maxActiveRequests);
+    void getStatistics(const std::string &prefix, IStat::Parameters &parameters) const;
 
 private:
+    void handleRequest(pion::http::request_ptr &requestPtr, pion::tcp::connection_ptr &tcpConnPtr, bool coalesce);
+    void finishFlight(RequestCoalescer::FlightPtr flightPtr);
+
     static Tools::Logger::Logger &logger();
     static bool checkID(const std::string &strID);
+    // for the responses sent without a context, counted as active until they are written
+    void sendResponse(pion::tcp::connection_ptr tcpConnPtr,
+                      pion::http::response_ptr responsePtr,
+                      boost::shared_ptr<const ResponseBody> bodyPtr);
+    // reports the failure to the error handler and answers 500 the same way
+    void sendServerError(pion::http::request_ptr requestPtr,
+                         pion::tcp::connection_ptr tcpConnPtr,
+                         const std::exception &e);
+    void onResponseSent();
+    static pion::http::response_ptr createServiceUnavailableResponse(const pion::http::request &request);
+    static void releaseLimit(AdaptiveConcurrencyLimiterPtr limiterPtr, boost::uint64_t startTime);
 
     boost::int64_t getNewTraceID();
 
     boost::atomic_int32_t &m_activeRequestsCount;
-    boost::int32_t m_maxActiveRequests;
+    const boost::atomic<bool> &m_isDraining;
+    boost::atomic<boost::int32_t> m_maxActiveRequests;
     IWebServicePtr m_servicePtr;
+    ServiceOptions m_options;
     ISchedulerPtr m_schedulerPtr;
     IStatPtr m_statPtr;
     ErrorHandler m_errorHandler;
+    // time of the service call on a worker thread
+    HistogramHandle m_handlerTimer;
+    RateHandle m_requestRate;
+    // the failed requests
+    RateHandle m_errorRate;
+    AdaptiveConcurrencyLimiterPtr m_limiterPtr;
+    QueueDelayShedderPtr m_shedderPtr;
+    boost::atomic<boost::uint64_t> m_shedRequests;
+    ResponseCachePtr m_cachePtr;
+    RequestCoalescerPtr m_coalescerPtr;
+    ResponseBodyCounters m_responseBodyCounters;
 };
 
 typedef boost::shared_ptr<ServiceHandler> ServiceHandlerPtr;
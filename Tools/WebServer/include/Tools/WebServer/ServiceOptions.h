@@ -0,0 +1,59 @@
+#ifndef SERVICEOPTIONS_H_
+#define SERVICEOPTIONS_H_
+
+// BOOST
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "Tools/WebServer/AdaptiveConcurrencyLimiter.h"
+#include "Tools/WebServer/IScheduler.h"
+#include "Tools/WebServer/ResponseCache.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+// Per-service settings given to WebServer::addService
+struct ServiceOptions
+{
+    ServiceOptions() :
+            lane(EL_NORMAL),
+            adaptiveLimit(true),
+            queueDelayShedding(true),
+            cacheTtl(boost::posix_time::seconds(0)),
+            coalesceRequests(false),
+            coalesceWindow(boost::posix_time::milliseconds(20))
+    {
+    }
+
+    explicit ServiceOptions(ExecutionLane lane) :
+            lane(lane),
+            adaptiveLimit(true),
+            queueDelayShedding(true),
+            cacheTtl(boost::posix_time::seconds(0)),
+            coalesceRequests(false),
+            coalesceWindow(boost::posix_time::milliseconds(20))
+    {
+    }
+
+    // worker lane the service requests are queued to
+    ExecutionLane lane;
+    // the service gets its own adaptive concurrency limit when it is enabled on the server
+    bool adaptiveLimit;
+    // requests queued for too long are dropped when queue delay shedding is enabled on the server
+    bool queueDelayShedding;
+    // GET responses are cached for this long when the response cache is enabled on the server,
+    // zero disables caching
+    boost::posix_time::time_duration cacheTtl;
+    // optional, bumped by the service when the cached data changes
+    CacheVersionPtr cacheVersionPtr;
+    // identical concurrent GET requests share one response, see RequestCoalescer
+    bool coalesceRequests;
+    // the shared response is also given to identical requests arriving this long after it
+    boost::posix_time::time_duration coalesceWindow;
+};
+
+} /* namespace WebServer */
+} /* namespace Tools */
+
+#endif /* SERVICEOPTIONS_H_ */
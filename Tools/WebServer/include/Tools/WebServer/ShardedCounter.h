@@ -0,0 +1,59 @@
+#ifndef SHARDEDCOUNTER_H_
+#define SHARDEDCOUNTER_H_
+
+// C++
+#include <stddef.h>
+
+// BOOST
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace Tools
+{
+namespace WebServer
+{
+
+// Counter updated by many threads: every thread adds to its own cache line,
+// the shards are summed when the value is read.
+class ShardedCounter : boost::noncopyable
+{
+public:
+    enum
+    {
+        SHARDS = 32,
+        CACHE_LINE_SIZE = 64
+    };
+
+    ShardedCounter();
+    ~ShardedCounter();
+
+    void add(long value)
+    {
+        m_shards[getShardIndex()].value.fetch_add(value, boost::memory_order_relaxed);
+    }
+
+    // for gauges: additions running at the same time may be lost
+    void set(long value);
+    long get() const;
+
+private:
+    struct Shard
+    {
+        boost::atomic<long> value;
+        char padding[CACHE_LINE_SIZE - sizeof(boost::atomic<long>)];
+    };
+
+    // threads get their shards round-robin when they update a counter for the first time
+    static std::size_t getShardIndex();
+
+    // aligned to a cache line
+    Shard *m_shards;
+};
+
+typedef boost::shared_ptr<ShardedCounter> ShardedCounterPtr;
+
+} /* namespace WebServer */
+} /* namespace Tools */
+
+#endif /* SHARDEDCOUNTER_H_ */
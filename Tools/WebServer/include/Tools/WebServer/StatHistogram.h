@@ -0,0 +1,104 @@
+#ifndef STATHISTOGRAM_H_
+#define STATHISTOGRAM_H_
+
+// C++
+#include <vector>
+#include <stddef.h>
+
+// BOOST
+#include <boost/atomic.hpp>
+#include <boost/chrono/system_clocks.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace Tools
+{
+namespace WebServer
+{
+
+// Monotonic timestamp for latency measurements
+inline boost::uint64_t getTimestampNs()
+{
+    return static_cast<boost::uint64_t>(boost::chrono::duration_cast<boost::chrono::nanoseconds>(
+            boost::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Log-linear histogram recorded by any number of threads without locks: every power of two
+// is split into 2^precision linear buckets, so a value is known within 2^-precision.
+// Histograms of the same precision are merged by adding their buckets.
+class StatHistogram : boost::noncopyable
+{
+public:
+    enum
+    {
+        MIN_PRECISION = 1,
+        MAX_PRECISION = 10,
+        // 3%, 1920 buckets
+        DEFAULT_PRECISION = 5
+    };
+
+    explicit StatHistogram(unsigned precision = DEFAULT_PRECISION);
+
+    void record(boost::uint64_t value)
+    {
+        m_counts[getBucket(value, m_precision)].fetch_add(1u, boost::memory_order_relaxed);
+        m_sum.fetch_add(value, boost::memory_order_relaxed);
+
+        boost::uint64_t max = m_max.load(boost::memory_order_relaxed);
+        while (value > max && !m_max.compare_exchange_weak(max, value, boost::memory_order_relaxed))
+        {
+        }
+    }
+
+    // the precisions must be equal
+    void add(const StatHistogram &histogram);
+
+    unsigned getPrecision() const;
+    boost::uint64_t getBucketCount(std::size_t bucket) const;
+    boost::uint64_t getSum() const;
+    boost::uint64_t getMax() const;
+
+    static std::size_t getBucketCount(unsigned precision);
+    static std::size_t getBucket(boost::uint64_t value, unsigned precision);
+    // middle of the bucket range
+    static boost::uint64_t getBucketValue(std::size_t bucket, unsigned precision);
+
+private:
+    const unsigned m_precision;
+    boost::scoped_array<boost::atomic<boost::uint64_t> > m_counts;
+    boost::atomic<boost::uint64_t> m_sum;
+    boost::atomic<boost::uint64_t> m_max;
+};
+
+typedef boost::shared_ptr<StatHistogram> StatHistogramPtr;
+
+// Values of a histogram at some moment, the recording goes on meanwhile
+class StatHistogramSnapshot
+{
+public:
+    explicit StatHistogramSnapshot(unsigned precision = StatHistogram::DEFAULT_PRECISION);
+
+    // the precisions must be equal
+    void add(const StatHistogram &histogram);
+    void add(const StatHistogramSnapshot &snapshot);
+
+    boost::uint64_t getCount() const;
+    boost::uint64_t getSum() const;
+    boost::uint64_t getMax() const;
+    // percentile is in [0, 100]
+    boost::uint64_t getPercentile(double percentile) const;
+
+private:
+    unsigned m_precision;
+    std::vector<boost::uint64_t> m_counts;
+    boost::uint64_t m_count;
+    boost::uint64_t m_sum;
+    boost::uint64_t m_max;
+};
+
+} /* namespace WebServer */
+} /* namespace Tools */
+
+#endif /* STATHISTOGRAM_H_ */
@@ -0,0 +1,78 @@
+#ifndef STATRATE_H_
+#define STATRATE_H_
+
+// C++
+#include <stddef.h>
+
+// BOOST
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "Tools/WebServer/ShardedCounter.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+// Counter with its rate per second over the windows of 1, 10 and 60 seconds.
+// The updates go to a sharded counter. Every second a single timer thread calls tick(),
+// which stores the total into a ring of buckets, so neither side takes a lock.
+// RK_EWMA smooths the per second rate exponentially with the window as the time constant.
+class StatRate : boost::noncopyable
+{
+public:
+    enum Kind
+    {
+        RK_WINDOW, RK_EWMA
+    };
+
+    enum
+    {
+        WINDOWS = 3,
+        // one total per second for the longest window, and one spare
+        // which the next tick overwrites while the rates are read
+        BUCKETS = 62
+    };
+
+    explicit StatRate(Kind kind);
+
+    void add(long value)
+    {
+        m_counter.add(value);
+    }
+
+    long get() const;
+    Kind getKind() const;
+    // timestamp in ns of getTimestampNs()
+    void tick(boost::uint64_t timestamp);
+    // per second, 0 until the second tick
+    double getRate(std::size_t window) const;
+
+    // 1, 10, 60
+    static unsigned getWindowSeconds(std::size_t window);
+
+private:
+    struct Bucket
+    {
+        boost::atomic<long> total;
+        boost::atomic<boost::uint64_t> timestamp;
+    };
+
+    const Kind m_kind;
+    ShardedCounter m_counter;
+    Bucket m_buckets[BUCKETS];
+    // the last tick is in m_buckets[(m_ticks - 1) % BUCKETS]
+    boost::atomic<boost::uint64_t> m_ticks;
+    // written by tick() only
+    boost::atomic<double> m_averages[WINDOWS];
+};
+
+typedef boost::shared_ptr<StatRate> StatRatePtr;
+
+} /* namespace WebServer */
+} /* namespace Tools */
+
+#endif /* STATRATE_H_ */
@@ -6,11 +6,18 @@
 #include <stdexcept>
 
 // BOOST
-#include <boost/date_time/posix_time/ptime.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 
+#include "Tools/WebServer/IScheduler.h"
 #include "Tools/WebServer/IStat.h"
 #include "Tools/WebServer/IWebService.h"
+#include "Tools/WebServer/ResponseBody.h"
+#include "Tools/WebServer/StatWriter.h"
 
 namespace Tools
 {
@@ -20,10 +27,14 @@ namespace WebServer
 class StatService : public Tools::WebServer::IStat, public Tools::WebServer::IWebService
 {
 public:
+    // with a snapshot interval the document is collected in the background
+    // and the requests get the last collected one, otherwise it is collected per request.
+    // The format is asked for by the Accept header or by the format query parameter.
     explicit StatService(const std::string &serviceName,
                          const std::string &resource,
                          const std::string &version,
-                         const std::string &revision);
+                         const std::string &revision,
+                         const boost::posix_time::time_duration &snapshotInterval = boost::posix_time::time_duration());
     virtual ~StatService();
 
     // IWebService overloads
@@ -32,28 +43,119 @@ public:
     virtual void stop(void);
 
     // Tools::WebServer::IStat overloads
-    virtual void registerParameter(const std::string &name);
+    // the handle updates the parameter without the lookup by name
+    virtual CounterHandle registerParameter(const std::string &name);
+    virtual CounterHandle registerParameter(const std::string &name, const Labels &labels);
     virtual void set(const std::string &name, const long value);
     virtual void increment(const std::string &name, const long value);
+    virtual HistogramHandle registerHistogram(const std::string &name, unsigned precision);
+    virtual HistogramHandle registerTimer(const std::string &name, unsigned precision);
+    virtual RateHandle registerRate(const std::string &name);
+    virtual RateHandle registerEwma(const std::string &name);
+    virtual HistogramHandle registerHistogram(const std::string &name, const Labels &labels, unsigned precision);
+    virtual HistogramHandle registerTimer(const std::string &name, const Labels &labels, unsigned precision);
+    virtual RateHandle registerRate(const std::string &name, const Labels &labels);
+    virtual RateHandle registerEwma(const std::string &name, const Labels &labels);
     virtual void registerParametersProvider(const std::string &name,
                                             const ParametersProvider &parametersProvider);
     virtual void unregisterParametersProvider(const std::string &name);
 
     bool isRunning() const;
 
+    // the rates advance every second on a timer of the scheduler while it is attached
+    void attachTimerScheduler(const ITimerSchedulerPtr &schedulerPtr);
+    void detachTimerScheduler();
+
+    // collects and renders the document as a request would get it
+    void render(StatFormat format, std::string &output);
+
 private:
-    typedef std::map<std::string, unsigned> ParameterIDs;
-    typedef std::map<std::string, ParametersProvider> ParametersProviders;
+    struct Parameter
+    {
+        Labels labels;
+        ShardedCounterPtr counterPtr;
+    };
+    // by name and labels, so the parameters of the same name follow each other
+    typedef std::map<std::pair<std::string, std::string>, Parameter> RegisteredParameters;
+    // provider and the timer of its calls
+    typedef std::map<std::string, std::pair<ParametersProvider, HistogramHandle> > ParametersProviders;
+    struct Histogram
+    {
+        Labels labels;
+        StatHistogramPtr histogramPtr;
+        // unit of the values
+        std::string suffix;
+    };
+    struct Rate
+    {
+        Labels labels;
+        StatRatePtr ratePtr;
+    };
+    // by name and labels as the parameters
+    typedef std::map<std::pair<std::string, std::string>, Histogram> Histograms;
+    typedef std::map<std::pair<std::string, std::string>, Rate> Rates;
+
+    // both encodings of a document are ready to be sent
+    struct Document
+    {
+        ResponseBody::Buffer identity;
+        // empty when the compression failed
+        ResponseBody::Buffer gzip;
+    };
+
+    struct Snapshot
+    {
+        Document documents[SF_COUNT];
+    };
+    typedef boost::shared_ptr<const Snapshot> SnapshotPtr;
+
+    HistogramHandle addHistogram(const std::string &name,
+                                 const Labels &labels,
+                                 unsigned precision,
+                                 const std::string &suffix);
+    RateHandle addRate(const std::string &name, const Labels &labels, StatRate::Kind kind);
+    // validates the labels and joins them into the key of the registration
+    static std::string getLabelsKey(const std::string &name, const Labels &labels);
+    void onRateTimer(const boost::system::error_code &error);
+    ShardedCounter &findParameter(const std::string &name);
+    void collect(StatDocument &document);
+    static Document createDocument(const StatDocument &statDocument, StatFormat format, bool isGzipEnabled);
+    SnapshotPtr createSnapshot();
+    void collectorRunner();
+    static bool getFormat(const pion::http::request &request, StatFormat &format);
+    static void sendDocument(ConnectionContextPtr contextPtr,
+                             const ResponseBody::Buffer &document,
+                             StatFormat format,
+                             bool isGzip);
 
     volatile bool m_isRunning;
-    ParameterIDs m_parameterIDs;
-    std::vector<long> m_parameterValues;
+    RegisteredParameters m_parameters;
     std::string m_serviceName;
     std::string m_resource;
 
     mutable boost::mutex m_mutexProvider;
     ParametersProviders m_parametersProviders;
 
+    mutable boost::mutex m_mutexHistograms;
+    Histograms m_histograms;
+
+    mutable boost::mutex m_mutexRates;
+    Rates m_rates;
+
+    // guards the scheduler and the timer of the rates
+    boost::mutex m_mutexRateTimer;
+    ITimerSchedulerPtr m_rateSchedulerPtr;
+    TimerHandle m_rateTimer;
+
+    HistogramHandle m_collectTimer;
+    boost::posix_time::time_duration m_snapshotInterval;
+    // swapped by boost::atomic_store, read by boost::atomic_load
+    SnapshotPtr m_snapshotPtr;
+    boost::mutex m_collectorMutex;
+    boost::condition_variable m_collectorCondition;
+    bool m_isCollecting;
+    boost::shared_ptr<boost::thread> m_collectorThreadPtr;
+
     // built-in values
     boost::posix_time::ptime m_startTime;
     std::string m_serviceVersion;
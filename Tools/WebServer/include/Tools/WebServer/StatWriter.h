@@ -0,0 +1,104 @@
+#ifndef STATWRITER_H_
+#define STATWRITER_H_
+
+// C++
+#include <string>
+#include <vector>
+
+// BOOST
+#include <boost/cstdint.hpp>
+#include <boost/date_time/posix_time/ptime.hpp>
+
+#include "Tools/WebServer/IStat.h"
+#include "Tools/WebServer/StatHistogram.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+enum StatFormat
+{
+    SF_XML,
+    // Prometheus text format 0.0.4
+    SF_PROMETHEUS,
+    SF_OPENMETRICS,
+    SF_JSON,
+    SF_COUNT
+};
+
+// Values of the stat service collected at one moment. Names and labels point
+// into the registrations of the service, which live as long as the service.
+struct StatDocument
+{
+    enum
+    {
+        PERCENTILES = 4
+    };
+
+    struct Parameter
+    {
+        const std::string *name;
+        const IStat::Labels *labels;
+        long value;
+    };
+
+    struct Histogram
+    {
+        const std::string *name;
+        const IStat::Labels *labels;
+        // unit of the values, e.g. "_us"
+        const std::string *suffix;
+        boost::uint64_t count;
+        boost::uint64_t sum;
+        boost::uint64_t max;
+        // p50, p90, p99, p999
+        boost::uint64_t percentiles[PERCENTILES];
+    };
+
+    struct Rate
+    {
+        const std::string *name;
+        const IStat::Labels *labels;
+        StatRate::Kind kind;
+        long value;
+        // per second over StatRate::getWindowSeconds()
+        double rates[StatRate::WINDOWS];
+    };
+
+    // values of a ParametersProvider
+    struct Group
+    {
+        std::string name;
+        IStat::Parameters parameters;
+    };
+
+    void addHistogram(const std::string &name,
+                      const IStat::Labels &labels,
+                      const std::string &suffix,
+                      const StatHistogram &histogram);
+    void addRate(const std::string &name, const IStat::Labels &labels, const StatRate &rate);
+
+    std::string serviceName;
+    std::string version;
+    std::string revision;
+    boost::posix_time::ptime startTime;
+    // the parameters, histograms and rates of the same name follow each other
+    std::vector<Parameter> parameters;
+    std::vector<Histogram> histograms;
+    std::vector<Rate> rates;
+    std::vector<Group> groups;
+};
+
+// appends the document to output as it goes, no tree of the document is built
+void writeStatDocument(const StatDocument &document, StatFormat format, std::string &output);
+const char *getStatContentType(StatFormat format);
+// xml, prometheus, openmetrics or json
+bool parseStatFormat(const std::string &name, StatFormat &format);
+// by the Accept header, XML when no other format is accepted
+StatFormat negotiateStatFormat(const std::string &accept);
+
+} /* namespace WebServer */
+} /* namespace Tools */
+
+#endif /* STATWRITER_H_ */
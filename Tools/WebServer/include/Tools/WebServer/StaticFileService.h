@@ -0,0 +1,142 @@
+#ifndef STATICFILESERVICE_H_
+#define STATICFILESERVICE_H_
+
+// C++
+#include <ctime>
+#include <list>
+#include <string>
+#include <stddef.h>
+
+// BOOST
+#include <boost/asio/io_service.hpp>
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/unordered_map.hpp>
+
+#include "Tools/WebServer/IStat.h"
+#include "Tools/WebServer/IWebService.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+class DirectoryWatcher;
+
+// Serves files of a directory with ETag/Last-Modified validation.
+// Small files are kept in memory together with their gzip encoding and dropped
+// when the directory reports a change. Larger ones are sent by TransmitFile or
+// sendfile, or over TLS read by bounded chunks on the reader threads.
+class StaticFileService : public Tools::WebServer::IWebService
+{
+public:
+    struct Settings
+    {
+        Settings();
+
+        std::string directory;
+        // served for directory requests
+        std::string indexFile;
+        // files up to this size are cached in memory
+        std::size_t maxCachedFileSize;
+        // limit for all cached files and their gzip encodings
+        std::size_t maxCacheSize;
+        // larger files are sent by pieces of this size
+        std::size_t chunkSize;
+        // read the chunks so that the I/O threads never wait for the disk
+        std::size_t readerThreads;
+        // how often a cached file is compared with the disk when the directory cannot be watched
+        boost::posix_time::time_duration checkInterval;
+    };
+
+    StaticFileService(const std::string &resource, const Settings &settings);
+    virtual ~StaticFileService();
+
+    // IWebService overloads
+    virtual void operator()(ConnectionContextPtr contextPtr);
+    virtual void start(void);
+    virtual void stop(void);
+
+    void getStatistics(IStat::Parameters &parameters) const;
+
+private:
+    struct FileInfo
+    {
+        boost::filesystem::path path;
+        boost::uintmax_t size;
+        std::time_t modified;
+        std::string etag;
+        std::string lastModified;
+        std::string contentType;
+    };
+
+    struct CachedFile
+    {
+        FileInfo info;
+        std::string content;
+        // empty when gzip does not make the file smaller
+        std::string gzipContent;
+        // the strong validator of the gzip representation differs from the identity one
+        std::string gzipEtag;
+        boost::atomic<boost::uint64_t> checked;
+    };
+
+    typedef boost::shared_ptr<CachedFile> CachedFilePtr;
+    // most recently used first
+    typedef std::list<CachedFilePtr> CachedFiles;
+    typedef boost::unordered_map<std::string, CachedFiles::iterator> CacheIndex;
+
+    bool getFilePath(const std::string &resource, boost::filesystem::path &path) const;
+    bool getFileInfo(const boost::filesystem::path &path, FileInfo &info) const;
+    CachedFilePtr findCached(const boost::filesystem::path &path);
+    CachedFilePtr loadCached(const FileInfo &info, boost::uint64_t changes);
+    void eraseCached(const boost::filesystem::path &path);
+    void clearCache();
+
+    void sendCached(ConnectionContextPtr contextPtr, const CachedFilePtr &filePtr);
+    void sendFile(ConnectionContextPtr contextPtr, const FileInfo &info);
+    static bool isNotModified(const pion::http::request &request,
+                              const std::string &etag,
+                              const std::string &lastModified);
+    static bool matchesEntityTag(const std::string &tags, const std::string &etag);
+    static pion::http::response_ptr createResponse(const pion::http::request &request,
+                                                   unsigned statusCode,
+                                                   const std::string &statusMessage);
+    static void addValidators(pion::http::response &response,
+                              const std::string &etag,
+                              const std::string &lastModified);
+    static std::string getContentType(const boost::filesystem::path &path);
+    static bool isCompressible(const std::string &contentType);
+
+    std::string m_resource;
+    Settings m_settings;
+
+    mutable boost::mutex m_mutex;
+    CachedFiles m_cachedFiles;
+    CacheIndex m_cacheIndex;
+    std::size_t m_cacheSize;
+    // incremented when the cache is cleared
+    boost::atomic<boost::uint64_t> m_changes;
+
+    boost::asio::io_service m_readerService;
+    boost::scoped_ptr<boost::asio::io_service::work> m_readerWorkPtr;
+    boost::thread_group m_readerThreads;
+    boost::scoped_ptr<DirectoryWatcher> m_watcherPtr;
+
+    boost::atomic<boost::uint64_t> m_cacheHits;
+    boost::atomic<boost::uint64_t> m_cacheMisses;
+    boost::atomic<boost::uint64_t> m_notModified;
+    boost::atomic<boost::uint64_t> m_streamed;
+    boost::atomic<boost::uint64_t> m_zeroCopy;
+};
+
+} /* namespace WebServer */
+} /* namespace Tools */
+
+#endif /* STATICFILESERVICE_H_ */
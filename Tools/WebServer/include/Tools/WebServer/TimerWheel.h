@@ -0,0 +1,109 @@
+#ifndef TIMERWHEEL_H_
+#define TIMERWHEEL_H_
+
+// C++
+#include <deque>
+#include <vector>
+#include <stddef.h>
+
+// BOOST
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include "Tools/WebServer/IScheduler.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+// Hierarchical timing wheel: 4 levels of 256 slots, insert and cancel are O(1).
+// A single thread advances the wheel every tick and hands expired handlers
+// to the executor. Timer nodes are recycled, so scheduling does not allocate
+// once the pool has grown to the peak number of outstanding timers.
+class TimerWheel : public ITimerScheduler, boost::noncopyable
+{
+public:
+    explicit TimerWheel(IScheduler &executor,
+                        const boost::posix_time::time_duration &tick = boost::posix_time::milliseconds(1));
+    virtual ~TimerWheel();
+
+    void start();
+    // outstanding timers are dropped without calling their handlers
+    void stop();
+    bool isRunning() const;
+    std::size_t getTimersCount() const;
+
+    // IScheduler
+    virtual void execute(SchedulerHandler handler, ExecutionLane lane = EL_NORMAL);
+    // ITimerScheduler
+    virtual TimerHandle executeOnTimer(SchedulerTimerHandler handler,
+                                       const boost::posix_time::time_duration &timeDuration);
+    virtual bool cancelTimer(const TimerHandle &timerHandle);
+
+private:
+    //types
+
+    enum
+    {
+        LEVELS = 4, SLOT_BITS = 8, SLOTS = 1 << SLOT_BITS, SLOT_MASK = SLOTS - 1
+    };
+
+    struct Node
+    {
+        Node();
+
+        SchedulerTimerHandler handler;
+        boost::uint64_t expires;
+        boost::uint32_t generation;
+        boost::uint32_t slot;
+        boost::uint32_t prev;
+        boost::uint32_t next;
+    };
+
+private:
+    //members
+
+    void tickRunner();
+    boost::uint64_t getCurrentTick() const;
+    void advance();
+    void cascade(std::size_t level);
+    void link(boost::uint32_t index);
+    void unlink(boost::uint32_t index);
+    boost::uint32_t allocateNode();
+    void releaseNode(boost::uint32_t index);
+    void clear();
+
+    IScheduler &m_executor;
+    boost::int64_t m_tickMicroseconds;
+    // tick 0 starts here
+    boost::posix_time::ptime m_startTime;
+    boost::atomic<bool> m_isRunning;
+
+    // guards everything below
+    mutable boost::mutex m_mutex;
+    boost::condition_variable m_condition;
+    // next tick to be processed
+    boost::uint64_t m_currentTick;
+    std::size_t m_timersCount;
+    std::deque<Node> m_nodes;
+    boost::uint32_t m_freeNodes;
+    boost::uint32_t m_slots[LEVELS * SLOTS];
+    std::vector<SchedulerTimerHandler> m_expired;
+
+    // expired handlers being passed to the executor, touched by the tick thread only
+    std::vector<SchedulerTimerHandler> m_dispatching;
+
+    boost::shared_ptr<boost::thread> m_tickThreadPtr;
+};
+
+typedef boost::shared_ptr<TimerWheel> TimerWheelPtr;
+
+} /* namespace WebServer */
+} /* namespace Tools */
+
+#endif /* TIMERWHEEL_H_ */
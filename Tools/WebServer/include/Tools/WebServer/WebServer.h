@@ -2,24 +2,34 @@
 #define WEBSERVER_H_
 
 // C++
+#include <deque>
 #include <map>
 #include <string>
 #include <utility>
 
 // Boost
 #include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
 
 // Pion
 #include <pion/http/auth.hpp>
 #include <pion/http/plugin_service.hpp>
 
+#include "Tools/WebServer/AdaptiveConcurrencyLimiter.h"
 #include "Tools/WebServer/Errors.h"
 #include "Tools/WebServer/IStat.h"
 #include "Tools/WebServer/IWebService.h"
+#include "Tools/WebServer/LaneQueue.h"
+#include "Tools/WebServer/QueueDelayShedder.h"
+#include "Tools/WebServer/ResponseCache.h"
 #include "Tools/WebServer/Scheduler.h"
+#include "Tools/WebServer/ServiceHandler.h"
+#include "Tools/WebServer/ServiceOptions.h"
+#include "Tools/WebServer/StatService.h"
 
 namespace Tools
 {
@@ -32,6 +42,11 @@ typedef std::map<std::string, std::string> PluginServiceOptions;
 class WebServer : boost::noncopyable
 {
 public:
+    enum WorkSchedulerType
+    {
+        WST_ASIO, WST_WORK_STEALING
+    };
+
     WebServer();
     WebServer(const std::string &host,
               const unsigned int port,
@@ -49,29 +64,74 @@ public:
     void setHost(const std::string &host);
     unsigned int getPort() const;
     void setPort(unsigned int port);
+    // the thread counts and the connection limit may be changed on the running server,
+    // the changes are reported by the "reconfiguration" stat provider
     std::size_t getHttpThreadCount() const;
     void setHttpThreadCount(std::size_t threadCount);
     std::size_t getTimeout() const;
     void setTimeout(std::size_t timeout);
+    // how long a keep-alive connection waits for the next request
+    std::size_t getIdleTimeout() const;
+    void setIdleTimeout(std::size_t idleTimeout);
     std::size_t getConnectionLimit() const;
     void setConnectionLimit(std::size_t connectionLimit);
+    // stop() waits this long for the active requests while new connections are refused,
+    // zero stops at once
+    std::size_t getDrainTimeout() const;
+    void setDrainTimeout(std::size_t drainTimeout);
+    // several acceptors listen the same port with SO_REUSEPORT,
+    // each one serves its connections by an own thread
+    std::size_t getAcceptorCount() const;
+    void setAcceptorCount(std::size_t acceptorCount);
+    // every http thread runs an own io_service, a connection stays on one of them
+    bool isIoShardingEnabled() const;
+    void setIoShardingEnabled(bool enabled);
     std::size_t getWorkerThreadCount() const;
     void setWorkerThreadCount(std::size_t workerThreadCount);
+    std::size_t getMinWorkerThreadCount() const;
+    // as set, 0 when the minimum follows the worker thread count
+    std::size_t getConfiguredMinWorkerThreadCount() const;
+    void setMinWorkerThreadCount(std::size_t minWorkerThreadCount);
+    WorkSchedulerType getWorkSchedulerType() const;
+    void setWorkSchedulerType(WorkSchedulerType workSchedulerType);
+    LanePolicy getLanePolicy() const;
+    void setLanePolicy(LanePolicy lanePolicy);
+    bool isAdaptiveLimitEnabled() const;
+    void setAdaptiveLimitEnabled(bool enabled);
+    const AdaptiveConcurrencyLimiter::Settings &getAdaptiveLimitSettings() const;
+    void setAdaptiveLimitSettings(const AdaptiveConcurrencyLimiter::Settings &settings);
+    bool isQueueDelaySheddingEnabled() const;
+    void setQueueDelaySheddingEnabled(bool enabled);
+    const QueueDelayShedder::Settings &getQueueDelaySheddingSettings() const;
+    void setQueueDelaySheddingSettings(const QueueDelayShedder::Settings &settings);
+    bool isResponseCacheEnabled() const;
+    void setResponseCacheEnabled(bool enabled);
+    const ResponseCache::Settings &getResponseCacheSettings() const;
+    void setResponseCacheSettings(const ResponseCache::Settings &settings);
     bool isRunning() const;
+    // see StatService for the snapshot interval
     void enableStatService(const std::string &serviceName,
                            const std::string &resource,
                            const std::string &version,
-                           const std::string &revision);
+                           const std::string &revision,
+                           const boost::posix_time::time_duration &snapshotInterval = boost::posix_time::time_duration());
     void enableConfService(boost::function<std::pair<std::string,std::string>()> confCallback,
                            const std::string &resource = "/conf");
+    // see AdminService, the remote clients are refused unless isRemoteAllowed is set
+    void enableAdminService(const std::string &resource = "/admin", bool isRemoteAllowed = false);
     IStatPtr getStatService();
-    void addService(const std::string &resource, IWebServicePtr servicePtr);
+    void addService(const std::string &resource,
+                    IWebServicePtr servicePtr,
+                    const ServiceOptions &options = ServiceOptions());
     void addPluginService(const std::string &resource,
                           PluginServicePtr servicePtr,
                           const PluginServiceOptions &options);
     void addRedirect(const std::string &from, const std::string &to);
     void setAuth(pion::http::auth_ptr authPtr);
 
+    // resource as a part of a stat tag name
+    static std::string getStatName(const std::string &resource);
+
 protected:
     void onHandlerError(pion::http::request_ptr requestPtr,
                         pion::tcp::connection_ptr tcpConnPtr,
@@ -79,24 +139,74 @@ protected:
 
 private:
     void setRunning(bool isRunning);
+    IWorkSchedulerPtr createWorkScheduler() const;
+    void getServicesStatistics(IStat::Parameters &parameters) const;
+    static void getRequestMemoryStatistics(IStat::Parameters &parameters);
+    // false when the deadline passed before all requests finished
+    bool drain();
+    void getDrainStatistics(IStat::Parameters &parameters) const;
+    // m_reconfigurationMutex must be locked
+    void recordReconfiguration(const std::string &parameter, std::size_t from, std::size_t to);
+    void getReconfigurationStatistics(IStat::Parameters &parameters) const;
+
+    struct Reconfiguration
+    {
+        boost::posix_time::ptime time;
+        std::string parameter;
+        std::size_t from;
+        std::size_t to;
+    };
+
+    // the latest first
+    typedef std::deque<Reconfiguration> Reconfigurations;
 
     struct WebServerImpl;
     boost::scoped_ptr<WebServerImpl> m_pImpl;
     boost::atomic_int32_t m_activeRequestsCount;
+    boost::atomic<bool> m_isDraining;
+    boost::atomic<boost::uint64_t> m_drainDeadline;
+    boost::atomic<boost::uint64_t> m_drainCutOff;
 
-    SchedulerPtr m_workSchedulerPtr;
+    IWorkSchedulerPtr m_workSchedulerPtr;
 
     std::string m_host;
     unsigned int m_port;
     std::size_t m_httpThreadCount;
     std::size_t m_timeout;
+    std::size_t m_idleTimeout;
     std::size_t m_connectionLimit;
+    std::size_t m_drainTimeout;
+    std::size_t m_acceptorCount;
+    bool m_ioShardingEnabled;
     std::size_t m_workerThreadCount;
-    bool m_isRunning;
-
-    typedef std::map<std::string, IWebServicePtr> Services;
+    std::size_t m_minWorkerThreadCount;
+    WorkSchedulerType m_workSchedulerType;
+    LanePolicy m_lanePolicy;
+    bool m_adaptiveLimitEnabled;
+    AdaptiveConcurrencyLimiter::Settings m_adaptiveLimitSettings;
+    bool m_queueDelaySheddingEnabled;
+    QueueDelayShedder::Settings m_queueDelaySheddingSettings;
+    bool m_responseCacheEnabled;
+    ResponseCache::Settings m_responseCacheSettings;
+    // read by the reconfigurations on worker threads
+    boost::atomic<bool> m_isRunning;
+
+    // serializes changes of the running server
+    mutable boost::mutex m_reconfigurationMutex;
+    Reconfigurations m_reconfigurations;
+    std::size_t m_reconfigurationCount;
+
+    typedef std::pair<IWebServicePtr, ServiceOptions> ServiceDesc;
+    typedef std::map<std::string, ServiceDesc> Services;
     Services m_services;
 
+    // handlers of the running server by stat name
+    typedef std::map<std::string, ServiceHandlerPtr> ServiceHandlers;
+    ServiceHandlers m_serviceHandlers;
+    // shared by all services of the running server
+    QueueDelayShedderPtr m_queueDelayShedderPtr;
+    ResponseCachePtr m_responseCachePtr;
+
     typedef std::pair<PluginServicePtr, PluginServiceOptions> PluginServiceDesc;
     typedef std::map<std::string, PluginServiceDesc> PluginServices;
     PluginServices m_pluginServices;
@@ -108,6 +218,8 @@ private:
     std::string m_statServiceName;
     std::string m_statResource;
     IStatPtr m_statPtr;
+    // the same service as m_statPtr when enabled, its rates tick on the work scheduler
+    boost::shared_ptr<StatService> m_statServicePtr;
 
     // trace options
     std::string m_serviceName;
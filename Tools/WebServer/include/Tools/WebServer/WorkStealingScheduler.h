@@ -0,0 +1,108 @@
+#ifndef WORKSTEALINGSCHEDULER_H_
+#define WORKSTEALINGSCHEDULER_H_
+
+// C++
+#include <vector>
+#include <stddef.h>
+
+// BOOST
+#include <boost/atomic.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+#include "Tools/WebServer/IScheduler.h"
+#include "Tools/WebServer/LaneQueue.h"
+#include "Tools/WebServer/TimerWheel.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+// Fixed-size pool with a deque per worker thread.
+// Handlers posted from a worker thread go to its own deque, handlers posted
+// from other threads are spread round-robin. Idle workers steal from the others.
+// Every deque is split into execution lanes served according to the lane policy.
+class WorkStealingScheduler : public IWorkScheduler, boost::noncopyable
+{
+public:
+    explicit WorkStealingScheduler(const std::size_t threads, LanePolicy lanePolicy = LP_WEIGHTED);
+    virtual ~WorkStealingScheduler();
+
+    // IWorkScheduler
+    virtual void start();
+    virtual void stop();
+    virtual bool isRunning() const;
+    virtual void getStatistics(IStat::Parameters &parameters) const;
+    virtual bool setThreadLimits(std::size_t minThreads, std::size_t maxThreads);
+
+    // IScheduler
+    virtual void execute(SchedulerHandler handler, ExecutionLane lane = EL_NORMAL);
+    // ITimerScheduler
+    virtual TimerHandle executeOnTimer(SchedulerTimerHandler handler,
+                                       const boost::posix_time::time_duration &timeDuration);
+    virtual bool cancelTimer(const TimerHandle &timerHandle);
+
+private:
+    //types
+
+    class Worker : boost::noncopyable
+    {
+    public:
+        Worker(std::size_t index, LanePolicy lanePolicy, LaneStatistics &laneStatistics);
+
+        void push(const SchedulerHandler &handler, ExecutionLane lane);
+        bool pop(SchedulerHandler &handler);
+        bool steal(SchedulerHandler &handler);
+        void clear();
+
+        std::size_t getIndex() const;
+        boost::shared_ptr<boost::thread> getThreadPtr();
+        void setThreadPtr(boost::shared_ptr<boost::thread> threadPtr);
+
+    private:
+        std::size_t m_index;
+        LaneQueue m_handlers;
+        boost::shared_ptr<boost::thread> m_threadPtr;
+    };
+
+    typedef boost::shared_ptr<Worker> WorkerPtr;
+    typedef std::vector<WorkerPtr> Workers;
+
+private:
+    //members
+
+    void setRunning(bool running);
+    void workerRunner(Worker *pWorker);
+    bool takeHandler(Worker *pWorker, SchedulerHandler &handler);
+    void waitForWork();
+    void wakeUpWorker();
+    Worker *getCurrentWorker();
+    static void deleteWorkerStub(Worker *);
+
+    std::size_t m_threadsCount;
+    Workers m_workers;
+    boost::atomic<bool> m_isRunning;
+
+    boost::atomic<std::size_t> m_nextWorker;
+    boost::atomic<std::size_t> m_pendingHandlers;
+    boost::atomic<std::size_t> m_sleepingWorkers;
+    boost::atomic<std::size_t> m_stolenHandlers;
+    LaneStatistics m_laneStatistics;
+    boost::mutex m_idleMutex;
+    boost::condition_variable m_idleCondition;
+
+    boost::thread_specific_ptr<Worker> m_currentWorker;
+
+    // expired timers are pushed to the workers as regular handlers
+    TimerWheel m_timerWheel;
+};
+
+typedef boost::shared_ptr<WorkStealingScheduler> WorkStealingSchedulerPtr;
+
+} /* namespace WebServer */
+} /* namespace Tools */
+
+#endif /* WORKSTEALINGSCHEDULER_H_ */
@@ -0,0 +1,153 @@
+// C++
+#include <algorithm>
+#include <cmath>
+
+// BOOST
+#include <boost/lexical_cast.hpp>
+
+// THIS
+#include "Tools/WebServer/AdaptiveConcurrencyLimiter.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+// the no-load latency estimate creeps up by this factor per second,
+// so that a permanent latency increase is eventually accepted
+static const double noLoadLatencyDrift = 1.01;
+
+//--------------------------------------------------------------------------------------------------
+AdaptiveConcurrencyLimiter::Settings::Settings() :
+        initialLimit(20u),
+        minLimit(4u),
+        maxLimit(1000u),
+        windowSamples(50u),
+        tolerance(1.5),
+        smoothing(0.2)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+AdaptiveConcurrencyLimiter::AdaptiveConcurrencyLimiter(const Settings &settings) :
+        m_settings(settings),
+        m_limit(0u),
+        m_inFlight(0u),
+        m_rejected(0u),
+        m_estimatedLimit(0.0),
+        m_noLoadLatency(0.0),
+        m_lastUpdateTime(getTimestampNs()),
+        m_windowLatencySum(0.0),
+        m_windowSamples(0u),
+        m_windowMaxInFlight(0u)
+{
+    m_settings.minLimit = std::max<std::size_t>(m_settings.minLimit, 1u);
+    m_settings.maxLimit = std::max(m_settings.maxLimit, m_settings.minLimit);
+    m_settings.windowSamples = std::max<std::size_t>(m_settings.windowSamples, 1u);
+
+    const std::size_t limit = std::min(std::max(m_settings.initialLimit, m_settings.minLimit), m_settings.maxLimit);
+    m_estimatedLimit = static_cast<double>(limit);
+    m_limit = limit;
+}
+
+//--------------------------------------------------------------------------------------------------
+bool AdaptiveConcurrencyLimiter::tryAcquire()
+{
+    std::size_t inFlight = m_inFlight.load(boost::memory_order_relaxed);
+    do
+    {
+        if (inFlight >= m_limit.load(boost::memory_order_relaxed))
+        {
+            m_rejected.fetch_add(1u, boost::memory_order_relaxed);
+            return false;
+        }
+    }
+    while (!m_inFlight.compare_exchange_weak(inFlight, inFlight + 1u, boost::memory_order_relaxed));
+
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+void AdaptiveConcurrencyLimiter::release(boost::uint64_t latencyNs)
+{
+    const std::size_t inFlight = m_inFlight.fetch_sub(1u, boost::memory_order_relaxed);
+
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_windowLatencySum += static_cast<double>(latencyNs);
+    m_windowMaxInFlight = std::max(m_windowMaxInFlight, inFlight);
+    if (++m_windowSamples >= m_settings.windowSamples)
+    {
+        updateLimit(m_windowLatencySum / static_cast<double>(m_windowSamples), getTimestampNs());
+
+        m_windowLatencySum = 0.0;
+        m_windowSamples = 0u;
+        m_windowMaxInFlight = 0u;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+void AdaptiveConcurrencyLimiter::updateLimit(double shortLatency, boost::uint64_t now)
+{
+    if (shortLatency <= 0.0)
+    {
+        return;
+    }
+
+    if (m_noLoadLatency <= 0.0 || shortLatency < m_noLoadLatency)
+    {
+        m_noLoadLatency = shortLatency;
+    }
+    else
+    {
+        const double elapsed = static_cast<double>(now - m_lastUpdateTime) / 1e9;
+        m_noLoadLatency = std::min(m_noLoadLatency * std::pow(noLoadLatencyDrift, elapsed), shortLatency);
+    }
+    m_lastUpdateTime = now;
+
+    // the limit is not the bottleneck, don't let it grow unbounded
+    if (static_cast<double>(m_windowMaxInFlight) * 2.0 < m_estimatedLimit)
+    {
+        return;
+    }
+
+    const double gradient = std::max(0.5, std::min(1.0, m_settings.tolerance * m_noLoadLatency / shortLatency));
+    const double newLimit = m_estimatedLimit * gradient + std::sqrt(m_estimatedLimit);
+
+    m_estimatedLimit = m_estimatedLimit * (1.0 - m_settings.smoothing) + newLimit * m_settings.smoothing;
+    m_estimatedLimit = std::max(static_cast<double>(m_settings.minLimit),
+                                std::min(static_cast<double>(m_settings.maxLimit), m_estimatedLimit));
+
+    m_limit.store(static_cast<std::size_t>(m_estimatedLimit), boost::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------------------------
+std::size_t AdaptiveConcurrencyLimiter::getLimit() const
+{
+    return m_limit.load(boost::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------------------------
+std::size_t AdaptiveConcurrencyLimiter::getInFlight() const
+{
+    return m_inFlight.load(boost::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------------------------
+boost::uint64_t AdaptiveConcurrencyLimiter::getRejected() const
+{
+    return m_rejected.load(boost::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------------------------
+void AdaptiveConcurrencyLimiter::getStatistics(const std::string &prefix, IStat::Parameters &parameters) const
+{
+    parameters.push_back(IStat::Parameter(prefix + "_limit",
+                                          boost::lexical_cast<std::string>(getLimit())));
+    parameters.push_back(IStat::Parameter(prefix + "_inflight",
+                                          boost::lexical_cast<std::string>(getInFlight())));
+    parameters.push_back(IStat::Parameter(prefix + "_rejected",
+                                          boost::lexical_cast<std::string>(getRejected())));
+}
+
+} /* namespace WebServer */
+} /* namespace Tools */
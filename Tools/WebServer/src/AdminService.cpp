@@ -0,0 +1,294 @@
+// C++
+#include <map>
+#include <sstream>
+#include <utility>
+#include <vector>
+
+// BOOST
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/lexical_cast.hpp>
+
+// PION
+#include <pion/http/types.hpp>
+
+// THIS
+#include "Tools/Logger/Logger.h"
+#include "Tools/WebServer/AdminService.h"
+#include "Tools/WebServer/Errors.h"
+#include "Tools/WebServer/WebServer.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+namespace
+{
+
+const char *const HTTP_THREADS = "httpthreads";
+const char *const WORKER_THREADS = "workerthreads";
+const char *const MIN_WORKER_THREADS = "minworkerthreads";
+const char *const CONNECTION_LIMIT = "connectionlimit";
+
+// a typo must not take the server down, the settings of the config are not limited
+const std::size_t MAX_HTTP_THREADS = 256u;
+const std::size_t MAX_WORKER_THREADS = 1024u;
+const std::size_t MAX_CONNECTION_LIMIT = 1000000u;
+
+std::size_t getMaxValue(const std::string &name)
+{
+    if (name == HTTP_THREADS)
+    {
+        return MAX_HTTP_THREADS;
+    }
+    if (name == WORKER_THREADS || name == MIN_WORKER_THREADS)
+    {
+        return MAX_WORKER_THREADS;
+    }
+    return MAX_CONNECTION_LIMIT;
+}
+
+}
+
+//--------------------------------------------------------------------------------------------------
+AdminService::AdminService(WebServer &webServer, bool isRemoteAllowed) :
+        m_webServer(webServer),
+        m_isRemoteAllowed(isRemoteAllowed)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+AdminService::~AdminService()
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+void AdminService::start()
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+void AdminService::stop()
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+void AdminService::operator()(ConnectionContextPtr contextPtr)
+{
+    pion::http::request_ptr requestPtr = contextPtr->getRequest();
+    const std::string &method = requestPtr->get_method();
+
+    if (!m_isRemoteAllowed && !isLocal(contextPtr->getTcpConn()))
+    {
+        sendResponse(contextPtr, pion::http::types::RESPONSE_CODE_FORBIDDEN,
+                     pion::http::types::RESPONSE_MESSAGE_FORBIDDEN,
+                     "Forbidden. The admin service answers local clients only.\n");
+        return;
+    }
+
+    if (method == pion::http::types::REQUEST_METHOD_GET)
+    {
+        sendResponse(contextPtr, pion::http::types::RESPONSE_CODE_OK, pion::http::types::RESPONSE_MESSAGE_OK,
+                     getSettings());
+        return;
+    }
+
+    if (method != pion::http::types::REQUEST_METHOD_POST)
+    {
+        sendResponse(contextPtr, pion::http::types::RESPONSE_CODE_METHOD_NOT_ALLOWED,
+                     pion::http::types::RESPONSE_MESSAGE_METHOD_NOT_ALLOWED,
+                     "Bad request. Request method must be GET or POST.\n");
+        return;
+    }
+
+    // a browser adds Origin to the cross-site POST of any page, which needs no preflight
+    if (!requestPtr->get_header("Origin").empty())
+    {
+        sendResponse(contextPtr, pion::http::types::RESPONSE_CODE_FORBIDDEN,
+                     pion::http::types::RESPONSE_MESSAGE_FORBIDDEN,
+                     "Forbidden. Cross-origin requests are not accepted.\n");
+        return;
+    }
+
+    // everything is checked before the first change
+    std::map<std::string, std::size_t> values;
+    const pion::ihash_multimap &queries = requestPtr->get_queries();
+    for (pion::ihash_multimap::const_iterator i = queries.begin(); i != queries.end(); ++i)
+    {
+        if (i->first != HTTP_THREADS && i->first != WORKER_THREADS
+                && i->first != MIN_WORKER_THREADS && i->first != CONNECTION_LIMIT)
+        {
+            sendResponse(contextPtr, pion::http::types::RESPONSE_CODE_BAD_REQUEST,
+                         pion::http::types::RESPONSE_MESSAGE_BAD_REQUEST,
+                         "Bad request. Unknown parameter " + i->first + ".\n");
+            return;
+        }
+        if (i->second.empty() || !boost::algorithm::all(i->second, boost::algorithm::is_digit()))
+        {
+            sendResponse(contextPtr, pion::http::types::RESPONSE_CODE_BAD_REQUEST,
+                         pion::http::types::RESPONSE_MESSAGE_BAD_REQUEST,
+                         "Bad request. Parameter " + i->first + " must be a number.\n");
+            return;
+        }
+
+        std::size_t value = 0u;
+        try
+        {
+            value = boost::lexical_cast<std::size_t>(i->second);
+        }
+        catch (const boost::bad_lexical_cast &)
+        {
+            value = 0u;
+        }
+        if (value < 1u || value > getMaxValue(i->first))
+        {
+            sendResponse(contextPtr, pion::http::types::RESPONSE_CODE_BAD_REQUEST,
+                         pion::http::types::RESPONSE_MESSAGE_BAD_REQUEST,
+                         "Bad request. Parameter " + i->first + " must be from 1 to "
+                         + boost::lexical_cast<std::string>(getMaxValue(i->first)) + ".\n");
+            return;
+        }
+        values[i->first] = value;
+    }
+
+    const std::size_t workerThreads = values.count(WORKER_THREADS) != 0u
+            ? values[WORKER_THREADS] : m_webServer.getWorkerThreadCount();
+    const std::size_t minWorkerThreads = values.count(MIN_WORKER_THREADS) != 0u
+            ? values[MIN_WORKER_THREADS] : m_webServer.getMinWorkerThreadCount();
+    if (minWorkerThreads > workerThreads)
+    {
+        sendResponse(contextPtr, pion::http::types::RESPONSE_CODE_BAD_REQUEST,
+                     pion::http::types::RESPONSE_MESSAGE_BAD_REQUEST,
+                     "Bad request. Parameter " + std::string(MIN_WORKER_THREADS) + " must not exceed "
+                     + WORKER_THREADS + ".\n");
+        return;
+    }
+
+    try
+    {
+        apply(values);
+    }
+    catch (const std::exception &e)
+    {
+        sendResponse(contextPtr, 409u, "Conflict", std::string(e.what()) + "\n");
+        return;
+    }
+
+    sendResponse(contextPtr, pion::http::types::RESPONSE_CODE_OK, pion::http::types::RESPONSE_MESSAGE_OK,
+                 getSettings());
+}
+
+//--------------------------------------------------------------------------------------------------
+void AdminService::apply(const std::map<std::string, std::size_t> &values)
+{
+    // the applied settings and their previous values, restored when a later one fails
+    std::vector<std::pair<std::string, std::size_t> > applied;
+    try
+    {
+        std::map<std::string, std::size_t>::const_iterator it = values.find(WORKER_THREADS);
+        if (it != values.end())
+        {
+            applied.push_back(std::make_pair(it->first, m_webServer.getWorkerThreadCount()));
+            m_webServer.setWorkerThreadCount(it->second);
+        }
+        it = values.find(MIN_WORKER_THREADS);
+        if (it != values.end())
+        {
+            // 0 follows workerthreads, the effective value would not
+            applied.push_back(std::make_pair(it->first, m_webServer.getConfiguredMinWorkerThreadCount()));
+            m_webServer.setMinWorkerThreadCount(it->second);
+        }
+        it = values.find(HTTP_THREADS);
+        if (it != values.end())
+        {
+            applied.push_back(std::make_pair(it->first, m_webServer.getHttpThreadCount()));
+            m_webServer.setHttpThreadCount(it->second);
+        }
+        it = values.find(CONNECTION_LIMIT);
+        if (it != values.end())
+        {
+            applied.push_back(std::make_pair(it->first, m_webServer.getConnectionLimit()));
+            m_webServer.setConnectionLimit(it->second);
+        }
+    }
+    catch (...)
+    {
+        // the setting which failed is restored too, it may have been half applied
+        for (std::vector<std::pair<std::string, std::size_t> >::reverse_iterator i = applied.rbegin();
+             i != applied.rend();
+             ++i)
+        {
+            try
+            {
+                set(i->first, i->second);
+            }
+            catch (const std::exception &e)
+            {
+                Tools::Logger::Logger::getInstance().error() << "Admin service could not restore " << i->first
+                        << "=" << i->second << ": " << e.what();
+            }
+        }
+        throw;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+void AdminService::set(const std::string &name, std::size_t value)
+{
+    if (name == WORKER_THREADS)
+    {
+        m_webServer.setWorkerThreadCount(value);
+    }
+    else if (name == MIN_WORKER_THREADS)
+    {
+        m_webServer.setMinWorkerThreadCount(value);
+    }
+    else if (name == HTTP_THREADS)
+    {
+        m_webServer.setHttpThreadCount(value);
+    }
+    else if (name == CONNECTION_LIMIT)
+    {
+        m_webServer.setConnectionLimit(value);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+std::string AdminService::getSettings() const
+{
+    std::ostringstream settings;
+    settings << HTTP_THREADS << "=" << m_webServer.getHttpThreadCount() << "\n"
+             << WORKER_THREADS << "=" << m_webServer.getWorkerThreadCount() << "\n"
+             << MIN_WORKER_THREADS << "=" << m_webServer.getMinWorkerThreadCount() << "\n"
+             << CONNECTION_LIMIT << "=" << m_webServer.getConnectionLimit() << "\n";
+    return settings.str();
+}
+
+//--------------------------------------------------------------------------------------------------
+bool AdminService::isLocal(const pion::tcp::connection_ptr &tcpConnPtr)
+{
+    const boost::asio::ip::address address = tcpConnPtr->get_remote_ip();
+    if (address.is_v6() && address.to_v6().is_v4_mapped())
+    {
+        return address.to_v6().to_v4().is_loopback();
+    }
+    return address.is_loopback();
+}
+
+//--------------------------------------------------------------------------------------------------
+void AdminService::sendResponse(ConnectionContextPtr contextPtr,
+                                unsigned statusCode,
+                                const std::string &statusMessage,
+                                const std::string &content)
+{
+    pion::http::response_ptr responsePtr(new pion::http::response(*contextPtr->getRequest()));
+    responsePtr->set_status_code(statusCode);
+    responsePtr->set_status_message(statusMessage);
+    responsePtr->set_content_type("text/plain;charset=UTF-8");
+    responsePtr->set_content(content);
+    contextPtr->sendResponse(responsePtr);
+}
+
+} /* namespace WebServer */
+} /* namespace Tools */
@@ -1,5 +1,17 @@
+// C++
+#include <limits>
+#include <new>
+
 // BOOST
+#include <boost/asio/placeholders.hpp>
 #include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/lockfree/stack.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
 
 // PION
 #include <pion/http/response_writer.hpp>
@@ -11,16 +23,183 @@ namespace Tools
 namespace WebServer
 {
 
+namespace
+{
+
+enum
+{
+    // freed contexts kept for reuse
+    MAX_POOLED_CONTEXTS = 1024,
+    // chunked responses up to this size are passed to the response handlers when finished
+    MAX_SHARED_CHUNKED_SIZE = 4 * 1024 * 1024
+};
+
+boost::atomic<boost::uint64_t> contextsAllocated(0u);
+boost::atomic<boost::uint64_t> contextsReused(0u);
+boost::atomic<boost::uint64_t> contextsFreed(0u);
+
+struct ContextPool
+{
+    ~ContextPool()
+    {
+        void *p = NULL;
+        while (blocks.pop(p))
+        {
+            ::operator delete(p);
+        }
+    }
+
+    // the nodes are preallocated, tagged indices keep pop() safe from ABA
+    boost::lockfree::stack<void *, boost::lockfree::capacity<MAX_POOLED_CONTEXTS> > blocks;
+};
+
+// Single objects are taken from and returned to a lock-free pool shared by all threads:
+// the context is created on an I/O thread and usually destroyed on a worker.
+// Used for the contexts together with their shared_ptr control blocks
+template <typename T>
+class PooledAllocator
+{
+public:
+    typedef T value_type;
+    typedef T *pointer;
+    typedef const T *const_pointer;
+    typedef T &reference;
+    typedef const T &const_reference;
+    typedef std::size_t size_type;
+    typedef std::ptrdiff_t difference_type;
+
+    template <typename U>
+    struct rebind
+    {
+        typedef PooledAllocator<U> other;
+    };
+
+    PooledAllocator()
+    {
+    }
+
+    template <typename U>
+    PooledAllocator(const PooledAllocator<U> &)
+    {
+    }
+
+    pointer allocate(size_type n, const void * = 0)
+    {
+        if (n == 1u)
+        {
+            void *p = NULL;
+            if (s_pool.blocks.pop(p))
+            {
+                contextsReused.fetch_add(1u, boost::memory_order_relaxed);
+                return static_cast<pointer>(p);
+            }
+            contextsAllocated.fetch_add(1u, boost::memory_order_relaxed);
+        }
+        return static_cast<pointer>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(pointer p, size_type n)
+    {
+        if (n == 1u)
+        {
+            if (s_pool.blocks.bounded_push(p))
+            {
+                return;
+            }
+            contextsFreed.fetch_add(1u, boost::memory_order_relaxed);
+        }
+        ::operator delete(p);
+    }
+
+    void construct(pointer p, const T &value)
+    {
+        new (static_cast<void *>(p)) T(value);
+    }
+
+    void destroy(pointer p)
+    {
+        p->~T();
+    }
+
+    size_type max_size() const
+    {
+        return std::numeric_limits<size_type>::max() / sizeof(T);
+    }
+
+private:
+    // one pool per object size
+    static ContextPool s_pool;
+};
+
+template <typename T>
+ContextPool PooledAllocator<T>::s_pool;
+
+template <typename T, typename U>
+inline bool operator==(const PooledAllocator<T> &, const PooledAllocator<U> &)
+{
+    return true;
+}
+
+template <typename T, typename U>
+inline bool operator!=(const PooledAllocator<T> &, const PooledAllocator<U> &)
+{
+    return false;
+}
+
+}
+
+struct ConnectionContext::ChunkedResponse
+{
+    ChunkedResponse() :
+            isWriting(false),
+            isFinished(false)
+    {
+    }
+
+    pion::http::response_ptr responsePtr;
+    pion::http::response_writer_ptr writer;
+    // copy of the sent body for the response handlers, reset when it grows too large
+    ResponseBodyPtr sentBodyPtr;
+    // set when the body is gzipped, writes into compressed
+    boost::scoped_ptr<boost::iostreams::filtering_ostream> gzipStreamPtr;
+    std::string compressed;
+    // the chunk being written, must stay intact until the write completes
+    std::string sending;
+    bool isWriting;
+    bool isFinished;
+    // set when a write fails, the connection is closed then
+    boost::system::error_code error;
+};
+
+//--------------------------------------------------------------------------------------------------
+ConnectionContext::ArenaHolder::ArenaHolder() :
+        arenaPtr(RequestArena::acquire())
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+ConnectionContext::ArenaHolder::~ArenaHolder()
+{
+    RequestArena::release(arenaPtr);
+}
+
 //--------------------------------------------------------------------------------------------------
 ConnectionContext::ConnectionContext(pion::http::request_ptr requestPtr,
                                      pion::tcp::connection_ptr tcpConnPtr,
                                      Tools::WebServer::IStatPtr statPtr,
-                                     boost::atomic_int32_t &activeRequestsCount):
+                                     boost::atomic_int32_t &activeRequestsCount,
+                                     const boost::atomic<bool> &isDraining,
+                                     ResponseBodyCounters &responseBodyCounters):
                                              m_requestPtr(requestPtr),
                                              m_tcpConnPtr(tcpConnPtr),
                                              m_statPtr(statPtr),
                                              m_responseSet(false),
-                                             m_activeRequestsCount(activeRequestsCount)
+                                             m_activeRequestsCount(activeRequestsCount),
+                                             m_isDraining(isDraining),
+                                             m_responseBodyCounters(responseBodyCounters),
+                                             m_finishHandlers(ArenaAllocator<FinishHandler>(*m_arena.arenaPtr)),
+                                             m_responseHandlers(ArenaAllocator<ResponseHandler>(*m_arena.arenaPtr)),
+                                             m_unsharedHandlers(ArenaAllocator<FinishHandler>(*m_arena.arenaPtr))
 {
     m_activeRequestsCount.fetch_add(1, boost::memory_order_release);
 }
@@ -28,10 +207,57 @@ ConnectionContext::ConnectionContext(pion::http::request_ptr requestPtr,
 //--------------------------------------------------------------------------------------------------
 ConnectionContext::~ConnectionContext()
 {
+    if (m_chunkedResponsePtr && !m_chunkedResponsePtr->isFinished && !m_chunkedResponsePtr->error)
+    {
+        // the body is incomplete, only closing tells the client
+        pion::tcp::connection_ptr tcpConnPtr = m_chunkedResponsePtr->writer->get_connection();
+        tcpConnPtr->set_lifecycle(pion::tcp::connection::LIFECYCLE_CLOSE);
+        tcpConnPtr->finish();
+    }
+
+    for (FinishHandlers::const_iterator i = m_finishHandlers.begin(); i != m_finishHandlers.end(); ++i)
+    {
+        try
+        {
+            (*i)();
+        }
+        catch (const std::exception &)
+        {
+        }
+    }
+
     // TODO: check isResponseSet()
     m_activeRequestsCount.fetch_add(-1, boost::memory_order_release);
 }
 
+//--------------------------------------------------------------------------------------------------
+ConnectionContextPtr ConnectionContext::create(pion::http::request_ptr requestPtr,
+                                               pion::tcp::connection_ptr tcpConnPtr,
+                                               Tools::WebServer::IStatPtr statPtr,
+                                               boost::atomic_int32_t &activeRequestsCount,
+                                               const boost::atomic<bool> &isDraining,
+                                               ResponseBodyCounters &responseBodyCounters)
+{
+    return boost::allocate_shared<ConnectionContext>(PooledAllocator<ConnectionContext>(),
+                                                     requestPtr,
+                                                     tcpConnPtr,
+                                                     statPtr,
+                                                     boost::ref(activeRequestsCount),
+                                                     boost::cref(isDraining),
+                                                     boost::ref(responseBodyCounters));
+}
+
+//--------------------------------------------------------------------------------------------------
+void ConnectionContext::getPoolStatistics(IStat::Parameters &parameters)
+{
+    parameters.push_back(IStat::Parameter("contexts_allocated",
+            boost::lexical_cast<std::string>(contextsAllocated.load(boost::memory_order_relaxed))));
+    parameters.push_back(IStat::Parameter("contexts_reused",
+            boost::lexical_cast<std::string>(contextsReused.load(boost::memory_order_relaxed))));
+    parameters.push_back(IStat::Parameter("contexts_freed",
+            boost::lexical_cast<std::string>(contextsFreed.load(boost::memory_order_relaxed))));
+}
+
 //--------------------------------------------------------------------------------------------------
 pion::http::request_ptr ConnectionContext::getRequest()
 {
@@ -50,6 +276,12 @@ Tools::WebServer::IStatPtr ConnectionContext::getStat()
     return m_statPtr;
 }
 
+//--------------------------------------------------------------------------------------------------
+RequestArena &ConnectionContext::getArena()
+{
+    return *m_arena.arenaPtr;
+}
+
 //--------------------------------------------------------------------------------------------------
 void ConnectionContext::sendResponse(pion::http::response_ptr responsePtr)
 {
@@ -58,15 +290,273 @@ void ConnectionContext::sendResponse(pion::http::response_ptr responsePtr)
         throw std::runtime_error("ConnectionContext::sendResponse() invoked twice");
     }
 
+    static const ResponseBody emptyBody;
+    callResponseHandlers(*responsePtr, emptyBody);
+
+    closeIfDraining();
     pion::http::response_writer_ptr writer(pion::http::response_writer::create(
             m_tcpConnPtr,
             responsePtr,
             boost::bind(&pion::tcp::connection::finish, m_tcpConnPtr)));
 
     writer->send();
+    m_responseBodyCounters.addCopied(responsePtr->get_content_length());
+
+    m_tcpConnPtr.reset();
+    m_responseSet = true;
+}
+
+//--------------------------------------------------------------------------------------------------
+void ConnectionContext::sendResponse(pion::http::response_ptr responsePtr, ResponseBodyPtr bodyPtr)
+{
+    if (isResponseSet())
+    {
+        throw std::runtime_error("ConnectionContext::sendResponse() invoked twice");
+    }
+
+    callResponseHandlers(*responsePtr, *bodyPtr);
+
+    closeIfDraining();
+    ResponseBody::send(m_tcpConnPtr, responsePtr, bodyPtr);
+    m_responseBodyCounters.add(*bodyPtr);
+
+    m_tcpConnPtr.reset();
+    m_responseSet = true;
+}
+
+//--------------------------------------------------------------------------------------------------
+pion::http::response_writer_ptr ConnectionContext::createResponseWriter(pion::http::response_ptr responsePtr)
+{
+    if (isResponseSet())
+    {
+        throw std::runtime_error("ConnectionContext::createResponseWriter() invoked after the response is set");
+    }
+
+    // the body is written by the caller and cannot be shared
+    callUnsharedHandlers();
+
+    closeIfDraining();
+    pion::http::response_writer_ptr writer(pion::http::response_writer::create(
+            m_tcpConnPtr,
+            responsePtr,
+            boost::bind(&pion::tcp::connection::finish, m_tcpConnPtr)));
 
     m_tcpConnPtr.reset();
     m_responseSet = true;
+    return writer;
+}
+
+//--------------------------------------------------------------------------------------------------
+void ConnectionContext::beginResponse(pion::http::response_ptr responsePtr, bool compress)
+{
+    if (isResponseSet())
+    {
+        throw std::runtime_error("ConnectionContext::beginResponse() invoked after the response is set");
+    }
+
+    closeIfDraining();
+    m_chunkedResponsePtr.reset(new ChunkedResponse());
+    m_chunkedResponsePtr->responsePtr = responsePtr;
+    if (!m_responseHandlers.empty())
+    {
+        m_chunkedResponsePtr->sentBodyPtr.reset(new ResponseBody());
+    }
+    if (compress && m_requestPtr->get_header(pion::http::types::HEADER_ACCEPT_ENCODING).find("gzip") != std::string::npos)
+    {
+        responsePtr->add_header(pion::http::types::HEADER_CONTENT_ENCODING, "gzip");
+        m_chunkedResponsePtr->gzipStreamPtr.reset(new boost::iostreams::filtering_ostream());
+        m_chunkedResponsePtr->gzipStreamPtr->push(boost::iostreams::gzip_compressor());
+        m_chunkedResponsePtr->gzipStreamPtr->push(boost::iostreams::back_inserter(m_chunkedResponsePtr->compressed));
+    }
+
+    // the length is unknown, without chunked encoding the body ends when the connection is closed
+    responsePtr->set_do_not_send_content_length();
+    // the connection is finished by onLastChunkWritten
+    m_chunkedResponsePtr->writer = pion::http::response_writer::create(m_tcpConnPtr, responsePtr);
+
+    m_tcpConnPtr.reset();
+    m_responseSet = true;
+}
+
+//--------------------------------------------------------------------------------------------------
+void ConnectionContext::writeChunk(const std::string &data, const WriteHandler &handler)
+{
+    ChunkedResponse &response = getChunkedResponse();
+    if (response.error)
+    {
+        response.writer->get_connection()->get_io_service().post(boost::bind(handler, response.error));
+        return;
+    }
+
+    if (response.gzipStreamPtr)
+    {
+        response.gzipStreamPtr->write(data.data(), static_cast<std::streamsize>(data.size()));
+        response.sending.swap(response.compressed);
+        response.compressed.clear();
+    }
+    else
+    {
+        response.sending = data;
+    }
+
+    keepSentData(response);
+    if (response.sending.empty())
+    {
+        // gzip keeps the data for now, nothing to send
+        response.writer->get_connection()->get_io_service().post(boost::bind(handler, boost::system::error_code()));
+        return;
+    }
+
+    response.writer->clear();
+    response.writer->write_no_copy(response.sending);
+    response.isWriting = true;
+    response.writer->send_chunk(boost::bind(&ConnectionContext::onChunkWritten,
+                                            shared_from_this(),
+                                            handler,
+                                            boost::asio::placeholders::error));
+}
+
+//--------------------------------------------------------------------------------------------------
+void ConnectionContext::finishResponse()
+{
+    ChunkedResponse &response = getChunkedResponse();
+    response.isFinished = true;
+    if (response.error)
+    {
+        return;
+    }
+
+    response.sending.clear();
+    if (response.gzipStreamPtr)
+    {
+        // writes the rest of the compressed data and the gzip trailer
+        response.gzipStreamPtr->reset();
+        response.sending.swap(response.compressed);
+    }
+
+    keepSentData(response);
+    response.writer->clear();
+    if (!response.sending.empty())
+    {
+        response.writer->write_no_copy(response.sending);
+    }
+    response.isWriting = true;
+    response.writer->send_final_chunk(boost::bind(&ConnectionContext::onLastChunkWritten,
+                                                  shared_from_this(),
+                                                  boost::asio::placeholders::error));
+}
+
+//--------------------------------------------------------------------------------------------------
+void ConnectionContext::onChunkWritten(WriteHandler handler, const boost::system::error_code &error)
+{
+    m_chunkedResponsePtr->isWriting = false;
+    if (error)
+    {
+        // the client is gone, the rest of the response is dropped
+        m_chunkedResponsePtr->error = error;
+        pion::tcp::connection_ptr tcpConnPtr = m_chunkedResponsePtr->writer->get_connection();
+        tcpConnPtr->set_lifecycle(pion::tcp::connection::LIFECYCLE_CLOSE);
+        tcpConnPtr->finish();
+    }
+    handler(error);
+}
+
+//--------------------------------------------------------------------------------------------------
+void ConnectionContext::onLastChunkWritten(const boost::system::error_code &error)
+{
+    m_chunkedResponsePtr->isWriting = false;
+
+    pion::tcp::connection_ptr tcpConnPtr = m_chunkedResponsePtr->writer->get_connection();
+    if (error)
+    {
+        tcpConnPtr->set_lifecycle(pion::tcp::connection::LIFECYCLE_CLOSE);
+    }
+    else if (m_chunkedResponsePtr->sentBodyPtr)
+    {
+        // the handlers see the whole body as if it was sent at once
+        pion::http::response &response = *m_chunkedResponsePtr->responsePtr;
+        response.delete_header(pion::http::types::HEADER_TRANSFER_ENCODING);
+        callResponseHandlers(response, *m_chunkedResponsePtr->sentBodyPtr);
+        m_chunkedResponsePtr->sentBodyPtr.reset();
+    }
+    tcpConnPtr->finish();
+}
+
+//--------------------------------------------------------------------------------------------------
+void ConnectionContext::keepSentData(ChunkedResponse &response)
+{
+    if (!response.sentBodyPtr || response.sending.empty())
+    {
+        return;
+    }
+
+    if (response.sentBodyPtr->getSize() + response.sending.size() > MAX_SHARED_CHUNKED_SIZE)
+    {
+        response.sentBodyPtr.reset();
+        callUnsharedHandlers();
+        return;
+    }
+    response.sentBodyPtr->appendCopy(response.sending.data(), response.sending.size());
+}
+
+//--------------------------------------------------------------------------------------------------
+void ConnectionContext::callResponseHandlers(pion::http::response &response, const ResponseBody &body)
+{
+    for (ResponseHandlers::const_iterator i = m_responseHandlers.begin(); i != m_responseHandlers.end(); ++i)
+    {
+        try
+        {
+            (*i)(response, body);
+        }
+        catch (const std::exception &)
+        {
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+void ConnectionContext::callUnsharedHandlers()
+{
+    FinishHandlers handlers(ArenaAllocator<FinishHandler>(*m_arena.arenaPtr));
+    handlers.swap(m_unsharedHandlers);
+    for (FinishHandlers::const_iterator i = handlers.begin(); i != handlers.end(); ++i)
+    {
+        try
+        {
+            (*i)();
+        }
+        catch (const std::exception &)
+        {
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+ConnectionContext::ChunkedResponse &ConnectionContext::getChunkedResponse()
+{
+    if (!m_chunkedResponsePtr)
+    {
+        throw std::runtime_error("ConnectionContext: chunked response is not started");
+    }
+    if (m_chunkedResponsePtr->isFinished)
+    {
+        throw std::runtime_error("ConnectionContext: chunked response is already finished");
+    }
+    if (m_chunkedResponsePtr->isWriting)
+    {
+        throw std::runtime_error("ConnectionContext: previous chunk is not written yet");
+    }
+    return *m_chunkedResponsePtr;
+}
+
+//--------------------------------------------------------------------------------------------------
+void ConnectionContext::closeIfDraining()
+{
+    // keep-alive responses of a draining server would bring the clients back
+    if (m_isDraining.load(boost::memory_order_acquire))
+    {
+        m_tcpConnPtr->set_lifecycle(pion::tcp::connection::LIFECYCLE_CLOSE);
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -75,5 +565,23 @@ bool ConnectionContext::isResponseSet() const
     return m_responseSet;
 }
 
+//--------------------------------------------------------------------------------------------------
+void ConnectionContext::addFinishHandler(const FinishHandler &finishHandler)
+{
+    m_finishHandlers.push_back(finishHandler);
+}
+
+//--------------------------------------------------------------------------------------------------
+void ConnectionContext::addResponseHandler(const ResponseHandler &responseHandler)
+{
+    m_responseHandlers.push_back(responseHandler);
+}
+
+//--------------------------------------------------------------------------------------------------
+void ConnectionContext::addUnsharedHandler(const FinishHandler &unsharedHandler)
+{
+    m_unsharedHandlers.push_back(unsharedHandler);
+}
+
 } /* namespace WebServer */
 } /* namespace Tools */
@@ -0,0 +1,335 @@
+// C++
+#include <map>
+#include <vector>
+
+// BOOST
+#include <boost/bind.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/filesystem/operations.hpp>
+
+// THIS
+#include "Tools/Logger/Logger.h"
+#include "Tools/WebServer/DirectoryWatcher.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <errno.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace Tools
+{
+namespace WebServer
+{
+
+namespace
+{
+
+enum
+{
+    // notifications read at once, the changes are reported as an overflow when they do not fit
+    NOTIFICATION_BUFFER_SIZE = 64 * 1024
+};
+
+}
+
+#ifdef _WIN32
+
+struct DirectoryWatcher::Impl
+{
+    Impl() :
+            directory(INVALID_HANDLE_VALUE),
+            stopEvent(NULL)
+    {
+    }
+
+    ~Impl()
+    {
+        if (directory != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(directory);
+        }
+        if (stopEvent != NULL)
+        {
+            CloseHandle(stopEvent);
+        }
+    }
+
+    HANDLE directory;
+    HANDLE stopEvent;
+};
+
+#elif defined(__linux__)
+
+struct DirectoryWatcher::Impl
+{
+    Impl() :
+            inotifyFd(-1),
+            stopFd(-1)
+    {
+    }
+
+    ~Impl()
+    {
+        if (inotifyFd >= 0)
+        {
+            ::close(inotifyFd);
+        }
+        if (stopFd >= 0)
+        {
+            ::close(stopFd);
+        }
+    }
+
+    // inotify does not watch subdirectories, each one gets its own watch
+    void addWatches(const boost::filesystem::path &directory)
+    {
+        static const boost::uint32_t events = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE
+                | IN_DELETE_SELF | IN_MOVED_FROM | IN_MOVED_TO | IN_MOVE_SELF;
+
+        const int wd = inotify_add_watch(inotifyFd, directory.string().c_str(), events);
+        if (wd < 0)
+        {
+            return;
+        }
+        watches[wd] = directory;
+
+        boost::system::error_code error;
+        for (boost::filesystem::directory_iterator i(directory, error), end; !error && i != end; i.increment(error))
+        {
+            if (boost::filesystem::is_directory(i->status()))
+            {
+                addWatches(i->path());
+            }
+        }
+    }
+
+    int inotifyFd;
+    // written by stop() to wake the watcher thread
+    int stopFd;
+    std::map<int, boost::filesystem::path> watches;
+};
+
+#else
+
+struct DirectoryWatcher::Impl
+{
+};
+
+#endif
+
+//--------------------------------------------------------------------------------------------------
+DirectoryWatcher::DirectoryWatcher(const boost::filesystem::path &directory, const ChangeHandler &changeHandler) :
+        m_directory(directory),
+        m_changeHandler(changeHandler),
+        m_isWatching(false)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+DirectoryWatcher::~DirectoryWatcher()
+{
+    stop();
+}
+
+//--------------------------------------------------------------------------------------------------
+bool DirectoryWatcher::start()
+{
+    if (m_implPtr)
+    {
+        return m_isWatching.load(boost::memory_order_acquire);
+    }
+
+    boost::scoped_ptr<Impl> implPtr(new Impl());
+#ifdef _WIN32
+    implPtr->directory = CreateFileW(m_directory.wstring().c_str(),
+                                     FILE_LIST_DIRECTORY,
+                                     FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                     NULL,
+                                     OPEN_EXISTING,
+                                     FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+                                     NULL);
+    implPtr->stopEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    if (implPtr->directory == INVALID_HANDLE_VALUE || implPtr->stopEvent == NULL)
+    {
+        return false;
+    }
+#elif defined(__linux__)
+    implPtr->inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    implPtr->stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (implPtr->inotifyFd < 0 || implPtr->stopFd < 0)
+    {
+        return false;
+    }
+    implPtr->addWatches(m_directory);
+    if (implPtr->watches.empty())
+    {
+        return false;
+    }
+#else
+    return false;
+#endif
+
+    m_implPtr.swap(implPtr);
+    m_isWatching.store(true, boost::memory_order_release);
+    m_thread = boost::thread(boost::bind(&DirectoryWatcher::run, this));
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+void DirectoryWatcher::stop()
+{
+    if (!m_implPtr)
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    SetEvent(m_implPtr->stopEvent);
+#elif defined(__linux__)
+    const boost::uint64_t value = 1u;
+    if (::write(m_implPtr->stopFd, &value, sizeof(value)) < 0)
+    {
+        // a single write to a new eventfd cannot overflow its counter
+    }
+#endif
+
+    m_thread.join();
+    m_implPtr.reset();
+    m_isWatching.store(false, boost::memory_order_release);
+}
+
+//--------------------------------------------------------------------------------------------------
+bool DirectoryWatcher::isWatching() const
+{
+    return m_isWatching.load(boost::memory_order_acquire);
+}
+
+//--------------------------------------------------------------------------------------------------
+void DirectoryWatcher::run()
+{
+#ifdef _WIN32
+    // FILE_NOTIFY_INFORMATION records are DWORD aligned
+    std::vector<DWORD> buffer(NOTIFICATION_BUFFER_SIZE / sizeof(DWORD));
+    OVERLAPPED overlapped = {};
+    overlapped.hEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    if (overlapped.hEvent == NULL)
+    {
+        m_isWatching.store(false, boost::memory_order_release);
+        return;
+    }
+
+    while (true)
+    {
+        ResetEvent(overlapped.hEvent);
+        if (!ReadDirectoryChangesW(m_implPtr->directory,
+                                   &buffer[0],
+                                   static_cast<DWORD>(buffer.size() * sizeof(DWORD)),
+                                   TRUE,
+                                   FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME
+                                           | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE,
+                                   NULL,
+                                   &overlapped,
+                                   NULL))
+        {
+            Tools::Logger::Logger::getInstance().error() << "Watching " << m_directory.string()
+                    << " failed with error " << GetLastError();
+            break;
+        }
+
+        HANDLE handles[] = { overlapped.hEvent, m_implPtr->stopEvent };
+        DWORD transferred = 0;
+        if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0)
+        {
+            CancelIo(m_implPtr->directory);
+            GetOverlappedResult(m_implPtr->directory, &overlapped, &transferred, TRUE);
+            break;
+        }
+        if (!GetOverlappedResult(m_implPtr->directory, &overlapped, &transferred, FALSE))
+        {
+            Tools::Logger::Logger::getInstance().error() << "Watching " << m_directory.string()
+                    << " failed with error " << GetLastError();
+            break;
+        }
+
+        // no records when the buffer overflowed, the handler is called anyway
+        m_changeHandler();
+    }
+
+    CloseHandle(overlapped.hEvent);
+#elif defined(__linux__)
+    std::vector<boost::uint64_t> buffer(NOTIFICATION_BUFFER_SIZE / sizeof(boost::uint64_t));
+    char *const data = reinterpret_cast<char *>(&buffer[0]);
+
+    pollfd fds[2];
+    fds[0].fd = m_implPtr->inotifyFd;
+    fds[0].events = POLLIN;
+    fds[1].fd = m_implPtr->stopFd;
+    fds[1].events = POLLIN;
+
+    while (true)
+    {
+        fds[0].revents = 0;
+        fds[1].revents = 0;
+        if (::poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            Tools::Logger::Logger::getInstance().error() << "Watching " << m_directory.string()
+                    << " failed with error " << errno;
+            break;
+        }
+        if (fds[1].revents != 0)
+        {
+            break;
+        }
+
+        bool changed = false;
+        ssize_t length = 0;
+        while ((length = ::read(m_implPtr->inotifyFd, data, buffer.size() * sizeof(boost::uint64_t))) > 0)
+        {
+            for (ssize_t offset = 0; offset < length; )
+            {
+                const inotify_event &event = *reinterpret_cast<const inotify_event *>(data + offset);
+                offset += sizeof(inotify_event) + event.len;
+
+                if ((event.mask & IN_IGNORED) != 0u)
+                {
+                    m_implPtr->watches.erase(event.wd);
+                    continue;
+                }
+                if ((event.mask & IN_ISDIR) != 0u && (event.mask & (IN_CREATE | IN_MOVED_TO)) != 0u && event.len != 0u)
+                {
+                    std::map<int, boost::filesystem::path>::const_iterator i = m_implPtr->watches.find(event.wd);
+                    if (i != m_implPtr->watches.end())
+                    {
+                        m_implPtr->addWatches(i->second / event.name);
+                    }
+                }
+                changed = true;
+            }
+        }
+
+        if (changed)
+        {
+            m_changeHandler();
+        }
+        if (m_implPtr->watches.empty())
+        {
+            // the directory itself is gone
+            break;
+        }
+    }
+#endif
+
+    m_isWatching.store(false, boost::memory_order_release);
+}
+
+} /* namespace WebServer */
+} /* namespace Tools */
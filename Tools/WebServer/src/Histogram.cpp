@@ -0,0 +1,126 @@
+// BOOST
+#include <boost/assert.hpp>
+#include <boost/lexical_cast.hpp>
+
+// THIS
+#include "Tools/WebServer/Histogram.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+//--------------------------------------------------------------------------------------------------
+Histogram::Histogram()
+{
+    for (std::size_t i = 0u; i < BUCKETS; ++i)
+    {
+        m_counts[i] = 0u;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+boost::uint64_t Histogram::getBucketCount(std::size_t bucket) const
+{
+    BOOST_ASSERT(bucket < BUCKETS);
+    return m_counts[bucket].load(boost::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------------------------
+void Histogram::add(const Histogram &histogram)
+{
+    for (std::size_t i = 0u; i < BUCKETS; ++i)
+    {
+        m_counts[i].store(m_counts[i].load(boost::memory_order_relaxed) + histogram.getBucketCount(i),
+                          boost::memory_order_relaxed);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+std::size_t Histogram::getBucket(boost::uint64_t value)
+{
+    return StatHistogram::getBucket(value, SUB_BUCKET_BITS);
+}
+
+//--------------------------------------------------------------------------------------------------
+boost::uint64_t Histogram::getBucketValue(std::size_t bucket)
+{
+    return StatHistogram::getBucketValue(bucket, SUB_BUCKET_BITS);
+}
+
+//--------------------------------------------------------------------------------------------------
+HistogramSnapshot::HistogramSnapshot() :
+        m_counts(Histogram::BUCKETS, 0u),
+        m_count(0u)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+void HistogramSnapshot::add(const Histogram &histogram)
+{
+    for (std::size_t i = 0u; i < Histogram::BUCKETS; ++i)
+    {
+        const boost::uint64_t count = histogram.getBucketCount(i);
+        m_counts[i] += count;
+        m_count += count;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+void HistogramSnapshot::clear()
+{
+    m_counts.assign(Histogram::BUCKETS, 0u);
+    m_count = 0u;
+}
+
+//--------------------------------------------------------------------------------------------------
+boost::uint64_t HistogramSnapshot::getCount() const
+{
+    return m_count;
+}
+
+//--------------------------------------------------------------------------------------------------
+boost::uint64_t HistogramSnapshot::getPercentile(double percentile) const
+{
+    if (m_count == 0u)
+    {
+        return 0u;
+    }
+
+    boost::uint64_t rank = static_cast<boost::uint64_t>(percentile / 100.0 * static_cast<double>(m_count) + 0.5);
+    if (rank == 0u)
+    {
+        rank = 1u;
+    }
+
+    boost::uint64_t seen = 0u;
+    for (std::size_t i = 0u; i < Histogram::BUCKETS; ++i)
+    {
+        seen += m_counts[i];
+        if (seen >= rank)
+        {
+            return Histogram::getBucketValue(i);
+        }
+    }
+    return Histogram::getBucketValue(Histogram::BUCKETS - 1u);
+}
+
+//--------------------------------------------------------------------------------------------------
+void HistogramSnapshot::getStatistics(const std::string &prefix,
+                                      const std::string &suffix,
+                                      IStat::Parameters &parameters) const
+{
+    parameters.push_back(IStat::Parameter(prefix + "_count",
+                                          boost::lexical_cast<std::string>(getCount())));
+    parameters.push_back(IStat::Parameter(prefix + "_p50" + suffix,
+                                          boost::lexical_cast<std::string>(getPercentile(50.0))));
+    parameters.push_back(IStat::Parameter(prefix + "_p90" + suffix,
+                                          boost::lexical_cast<std::string>(getPercentile(90.0))));
+    parameters.push_back(IStat::Parameter(prefix + "_p99" + suffix,
+                                          boost::lexical_cast<std::string>(getPercentile(99.0))));
+    parameters.push_back(IStat::Parameter(prefix + "_p999" + suffix,
+                                          boost::lexical_cast<std::string>(getPercentile(99.9))));
+}
+
+} /* namespace WebServer */
+} /* namespace Tools */
@@ -0,0 +1,213 @@
+// BOOST
+#include <boost/assert.hpp>
+#include <boost/lexical_cast.hpp>
+
+// THIS
+#include "Tools/WebServer/LaneQueue.h"
+#include "Tools/WebServer/StatHistogram.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+// handlers taken from a lane per refill in LP_WEIGHTED mode
+static const unsigned laneWeights[EL_COUNT] = { 8u, 4u, 1u };
+
+//--------------------------------------------------------------------------------------------------
+const char *getLaneName(ExecutionLane lane)
+{
+    switch (lane)
+    {
+    case EL_INTERACTIVE:
+        return "interactive";
+    case EL_NORMAL:
+        return "normal";
+    case EL_BULK:
+        return "bulk";
+    default:
+        break;
+    }
+    return "unknown";
+}
+
+//--------------------------------------------------------------------------------------------------
+LaneStatistics::LaneStatistics()
+{
+    for (int i = 0; i < EL_COUNT; ++i)
+    {
+        m_depth[i] = 0u;
+        m_dispatched[i] = 0u;
+        m_totalWait[i] = 0u;
+        m_maxWait[i] = 0u;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+void LaneStatistics::onPush(ExecutionLane lane)
+{
+    m_depth[lane].fetch_add(1u, boost::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------------------------
+void LaneStatistics::onPop(ExecutionLane lane, boost::uint64_t waitMicroseconds)
+{
+    m_depth[lane].fetch_sub(1u, boost::memory_order_relaxed);
+    m_dispatched[lane].fetch_add(1u, boost::memory_order_relaxed);
+    m_totalWait[lane].fetch_add(waitMicroseconds, boost::memory_order_relaxed);
+
+    boost::uint64_t maxWait = m_maxWait[lane].load(boost::memory_order_relaxed);
+    while (waitMicroseconds > maxWait
+            && !m_maxWait[lane].compare_exchange_weak(maxWait, waitMicroseconds, boost::memory_order_relaxed))
+    {
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+void LaneStatistics::onClear(ExecutionLane lane, std::size_t count)
+{
+    m_depth[lane].fetch_sub(count, boost::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------------------------
+void LaneStatistics::getStatistics(IStat::Parameters &parameters) const
+{
+    for (int i = 0; i < EL_COUNT; ++i)
+    {
+        const std::string prefix = std::string("lane_") + getLaneName(static_cast<ExecutionLane>(i));
+        const boost::uint64_t dispatched = m_dispatched[i].load(boost::memory_order_relaxed);
+
+        parameters.push_back(IStat::Parameter(prefix + "_depth",
+                boost::lexical_cast<std::string>(m_depth[i].load(boost::memory_order_relaxed))));
+        parameters.push_back(IStat::Parameter(prefix + "_dispatched",
+                boost::lexical_cast<std::string>(dispatched)));
+#ifdef TOOLS_WEBSERVER_HANDLER_TIMINGS
+        const boost::uint64_t totalWait = m_totalWait[i].load(boost::memory_order_relaxed);
+        parameters.push_back(IStat::Parameter(prefix + "_wait_avg_us",
+                boost::lexical_cast<std::string>(dispatched != 0u ? totalWait / dispatched : 0u)));
+        parameters.push_back(IStat::Parameter(prefix + "_wait_max_us",
+                boost::lexical_cast<std::string>(m_maxWait[i].load(boost::memory_order_relaxed))));
+#endif
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+LaneQueue::LaneQueue(LanePolicy policy, LaneStatistics &statistics) :
+        m_policy(policy),
+        m_statistics(statistics)
+{
+    for (int i = 0; i < EL_COUNT; ++i)
+    {
+        m_credits[i] = laneWeights[i];
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+void LaneQueue::push(const SchedulerHandler &handler, ExecutionLane lane)
+{
+    BOOST_ASSERT(lane >= 0 && lane < EL_COUNT);
+
+    Item item;
+    item.handler = handler;
+#ifdef TOOLS_WEBSERVER_HANDLER_TIMINGS
+    item.enqueueTime = getTimestampNs();
+#endif
+
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_items[lane].push_back(item);
+    m_statistics.onPush(lane);
+}
+
+//--------------------------------------------------------------------------------------------------
+bool LaneQueue::pop(SchedulerHandler &handler)
+{
+    boost::uint64_t waitNs = 0u;
+    return pop(handler, waitNs);
+}
+
+//--------------------------------------------------------------------------------------------------
+bool LaneQueue::pop(SchedulerHandler &handler, boost::uint64_t &waitNs)
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    return popLocked(handler, waitNs);
+}
+
+//--------------------------------------------------------------------------------------------------
+bool LaneQueue::tryPop(SchedulerHandler &handler)
+{
+    boost::uint64_t waitNs = 0u;
+    boost::unique_lock<boost::mutex> lock(m_mutex, boost::try_to_lock);
+    return lock.owns_lock() && popLocked(handler, waitNs);
+}
+
+//--------------------------------------------------------------------------------------------------
+void LaneQueue::clear()
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    for (int i = 0; i < EL_COUNT; ++i)
+    {
+        m_statistics.onClear(static_cast<ExecutionLane>(i), m_items[i].size());
+        m_items[i].clear();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+bool LaneQueue::popLocked(SchedulerHandler &handler, boost::uint64_t &waitNs)
+{
+    const int lane = selectLane();
+    if (lane < 0)
+    {
+        return false;
+    }
+
+    Item &item = m_items[lane].front();
+    handler.swap(item.handler);
+#ifdef TOOLS_WEBSERVER_HANDLER_TIMINGS
+    const boost::uint64_t now = getTimestampNs();
+    waitNs = now > item.enqueueTime ? now - item.enqueueTime : 0u;
+#else
+    waitNs = 0u;
+#endif
+    m_items[lane].pop_front();
+
+    m_statistics.onPop(static_cast<ExecutionLane>(lane), waitNs / 1000u);
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+int LaneQueue::selectLane()
+{
+    if (m_policy == LP_STRICT)
+    {
+        for (int i = 0; i < EL_COUNT; ++i)
+        {
+            if (!m_items[i].empty())
+            {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    // weighted round: every non-empty lane spends its credits, refill when all are spent
+    for (int attempt = 0; attempt < 2; ++attempt)
+    {
+        for (int i = 0; i < EL_COUNT; ++i)
+        {
+            if (!m_items[i].empty() && m_credits[i] > 0u)
+            {
+                --m_credits[i];
+                return i;
+            }
+        }
+
+        for (int i = 0; i < EL_COUNT; ++i)
+        {
+            m_credits[i] = laneWeights[i];
+        }
+    }
+    return -1;
+}
+
+} /* namespace WebServer */
+} /* namespace Tools */
@@ -1,7 +1,17 @@
+// C++
+#include <vector>
+
+// BOOST
+#include <boost/assert.hpp>
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/locks.hpp>
+
 // PION
 #include <pion/http/request_reader.hpp>
 #include <pion/logger.hpp>
 
+#include "Tools/WebServer/Errors.h"
 #include "Tools/WebServer/PionWebServerCore.h"
 
 namespace Tools
@@ -15,16 +25,31 @@ namespace Detail
 PionWebServerCore::PionWebServerCore(pion::scheduler &scheduler,
                                      const boost::asio::ip::tcp::endpoint &endpoint,
                                      std::size_t timeout,
-                                     std::size_t connectionLimit):
+                                     std::size_t connectionLimit,
+                                     std::size_t idleTimeout):
         pion::http::plugin_server(scheduler, endpoint),
         m_timeout(timeout),
-        m_connectionLimit(connectionLimit)
+        m_connectionLimit(connectionLimit),
+        m_idleTimeout(idleTimeout),
+        m_isAccepting(false),
+        m_isDraining(false),
+        m_evicted(0u),
+        m_refused(0u)
 {
 #ifdef DEBUG
     PION_LOG_SETLEVEL_DEBUG(get_logger());
 #endif
 }
 
+namespace
+{
+
+#ifdef SO_REUSEPORT
+typedef boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT> ReusePort;
+#endif
+
+}
+
 //--------------------------------------------------------------------------------------------------
 PionWebServerCore::~PionWebServerCore()
 {
@@ -33,7 +58,13 @@ PionWebServerCore::~PionWebServerCore()
 //--------------------------------------------------------------------------------------------------
 std::size_t PionWebServerCore::getConnectionLimit() const
 {
-    return m_connectionLimit;
+    return m_connectionLimit.load(boost::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------------------------
+void PionWebServerCore::setConnectionLimit(std::size_t connectionLimit)
+{
+    m_connectionLimit.store(connectionLimit, boost::memory_order_relaxed);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -42,32 +73,303 @@ std::size_t PionWebServerCore::getTimeout() const
     return m_timeout;
 }
 
+//--------------------------------------------------------------------------------------------------
+std::size_t PionWebServerCore::getIdleTimeout() const
+{
+    return m_idleTimeout;
+}
+
+//--------------------------------------------------------------------------------------------------
+void PionWebServerCore::startAcceptors(const std::vector<boost::asio::io_service *> &ioServices)
+{
+#ifdef SO_REUSEPORT
+    BOOST_ASSERT(m_acceptors.empty());
+
+    for (std::vector<boost::asio::io_service *>::const_iterator i = ioServices.begin(); i != ioServices.end(); ++i)
+    {
+        AcceptorPtr acceptorPtr(new Acceptor(**i));
+        acceptorPtr->acceptor.open(get_endpoint().protocol());
+        acceptorPtr->acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
+        acceptorPtr->acceptor.set_option(ReusePort(true));
+        acceptorPtr->acceptor.bind(get_endpoint());
+        acceptorPtr->acceptor.listen();
+        m_acceptors.push_back(acceptorPtr);
+    }
+
+    before_starting();
+    m_isAccepting = true;
+    for (std::vector<AcceptorPtr>::iterator i = m_acceptors.begin(); i != m_acceptors.end(); ++i)
+    {
+        accept(*i);
+    }
+#else
+    throw WebServerError("Several acceptors need SO_REUSEPORT which is not supported on this platform");
+#endif
+}
+
+//--------------------------------------------------------------------------------------------------
+void PionWebServerCore::stopAcceptors()
+{
+    if (!m_isAccepting.exchange(false))
+    {
+        return;
+    }
+    for (std::vector<AcceptorPtr>::iterator i = m_acceptors.begin(); i != m_acceptors.end(); ++i)
+    {
+        boost::system::error_code ec;
+        (*i)->acceptor.close(ec);
+    }
+
+    boost::unique_lock<boost::mutex> lock(m_connectionsMutex);
+    for (std::set<pion::tcp::connection_ptr>::iterator i = m_connections.begin(); i != m_connections.end(); ++i)
+    {
+        (*i)->close();
+    }
+    while (!m_connections.empty())
+    {
+        m_noConnections.wait(lock);
+    }
+    lock.unlock();
+
+    after_stopping();
+}
+
+//--------------------------------------------------------------------------------------------------
+void PionWebServerCore::beginDrain()
+{
+    if (m_isDraining.exchange(true))
+    {
+        return;
+    }
+
+    // the pion acceptor can't be closed alone, handle_connection() refuses its connections
+    for (std::vector<AcceptorPtr>::iterator i = m_acceptors.begin(); i != m_acceptors.end(); ++i)
+    {
+        boost::system::error_code ec;
+        (*i)->acceptor.close(ec);
+    }
+
+    std::vector<pion::tcp::connection_ptr> idle;
+    {
+        boost::lock_guard<boost::mutex> lock(m_idleMutex);
+        for (IdleConnections::iterator i = m_idleConnections.begin(); i != m_idleConnections.end(); ++i)
+        {
+            pion::tcp::connection_ptr connectionPtr = i->connection.lock();
+            if (connectionPtr)
+            {
+                m_closingConnections.insert(i->key);
+                idle.push_back(connectionPtr);
+            }
+        }
+        m_idleConnections.clear();
+        m_idleIndex.clear();
+    }
+
+    for (std::vector<pion::tcp::connection_ptr>::iterator i = idle.begin(); i != idle.end(); ++i)
+    {
+        (*i)->set_lifecycle(pion::tcp::connection::LIFECYCLE_CLOSE);
+        (*i)->close();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+void PionWebServerCore::getStatistics(IStat::Parameters &parameters) const
+{
+    std::size_t idle = 0u;
+    {
+        boost::lock_guard<boost::mutex> lock(m_idleMutex);
+        idle = m_idleIndex.size();
+    }
+
+    parameters.push_back(IStat::Parameter("open", boost::lexical_cast<std::string>(getConnections())));
+    parameters.push_back(IStat::Parameter("idle", boost::lexical_cast<std::string>(idle)));
+    parameters.push_back(IStat::Parameter("limit", boost::lexical_cast<std::string>(getConnectionLimit())));
+    parameters.push_back(IStat::Parameter("evicted",
+            boost::lexical_cast<std::string>(m_evicted.load(boost::memory_order_relaxed))));
+    parameters.push_back(IStat::Parameter("refused",
+            boost::lexical_cast<std::string>(m_refused.load(boost::memory_order_relaxed))));
+}
+
 //--------------------------------------------------------------------------------------------------
 void PionWebServerCore::handle_connection(pion::tcp::connection_ptr &tcpConnPtr)
 {
-//TODO: avoid deadlock with keep-alive connections
-//    // Если лимит подключений достигнут, то текущее подключение разрывается
-//    if (getConnections() > getConnectionLimit())
-//    {
-//        tcpConn->setLifecycle(pion::net::TCPConnection::LIFECYCLE_CLOSE);
-//        tcpConn->close();
-//        return;
-//    }
+    // Kept alive connections come back here from finish_connection() under the lock
+    // of the pion server, so get_connections() may be called for new connections only
+    const bool isKeptAlive = tcpConnPtr->get_keep_alive();
+    if (m_isDraining.load(boost::memory_order_acquire))
+    {
+        tcpConnPtr->set_lifecycle(pion::tcp::connection::LIFECYCLE_CLOSE);
+        tcpConnPtr->close();
+        if (!isKeptAlive)
+        {
+            m_refused.fetch_add(1u, boost::memory_order_relaxed);
+            tcpConnPtr->finish();
+            return;
+        }
+        // finishing here would reenter the pion server lock, the reader fails and finishes it
+    }
+    else if (isKeptAlive)
+    {
+        IdleConnection idleConnection = { tcpConnPtr.get(), tcpConnPtr };
+
+        boost::lock_guard<boost::mutex> lock(m_idleMutex);
+        m_idleIndex[idleConnection.key] = m_idleConnections.insert(m_idleConnections.end(), idleConnection);
+    }
+    else if (!acceptConnection())
+    {
+        m_refused.fetch_add(1u, boost::memory_order_relaxed);
+        tcpConnPtr->set_lifecycle(pion::tcp::connection::LIFECYCLE_CLOSE);
+        tcpConnPtr->close();
+        tcpConnPtr->finish();
+        return;
+    }
 
     pion::http::request_reader::finished_handler_t handler(boost::bind(&PionWebServerCore::handle_request, this, _1, _2, _3));
     pion::http::request_reader_ptr readerPtr = pion::http::request_reader::create(tcpConnPtr, handler);
 
-    readerPtr->set_timeout(getTimeout());
+    // the timeout of a kept alive connection includes the wait for the next request
+    readerPtr->set_timeout(isKeptAlive ? getIdleTimeout() : getTimeout());
     readerPtr->receive();
 }
 
+//--------------------------------------------------------------------------------------------------
 void PionWebServerCore::handle_request(pion::http::request_ptr http_request_ptr,
                                        pion::tcp::connection_ptr tcp_conn,
                                        const boost::system::error_code& ec)
 {
+    {
+        boost::lock_guard<boost::mutex> lock(m_idleMutex);
+        IdleIndex::iterator i = m_idleIndex.find(tcp_conn.get());
+        if (i != m_idleIndex.end())
+        {
+            m_idleConnections.erase(i->second);
+            m_idleIndex.erase(i);
+        }
+        else
+        {
+            m_closingConnections.erase(tcp_conn.get());
+        }
+    }
+
+    if (m_isDraining.load(boost::memory_order_acquire))
+    {
+        // the response tells the client to reconnect
+        tcp_conn->set_lifecycle(pion::tcp::connection::LIFECYCLE_CLOSE);
+    }
+
     pion::http::server::handle_request(http_request_ptr, tcp_conn, ec);
 }
 
+//--------------------------------------------------------------------------------------------------
+void PionWebServerCore::accept(AcceptorPtr acceptorPtr)
+{
+    pion::tcp::connection_ptr tcpConnPtr(pion::tcp::connection::create(acceptorPtr->ioService,
+            get_ssl_context_type(),
+            false,
+            boost::bind(&PionWebServerCore::finishConnection, this, _1)));
+    acceptorPtr->acceptor.async_accept(tcpConnPtr->get_socket(),
+                                       boost::bind(&PionWebServerCore::onAccepted, this, acceptorPtr, tcpConnPtr,
+                                                   boost::asio::placeholders::error));
+}
+
+//--------------------------------------------------------------------------------------------------
+void PionWebServerCore::onAccepted(AcceptorPtr acceptorPtr,
+                                   pion::tcp::connection_ptr tcpConnPtr,
+                                   const boost::system::error_code &ec)
+{
+    if (!m_isAccepting || m_isDraining)
+    {
+        return;
+    }
+
+    accept(acceptorPtr);
+    if (ec)
+    {
+        return;
+    }
+
+    {
+        boost::lock_guard<boost::mutex> lock(m_connectionsMutex);
+        m_connections.insert(tcpConnPtr);
+    }
+    handle_connection(tcpConnPtr);
+}
+
+//--------------------------------------------------------------------------------------------------
+void PionWebServerCore::finishConnection(pion::tcp::connection_ptr tcpConnPtr)
+{
+    if (m_isAccepting && tcpConnPtr->get_keep_alive())
+    {
+        handle_connection(tcpConnPtr);
+        return;
+    }
+
+    tcpConnPtr->close();
+
+    boost::lock_guard<boost::mutex> lock(m_connectionsMutex);
+    m_connections.erase(tcpConnPtr);
+    if (m_connections.empty())
+    {
+        m_noConnections.notify_all();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+std::size_t PionWebServerCore::getConnections() const
+{
+    if (!m_acceptors.empty())
+    {
+        boost::lock_guard<boost::mutex> lock(m_connectionsMutex);
+        return m_connections.size();
+    }
+
+    // the pion server does not count the connection waiting for the next accept
+    return get_connections();
+}
+
+//--------------------------------------------------------------------------------------------------
+bool PionWebServerCore::acceptConnection()
+{
+    // the new connection is already counted
+    const std::size_t connections = getConnections();
+    const std::size_t connectionLimit = getConnectionLimit();
+    if (connections <= connectionLimit)
+    {
+        return true;
+    }
+
+    std::size_t excess = connections - connectionLimit;
+    std::vector<pion::tcp::connection_ptr> evicted;
+    {
+        boost::lock_guard<boost::mutex> lock(m_idleMutex);
+        // evicted connections stay in the pool until their readers are cancelled
+        const std::size_t closing = m_closingConnections.size();
+        excess = excess > closing ? excess - closing : 0u;
+
+        while (evicted.size() < excess && !m_idleConnections.empty())
+        {
+            const IdleConnection &idleConnection = m_idleConnections.front();
+            pion::tcp::connection_ptr connectionPtr = idleConnection.connection.lock();
+            if (connectionPtr)
+            {
+                m_closingConnections.insert(idleConnection.key);
+                evicted.push_back(connectionPtr);
+            }
+            m_idleIndex.erase(idleConnection.key);
+            m_idleConnections.pop_front();
+        }
+    }
+
+    for (std::vector<pion::tcp::connection_ptr>::iterator i = evicted.begin(); i != evicted.end(); ++i)
+    {
+        (*i)->set_lifecycle(pion::tcp::connection::LIFECYCLE_CLOSE);
+        (*i)->close();
+    }
+    m_evicted.fetch_add(evicted.size(), boost::memory_order_relaxed);
+
+    return evicted.size() == excess;
+}
+
 } /* namespace Detail */
 } /* namespace WebServer */
 } /* namespace Tools */
@@ -0,0 +1,90 @@
+// BOOST
+#include <boost/lexical_cast.hpp>
+
+// THIS
+#include "Tools/WebServer/Histogram.h"
+#include "Tools/WebServer/QueueDelayShedder.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+//--------------------------------------------------------------------------------------------------
+QueueDelayShedder::Settings::Settings() :
+        target(boost::posix_time::milliseconds(50)),
+        interval(boost::posix_time::milliseconds(500))
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+QueueDelayShedder::QueueDelayShedder(const Settings &settings) :
+        m_targetNs(static_cast<boost::uint64_t>(settings.target.total_microseconds()) * 1000u),
+        m_intervalNs(static_cast<boost::uint64_t>(settings.interval.total_microseconds()) * 1000u),
+        m_intervalStart(getTimestampNs()),
+        m_minDelay(0u),
+        m_lastMinDelay(0u),
+        m_isOverloaded(false),
+        m_dropped(0u)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+bool QueueDelayShedder::shouldDrop(boost::uint64_t sojournNs)
+{
+    const boost::uint64_t now = getTimestampNs();
+
+    boost::uint64_t intervalStart = m_intervalStart.load(boost::memory_order_relaxed);
+    if (now - intervalStart >= m_intervalNs)
+    {
+        // the thread that closes the interval evaluates it and seeds the next one
+        if (m_intervalStart.compare_exchange_strong(intervalStart, now, boost::memory_order_relaxed))
+        {
+            const boost::uint64_t minDelay = m_minDelay.exchange(sojournNs, boost::memory_order_relaxed);
+            m_lastMinDelay.store(minDelay, boost::memory_order_relaxed);
+            m_isOverloaded.store(minDelay > m_targetNs, boost::memory_order_relaxed);
+        }
+    }
+    else
+    {
+        boost::uint64_t minDelay = m_minDelay.load(boost::memory_order_relaxed);
+        while (sojournNs < minDelay
+                && !m_minDelay.compare_exchange_weak(minDelay, sojournNs, boost::memory_order_relaxed))
+        {
+        }
+    }
+
+    const boost::uint64_t threshold = isOverloaded() ? m_targetNs : m_intervalNs;
+    if (sojournNs > threshold)
+    {
+        m_dropped.fetch_add(1u, boost::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+//--------------------------------------------------------------------------------------------------
+bool QueueDelayShedder::isOverloaded() const
+{
+    return m_isOverloaded.load(boost::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------------------------
+boost::uint64_t QueueDelayShedder::getDropped() const
+{
+    return m_dropped.load(boost::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------------------------
+void QueueDelayShedder::getStatistics(IStat::Parameters &parameters) const
+{
+    parameters.push_back(IStat::Parameter("overloaded",
+                                          isOverloaded() ? "1" : "0"));
+    parameters.push_back(IStat::Parameter("min_delay_us",
+            boost::lexical_cast<std::string>(m_lastMinDelay.load(boost::memory_order_relaxed) / 1000u)));
+    parameters.push_back(IStat::Parameter("dropped",
+                                          boost::lexical_cast<std::string>(getDropped())));
+}
+
+} /* namespace WebServer */
+} /* namespace Tools */
@@ -0,0 +1,199 @@
+// C++
+#include <cstdlib>
+
+// BOOST
+#include <boost/atomic.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/lockfree/stack.hpp>
+
+#include "Tools/WebServer/RequestArena.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+namespace
+{
+
+boost::atomic<boost::uint64_t> arenasAcquired(0u);
+boost::atomic<boost::uint64_t> arenasCreated(0u);
+boost::atomic<boost::uint64_t> arenasDeleted(0u);
+boost::atomic<boost::uint64_t> blocksAllocated(0u);
+
+std::size_t alignSize(std::size_t size)
+{
+    return (size + RequestArena::ALIGNMENT - 1u) & ~static_cast<std::size_t>(RequestArena::ALIGNMENT - 1u);
+}
+
+}
+
+struct RequestArena::Pool
+{
+    ~Pool()
+    {
+        RequestArena *arenaPtr = NULL;
+        while (arenas.pop(arenaPtr))
+        {
+            delete arenaPtr;
+        }
+    }
+
+    // the nodes are preallocated, tagged indices keep pop() safe from ABA
+    boost::lockfree::stack<RequestArena *, boost::lockfree::capacity<MAX_POOLED> > arenas;
+};
+
+RequestArena::Pool RequestArena::s_pool;
+
+//--------------------------------------------------------------------------------------------------
+RequestArena::RequestArena() :
+        m_blocks(NULL),
+        m_current(NULL),
+        m_end(NULL),
+        m_allocated(0u)
+{
+    arenasCreated.fetch_add(1u, boost::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------------------------
+RequestArena::~RequestArena()
+{
+    while (m_blocks != NULL)
+    {
+        Block *block = m_blocks;
+        m_blocks = block->next;
+        std::free(block);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+RequestArena *RequestArena::acquire()
+{
+    arenasAcquired.fetch_add(1u, boost::memory_order_relaxed);
+
+    RequestArena *arenaPtr = NULL;
+    if (!s_pool.arenas.pop(arenaPtr))
+    {
+        arenaPtr = new RequestArena();
+    }
+    return arenaPtr;
+}
+
+//--------------------------------------------------------------------------------------------------
+void RequestArena::release(RequestArena *arenaPtr)
+{
+    if (arenaPtr == NULL)
+    {
+        return;
+    }
+
+    arenaPtr->reset();
+    if (!s_pool.arenas.bounded_push(arenaPtr))
+    {
+        arenasDeleted.fetch_add(1u, boost::memory_order_relaxed);
+        delete arenaPtr;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+void RequestArena::getStatistics(IStat::Parameters &parameters)
+{
+    parameters.push_back(IStat::Parameter("acquired",
+            boost::lexical_cast<std::string>(arenasAcquired.load(boost::memory_order_relaxed))));
+    parameters.push_back(IStat::Parameter("created",
+            boost::lexical_cast<std::string>(arenasCreated.load(boost::memory_order_relaxed))));
+    parameters.push_back(IStat::Parameter("deleted",
+            boost::lexical_cast<std::string>(arenasDeleted.load(boost::memory_order_relaxed))));
+    parameters.push_back(IStat::Parameter("blocks_allocated",
+            boost::lexical_cast<std::string>(blocksAllocated.load(boost::memory_order_relaxed))));
+}
+
+//--------------------------------------------------------------------------------------------------
+void *RequestArena::allocate(std::size_t size)
+{
+    size = alignSize(size == 0u ? 1u : size);
+    m_allocated += size;
+    if (static_cast<std::size_t>(m_end - m_current) < size)
+    {
+        return allocateBlock(size);
+    }
+
+    void *p = m_current;
+    m_current += size;
+    return p;
+}
+
+//--------------------------------------------------------------------------------------------------
+std::size_t RequestArena::getAllocated() const
+{
+    return m_allocated;
+}
+
+//--------------------------------------------------------------------------------------------------
+void *RequestArena::allocateBlock(std::size_t size)
+{
+    const std::size_t headerSize = alignSize(sizeof(Block));
+    const bool isLarge = size > BLOCK_SIZE / 2u;
+    const std::size_t blockSize = headerSize + (isLarge ? size : static_cast<std::size_t>(BLOCK_SIZE));
+
+    Block *block = static_cast<Block *>(std::malloc(blockSize));
+    if (block == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    blocksAllocated.fetch_add(1u, boost::memory_order_relaxed);
+
+    char *data = reinterpret_cast<char *>(block) + headerSize;
+    block->size = blockSize;
+    if (isLarge && m_blocks != NULL)
+    {
+        // the current block keeps serving small allocations
+        block->next = m_blocks->next;
+        m_blocks->next = block;
+        return data;
+    }
+
+    block->next = m_blocks;
+    m_blocks = block;
+    m_current = data + size;
+    m_end = reinterpret_cast<char *>(block) + blockSize;
+    return data;
+}
+
+//--------------------------------------------------------------------------------------------------
+void RequestArena::reset()
+{
+    // one block of the regular size is kept for the next request
+    const std::size_t headerSize = alignSize(sizeof(Block));
+    Block *kept = NULL;
+    while (m_blocks != NULL)
+    {
+        Block *block = m_blocks;
+        m_blocks = block->next;
+        if (kept == NULL && block->size == headerSize + BLOCK_SIZE)
+        {
+            kept = block;
+        }
+        else
+        {
+            std::free(block);
+        }
+    }
+
+    m_allocated = 0u;
+    m_blocks = kept;
+    if (kept == NULL)
+    {
+        m_current = NULL;
+        m_end = NULL;
+        return;
+    }
+
+    kept->next = NULL;
+    m_current = reinterpret_cast<char *>(kept) + headerSize;
+    m_end = reinterpret_cast<char *>(kept) + kept->size;
+}
+
+} /* namespace WebServer */
+} /* namespace Tools */
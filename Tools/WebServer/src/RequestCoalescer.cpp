@@ -0,0 +1,206 @@
+// C++
+#include <algorithm>
+
+// BOOST
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/locks.hpp>
+
+// PION
+#include <pion/http/types.hpp>
+
+// THIS
+#include "Tools/WebServer/Histogram.h"
+#include "Tools/WebServer/RequestCoalescer.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+//--------------------------------------------------------------------------------------------------
+RequestCoalescer::RequestCoalescer(const boost::posix_time::time_duration &window, const Sender &sender) :
+        m_window(static_cast<boost::uint64_t>(std::max<boost::int64_t>(window.total_microseconds(), 0)) * 1000u),
+        m_sender(sender),
+        m_flightCount(0u),
+        m_coalesced(0u),
+        m_shared(0u),
+        m_fallbacks(0u)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+RequestCoalescer::FlightPtr RequestCoalescer::join(const std::string &key,
+                                                   boost::uint64_t version,
+                                                   pion::http::request_ptr &requestPtr,
+                                                   pion::tcp::connection_ptr &tcpConnPtr)
+{
+    FlightPtr completedPtr;
+    {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        eraseExpired(getTimestampNs());
+
+        // the response of a flight under an older version may be stale, it is not shared
+        // with the requests after the change; its own waiters still get it
+        Flights::iterator i = m_flights.find(key);
+        if (i == m_flights.end() || i->second->version != version)
+        {
+            FlightPtr flightPtr(new Flight());
+            flightPtr->key = key;
+            flightPtr->version = version;
+            m_flights[key] = flightPtr;
+            m_flightCount.fetch_add(1u, boost::memory_order_relaxed);
+            return flightPtr;
+        }
+
+        m_coalesced.fetch_add(1u, boost::memory_order_relaxed);
+        if (!i->second->isCompleted)
+        {
+            i->second->waiters.push_back(Waiter(requestPtr, tcpConnPtr));
+            return FlightPtr();
+        }
+        completedPtr = i->second;
+    }
+
+    // the response of a completed flight does not change any more
+    send(*completedPtr, Waiter(requestPtr, tcpConnPtr));
+    return FlightPtr();
+}
+
+//--------------------------------------------------------------------------------------------------
+void RequestCoalescer::complete(FlightPtr flightPtr, pion::http::response &response, const ResponseBody &body)
+{
+    if (response.get_status_code() != pion::http::types::RESPONSE_CODE_OK
+            || response.has_header(pion::http::types::HEADER_SET_COOKIE))
+    {
+        return;
+    }
+
+    Headers headers;
+    const pion::ihash_multimap &responseHeaders = response.get_headers();
+    for (pion::ihash_multimap::const_iterator i = responseHeaders.begin(); i != responseHeaders.end(); ++i)
+    {
+        // connection specific, set again when the response is sent
+        if (boost::algorithm::iequals(i->first, pion::http::types::HEADER_CONNECTION)
+                || boost::algorithm::iequals(i->first, pion::http::types::HEADER_CONTENT_LENGTH))
+        {
+            continue;
+        }
+        headers.push_back(*i);
+    }
+
+    ResponseBodyPtr bodyPtr(new ResponseBody());
+    if (!body.empty())
+    {
+        bodyPtr->append(body);
+    }
+    else if (response.get_content_length() != 0u)
+    {
+        bodyPtr->appendCopy(response.get_content(), response.get_content_length());
+    }
+
+    Waiters waiters;
+    {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        if (flightPtr->isCompleted)
+        {
+            return;
+        }
+
+        flightPtr->statusCode = response.get_status_code();
+        flightPtr->statusMessage = response.get_status_message();
+        flightPtr->headers.swap(headers);
+        flightPtr->bodyPtr = bodyPtr;
+        flightPtr->isCompleted = true;
+        flightPtr->waiters.swap(waiters);
+        m_shared.fetch_add(1u, boost::memory_order_relaxed);
+
+        const boost::uint64_t now = getTimestampNs();
+        flightPtr->expires = now + m_window;
+        if (m_window != 0u)
+        {
+            m_expiring.push_back(flightPtr);
+        }
+        else
+        {
+            // a flight of a newer version may have replaced it
+            Flights::iterator i = m_flights.find(flightPtr->key);
+            if (i != m_flights.end() && i->second == flightPtr)
+            {
+                m_flights.erase(i);
+            }
+        }
+        eraseExpired(now);
+    }
+
+    for (Waiters::const_iterator i = waiters.begin(); i != waiters.end(); ++i)
+    {
+        send(*flightPtr, *i);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+RequestCoalescer::Waiters RequestCoalescer::abandon(FlightPtr flightPtr)
+{
+    Waiters waiters;
+
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    if (flightPtr->isCompleted)
+    {
+        return waiters;
+    }
+
+    Flights::iterator i = m_flights.find(flightPtr->key);
+    if (i != m_flights.end() && i->second == flightPtr)
+    {
+        m_flights.erase(i);
+    }
+    flightPtr->waiters.swap(waiters);
+    // abandoned flights are not joined any more
+    flightPtr->isCompleted = true;
+    m_fallbacks.fetch_add(waiters.size(), boost::memory_order_relaxed);
+    return waiters;
+}
+
+//--------------------------------------------------------------------------------------------------
+void RequestCoalescer::getStatistics(const std::string &prefix, IStat::Parameters &parameters) const
+{
+    parameters.push_back(IStat::Parameter(prefix + "_coalesce_flights",
+            boost::lexical_cast<std::string>(m_flightCount.load(boost::memory_order_relaxed))));
+    parameters.push_back(IStat::Parameter(prefix + "_coalesced",
+            boost::lexical_cast<std::string>(m_coalesced.load(boost::memory_order_relaxed))));
+    parameters.push_back(IStat::Parameter(prefix + "_coalesce_shared",
+            boost::lexical_cast<std::string>(m_shared.load(boost::memory_order_relaxed))));
+    parameters.push_back(IStat::Parameter(prefix + "_coalesce_fallbacks",
+            boost::lexical_cast<std::string>(m_fallbacks.load(boost::memory_order_relaxed))));
+}
+
+//--------------------------------------------------------------------------------------------------
+void RequestCoalescer::send(const Flight &flight, const Waiter &waiter)
+{
+    pion::http::response_ptr responsePtr(new pion::http::response(*waiter.first));
+    responsePtr->set_status_code(flight.statusCode);
+    responsePtr->set_status_message(flight.statusMessage);
+    for (Headers::const_iterator i = flight.headers.begin(); i != flight.headers.end(); ++i)
+    {
+        responsePtr->add_header(i->first, i->second);
+    }
+    m_sender(waiter.second, responsePtr, flight.bodyPtr);
+}
+
+//--------------------------------------------------------------------------------------------------
+void RequestCoalescer::eraseExpired(boost::uint64_t now)
+{
+    while (!m_expiring.empty() && m_expiring.front()->expires <= now)
+    {
+        Flights::iterator i = m_flights.find(m_expiring.front()->key);
+        if (i != m_flights.end() && i->second == m_expiring.front())
+        {
+            m_flights.erase(i);
+        }
+        m_expiring.pop_front();
+    }
+}
+
+} /* namespace WebServer */
+} /* namespace Tools */
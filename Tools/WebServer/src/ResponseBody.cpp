@@ -0,0 +1,209 @@
+// BOOST
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+
+#include "Tools/WebServer/ResponseBody.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+//--------------------------------------------------------------------------------------------------
+ResponseBody::ResponseBody() :
+        m_size(0u),
+        m_allocations(0u),
+        m_copiedBytes(0u)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+void ResponseBody::appendStatic(const char *data, std::size_t size)
+{
+    if (size == 0u)
+    {
+        return;
+    }
+
+    Segment segment;
+    segment.data = data;
+    segment.size = size;
+    m_segments.push_back(segment);
+    m_size += size;
+}
+
+//--------------------------------------------------------------------------------------------------
+void ResponseBody::append(const Buffer &buffer)
+{
+    if (!buffer || buffer->empty())
+    {
+        return;
+    }
+
+    Segment segment;
+    segment.buffer = buffer;
+    segment.data = buffer->data();
+    segment.size = buffer->size();
+    m_segments.push_back(segment);
+    m_size += segment.size;
+}
+
+//--------------------------------------------------------------------------------------------------
+void ResponseBody::append(std::string &data)
+{
+    if (data.empty())
+    {
+        return;
+    }
+
+    boost::shared_ptr<std::string> bufferPtr = boost::make_shared<std::string>();
+    bufferPtr->swap(data);
+    ++m_allocations;
+    append(Buffer(bufferPtr));
+}
+
+//--------------------------------------------------------------------------------------------------
+void ResponseBody::append(const ResponseBody &body)
+{
+    m_segments.insert(m_segments.end(), body.m_segments.begin(), body.m_segments.end());
+    m_size += body.m_size;
+}
+
+//--------------------------------------------------------------------------------------------------
+void ResponseBody::appendCopy(const char *data, std::size_t size)
+{
+    if (size == 0u)
+    {
+        return;
+    }
+
+    ++m_allocations;
+    m_copiedBytes += size;
+    append(Buffer(boost::make_shared<std::string>(data, size)));
+}
+
+//--------------------------------------------------------------------------------------------------
+bool ResponseBody::empty() const
+{
+    return m_size == 0u;
+}
+
+//--------------------------------------------------------------------------------------------------
+std::size_t ResponseBody::getSize() const
+{
+    return m_size;
+}
+
+//--------------------------------------------------------------------------------------------------
+std::size_t ResponseBody::getSegmentCount() const
+{
+    return m_segments.size();
+}
+
+//--------------------------------------------------------------------------------------------------
+std::size_t ResponseBody::getAllocations() const
+{
+    return m_allocations;
+}
+
+//--------------------------------------------------------------------------------------------------
+std::size_t ResponseBody::getCopiedBytes() const
+{
+    return m_copiedBytes;
+}
+
+//--------------------------------------------------------------------------------------------------
+std::string ResponseBody::toString() const
+{
+    std::string result;
+    result.reserve(m_size);
+    for (std::vector<Segment>::const_iterator i = m_segments.begin(); i != m_segments.end(); ++i)
+    {
+        result.append(i->data, i->size);
+    }
+    return result;
+}
+
+//--------------------------------------------------------------------------------------------------
+void ResponseBody::send(pion::tcp::connection_ptr tcpConnPtr,
+                        pion::http::response_ptr responsePtr,
+                        const boost::shared_ptr<const ResponseBody> &bodyPtr,
+                        const SentHandler &sentHandler)
+{
+    pion::http::response_writer_ptr writer(pion::http::response_writer::create(
+            tcpConnPtr,
+            responsePtr,
+            boost::bind(&ResponseBody::onSent, tcpConnPtr, bodyPtr, sentHandler)));
+
+    // the writer sets Content-Length from the buffers
+    for (std::vector<Segment>::const_iterator i = bodyPtr->m_segments.begin(); i != bodyPtr->m_segments.end(); ++i)
+    {
+        writer->write_no_copy(const_cast<char *>(i->data), i->size);
+    }
+    writer->send();
+}
+
+//--------------------------------------------------------------------------------------------------
+void ResponseBody::onSent(pion::tcp::connection_ptr tcpConnPtr,
+                          boost::shared_ptr<const ResponseBody>,
+                          SentHandler sentHandler)
+{
+    if (sentHandler)
+    {
+        sentHandler();
+    }
+    tcpConnPtr->finish();
+}
+
+//--------------------------------------------------------------------------------------------------
+ResponseBodyCounters::ResponseBodyCounters() :
+        m_responses(0u),
+        m_bytes(0u),
+        m_segments(0u),
+        m_allocations(0u),
+        m_copiedBytes(0u)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+void ResponseBodyCounters::add(const ResponseBody &body)
+{
+    m_responses.fetch_add(1u, boost::memory_order_relaxed);
+    m_bytes.fetch_add(body.getSize(), boost::memory_order_relaxed);
+    m_segments.fetch_add(body.getSegmentCount(), boost::memory_order_relaxed);
+    m_allocations.fetch_add(body.getAllocations(), boost::memory_order_relaxed);
+    m_copiedBytes.fetch_add(body.getCopiedBytes(), boost::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------------------------
+void ResponseBodyCounters::addCopied(std::size_t size)
+{
+    m_responses.fetch_add(1u, boost::memory_order_relaxed);
+    if (size == 0u)
+    {
+        return;
+    }
+    m_bytes.fetch_add(size, boost::memory_order_relaxed);
+    m_segments.fetch_add(1u, boost::memory_order_relaxed);
+    m_allocations.fetch_add(1u, boost::memory_order_relaxed);
+    m_copiedBytes.fetch_add(size, boost::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------------------------
+void ResponseBodyCounters::getStatistics(const std::string &prefix, IStat::Parameters &parameters) const
+{
+    parameters.push_back(IStat::Parameter(prefix + "_responses",
+            boost::lexical_cast<std::string>(m_responses.load(boost::memory_order_relaxed))));
+    parameters.push_back(IStat::Parameter(prefix + "_body_bytes",
+            boost::lexical_cast<std::string>(m_bytes.load(boost::memory_order_relaxed))));
+    parameters.push_back(IStat::Parameter(prefix + "_body_segments",
+            boost::lexical_cast<std::string>(m_segments.load(boost::memory_order_relaxed))));
+    parameters.push_back(IStat::Parameter(prefix + "_body_allocations",
+            boost::lexical_cast<std::string>(m_allocations.load(boost::memory_order_relaxed))));
+    parameters.push_back(IStat::Parameter(prefix + "_body_copied_bytes",
+            boost::lexical_cast<std::string>(m_copiedBytes.load(boost::memory_order_relaxed))));
+}
+
+} /* namespace WebServer */
+} /* namespace Tools */
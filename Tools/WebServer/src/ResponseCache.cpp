@@ -0,0 +1,224 @@
+// BOOST
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/locks.hpp>
+
+// PION
+#include <pion/http/types.hpp>
+
+// THIS
+#include "Tools/WebServer/Histogram.h"
+#include "Tools/WebServer/ResponseCache.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+//--------------------------------------------------------------------------------------------------
+CacheVersion::CacheVersion() :
+        m_version(0u)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+void CacheVersion::bump()
+{
+    m_version.fetch_add(1u, boost::memory_order_release);
+}
+
+//--------------------------------------------------------------------------------------------------
+boost::uint64_t CacheVersion::get() const
+{
+    return m_version.load(boost::memory_order_acquire);
+}
+
+//--------------------------------------------------------------------------------------------------
+ResponseCache::Settings::Settings() :
+        maxSize(16u * 1024u * 1024u)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+ResponseCache::ResponseCache(const Settings &settings) :
+        m_maxSize(settings.maxSize),
+        m_size(0u),
+        m_hits(0u),
+        m_misses(0u),
+        m_expired(0u),
+        m_evicted(0u)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+bool ResponseCache::isCacheable(const pion::http::request &request)
+{
+    return request.get_method() == pion::http::types::REQUEST_METHOD_GET;
+}
+
+//--------------------------------------------------------------------------------------------------
+std::string ResponseCache::getKey(const pion::http::request &request)
+{
+    // services pick the content encoding from Accept-Encoding
+    std::string key = request.get_resource();
+    key += '?';
+    key += request.get_query_string();
+    key += '\n';
+    key += request.get_header(pion::http::types::HEADER_ACCEPT_ENCODING);
+    return key;
+}
+
+//--------------------------------------------------------------------------------------------------
+pion::http::response_ptr ResponseCache::find(const std::string &key,
+                                             boost::uint64_t version,
+                                             const pion::http::request &request,
+                                             boost::shared_ptr<const ResponseBody> &bodyPtr)
+{
+    pion::http::response_ptr responsePtr;
+    {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        Index::iterator i = m_index.find(key);
+        if (i == m_index.end())
+        {
+            m_misses.fetch_add(1u, boost::memory_order_relaxed);
+            return responsePtr;
+        }
+
+        const Entry &entry = *i->second;
+        if (entry.version != version || entry.expires <= getTimestampNs())
+        {
+            erase(i);
+            m_expired.fetch_add(1u, boost::memory_order_relaxed);
+            m_misses.fetch_add(1u, boost::memory_order_relaxed);
+            return responsePtr;
+        }
+
+        m_entries.splice(m_entries.begin(), m_entries, i->second);
+
+        responsePtr.reset(new pion::http::response(request));
+        responsePtr->set_status_code(entry.statusCode);
+        responsePtr->set_status_message(entry.statusMessage);
+        for (Headers::const_iterator j = entry.headers.begin(); j != entry.headers.end(); ++j)
+        {
+            responsePtr->add_header(j->first, j->second);
+        }
+        bodyPtr = entry.bodyPtr;
+    }
+
+    m_hits.fetch_add(1u, boost::memory_order_relaxed);
+    return responsePtr;
+}
+
+//--------------------------------------------------------------------------------------------------
+void ResponseCache::insert(const std::string &key,
+                           boost::uint64_t version,
+                           const boost::posix_time::time_duration &ttl,
+                           pion::http::response &response,
+                           const ResponseBody &body)
+{
+    if (response.get_status_code() != pion::http::types::RESPONSE_CODE_OK
+            || response.has_header(pion::http::types::HEADER_SET_COOKIE))
+    {
+        return;
+    }
+
+    // filled outside of the lock and spliced in
+    Entries node(1u);
+    Entry &entry = node.front();
+    entry.key = key;
+    entry.version = version;
+    entry.expires = getTimestampNs() + static_cast<boost::uint64_t>(ttl.total_microseconds()) * 1000u;
+    entry.statusCode = response.get_status_code();
+    entry.statusMessage = response.get_status_message();
+    entry.size = sizeof(Entry) + key.size() + entry.statusMessage.size();
+
+    const pion::ihash_multimap &headers = response.get_headers();
+    for (pion::ihash_multimap::const_iterator i = headers.begin(); i != headers.end(); ++i)
+    {
+        // connection specific, set again when the response is sent
+        if (boost::algorithm::iequals(i->first, pion::http::types::HEADER_CONNECTION)
+                || boost::algorithm::iequals(i->first, pion::http::types::HEADER_CONTENT_LENGTH))
+        {
+            continue;
+        }
+        entry.headers.push_back(*i);
+        entry.size += i->first.size() + i->second.size();
+    }
+
+    ResponseBodyPtr bodyPtr(new ResponseBody());
+    if (!body.empty())
+    {
+        bodyPtr->append(body);
+    }
+    else if (response.get_content_length() != 0u)
+    {
+        bodyPtr->appendCopy(response.get_content(), response.get_content_length());
+    }
+    entry.bodyPtr = bodyPtr;
+    entry.size += bodyPtr->getSize();
+
+    if (entry.size > m_maxSize)
+    {
+        return;
+    }
+
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    Index::iterator i = m_index.find(key);
+    if (i != m_index.end())
+    {
+        erase(i);
+    }
+
+    while (m_size + entry.size > m_maxSize && !m_entries.empty())
+    {
+        erase(m_index.find(m_entries.back().key));
+        m_evicted.fetch_add(1u, boost::memory_order_relaxed);
+    }
+
+    m_size += entry.size;
+    m_entries.splice(m_entries.begin(), node);
+    m_index[key] = m_entries.begin();
+}
+
+//--------------------------------------------------------------------------------------------------
+void ResponseCache::clear()
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_index.clear();
+    m_entries.clear();
+    m_size = 0u;
+}
+
+//--------------------------------------------------------------------------------------------------
+void ResponseCache::getStatistics(IStat::Parameters &parameters) const
+{
+    std::size_t entries = 0u;
+    std::size_t size = 0u;
+    {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        entries = m_index.size();
+        size = m_size;
+    }
+
+    parameters.push_back(IStat::Parameter("entries", boost::lexical_cast<std::string>(entries)));
+    parameters.push_back(IStat::Parameter("size", boost::lexical_cast<std::string>(size)));
+    parameters.push_back(IStat::Parameter("hits",
+            boost::lexical_cast<std::string>(m_hits.load(boost::memory_order_relaxed))));
+    parameters.push_back(IStat::Parameter("misses",
+            boost::lexical_cast<std::string>(m_misses.load(boost::memory_order_relaxed))));
+    parameters.push_back(IStat::Parameter("expired",
+            boost::lexical_cast<std::string>(m_expired.load(boost::memory_order_relaxed))));
+    parameters.push_back(IStat::Parameter("evicted",
+            boost::lexical_cast<std::string>(m_evicted.load(boost::memory_order_relaxed))));
+}
+
+//--------------------------------------------------------------------------------------------------
+void ResponseCache::erase(Index::iterator i)
+{
+    m_size -= i->second->size;
+    m_entries.erase(i->second);
+    m_index.erase(i);
+}
+
+} /* namespace WebServer */
+} /* namespace Tools */
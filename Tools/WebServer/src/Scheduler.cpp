@@ -1,9 +1,14 @@
+// C++
+#include <algorithm>
+
 // BOOST
 #include <boost/assert.hpp>
+#include <boost/bind.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/thread/tss.hpp>
 
 // THIS
+#include "Tools/Logger/Logger.h"
 #include "Tools/WebServer/Scheduler.h"
 
 namespace Tools
@@ -17,12 +22,39 @@ static void deleteThreadInfoStub(Scheduler::ThreadInfo *)
 }
 
 //--------------------------------------------------------------------------------------------------
-Scheduler::Scheduler(const std::size_t minThreads, const std::size_t maxThreads) :
+static void wakeUpStub()
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+Scheduler::ResizePolicy::ResizePolicy() :
+                samplingInterval(boost::posix_time::milliseconds(100)),
+                growSamples(2u),
+                shrinkSamples(50u),
+                cooldown(boost::posix_time::seconds(1)),
+                minThreadLifetime(boost::posix_time::seconds(30))
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+Scheduler::Scheduler(const std::size_t minThreads,
+                     const std::size_t maxThreads,
+                     const ResizePolicy &resizePolicy,
+                     LanePolicy lanePolicy) :
                 m_minThreads(minThreads),
                 m_maxThreads(maxThreads),
+                m_resizePolicy(resizePolicy),
+                m_lanes(lanePolicy, m_laneStatistics),
+                m_timerWheel(*this),
                 m_isRunning(false),
                 m_pendingRequests(0u),
+                m_busyThreads(0u),
                 m_threadsCount(0u),
+                m_threadsToRetire(0u),
+                m_threadsCreated(0u),
+                m_threadsDestroyed(0u),
+                m_overloadedSamples(0u),
+                m_underloadedSamples(0u),
                 m_threadInfo(&deleteThreadInfoStub)
 {
 }
@@ -39,11 +71,15 @@ void Scheduler::start()
     if (!isRunning())
     {
         m_pWork.reset(new boost::asio::io_service::work(m_ioService));
-        for (std::size_t i = 0u; i < m_minThreads; ++i)
+        for (std::size_t i = 0u; i < m_minThreads.load(); ++i)
         {
             addThread();
         }
+        m_lastResizeTime = boost::posix_time::microsec_clock::universal_time();
         setRunning(true);
+        m_timerWheel.start();
+
+        m_controllerThreadPtr.reset(new boost::thread(boost::bind(&Scheduler::resizeController, this)));
     }
 }
 
@@ -52,91 +88,187 @@ void Scheduler::stop()
 {
     if (isRunning())
     {
+        {
+            boost::lock_guard<boost::mutex> lock(m_controllerMutex);
+            setRunning(false);
+            m_controllerCondition.notify_all();
+        }
+        m_controllerThreadPtr->join();
+        m_controllerThreadPtr.reset();
+        m_timerWheel.stop();
+
         m_pWork.reset();
         m_ioService.stop();
+
+        boost::lock_guard<boost::mutex> lock(m_mutex);
         for (Threads::iterator i = m_threads.begin(); i != m_threads.end(); ++i)
         {
             i->second->getThreadPtr()->join();
+            retireTimings(*i->second);
         }
         m_threads.clear();
         m_ioService.reset();
+        m_lanes.clear();
         m_pendingRequests = 0u;
-        setRunning(false);
+        m_busyThreads = 0u;
+        m_threadsCount = 0u;
+        m_threadsToRetire = 0u;
     }
 }
 
 //--------------------------------------------------------------------------------------------------
 bool Scheduler::isRunning() const
 {
-    return m_isRunning;
+    return m_isRunning.load(boost::memory_order_acquire);
 }
 
 //--------------------------------------------------------------------------------------------------
 void Scheduler::setRunning(bool running)
 {
-    m_isRunning = running;
+    m_isRunning.store(running, boost::memory_order_release);
 }
 
 //--------------------------------------------------------------------------------------------------
-void Scheduler::execute(SchedulerHandler handler)
+void Scheduler::getStatistics(IStat::Parameters &parameters) const
 {
+    parameters.push_back(IStat::Parameter("threads",
+                                          boost::lexical_cast<std::string>(m_threadsCount.load())));
+    parameters.push_back(IStat::Parameter("busy_threads",
+                                          boost::lexical_cast<std::string>(m_busyThreads.load())));
+    parameters.push_back(IStat::Parameter("pending_requests",
+                                          boost::lexical_cast<std::string>(m_pendingRequests.load())));
+    parameters.push_back(IStat::Parameter("threads_created",
+                                          boost::lexical_cast<std::string>(m_threadsCreated.load())));
+    parameters.push_back(IStat::Parameter("threads_destroyed",
+                                          boost::lexical_cast<std::string>(m_threadsDestroyed.load())));
+    parameters.push_back(IStat::Parameter("timers",
+                                          boost::lexical_cast<std::string>(m_timerWheel.getTimersCount())));
+    m_laneStatistics.getStatistics(parameters);
+
+#ifdef TOOLS_WEBSERVER_HANDLER_TIMINGS
+    HistogramSnapshot queueWait;
+    HistogramSnapshot execTime;
     {
         boost::lock_guard<boost::mutex> lock(m_mutex);
-        ++m_pendingRequests;
-        checkThreads();
+        queueWait.add(m_retiredTimings.queueWait);
+        execTime.add(m_retiredTimings.execTime);
+        for (Threads::const_iterator i = m_threads.begin(); i != m_threads.end(); ++i)
+        {
+            queueWait.add(i->second->getTimings().queueWait);
+            execTime.add(i->second->getTimings().execTime);
+        }
     }
+    queueWait.getStatistics("queue_wait", "_ns", parameters);
+    execTime.getStatistics("exec_time", "_ns", parameters);
+#endif
+}
 
-    HandlerWrapper hw(this, handler);
+//--------------------------------------------------------------------------------------------------
+bool Scheduler::setThreadLimits(std::size_t minThreads, std::size_t maxThreads)
+{
+    m_minThreads = minThreads;
+    m_maxThreads = std::max(minThreads, maxThreads);
+
+    // the controller applies the limits without waiting for the next sample
+    boost::lock_guard<boost::mutex> lock(m_controllerMutex);
+    m_controllerCondition.notify_all();
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+void Scheduler::execute(SchedulerHandler handler, ExecutionLane lane)
+{
+    m_pendingRequests.fetch_add(1u, boost::memory_order_relaxed);
+    m_lanes.push(handler, lane);
+
+    HandlerWrapper hw(this, boost::bind(&Scheduler::dispatchNext, this));
     m_ioService.post(hw);
 }
 
 //--------------------------------------------------------------------------------------------------
-DeadlineTimerPtr Scheduler::executeOnTimer(SchedulerTimerHandler handler,
-                                           const boost::posix_time::time_duration &timeDuration)
+void Scheduler::dispatchNext()
 {
+    SchedulerHandler handler;
+    boost::uint64_t waitNs = 0u;
+    if (m_lanes.pop(handler, waitNs))
     {
-        boost::lock_guard<boost::mutex> lock(m_mutex);
-        ++m_pendingRequests;
-        checkThreads();
+#ifdef TOOLS_WEBSERVER_HANDLER_TIMINGS
+        // the wait of the handler itself, the lanes may reorder it against the tokens
+        getThreadInfo()->getTimings().queueWait.record(waitNs);
+#endif
+        handler();
     }
+}
 
-    TimerHandlerWrapper hw(this, handler);
+//--------------------------------------------------------------------------------------------------
+TimerHandle Scheduler::executeOnTimer(SchedulerTimerHandler handler,
+                                      const boost::posix_time::time_duration &timeDuration)
+{
+    return m_timerWheel.executeOnTimer(handler, timeDuration);
+}
 
-    boost::shared_ptr<boost::asio::deadline_timer> pTimer(new boost::asio::deadline_timer(m_ioService,
-                                                                                          timeDuration));
-    pTimer->async_wait(hw);
-    return pTimer;
+//--------------------------------------------------------------------------------------------------
+bool Scheduler::cancelTimer(const TimerHandle &timerHandle)
+{
+    return m_timerWheel.cancelTimer(timerHandle);
 }
 
 //--------------------------------------------------------------------------------------------------
 void Scheduler::iosRunner(ThreadInfo *pThreadInfo)
 {
-    const boost::thread::id id = boost::this_thread::get_id();
+    m_threadInfo.reset(pThreadInfo);
 
+    try
     {
-        boost::lock_guard<boost::mutex> lock(m_mutex);
-        m_threadInfo.reset(pThreadInfo);
+        // run_one() returns 0 only when the io_service is stopped
+        while (m_ioService.run_one() != 0u)
+        {
+            if (shouldRetire(pThreadInfo))
+            {
+                break;
+            }
+        }
+    }
+    catch (const std::exception &e)
+    {
+        // the thread is replaced by the resize controller if needed
+        Tools::Logger::Logger::getInstance().error() << "Scheduler handler failed: " << e.what();
     }
 
-    try
+    markThreadAsZombie();
+    const std::size_t threads = m_threadsCount.fetch_sub(1u) - 1u;
+    m_threadsDestroyed.fetch_add(1u, boost::memory_order_relaxed);
+
+    // a failed thread does not take a retire request, more may be pending than threads are left
+    std::size_t toRetire = m_threadsToRetire.load();
+    while (toRetire > threads && !m_threadsToRetire.compare_exchange_weak(toRetire, threads))
     {
-        m_ioService.run();
     }
-    catch (const boost::system::system_error &)
+}
+
+//--------------------------------------------------------------------------------------------------
+bool Scheduler::shouldRetire(const ThreadInfo *pThreadInfo)
+{
+    std::size_t toRetire = m_threadsToRetire.load();
+    if (toRetire == 0u)
     {
-        markThreadAsZombie();
-        execute(boost::bind(&Scheduler::deleteThread, this, id));
+        return false;
     }
-    catch (const TerminateException &)
+
+    const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+    if (now - pThreadInfo->getStartTime() < m_resizePolicy.minThreadLifetime)
     {
-        markThreadAsZombie();
-        execute(boost::bind(&Scheduler::deleteThread, this, id));
+        return false;
     }
-    catch (const std::exception &)
+
+    while (toRetire > 0u)
     {
-        markThreadAsZombie();
-        execute(boost::bind(&Scheduler::deleteThread, this, id));
+        if (m_threadsToRetire.compare_exchange_weak(toRetire, toRetire - 1u))
+        {
+            return true;
+        }
     }
+    return false;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -145,175 +277,166 @@ void Scheduler::markThreadAsZombie()
     getThreadInfo()->setState(TS_ZOMBIE);
 }
 
-//--------------------------------------------------------------------------------------------------
-void threadStopper()
-{
-    throw Scheduler::TerminateException();
-}
-
 //--------------------------------------------------------------------------------------------------
 void Scheduler::addThread()
 {
-    if (m_threadsCount < m_maxThreads)
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    if (m_threadsCount.load() < m_maxThreads.load())
     {
         boost::shared_ptr<boost::thread> threadPtr;
         boost::shared_ptr<ThreadInfo> threadInfoPtr(new ThreadInfo(threadPtr, TS_IDLE));
+        m_threadsCount.fetch_add(1u);
         threadPtr.reset(new boost::thread(boost::bind(&Scheduler::iosRunner,
                                                       boost::ref(*this),
                                                       threadInfoPtr.get())));
         threadInfoPtr->setThreadPtr(threadPtr);
         m_threads.insert(std::make_pair(threadPtr->get_id(), threadInfoPtr));
-        ++m_threadsCount;
+        m_threadsCreated.fetch_add(1u, boost::memory_order_relaxed);
     }
 }
 
 //--------------------------------------------------------------------------------------------------
-void Scheduler::killThread()
+void Scheduler::retireThread()
 {
-    if (m_threadsCount > m_minThreads)
+    if (getLiveThreadsCount() > m_minThreads.load())
     {
-        --m_threadsCount;
-        m_ioService.post(threadStopper);
+        m_threadsToRetire.fetch_add(1u);
     }
 }
 
 //--------------------------------------------------------------------------------------------------
-void Scheduler::deleteThread(const boost::thread::id &id)
+std::size_t Scheduler::getLiveThreadsCount() const
 {
-    boost::lock_guard<boost::mutex> lock(m_mutex);
-    Threads::iterator it = m_threads.find(id);
-
-    BOOST_ASSERT(it != m_threads.end());
-
-    if (it != m_threads.end())
-    {
-        it->second->getThreadPtr()->join();
-        m_threads.erase(it);
-    }
+    const std::size_t threads = m_threadsCount.load();
+    const std::size_t toRetire = m_threadsToRetire.load();
+    return threads > toRetire ? threads - toRetire : 0u;
 }
 
 //--------------------------------------------------------------------------------------------------
-void Scheduler::checkThreads()
+void Scheduler::reapZombies()
 {
-    int threadsDelta = 0;
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    for (Threads::iterator it = m_threads.begin(); it != m_threads.end();)
     {
-        const double threads = m_threadsCount;
-        const double requests = m_pendingRequests;
-        const double ratio = requests / threads;
-        if (ratio > 1.5)
+        if (it->second->getState() == TS_ZOMBIE)
         {
-            threadsDelta = threads * (ratio - 1.0);
+            it->second->getThreadPtr()->join();
+            retireTimings(*it->second);
+            m_threads.erase(it++);
         }
-        else if (ratio < 0.5)
+        else
         {
-            threadsDelta = -1 * threads * (1.0 - ratio);
+            ++it;
         }
     }
+}
 
-    if (threadsDelta > 0)
-    {
-        for (int i = 0; i < threadsDelta; ++i)
-        {
-            addThread();
-        }
-    }
-    else if (threadsDelta < 0)
+//--------------------------------------------------------------------------------------------------
+void Scheduler::retireTimings(const ThreadInfo &threadInfo)
+{
+    m_retiredTimings.queueWait.add(threadInfo.getTimings().queueWait);
+    m_retiredTimings.execTime.add(threadInfo.getTimings().execTime);
+}
+
+//--------------------------------------------------------------------------------------------------
+void Scheduler::resizeController()
+{
+    boost::unique_lock<boost::mutex> lock(m_controllerMutex);
+    while (isRunning())
     {
-        for (int i = 0; i < -1 * threadsDelta; ++i)
+        m_controllerCondition.timed_wait(lock, m_resizePolicy.samplingInterval);
+        if (!isRunning())
         {
-            killThread();
+            break;
         }
+
+        lock.unlock();
+        checkThreads();
+        lock.lock();
     }
 }
 
 //--------------------------------------------------------------------------------------------------
-void Scheduler::onFinishExec()
+void Scheduler::checkThreads()
 {
-#ifdef DEBUG
-    std::size_t busyThreads = 0u;
-    std::size_t threadsCount = 0u;
-#endif
+    reapZombies();
 
+    // replace threads terminated by handler exceptions
+    while (m_threadsCount.load() < m_minThreads.load())
     {
-        boost::lock_guard<boost::mutex> lock(m_mutex);
-        --m_pendingRequests;
+        addThread();
+    }
 
-        checkThreads();
+    // the limits may have been lowered
+    while (getLiveThreadsCount() > m_maxThreads.load())
+    {
+        retireThread();
+    }
 
-#ifdef DEBUG
-        for(Threads::const_iterator it = m_threads.begin(); it != m_threads.end(); ++it)
-        {
-            if (it->second->getState() == TS_BUSY)
-            {
-                ++busyThreads;
-            }
+    const std::size_t threads = getLiveThreadsCount();
+    const std::size_t pending = m_pendingRequests.load(boost::memory_order_relaxed);
 
-            if (it->second->getState() != TS_ZOMBIE)
-            {
-                ++threadsCount;
-            }
+    m_overloadedSamples = (pending > threads) ? m_overloadedSamples + 1u : 0u;
+    m_underloadedSamples = (pending * 2u < threads) ? m_underloadedSamples + 1u : 0u;
+
+    const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+    if (now - m_lastResizeTime >= m_resizePolicy.cooldown)
+    {
+        if (m_overloadedSamples >= m_resizePolicy.growSamples && threads < m_maxThreads.load())
+        {
+            addThread();
+            m_overloadedSamples = 0u;
+            m_lastResizeTime = now;
+        }
+        else if (m_underloadedSamples >= m_resizePolicy.shrinkSamples && threads > m_minThreads.load())
+        {
+            retireThread();
+            m_underloadedSamples = 0u;
+            m_lastResizeTime = now;
         }
-#endif
     }
 
-#ifdef DEBUG
-    std::size_t thisPtr = reinterpret_cast<std::size_t>(this);
-    const std::string thisId = boost::lexical_cast<std::string>(thisPtr);
-#endif
-}
-
-//--------------------------------------------------------------------------------------------------
-boost::thread_specific_ptr<Scheduler::ThreadInfo> &Scheduler::getThreadInfo()
-{
-    return m_threadInfo;
-}
-
-//--------------------------------------------------------------------------------------------------
-Scheduler::HandlerWrapper::HandlerWrapper(Scheduler *pExecutor, SchedulerHandler handler) :
-        Scheduler::BaseHandlerWrapper(pExecutor), m_handler(handler)
-{
+    if (m_threadsToRetire.load() > 0u)
+    {
+        // idle threads check the retire request only after running a handler
+        m_ioService.post(&wakeUpStub);
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
-Scheduler::HandlerWrapper::HandlerWrapper(const Scheduler::HandlerWrapper &rhs) :
-        Scheduler::BaseHandlerWrapper(rhs)
+void Scheduler::onStartExec()
 {
-    *this = rhs;
+    m_busyThreads.fetch_add(1u, boost::memory_order_relaxed);
 }
 
 //--------------------------------------------------------------------------------------------------
-Scheduler::HandlerWrapper &Scheduler::HandlerWrapper::operator=(const Scheduler::HandlerWrapper &rhs)
+void Scheduler::onFinishExec()
 {
-    if (this != &rhs)
-    {
-        this->BaseHandlerWrapper::operator=(rhs);
-        m_handler = rhs.m_handler;
-    }
-    return *this;
+    m_busyThreads.fetch_sub(1u, boost::memory_order_relaxed);
+    m_pendingRequests.fetch_sub(1u, boost::memory_order_relaxed);
 }
 
 //--------------------------------------------------------------------------------------------------
-void Scheduler::HandlerWrapper::operator()()
+boost::thread_specific_ptr<Scheduler::ThreadInfo> &Scheduler::getThreadInfo()
 {
-    executeHandler(m_handler);
+    return m_threadInfo;
 }
 
 //--------------------------------------------------------------------------------------------------
-Scheduler::TimerHandlerWrapper::TimerHandlerWrapper(Scheduler *pExecutor,
-                                                    SchedulerTimerHandler handler) :
+Scheduler::HandlerWrapper::HandlerWrapper(Scheduler *pExecutor, SchedulerHandler handler) :
         Scheduler::BaseHandlerWrapper(pExecutor), m_handler(handler)
 {
 }
 
 //--------------------------------------------------------------------------------------------------
-Scheduler::TimerHandlerWrapper::TimerHandlerWrapper(const Scheduler::TimerHandlerWrapper &rhs) :
+Scheduler::HandlerWrapper::HandlerWrapper(const Scheduler::HandlerWrapper &rhs) :
         Scheduler::BaseHandlerWrapper(rhs)
 {
     *this = rhs;
 }
 
 //--------------------------------------------------------------------------------------------------
-Scheduler::TimerHandlerWrapper &Scheduler::TimerHandlerWrapper::operator=(const Scheduler::TimerHandlerWrapper &rhs)
+Scheduler::HandlerWrapper &Scheduler::HandlerWrapper::operator=(const Scheduler::HandlerWrapper &rhs)
 {
     if (this != &rhs)
     {
@@ -324,9 +447,9 @@ Scheduler::TimerHandlerWrapper &Scheduler::TimerHandlerWrapper::operator=(const
 }
 
 //--------------------------------------------------------------------------------------------------
-void Scheduler::TimerHandlerWrapper::operator()(const boost::system::error_code &error)
+void Scheduler::HandlerWrapper::operator()()
 {
-    executeHandler(SchedulerHandler(boost::bind(m_handler, error)));
+    executeHandler(m_handler);
 }
 
 } /* namespace WebServer */
@@ -6,6 +6,12 @@
 // BOOST
 #include <boost/assert.hpp>
 #include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+
+// PION
+#include <pion/algorithm.hpp>
+#include <pion/http/response_writer.hpp>
 
 #include "Tools/WebServer/ServiceHandler.h"
 
@@ -16,18 +22,40 @@ namespace WebServer
 
 //--------------------------------------------------------------------------------------------------
 ServiceHandler::ServiceHandler(IWebServicePtr servicePtr,
+                               const ServiceOptions &options,
                                ISchedulerPtr schedulerPtr,
                                IStatPtr statPtr,
                                ErrorHandler errorHandler,
+                               const HistogramHandle &handlerTimer,
+                               const RateHandle &requestRate,
+                               const RateHandle &errorRate,
                                boost::int32_t maxActiveRequests,
-                               boost::atomic_int32_t &activeRequestsCount):
+                               boost::atomic_int32_t &activeRequestsCount,
+                               const boost::atomic<bool> &isDraining,
+                               AdaptiveConcurrencyLimiterPtr limiterPtr,
+                               QueueDelayShedderPtr shedderPtr,
+                               ResponseCachePtr cachePtr):
         m_activeRequestsCount(activeRequestsCount),
+        m_isDraining(isDraining),
         m_maxActiveRequests(maxActiveRequests),
         m_servicePtr(servicePtr),
+        m_options(options),
         m_schedulerPtr(schedulerPtr),
         m_statPtr(statPtr),
-        m_errorHandler(errorHandler)
+        m_errorHandler(errorHandler),
+        m_handlerTimer(handlerTimer),
+        m_requestRate(requestRate),
+        m_errorRate(errorRate),
+        m_limiterPtr(limiterPtr),
+        m_shedderPtr(shedderPtr),
+        m_shedRequests(0u),
+        m_cachePtr(cachePtr)
 {
+    if (m_options.coalesceRequests)
+    {
+        m_coalescerPtr.reset(new RequestCoalescer(m_options.coalesceWindow,
+                                                  boost::bind(&ServiceHandler::sendResponse, this, _1, _2, _3)));
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -38,49 +66,257 @@ ServiceHandler::~ServiceHandler()
 //--------------------------------------------------------------------------------------------------
 void ServiceHandler::operator()(pion::http::request_ptr &requestPtr,
                                 pion::tcp::connection_ptr &tcpConnPtr)
+{
+    m_requestRate.increment(1);
+    handleRequest(requestPtr, tcpConnPtr, m_coalescerPtr != NULL);
+}
+
+//--------------------------------------------------------------------------------------------------
+void ServiceHandler::handleRequest(pion::http::request_ptr &requestPtr,
+                                   pion::tcp::connection_ptr &tcpConnPtr,
+                                   bool coalesce)
 {
     const boost::int32_t activeRequestsCount = m_activeRequestsCount.load(boost::memory_order_acquire);
 
     if (activeRequestsCount > getMaxActiveRequests())
     {
-        m_errorHandler(requestPtr, tcpConnPtr, std::runtime_error("server overloaded"));
+        sendServerError(requestPtr, tcpConnPtr, std::runtime_error("server overloaded"));
         return;
     }
 
-    ConnectionContextPtr contextPtr(new ConnectionContext(requestPtr,
-                                                          tcpConnPtr,
-                                                          m_statPtr,
-                                                          m_activeRequestsCount));
+    // responses of an older version are neither cached nor shared with the waiters
+    const boost::uint64_t cacheVersion = m_options.cacheVersionPtr ? m_options.cacheVersionPtr->get() : 0u;
+
+    std::string cacheKey;
+    if (m_cachePtr && ResponseCache::isCacheable(*requestPtr))
+    {
+        cacheKey = ResponseCache::getKey(*requestPtr);
+
+        // hits are served right here and never take a worker
+        boost::shared_ptr<const ResponseBody> bodyPtr;
+        pion::http::response_ptr responsePtr = m_cachePtr->find(cacheKey, cacheVersion, *requestPtr, bodyPtr);
+        if (responsePtr)
+        {
+            sendResponse(tcpConnPtr, responsePtr, bodyPtr);
+            return;
+        }
+    }
+
+    RequestCoalescer::FlightPtr flightPtr;
+    if (coalesce && ResponseCache::isCacheable(*requestPtr))
+    {
+        flightPtr = m_coalescerPtr->join(cacheKey.empty() ? ResponseCache::getKey(*requestPtr) : cacheKey,
+                                         cacheVersion,
+                                         requestPtr,
+                                         tcpConnPtr);
+        if (!flightPtr)
+        {
+            // answered by or waiting for an identical request
+            return;
+        }
+    }
+
+    if (m_limiterPtr && !m_limiterPtr->tryAcquire())
+    {
+        sendResponse(tcpConnPtr, createServiceUnavailableResponse(*requestPtr), boost::make_shared<ResponseBody>());
+        if (flightPtr)
+        {
+            finishFlight(flightPtr);
+        }
+        return;
+    }
+
+    const boost::uint64_t admissionTime = getTimestampNs();
+    ConnectionContextPtr contextPtr(ConnectionContext::create(requestPtr,
+                                                              tcpConnPtr,
+                                                              m_statPtr,
+                                                              m_activeRequestsCount,
+                                                              m_isDraining,
+                                                              m_responseBodyCounters));
+    if (m_limiterPtr)
+    {
+        contextPtr->addFinishHandler(boost::bind(&ServiceHandler::releaseLimit, m_limiterPtr, admissionTime));
+    }
+    if (!cacheKey.empty())
+    {
+        contextPtr->addResponseHandler(boost::bind(&ResponseCache::insert,
+                                                   m_cachePtr,
+                                                   cacheKey,
+                                                   cacheVersion,
+                                                   m_options.cacheTtl,
+                                                   _1,
+                                                   _2));
+    }
+    if (flightPtr)
+    {
+        contextPtr->addResponseHandler(boost::bind(&RequestCoalescer::complete, m_coalescerPtr, flightPtr, _1, _2));
+        // the waiters do not wait for a response they cannot share
+        contextPtr->addUnsharedHandler(boost::bind(&ServiceHandler::finishFlight, this, flightPtr));
+        contextPtr->addFinishHandler(boost::bind(&ServiceHandler::finishFlight, this, flightPtr));
+    }
 
     try
     {
-        m_schedulerPtr->execute(boost::bind(&ServiceHandler::invokeHandler, this, contextPtr));
+        m_schedulerPtr->execute(boost::bind(&ServiceHandler::invokeHandler, this, contextPtr, admissionTime),
+                                m_options.lane);
     }
     catch (const std::exception &e)
     {
-        m_errorHandler(requestPtr, tcpConnPtr, e);
+        sendServerError(requestPtr, tcpConnPtr, e);
     }
 }
 
 //--------------------------------------------------------------------------------------------------
 inline boost::int32_t ServiceHandler::getMaxActiveRequests() const
 {
-    return m_maxActiveRequests;
+    return m_maxActiveRequests.load(boost::memory_order_relaxed);
 }
 
 //--------------------------------------------------------------------------------------------------
-void ServiceHandler::invokeHandler(ConnectionContextPtr contextPtr)
+void ServiceHandler::setMaxActiveRequests(boost::int32_t maxActiveRequests)
 {
+    m_maxActiveRequests.store(maxActiveRequests, boost::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------------------------
+void ServiceHandler::invokeHandler(ConnectionContextPtr contextPtr, boost::uint64_t admissionTime)
+{
+    if (m_shedderPtr && m_shedderPtr->shouldDrop(getTimestampNs() - admissionTime))
+    {
+        m_shedRequests.fetch_add(1u, boost::memory_order_relaxed);
+
+        // the client is likely to retry elsewhere, free the connection
+        pion::http::response_ptr responsePtr = createServiceUnavailableResponse(*contextPtr->getRequest());
+        responsePtr->add_header(pion::http::types::HEADER_CONNECTION, "close");
+        contextPtr->getTcpConn()->set_lifecycle(pion::tcp::connection::LIFECYCLE_CLOSE);
+        contextPtr->sendResponse(responsePtr);
+        return;
+    }
+
     try
     {
+        ScopedTimer timer(m_handlerTimer);
         (*m_servicePtr)(contextPtr);
     }
     catch (const std::exception &e)
     {
-        m_errorHandler(contextPtr->getRequest(), contextPtr->getTcpConn(), e);
+        if (contextPtr->isResponseSet())
+        {
+            // the response is on its way already, only report the failure
+            m_errorRate.increment(1);
+            m_errorHandler(contextPtr->getRequest(), contextPtr->getTcpConn(), e);
+            return;
+        }
+        sendServerError(contextPtr->getRequest(), contextPtr->getTcpConn(), e);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+void ServiceHandler::getStatistics(const std::string &prefix, IStat::Parameters &parameters) const
+{
+    m_responseBodyCounters.getStatistics(prefix, parameters);
+
+    if (m_limiterPtr)
+    {
+        m_limiterPtr->getStatistics(prefix, parameters);
+    }
+
+    if (m_shedderPtr)
+    {
+        parameters.push_back(IStat::Parameter(prefix + "_shed",
+                boost::lexical_cast<std::string>(m_shedRequests.load(boost::memory_order_relaxed))));
+    }
+
+    if (m_coalescerPtr)
+    {
+        m_coalescerPtr->getStatistics(prefix, parameters);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+void ServiceHandler::sendResponse(pion::tcp::connection_ptr tcpConnPtr,
+                                  pion::http::response_ptr responsePtr,
+                                  boost::shared_ptr<const ResponseBody> bodyPtr)
+{
+    // the same as ConnectionContext::closeIfDraining
+    if (m_isDraining.load(boost::memory_order_acquire))
+    {
+        tcpConnPtr->set_lifecycle(pion::tcp::connection::LIFECYCLE_CLOSE);
+        responsePtr->change_header(pion::http::types::HEADER_CONNECTION, "close");
+    }
+
+    m_activeRequestsCount.fetch_add(1, boost::memory_order_release);
+    try
+    {
+        ResponseBody::send(tcpConnPtr, responsePtr, bodyPtr, boost::bind(&ServiceHandler::onResponseSent, this));
+    }
+    catch (const std::exception &)
+    {
+        m_activeRequestsCount.fetch_add(-1, boost::memory_order_release);
+        throw;
+    }
+    m_responseBodyCounters.add(*bodyPtr);
+}
+
+//--------------------------------------------------------------------------------------------------
+void ServiceHandler::sendServerError(pion::http::request_ptr requestPtr,
+                                     pion::tcp::connection_ptr tcpConnPtr,
+                                     const std::exception &e)
+{
+    static const char errorStart[] = "<html><head>\n<title>500 Server Error</title>\n</head><body>\n"
+                                     "<h1>Server Error</h1>\n<p>";
+    static const char errorFinish[] = "</p>\n</body></html>\n";
+
+    m_errorRate.increment(1);
+    m_errorHandler(requestPtr, tcpConnPtr, e);
+
+    // the same document as pion::http::server::handle_server_error
+    pion::http::response_ptr responsePtr(new pion::http::response(*requestPtr));
+    responsePtr->set_status_code(pion::http::types::RESPONSE_CODE_SERVER_ERROR);
+    responsePtr->set_status_message(pion::http::types::RESPONSE_MESSAGE_SERVER_ERROR);
+    responsePtr->set_content_type(pion::http::types::CONTENT_TYPE_HTML);
+
+    boost::shared_ptr<ResponseBody> bodyPtr(boost::make_shared<ResponseBody>());
+    std::string message = pion::algorithm::xml_encode(e.what());
+    bodyPtr->appendStatic(errorStart, sizeof(errorStart) - 1u);
+    bodyPtr->append(message);
+    bodyPtr->appendStatic(errorFinish, sizeof(errorFinish) - 1u);
+    sendResponse(tcpConnPtr, responsePtr, bodyPtr);
+}
+
+//--------------------------------------------------------------------------------------------------
+void ServiceHandler::onResponseSent()
+{
+    m_activeRequestsCount.fetch_add(-1, boost::memory_order_release);
+}
+
+//--------------------------------------------------------------------------------------------------
+void ServiceHandler::finishFlight(RequestCoalescer::FlightPtr flightPtr)
+{
+    // the flight ended without a response to share, its waiters are handled on their own
+    RequestCoalescer::Waiters waiters = m_coalescerPtr->abandon(flightPtr);
+    for (RequestCoalescer::Waiters::iterator i = waiters.begin(); i != waiters.end(); ++i)
+    {
+        handleRequest(i->first, i->second, false);
     }
 }
 
+//--------------------------------------------------------------------------------------------------
+pion::http::response_ptr ServiceHandler::createServiceUnavailableResponse(const pion::http::request &request)
+{
+    pion::http::response_ptr responsePtr(new pion::http::response(request));
+    responsePtr->set_status_code(503u);
+    responsePtr->set_status_message("Service Unavailable");
+    responsePtr->add_header("Retry-After", "1");
+    return responsePtr;
+}
+
+//--------------------------------------------------------------------------------------------------
+void ServiceHandler::releaseLimit(AdaptiveConcurrencyLimiterPtr limiterPtr, boost::uint64_t startTime)
+{
+    limiterPtr->release(getTimestampNs() - startTime);
+}
+
 //--------------------------------------------------------------------------------------------------
 Tools::Logger::Logger &ServiceHandler::logger()
 {
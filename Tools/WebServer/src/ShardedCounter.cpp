@@ -0,0 +1,78 @@
+// C++
+#include <new>
+
+// BOOST
+#include <boost/align/aligned_alloc.hpp>
+#include <boost/static_assert.hpp>
+#include <boost/thread/tss.hpp>
+
+#include "Tools/WebServer/ShardedCounter.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+BOOST_STATIC_ASSERT(sizeof(boost::atomic<long>) < ShardedCounter::CACHE_LINE_SIZE);
+
+//--------------------------------------------------------------------------------------------------
+ShardedCounter::ShardedCounter() :
+        m_shards(static_cast<Shard *>(boost::alignment::aligned_alloc(CACHE_LINE_SIZE, SHARDS * sizeof(Shard))))
+{
+    if (m_shards == NULL)
+    {
+        throw std::bad_alloc();
+    }
+
+    for (std::size_t i = 0u; i < SHARDS; ++i)
+    {
+        new (&m_shards[i]) Shard();
+        m_shards[i].value.store(0, boost::memory_order_relaxed);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+ShardedCounter::~ShardedCounter()
+{
+    for (std::size_t i = 0u; i < SHARDS; ++i)
+    {
+        m_shards[i].~Shard();
+    }
+    boost::alignment::aligned_free(m_shards);
+}
+
+//--------------------------------------------------------------------------------------------------
+void ShardedCounter::set(long value)
+{
+    for (std::size_t i = 1u; i < SHARDS; ++i)
+    {
+        m_shards[i].value.store(0, boost::memory_order_relaxed);
+    }
+    m_shards[0].value.store(value, boost::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------------------------
+long ShardedCounter::get() const
+{
+    long value = 0;
+    for (std::size_t i = 0u; i < SHARDS; ++i)
+    {
+        value += m_shards[i].value.load(boost::memory_order_relaxed);
+    }
+    return value;
+}
+
+//--------------------------------------------------------------------------------------------------
+std::size_t ShardedCounter::getShardIndex()
+{
+    static boost::atomic<std::size_t> nextIndex(0u);
+    static boost::thread_specific_ptr<std::size_t> indexPtr;
+    if (indexPtr.get() == NULL)
+    {
+        indexPtr.reset(new std::size_t(nextIndex.fetch_add(1u, boost::memory_order_relaxed) % SHARDS));
+    }
+    return *indexPtr;
+}
+
+} /* namespace WebServer */
+} /* namespace Tools */
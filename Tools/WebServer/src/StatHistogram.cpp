@@ -0,0 +1,217 @@
+// C++
+#include <algorithm>
+#include <stdexcept>
+
+// BOOST
+#include <boost/assert.hpp>
+
+// THIS
+#include "Tools/WebServer/StatHistogram.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+//--------------------------------------------------------------------------------------------------
+static std::size_t getHighestBit(boost::uint64_t value)
+{
+    std::size_t bit = 0u;
+    for (std::size_t shift = 32u; shift != 0u; shift /= 2u)
+    {
+        if ((value >> shift) != 0u)
+        {
+            value >>= shift;
+            bit += shift;
+        }
+    }
+    return bit;
+}
+
+//--------------------------------------------------------------------------------------------------
+StatHistogram::StatHistogram(unsigned precision) :
+        m_precision(precision),
+        m_sum(0u),
+        m_max(0u)
+{
+    if (precision < MIN_PRECISION || precision > MAX_PRECISION)
+    {
+        throw std::invalid_argument("Histogram precision is out of range");
+    }
+
+    const std::size_t bucketCount = getBucketCount(m_precision);
+    m_counts.reset(new boost::atomic<boost::uint64_t>[bucketCount]);
+    for (std::size_t i = 0u; i < bucketCount; ++i)
+    {
+        m_counts[i].store(0u, boost::memory_order_relaxed);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+void StatHistogram::add(const StatHistogram &histogram)
+{
+    BOOST_ASSERT(histogram.m_precision == m_precision);
+
+    const std::size_t bucketCount = getBucketCount(m_precision);
+    for (std::size_t i = 0u; i < bucketCount; ++i)
+    {
+        const boost::uint64_t count = histogram.getBucketCount(i);
+        if (count != 0u)
+        {
+            m_counts[i].fetch_add(count, boost::memory_order_relaxed);
+        }
+    }
+    m_sum.fetch_add(histogram.getSum(), boost::memory_order_relaxed);
+
+    const boost::uint64_t value = histogram.getMax();
+    boost::uint64_t max = m_max.load(boost::memory_order_relaxed);
+    while (value > max && !m_max.compare_exchange_weak(max, value, boost::memory_order_relaxed))
+    {
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+unsigned StatHistogram::getPrecision() const
+{
+    return m_precision;
+}
+
+//--------------------------------------------------------------------------------------------------
+boost::uint64_t StatHistogram::getBucketCount(std::size_t bucket) const
+{
+    BOOST_ASSERT(bucket < getBucketCount(m_precision));
+    return m_counts[bucket].load(boost::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------------------------
+boost::uint64_t StatHistogram::getSum() const
+{
+    return m_sum.load(boost::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------------------------
+boost::uint64_t StatHistogram::getMax() const
+{
+    return m_max.load(boost::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------------------------
+std::size_t StatHistogram::getBucketCount(unsigned precision)
+{
+    return static_cast<std::size_t>(64u - precision + 1u) << precision;
+}
+
+//--------------------------------------------------------------------------------------------------
+std::size_t StatHistogram::getBucket(boost::uint64_t value, unsigned precision)
+{
+    const std::size_t subBuckets = static_cast<std::size_t>(1u) << precision;
+    if (value < subBuckets)
+    {
+        return static_cast<std::size_t>(value);
+    }
+
+    const std::size_t exponent = getHighestBit(value);
+    const std::size_t subBucket = static_cast<std::size_t>(value >> (exponent - precision)) & (subBuckets - 1u);
+    return (exponent - precision + 1u) * subBuckets + subBucket;
+}
+
+//--------------------------------------------------------------------------------------------------
+boost::uint64_t StatHistogram::getBucketValue(std::size_t bucket, unsigned precision)
+{
+    const std::size_t subBuckets = static_cast<std::size_t>(1u) << precision;
+    if (bucket < subBuckets)
+    {
+        return bucket;
+    }
+
+    const std::size_t shift = bucket / subBuckets - 1u;
+    const boost::uint64_t lower = static_cast<boost::uint64_t>(subBuckets + bucket % subBuckets) << shift;
+    return lower + ((static_cast<boost::uint64_t>(1u) << shift) >> 1);
+}
+
+//--------------------------------------------------------------------------------------------------
+StatHistogramSnapshot::StatHistogramSnapshot(unsigned precision) :
+        m_precision(precision),
+        m_counts(StatHistogram::getBucketCount(precision), 0u),
+        m_count(0u),
+        m_sum(0u),
+        m_max(0u)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+void StatHistogramSnapshot::add(const StatHistogram &histogram)
+{
+    BOOST_ASSERT(histogram.getPrecision() == m_precision);
+
+    for (std::size_t i = 0u; i < m_counts.size(); ++i)
+    {
+        const boost::uint64_t count = histogram.getBucketCount(i);
+        m_counts[i] += count;
+        m_count += count;
+    }
+    m_sum += histogram.getSum();
+    m_max = std::max(m_max, histogram.getMax());
+}
+
+//--------------------------------------------------------------------------------------------------
+void StatHistogramSnapshot::add(const StatHistogramSnapshot &snapshot)
+{
+    BOOST_ASSERT(snapshot.m_precision == m_precision);
+
+    for (std::size_t i = 0u; i < m_counts.size(); ++i)
+    {
+        m_counts[i] += snapshot.m_counts[i];
+    }
+    m_count += snapshot.m_count;
+    m_sum += snapshot.m_sum;
+    m_max = std::max(m_max, snapshot.m_max);
+}
+
+//--------------------------------------------------------------------------------------------------
+boost::uint64_t StatHistogramSnapshot::getCount() const
+{
+    return m_count;
+}
+
+//--------------------------------------------------------------------------------------------------
+boost::uint64_t StatHistogramSnapshot::getSum() const
+{
+    return m_sum;
+}
+
+//--------------------------------------------------------------------------------------------------
+boost::uint64_t StatHistogramSnapshot::getMax() const
+{
+    return m_max;
+}
+
+//--------------------------------------------------------------------------------------------------
+boost::uint64_t StatHistogramSnapshot::getPercentile(double percentile) const
+{
+    if (m_count == 0u)
+    {
+        return 0u;
+    }
+
+    boost::uint64_t rank = static_cast<boost::uint64_t>(percentile / 100.0 * static_cast<double>(m_count) + 0.5);
+    if (rank == 0u)
+    {
+        rank = 1u;
+    }
+
+    boost::uint64_t seen = 0u;
+    for (std::size_t i = 0u; i < m_counts.size(); ++i)
+    {
+        seen += m_counts[i];
+        if (seen >= rank)
+        {
+            // the middle of the last bucket may be above the largest value
+            return std::min(StatHistogram::getBucketValue(i, m_precision), m_max);
+        }
+    }
+    return m_max;
+}
+
+} /* namespace WebServer */
+} /* namespace Tools */
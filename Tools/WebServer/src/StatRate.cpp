@@ -0,0 +1,118 @@
+// C++
+#include <algorithm>
+#include <cmath>
+
+// BOOST
+#include <boost/assert.hpp>
+
+#include "Tools/WebServer/StatRate.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+static const unsigned s_windowSeconds[StatRate::WINDOWS] = { 1u, 10u, 60u };
+static const double NS_PER_SECOND = 1e9;
+
+//--------------------------------------------------------------------------------------------------
+StatRate::StatRate(Kind kind) :
+        m_kind(kind),
+        m_ticks(0u)
+{
+    for (std::size_t i = 0u; i < BUCKETS; ++i)
+    {
+        m_buckets[i].total.store(0, boost::memory_order_relaxed);
+        m_buckets[i].timestamp.store(0u, boost::memory_order_relaxed);
+    }
+    for (std::size_t i = 0u; i < WINDOWS; ++i)
+    {
+        m_averages[i].store(0.0, boost::memory_order_relaxed);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+long StatRate::get() const
+{
+    return m_counter.get();
+}
+
+//--------------------------------------------------------------------------------------------------
+StatRate::Kind StatRate::getKind() const
+{
+    return m_kind;
+}
+
+//--------------------------------------------------------------------------------------------------
+void StatRate::tick(boost::uint64_t timestamp)
+{
+    const long total = m_counter.get();
+    const boost::uint64_t ticks = m_ticks.load(boost::memory_order_relaxed);
+
+    Bucket &bucket = m_buckets[ticks % BUCKETS];
+    bucket.total.store(total, boost::memory_order_relaxed);
+    bucket.timestamp.store(timestamp, boost::memory_order_relaxed);
+
+    if (m_kind == RK_EWMA && ticks > 0u)
+    {
+        const Bucket &previous = m_buckets[(ticks - 1u) % BUCKETS];
+        const boost::uint64_t previousTimestamp = previous.timestamp.load(boost::memory_order_relaxed);
+        if (timestamp > previousTimestamp)
+        {
+            // a late tick weighs the rate of its longer interval more
+            const double seconds = static_cast<double>(timestamp - previousTimestamp) / NS_PER_SECOND;
+            const double rate = static_cast<double>(total - previous.total.load(boost::memory_order_relaxed)) / seconds;
+            for (std::size_t i = 0u; i < WINDOWS; ++i)
+            {
+                const double average = m_averages[i].load(boost::memory_order_relaxed);
+                const double alpha = 1.0 - std::exp(-seconds / s_windowSeconds[i]);
+                m_averages[i].store(ticks == 1u ? rate : average + alpha * (rate - average),
+                                    boost::memory_order_relaxed);
+            }
+        }
+    }
+
+    m_ticks.store(ticks + 1u, boost::memory_order_release);
+}
+
+//--------------------------------------------------------------------------------------------------
+double StatRate::getRate(std::size_t window) const
+{
+    BOOST_ASSERT(window < WINDOWS);
+
+    const boost::uint64_t ticks = m_ticks.load(boost::memory_order_acquire);
+    if (ticks < 2u)
+    {
+        return 0.0;
+    }
+
+    if (m_kind == RK_EWMA)
+    {
+        return m_averages[window].load(boost::memory_order_relaxed);
+    }
+
+    // the window is shorter while the ring fills up
+    const boost::uint64_t span = std::min<boost::uint64_t>(s_windowSeconds[window], ticks - 1u);
+    const Bucket &last = m_buckets[(ticks - 1u) % BUCKETS];
+    const Bucket &first = m_buckets[(ticks - 1u - span) % BUCKETS];
+
+    const boost::uint64_t lastTimestamp = last.timestamp.load(boost::memory_order_relaxed);
+    const boost::uint64_t firstTimestamp = first.timestamp.load(boost::memory_order_relaxed);
+    if (lastTimestamp <= firstTimestamp)
+    {
+        return 0.0;
+    }
+
+    const long delta = last.total.load(boost::memory_order_relaxed) - first.total.load(boost::memory_order_relaxed);
+    return static_cast<double>(delta) * NS_PER_SECOND / static_cast<double>(lastTimestamp - firstTimestamp);
+}
+
+//--------------------------------------------------------------------------------------------------
+unsigned StatRate::getWindowSeconds(std::size_t window)
+{
+    BOOST_ASSERT(window < WINDOWS);
+    return s_windowSeconds[window];
+}
+
+} /* namespace WebServer */
+} /* namespace Tools */
@@ -1,7 +1,8 @@
 // BOOST
+#include <boost/bind.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
-#include <boost/date_time/posix_time/time_formatters.hpp>
 #include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
 
 // PION
 #include <pion/algorithm.hpp>
@@ -9,55 +10,69 @@
 #include <pion/http/types.hpp>
 
 #include "Tools/CompressUtils/Compress.h"
-#include "Tools/StringUtils/StringEscapeUtils.h"
-#include "Tools/StringUtils/UnicodeTextProcessing.h"
+#include "Tools/Logger/Logger.h"
 #include "Tools/WebServer/StatService.h"
 
-#ifdef __GNUC__
-#define atomic_inc(ptr, value) __sync_fetch_and_add ((ptr), (value))
-#elif defined (_WIN32)
-#define atomic_inc(ptr, value) InterlockedExchangeAdd ((ptr), (value))
-#else
-#error "Need some more porting work here"
-#endif
-
-using namespace Tools::StringUtils;
-
 namespace Tools
 {
 namespace WebServer
 {
 
+static const boost::posix_time::seconds s_rateTick(1);
+
 //--------------------------------------------------------------------------------------------------
 StatService::StatService(const std::string &serviceName,
                          const std::string &resource,
                          const std::string &version,
-                         const std::string &revision):
+                         const std::string &revision,
+                         const boost::posix_time::time_duration &snapshotInterval):
                 m_isRunning(false),
                 m_serviceName(serviceName),
                 m_resource(resource),
+                m_snapshotInterval(snapshotInterval),
+                m_isCollecting(false),
                 m_serviceVersion(version),
                 m_serviceRevision(revision)
 {
+    m_collectTimer = addHistogram("stat_collect_time", Labels(), StatHistogram::DEFAULT_PRECISION, "_us");
 }
 
 //--------------------------------------------------------------------------------------------------
 StatService::~StatService()
 {
+    detachTimerScheduler();
+    stop();
 }
 
 //--------------------------------------------------------------------------------------------------
 void StatService::start()
 {
-    m_parameterValues.resize(m_parameterIDs.size(), 0u);
     m_startTime = boost::posix_time::microsec_clock::universal_time();
     m_isRunning = true;
+
+    if (m_snapshotInterval > boost::posix_time::time_duration() && !m_collectorThreadPtr)
+    {
+        m_isCollecting = true;
+        m_collectorThreadPtr.reset(new boost::thread(boost::bind(&StatService::collectorRunner, this)));
+    }
 }
 
 //--------------------------------------------------------------------------------------------------
 void StatService::stop()
 {
     m_isRunning = false;
+
+    if (m_collectorThreadPtr)
+    {
+        {
+            boost::lock_guard<boost::mutex> lock(m_collectorMutex);
+            m_isCollecting = false;
+            m_collectorCondition.notify_all();
+        }
+        m_collectorThreadPtr->join();
+        m_collectorThreadPtr.reset();
+    }
+    boost::atomic_store(&m_snapshotPtr, SnapshotPtr());
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -67,11 +82,11 @@ void StatService::operator()(ConnectionContextPtr contextPtr)
 
     const std::string method = requestPtr->get_method();
     const std::string url = requestPtr->get_resource();
-    const pion::ihash_multimap &params = requestPtr->get_queries();
 
     const bool isGzipEnabled = (requestPtr->get_header("Accept-Encoding").find("gzip") != std::string::npos);
 
-    if (method != pion::http::types::REQUEST_METHOD_GET || !params.empty() || url != m_resource)
+    StatFormat format = SF_XML;
+    if (method != pion::http::types::REQUEST_METHOD_GET || url != m_resource || !getFormat(*requestPtr, format))
     {
         // bad request
         static const std::string badRequestData = std::string("<?xml version=\"1.0\" encoding=\"UTF-8\" ?>") +
@@ -105,118 +120,433 @@ void StatService::operator()(ConnectionContextPtr contextPtr)
         return;
     }
 
-    std::ostringstream xmlStream;
+    // until the first snapshot is collected the document is collected per request
+    SnapshotPtr snapshotPtr = boost::atomic_load(&m_snapshotPtr);
+    Document document;
+    if (snapshotPtr)
+    {
+        document = snapshotPtr->documents[format];
+    }
+    else
+    {
+        ScopedTimer timer(m_collectTimer);
+        StatDocument statDocument;
+        collect(statDocument);
+        document = createDocument(statDocument, format, isGzipEnabled);
+    }
+
+    if (isGzipEnabled && document.gzip)
+    {
+        sendDocument(contextPtr, document.gzip, format, true);
+    }
+    else
+    {
+        sendDocument(contextPtr, document.identity, format, false);
+    }
+}
 
-    xmlStream << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>" << "\n"
-            << "<document version=\"" << m_serviceName << "-" << m_serviceVersion << "\">" << "\n"
-            << "<system>" << "\n"
-            << "<version>" << m_serviceVersion << "</version>" << "\n"
-            << "<revision>" << m_serviceRevision << "</revision>" << "\n"
-            << "<start_time>" << boost::posix_time::to_iso_extended_string(m_startTime) << "</start_time>" << "\n"
-            << "</system>" << "\n";
+//--------------------------------------------------------------------------------------------------
+void StatService::render(StatFormat format, std::string &output)
+{
+    StatDocument statDocument;
+    collect(statDocument);
+    writeStatDocument(statDocument, format, output);
+}
 
-    xmlStream << "<user>" << "\n";
-    BOOST_FOREACH(const ParameterIDs::value_type &value, m_parameterIDs)
+//--------------------------------------------------------------------------------------------------
+void StatService::collect(StatDocument &document)
+{
+    document.serviceName = m_serviceName;
+    document.version = m_serviceVersion;
+    document.revision = m_serviceRevision;
+    document.startTime = m_startTime;
+
+    document.parameters.reserve(m_parameters.size());
+    BOOST_FOREACH(const RegisteredParameters::value_type &value, m_parameters)
+    {
+        const StatDocument::Parameter parameter = { &value.first.first, &value.second.labels, value.second.counterPtr->get() };
+        document.parameters.push_back(parameter);
+    }
+
+    boost::unique_lock<boost::mutex> lockHistograms(m_mutexHistograms);
+    document.histograms.reserve(m_histograms.size());
+    BOOST_FOREACH(const Histograms::value_type &value, m_histograms)
     {
-        xmlStream << "<" << value.first << ">" << m_parameterValues[value.second] << "</" << value.first << ">" << "\n";
+        document.addHistogram(value.first.first,
+                              value.second.labels,
+                              value.second.suffix,
+                              *value.second.histogramPtr);
     }
+    lockHistograms.unlock();
+
+    boost::unique_lock<boost::mutex> lockRates(m_mutexRates);
+    document.rates.reserve(m_rates.size());
+    BOOST_FOREACH(const Rates::value_type &value, m_rates)
+    {
+        document.addRate(value.first.first, value.second.labels, *value.second.ratePtr);
+    }
+    lockRates.unlock();
 
     boost::unique_lock<boost::mutex> lockProvider(m_mutexProvider);
+    document.groups.reserve(m_parametersProviders.size());
     BOOST_FOREACH(ParametersProviders::value_type &provider, m_parametersProviders)
     {
-    	Parameters parameters;
-    	provider.second(parameters);
+        document.groups.push_back(StatDocument::Group());
+        StatDocument::Group &group = document.groups.back();
+        group.name = provider.first;
+        {
+            ScopedTimer timer(provider.second.second);
+            provider.second.first(group.parameters);
+        }
+
+        if (group.parameters.empty())
+        {
+            document.groups.pop_back();
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+StatService::Document StatService::createDocument(const StatDocument &statDocument,
+                                                  StatFormat format,
+                                                  bool isGzipEnabled)
+{
+    // rendered right into the buffer which is sent
+    const boost::shared_ptr<std::string> identityPtr(new std::string());
+    writeStatDocument(statDocument, format, *identityPtr);
+
+    Document document;
+    document.identity = identityPtr;
+    if (isGzipEnabled)
+    {
+        try
+        {
+            document.gzip = boost::make_shared<std::string>(Tools::CompressUtils::gzipStringCompress(*identityPtr));
+        }
+        catch (...)
+        {
+        }
+    }
+    return document;
+}
+
+//--------------------------------------------------------------------------------------------------
+StatService::SnapshotPtr StatService::createSnapshot()
+{
+    ScopedTimer timer(m_collectTimer);
+
+    // the providers are called once for all formats
+    StatDocument statDocument;
+    collect(statDocument);
+
+    boost::shared_ptr<Snapshot> snapshotPtr(new Snapshot());
+    for (std::size_t i = 0u; i < SF_COUNT; ++i)
+    {
+        snapshotPtr->documents[i] = createDocument(statDocument, static_cast<StatFormat>(i), true);
+    }
+    return snapshotPtr;
+}
+
+//--------------------------------------------------------------------------------------------------
+void StatService::collectorRunner()
+{
+    boost::unique_lock<boost::mutex> lock(m_collectorMutex);
+    while (m_isCollecting)
+    {
+        // the providers are registered after the start, the first snapshot waits for an interval
+        m_collectorCondition.timed_wait(lock, m_snapshotInterval);
+        if (!m_isCollecting)
+        {
+            break;
+        }
 
-    	if (!parameters.empty())
-    	{
-    		xmlStream << "<" << provider.first << ">" << "\n";
-    		BOOST_FOREACH(const Parameters::value_type &parameter, parameters)
-    		{
-    			xmlStream << "<" << parameter.first << ">" << parameter.second << "</" << parameter.first << ">" << "\n";
-    		}
-    		xmlStream << "</" << provider.first << ">" << "\n";
-    	}
+        lock.unlock();
+        try
+        {
+            boost::atomic_store(&m_snapshotPtr, createSnapshot());
+        }
+        catch (const std::exception &e)
+        {
+            // the last snapshot is kept
+            Tools::Logger::Logger::getInstance().error() << "Stat snapshot failed: " << e.what();
+        }
+        lock.lock();
     }
-    lockProvider.unlock();
+}
 
-    xmlStream << "</user>" << "\n"
-            << "</document>";
-    const std::string xmlResponse = xmlStream.str();
+//--------------------------------------------------------------------------------------------------
+bool StatService::getFormat(const pion::http::request &request, StatFormat &format)
+{
+    // the only query parameter is the format, e.g. for a browser
+    const pion::ihash_multimap &params = request.get_queries();
+    if (params.empty())
+    {
+        format = negotiateStatFormat(request.get_header("Accept"));
+        return true;
+    }
 
+    pion::ihash_multimap::const_iterator it = params.find("format");
+    return params.size() == 1u && it != params.end() && parseStatFormat(it->second, format);
+}
+
+//--------------------------------------------------------------------------------------------------
+void StatService::sendDocument(ConnectionContextPtr contextPtr,
+                               const ResponseBody::Buffer &document,
+                               StatFormat format,
+                               bool isGzip)
+{
     pion::http::response_ptr responsePtr(new pion::http::response(pion::http::types::REQUEST_METHOD_GET));
     responsePtr->set_status_code(pion::http::types::RESPONSE_CODE_OK);
     responsePtr->set_status_message(pion::http::types::RESPONSE_MESSAGE_OK);
-    responsePtr->set_content_type("text/xml;charset=UTF-8");
-
-     if (isGzipEnabled)
-     {
-         std::string compressedXmlResponse;
-         try
-         {
-             compressedXmlResponse = Tools::CompressUtils::gzipStringCompress(xmlResponse);
-             responsePtr->add_header(pion::http::types::HEADER_CONTENT_ENCODING, "gzip");
-         }
-         catch(...)
-         {
-             compressedXmlResponse = xmlResponse;
-         }
-         responsePtr->set_content_length(compressedXmlResponse.length());
-         responsePtr->set_content(compressedXmlResponse);
-     }
-     else
-     {
-         responsePtr->set_content_length(xmlResponse.length());
-         responsePtr->set_content(xmlResponse);
-     }
-
-     contextPtr->sendResponse(responsePtr);
-}
-
-//--------------------------------------------------------------------------------------------------
-void StatService::registerParameter(const std::string &name)
+    responsePtr->set_content_type(getStatContentType(format));
+    responsePtr->add_header("Vary", "Accept, Accept-Encoding");
+    if (isGzip)
+    {
+        responsePtr->add_header(pion::http::types::HEADER_CONTENT_ENCODING, "gzip");
+    }
+
+    // the document is shared with the snapshot, not copied
+    ResponseBodyPtr bodyPtr(new ResponseBody());
+    bodyPtr->append(document);
+    contextPtr->sendResponse(responsePtr, bodyPtr);
+}
+
+//--------------------------------------------------------------------------------------------------
+CounterHandle StatService::registerParameter(const std::string &name)
+{
+    return registerParameter(name, Labels());
+}
+
+//--------------------------------------------------------------------------------------------------
+CounterHandle StatService::registerParameter(const std::string &name, const Labels &labels)
 {
     if (isRunning())
     {
         throw std::runtime_error("Can't register parameter when service running.");
     }
 
-    if (m_parameterIDs.find(name) != m_parameterIDs.end())
+    const std::string labelsKey = getLabelsKey(name, labels);
+    const RegisteredParameters::key_type key(name, labelsKey);
+    if (m_parameters.find(key) != m_parameters.end())
     {
-        throw std::runtime_error("Parameter " + name + " already registered.");
+        throw std::runtime_error("Parameter " + name + (labelsKey.empty() ? "" : "{" + labelsKey + "}")
+                + " already registered.");
     }
 
-    const unsigned ID = m_parameterIDs.size();
-    m_parameterIDs[name] = ID;
-    m_parameterValues.resize(m_parameterIDs.size(), 0u);
+    Parameter &parameter = m_parameters[key];
+    parameter.labels = labels;
+    parameter.counterPtr = boost::make_shared<ShardedCounter>();
+    return CounterHandle(parameter.counterPtr);
 }
 
 //--------------------------------------------------------------------------------------------------
-void StatService::set(const std::string &name, const long value)
+std::string StatService::getLabelsKey(const std::string &name, const Labels &labels)
+{
+    // the label names are written as they are into every format, the values are escaped
+    std::string labelsKey;
+    BOOST_FOREACH(const Labels::value_type &label, labels)
+    {
+        const bool isValid = !label.first.empty()
+                && (label.first[0] < '0' || label.first[0] > '9')
+                && label.first.find_first_not_of("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_")
+                        == std::string::npos;
+        if (!isValid)
+        {
+            throw std::runtime_error("Invalid label " + label.first + " of " + name + ".");
+        }
+        labelsKey += label.first + "=" + label.second + ",";
+    }
+    return labelsKey;
+}
+
+//--------------------------------------------------------------------------------------------------
+ShardedCounter &StatService::findParameter(const std::string &name)
 {
-    ParameterIDs::const_iterator it = m_parameterIDs.find(name);
-    if (it == m_parameterIDs.end())
+    RegisteredParameters::const_iterator it = m_parameters.find(std::make_pair(name, std::string()));
+    if (it == m_parameters.end())
     {
         throw std::runtime_error("Parameter " + name + " not registered.");
     }
 
-    BOOST_ASSERT(it->second < m_parameterValues.size());
+    BOOST_ASSERT(it->second.counterPtr);
 
-    m_parameterValues[it->second] = value;
+    return *it->second.counterPtr;
+}
+
+//--------------------------------------------------------------------------------------------------
+void StatService::set(const std::string &name, const long value)
+{
+    findParameter(name).set(value);
 }
 
 //--------------------------------------------------------------------------------------------------
 void StatService::increment(const std::string &name, const long value)
 {
-    ParameterIDs::const_iterator it = m_parameterIDs.find(name);
-    if (it == m_parameterIDs.end())
+    findParameter(name).add(value);
+}
+
+//--------------------------------------------------------------------------------------------------
+HistogramHandle StatService::registerHistogram(const std::string &name, unsigned precision)
+{
+    return addHistogram(name, Labels(), precision, "");
+}
+
+//--------------------------------------------------------------------------------------------------
+HistogramHandle StatService::registerTimer(const std::string &name, unsigned precision)
+{
+    return addHistogram(name, Labels(), precision, "_us");
+}
+
+//--------------------------------------------------------------------------------------------------
+HistogramHandle StatService::registerHistogram(const std::string &name, const Labels &labels, unsigned precision)
+{
+    return addHistogram(name, labels, precision, "");
+}
+
+//--------------------------------------------------------------------------------------------------
+HistogramHandle StatService::registerTimer(const std::string &name, const Labels &labels, unsigned precision)
+{
+    return addHistogram(name, labels, precision, "_us");
+}
+
+//--------------------------------------------------------------------------------------------------
+HistogramHandle StatService::addHistogram(const std::string &name,
+                                          const Labels &labels,
+                                          unsigned precision,
+                                          const std::string &suffix)
+{
+    if (name.empty())
     {
-        throw std::runtime_error("Parameter " + name + " not registered.");
+        throw std::runtime_error("Empty name of histogram");
+    }
+
+    const Histograms::key_type key(name, getLabelsKey(name, labels));
+
+    // handlers register their histograms on every start of the server
+    boost::unique_lock<boost::mutex> lockHistograms(m_mutexHistograms);
+    Histograms::const_iterator it = m_histograms.find(key);
+    if (it != m_histograms.end())
+    {
+        if (it->second.histogramPtr->getPrecision() != precision || it->second.suffix != suffix)
+        {
+            throw std::runtime_error("Histogram " + name + " already registered with other settings.");
+        }
+        return HistogramHandle(it->second.histogramPtr);
+    }
+
+    Histogram &histogram = m_histograms[key];
+    histogram.labels = labels;
+    histogram.histogramPtr.reset(new StatHistogram(precision));
+    histogram.suffix = suffix;
+    return HistogramHandle(histogram.histogramPtr);
+}
+
+//--------------------------------------------------------------------------------------------------
+RateHandle StatService::registerRate(const std::string &name)
+{
+    return addRate(name, Labels(), StatRate::RK_WINDOW);
+}
+
+//--------------------------------------------------------------------------------------------------
+RateHandle StatService::registerEwma(const std::string &name)
+{
+    return addRate(name, Labels(), StatRate::RK_EWMA);
+}
+
+//--------------------------------------------------------------------------------------------------
+RateHandle StatService::registerRate(const std::string &name, const Labels &labels)
+{
+    return addRate(name, labels, StatRate::RK_WINDOW);
+}
+
+//--------------------------------------------------------------------------------------------------
+RateHandle StatService::registerEwma(const std::string &name, const Labels &labels)
+{
+    return addRate(name, labels, StatRate::RK_EWMA);
+}
+
+//--------------------------------------------------------------------------------------------------
+RateHandle StatService::addRate(const std::string &name, const Labels &labels, StatRate::Kind kind)
+{
+    if (name.empty())
+    {
+        throw std::runtime_error("Empty name of rate");
+    }
+
+    const Rates::key_type key(name, getLabelsKey(name, labels));
+
+    // handlers register their rates on every start of the server
+    boost::lock_guard<boost::mutex> lockRates(m_mutexRates);
+    Rates::const_iterator it = m_rates.find(key);
+    if (it != m_rates.end())
+    {
+        if (it->second.ratePtr->getKind() != kind)
+        {
+            throw std::runtime_error("Rate " + name + " already registered with other settings.");
+        }
+        return RateHandle(it->second.ratePtr);
     }
 
-    BOOST_ASSERT(it->second < m_parameterValues.size());
+    Rate &rate = m_rates[key];
+    rate.labels = labels;
+    rate.ratePtr.reset(new StatRate(kind));
+    return RateHandle(rate.ratePtr);
+}
+
+//--------------------------------------------------------------------------------------------------
+void StatService::attachTimerScheduler(const ITimerSchedulerPtr &schedulerPtr)
+{
+    detachTimerScheduler();
 
-    atomic_inc(&m_parameterValues[it->second], value);
+    boost::lock_guard<boost::mutex> lock(m_mutexRateTimer);
+    m_rateSchedulerPtr = schedulerPtr;
+    m_rateTimer = m_rateSchedulerPtr->executeOnTimer(boost::bind(&StatService::onRateTimer, this, _1), s_rateTick);
 }
+
+//--------------------------------------------------------------------------------------------------
+void StatService::detachTimerScheduler()
+{
+    ITimerSchedulerPtr schedulerPtr;
+    TimerHandle rateTimer;
+    {
+        boost::lock_guard<boost::mutex> lock(m_mutexRateTimer);
+        schedulerPtr.swap(m_rateSchedulerPtr);
+        rateTimer = m_rateTimer;
+        m_rateTimer = TimerHandle();
+    }
+
+    // a timer firing meanwhile finds no scheduler and is not scheduled again
+    if (schedulerPtr)
+    {
+        schedulerPtr->cancelTimer(rateTimer);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+void StatService::onRateTimer(const boost::system::error_code &error)
+{
+    if (error)
+    {
+        return;
+    }
+
+    const boost::uint64_t timestamp = getTimestampNs();
+    {
+        boost::lock_guard<boost::mutex> lockRates(m_mutexRates);
+        BOOST_FOREACH(const Rates::value_type &value, m_rates)
+        {
+            value.second.ratePtr->tick(timestamp);
+        }
+    }
+
+    boost::lock_guard<boost::mutex> lock(m_mutexRateTimer);
+    if (m_rateSchedulerPtr)
+    {
+        m_rateTimer = m_rateSchedulerPtr->executeOnTimer(boost::bind(&StatService::onRateTimer, this, _1),
+                                                         s_rateTick);
+    }
+}
+
 //--------------------------------------------------------------------------------------------------
 void StatService::registerParametersProvider(const std::string &name,
                                              const ParametersProvider &parametersProvider)
@@ -226,13 +556,18 @@ void StatService::registerParametersProvider(const std::string &name,
 		throw std::runtime_error("Empty name of provider paramerers");
 	}
 
+	const HistogramHandle timer = addHistogram("stat_provider_" + name + "_time",
+	                                           Labels(),
+	                                           StatHistogram::DEFAULT_PRECISION,
+	                                           "_us");
+
 	boost::unique_lock<boost::mutex> lockProvider(m_mutexProvider);
 	ParametersProviders::const_iterator it = m_parametersProviders.find(name);
 	if (it != m_parametersProviders.end())
 	{
 		throw std::runtime_error("Parameter " + name + " already registered.");
 	}
-	m_parametersProviders[name] = parametersProvider;
+	m_parametersProviders[name] = std::make_pair(parametersProvider, timer);
 }
 //--------------------------------------------------------------------------------------------------
 void StatService::unregisterParametersProvider(const std::string &name)
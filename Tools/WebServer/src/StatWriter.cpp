@@ -0,0 +1,786 @@
+// C++
+#include <cstdio>
+#include <stdexcept>
+
+// BOOST
+#include <boost/date_time/gregorian/gregorian_types.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "Tools/StringUtils/JSONUtils.h"
+#include "Tools/StringUtils/StringEscapeUtils.h"
+#include "Tools/WebServer/StatWriter.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+static const double s_percentiles[StatDocument::PERCENTILES] = { 50.0, 90.0, 99.0, 99.9 };
+static const char *const s_percentileNames[StatDocument::PERCENTILES] = { "_p50", "_p90", "_p99", "_p999" };
+static const char *const s_quantiles[StatDocument::PERCENTILES] = { "0.5", "0.9", "0.99", "0.999" };
+
+// by StatRate::Kind
+static const char *const s_rateNames[] = { "_rate", "_ewma" };
+static const char *const s_rateKinds[] = { "rate", "ewma" };
+
+static const char *const s_formatNames[SF_COUNT] = { "xml", "prometheus", "openmetrics", "json" };
+static const char *const s_contentTypes[SF_COUNT] = {
+    "text/xml;charset=UTF-8",
+    "text/plain; version=0.0.4; charset=utf-8",
+    "application/openmetrics-text; version=1.0.0; charset=utf-8",
+    "application/json;charset=UTF-8"
+};
+
+//--------------------------------------------------------------------------------------------------
+static void appendUnsigned(std::string &output, boost::uint64_t value)
+{
+    char buffer[20];
+    char *const end = buffer + sizeof(buffer);
+    char *begin = end;
+    do
+    {
+        *--begin = static_cast<char>('0' + value % 10u);
+        value /= 10u;
+    }
+    while (value != 0u);
+    output.append(begin, end);
+}
+
+//--------------------------------------------------------------------------------------------------
+static void appendInteger(std::string &output, long value)
+{
+    if (value < 0)
+    {
+        output += '-';
+        // -LONG_MIN does not fit into long
+        appendUnsigned(output, static_cast<boost::uint64_t>(-(value + 1)) + 1u);
+    }
+    else
+    {
+        appendUnsigned(output, static_cast<boost::uint64_t>(value));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+static void appendDouble(std::string &output, double value)
+{
+    // a rate of long values per nanosecond at most, 28 digits
+    char buffer[64];
+    const int length = std::sprintf(buffer, "%.3f", value);
+    output.append(buffer, length > 0 ? static_cast<std::size_t>(length) : 0u);
+}
+
+//--------------------------------------------------------------------------------------------------
+static void appendWindow(std::string &output, std::size_t window)
+{
+    appendUnsigned(output, StatRate::getWindowSeconds(window));
+    output += 's';
+}
+
+//--------------------------------------------------------------------------------------------------
+// -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?, valid in JSON and Prometheus
+static bool isNumber(const std::string &value)
+{
+    std::string::const_iterator i = value.begin();
+    const std::string::const_iterator end = value.end();
+
+    if (i != end && *i == '-')
+    {
+        ++i;
+    }
+    if (i == end || *i < '0' || *i > '9')
+    {
+        return false;
+    }
+    if (*i++ != '0')
+    {
+        while (i != end && *i >= '0' && *i <= '9')
+        {
+            ++i;
+        }
+    }
+    if (i != end && *i == '.')
+    {
+        if (++i == end || *i < '0' || *i > '9')
+        {
+            return false;
+        }
+        while (i != end && *i >= '0' && *i <= '9')
+        {
+            ++i;
+        }
+    }
+    if (i != end && (*i == 'e' || *i == 'E'))
+    {
+        if (++i != end && (*i == '+' || *i == '-'))
+        {
+            ++i;
+        }
+        if (i == end || *i < '0' || *i > '9')
+        {
+            return false;
+        }
+        while (i != end && *i >= '0' && *i <= '9')
+        {
+            ++i;
+        }
+    }
+    return i == end;
+}
+
+//--------------------------------------------------------------------------------------------------
+static void appendXmlEscaped(std::string &output, const std::string &value)
+{
+    if (value.find_first_of("&<>\"'") == std::string::npos)
+    {
+        output += value;
+    }
+    else
+    {
+        output += Tools::StringUtils::EscapeUtils::escapeStringToXml(value);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+static void appendXmlLabels(std::string &output, const IStat::Labels &labels)
+{
+    for (IStat::Labels::const_iterator i = labels.begin(); i != labels.end(); ++i)
+    {
+        output += ' ';
+        output += i->first;
+        output += "=\"";
+        appendXmlEscaped(output, i->second);
+        output += '"';
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+static void appendXmlElement(std::string &output,
+                             const std::string &name,
+                             const IStat::Labels &labels,
+                             const char *part,
+                             const std::string &suffix,
+                             boost::uint64_t value)
+{
+    output += '<';
+    output += name;
+    output += part;
+    output += suffix;
+    appendXmlLabels(output, labels);
+    output += '>';
+    appendUnsigned(output, value);
+    output += "</";
+    output += name;
+    output += part;
+    output += suffix;
+    output += ">\n";
+}
+
+//--------------------------------------------------------------------------------------------------
+static void writeXml(const StatDocument &document, std::string &output)
+{
+    static const std::string noSuffix;
+
+    output += "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n<document version=\"";
+    output += document.serviceName;
+    output += '-';
+    output += document.version;
+    output += "\">\n<system>\n<version>";
+    output += document.version;
+    output += "</version>\n<revision>";
+    output += document.revision;
+    output += "</revision>\n<start_time>";
+    output += boost::posix_time::to_iso_extended_string(document.startTime);
+    output += "</start_time>\n</system>\n<user>\n";
+
+    for (std::vector<StatDocument::Parameter>::const_iterator i = document.parameters.begin();
+         i != document.parameters.end();
+         ++i)
+    {
+        output += '<';
+        output += *i->name;
+        appendXmlLabels(output, *i->labels);
+        output += '>';
+        appendInteger(output, i->value);
+        output += "</";
+        output += *i->name;
+        output += ">\n";
+    }
+
+    for (std::vector<StatDocument::Histogram>::const_iterator i = document.histograms.begin();
+         i != document.histograms.end();
+         ++i)
+    {
+        appendXmlElement(output, *i->name, *i->labels, "_count", noSuffix, i->count);
+        appendXmlElement(output, *i->name, *i->labels, "_sum", *i->suffix, i->sum);
+        appendXmlElement(output, *i->name, *i->labels, "_max", *i->suffix, i->max);
+        for (std::size_t j = 0u; j < StatDocument::PERCENTILES; ++j)
+        {
+            appendXmlElement(output, *i->name, *i->labels, s_percentileNames[j], *i->suffix, i->percentiles[j]);
+        }
+    }
+
+    for (std::vector<StatDocument::Rate>::const_iterator i = document.rates.begin(); i != document.rates.end(); ++i)
+    {
+        output += '<';
+        output += *i->name;
+        appendXmlLabels(output, *i->labels);
+        output += '>';
+        appendInteger(output, i->value);
+        output += "</";
+        output += *i->name;
+        output += ">\n";
+        for (std::size_t j = 0u; j < StatRate::WINDOWS; ++j)
+        {
+            std::string element = *i->name;
+            element += s_rateNames[i->kind];
+            element += '_';
+            appendWindow(element, j);
+
+            output += '<';
+            output += element;
+            appendXmlLabels(output, *i->labels);
+            output += '>';
+            appendDouble(output, i->rates[j]);
+            output += "</";
+            output += element;
+            output += ">\n";
+        }
+    }
+
+    for (std::vector<StatDocument::Group>::const_iterator i = document.groups.begin(); i != document.groups.end(); ++i)
+    {
+        output += '<';
+        output += i->name;
+        output += ">\n";
+        for (IStat::Parameters::const_iterator j = i->parameters.begin(); j != i->parameters.end(); ++j)
+        {
+            output += '<';
+            output += j->first;
+            output += '>';
+            output += j->second;
+            output += "</";
+            output += j->first;
+            output += ">\n";
+        }
+        output += "</";
+        output += i->name;
+        output += ">\n";
+    }
+
+    output += "</user>\n</document>";
+}
+
+//--------------------------------------------------------------------------------------------------
+// [a-zA-Z_:][a-zA-Z0-9_:]*, the other characters become '_'
+static void appendMetricName(std::string &output, const std::string &name)
+{
+    if (!name.empty() && name[0] >= '0' && name[0] <= '9')
+    {
+        output += '_';
+    }
+    for (std::string::const_iterator i = name.begin(); i != name.end(); ++i)
+    {
+        const bool isValid = (*i >= 'a' && *i <= 'z') || (*i >= 'A' && *i <= 'Z') || (*i >= '0' && *i <= '9')
+                || *i == '_' || *i == ':';
+        output += isValid ? *i : '_';
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+static void appendLabelValue(std::string &output, const std::string &value)
+{
+    for (std::string::const_iterator i = value.begin(); i != value.end(); ++i)
+    {
+        switch (*i)
+        {
+        case '\\':
+            output += "\\\\";
+            break;
+        case '"':
+            output += "\\\"";
+            break;
+        case '\n':
+            output += "\\n";
+            break;
+        default:
+            output += *i;
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+static void appendLabels(std::string &output, const IStat::Labels &labels)
+{
+    if (labels.empty())
+    {
+        return;
+    }
+
+    output += '{';
+    for (IStat::Labels::const_iterator i = labels.begin(); i != labels.end(); ++i)
+    {
+        if (i != labels.begin())
+        {
+            output += ',';
+        }
+        output += i->first;
+        output += "=\"";
+        appendLabelValue(output, i->second);
+        output += '"';
+    }
+    output += '}';
+}
+
+//--------------------------------------------------------------------------------------------------
+// the labels of the value and the label of the series, e.g. the quantile
+static void appendLabels(std::string &output, const IStat::Labels &labels, const char *name, const char *value)
+{
+    output += '{';
+    for (IStat::Labels::const_iterator i = labels.begin(); i != labels.end(); ++i)
+    {
+        output += i->first;
+        output += "=\"";
+        appendLabelValue(output, i->second);
+        output += "\",";
+    }
+    output += name;
+    output += "=\"";
+    output += value;
+    output += "\"}";
+}
+
+//--------------------------------------------------------------------------------------------------
+static void appendTypeLine(std::string &output, const std::string &name, const char *suffix, const char *type)
+{
+    output += "# TYPE ";
+    appendMetricName(output, name);
+    output += suffix;
+    output += ' ';
+    output += type;
+    output += '\n';
+}
+
+//--------------------------------------------------------------------------------------------------
+static void writePrometheus(const StatDocument &document, bool isOpenMetrics, std::string &output)
+{
+    const char *const untyped = isOpenMetrics ? "unknown" : "untyped";
+
+    output += isOpenMetrics ? "# TYPE stat info\n" : "# TYPE stat_info gauge\n";
+    output += "stat_info{service=\"";
+    appendLabelValue(output, document.serviceName);
+    output += "\",version=\"";
+    appendLabelValue(output, document.version);
+    output += "\",revision=\"";
+    appendLabelValue(output, document.revision);
+    output += "\"} 1\n";
+
+    if (!document.startTime.is_special())
+    {
+        static const boost::posix_time::ptime epoch(boost::gregorian::date(1970, 1, 1));
+        output += "# TYPE stat_start_time_seconds gauge\nstat_start_time_seconds ";
+        appendUnsigned(output, static_cast<boost::uint64_t>((document.startTime - epoch).total_seconds()));
+        output += '\n';
+    }
+
+    const std::string *family = NULL;
+    for (std::vector<StatDocument::Parameter>::const_iterator i = document.parameters.begin();
+         i != document.parameters.end();
+         ++i)
+    {
+        if (family == NULL || *family != *i->name)
+        {
+            appendTypeLine(output, *i->name, "", untyped);
+            family = i->name;
+        }
+        appendMetricName(output, *i->name);
+        appendLabels(output, *i->labels);
+        output += ' ';
+        appendInteger(output, i->value);
+        output += '\n';
+    }
+
+    // a family is written at once, the histograms of the same name differ by their labels
+    std::vector<StatDocument::Histogram>::const_iterator next;
+    for (std::vector<StatDocument::Histogram>::const_iterator i = document.histograms.begin();
+         i != document.histograms.end();
+         i = next)
+    {
+        next = i;
+        while (next != document.histograms.end() && *next->name == *i->name && *next->suffix == *i->suffix)
+        {
+            ++next;
+        }
+
+        // percentiles are quantiles of a summary, the max is a gauge of its own
+        appendTypeLine(output, *i->name + *i->suffix, "", "summary");
+        for (std::vector<StatDocument::Histogram>::const_iterator j = i; j != next; ++j)
+        {
+            for (std::size_t k = 0u; k < StatDocument::PERCENTILES; ++k)
+            {
+                appendMetricName(output, *j->name);
+                output += *j->suffix;
+                appendLabels(output, *j->labels, "quantile", s_quantiles[k]);
+                output += ' ';
+                appendUnsigned(output, j->percentiles[k]);
+                output += '\n';
+            }
+            appendMetricName(output, *j->name);
+            output += *j->suffix;
+            output += "_sum";
+            appendLabels(output, *j->labels);
+            output += ' ';
+            appendUnsigned(output, j->sum);
+            output += '\n';
+            appendMetricName(output, *j->name);
+            output += *j->suffix;
+            output += "_count";
+            appendLabels(output, *j->labels);
+            output += ' ';
+            appendUnsigned(output, j->count);
+            output += '\n';
+        }
+
+        appendTypeLine(output, *i->name + *i->suffix, "_max", "gauge");
+        for (std::vector<StatDocument::Histogram>::const_iterator j = i; j != next; ++j)
+        {
+            appendMetricName(output, *j->name);
+            output += *j->suffix;
+            output += "_max";
+            appendLabels(output, *j->labels);
+            output += ' ';
+            appendUnsigned(output, j->max);
+            output += '\n';
+        }
+    }
+
+    // the counter next to its rates, a gauge labeled by the window
+    std::string windows[StatRate::WINDOWS];
+    for (std::size_t i = 0u; i < StatRate::WINDOWS; ++i)
+    {
+        appendWindow(windows[i], i);
+    }
+    std::vector<StatDocument::Rate>::const_iterator nextRate;
+    for (std::vector<StatDocument::Rate>::const_iterator i = document.rates.begin();
+         i != document.rates.end();
+         i = nextRate)
+    {
+        nextRate = i;
+        while (nextRate != document.rates.end() && *nextRate->name == *i->name && nextRate->kind == i->kind)
+        {
+            ++nextRate;
+        }
+
+        appendTypeLine(output, *i->name, "", "counter");
+        for (std::vector<StatDocument::Rate>::const_iterator j = i; j != nextRate; ++j)
+        {
+            appendMetricName(output, *j->name);
+            output += isOpenMetrics ? "_total" : "";
+            appendLabels(output, *j->labels);
+            output += ' ';
+            appendInteger(output, j->value);
+            output += '\n';
+        }
+
+        appendTypeLine(output, *i->name, s_rateNames[i->kind], "gauge");
+        for (std::vector<StatDocument::Rate>::const_iterator j = i; j != nextRate; ++j)
+        {
+            for (std::size_t k = 0u; k < StatRate::WINDOWS; ++k)
+            {
+                appendMetricName(output, *j->name);
+                output += s_rateNames[j->kind];
+                appendLabels(output, *j->labels, "window", windows[k].c_str());
+                output += ' ';
+                appendDouble(output, j->rates[k]);
+                output += '\n';
+            }
+        }
+    }
+
+    // the providers' values which are not numbers have no place here
+    for (std::vector<StatDocument::Group>::const_iterator i = document.groups.begin(); i != document.groups.end(); ++i)
+    {
+        for (IStat::Parameters::const_iterator j = i->parameters.begin(); j != i->parameters.end(); ++j)
+        {
+            if (!isNumber(j->second))
+            {
+                continue;
+            }
+
+            const std::string name = i->name + "_" + j->first;
+            appendTypeLine(output, name, "", untyped);
+            appendMetricName(output, name);
+            output += ' ';
+            output += j->second;
+            output += '\n';
+        }
+    }
+
+    if (isOpenMetrics)
+    {
+        output += "# EOF\n";
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+static void appendJsonString(std::string &output, const std::string &value)
+{
+    bool isEscaped = false;
+    for (std::string::const_iterator i = value.begin(); i != value.end() && !isEscaped; ++i)
+    {
+        isEscaped = *i == '"' || *i == '\\' || *i == '/' || static_cast<unsigned char>(*i) < 0x20u;
+    }
+
+    output += '"';
+    output += isEscaped ? Tools::StringUtils::escapeJSON(value) : value;
+    output += '"';
+}
+
+//--------------------------------------------------------------------------------------------------
+static void appendJsonMember(std::string &output, const char *name, boost::uint64_t value)
+{
+    output += ",\"";
+    output += name;
+    output += "\":";
+    appendUnsigned(output, value);
+}
+
+//--------------------------------------------------------------------------------------------------
+static void appendJsonLabels(std::string &output, const IStat::Labels &labels)
+{
+    if (labels.empty())
+    {
+        return;
+    }
+
+    output += ",\"labels\":{";
+    for (IStat::Labels::const_iterator i = labels.begin(); i != labels.end(); ++i)
+    {
+        if (i != labels.begin())
+        {
+            output += ',';
+        }
+        appendJsonString(output, i->first);
+        output += ':';
+        appendJsonString(output, i->second);
+    }
+    output += '}';
+}
+
+//--------------------------------------------------------------------------------------------------
+static void writeJson(const StatDocument &document, std::string &output)
+{
+    output += "{\"service\":";
+    appendJsonString(output, document.serviceName);
+    output += ",\"version\":";
+    appendJsonString(output, document.version);
+    output += ",\"revision\":";
+    appendJsonString(output, document.revision);
+    output += ",\"start_time\":";
+    appendJsonString(output, boost::posix_time::to_iso_extended_string(document.startTime));
+
+    output += ",\"parameters\":[";
+    for (std::vector<StatDocument::Parameter>::const_iterator i = document.parameters.begin();
+         i != document.parameters.end();
+         ++i)
+    {
+        if (i != document.parameters.begin())
+        {
+            output += ',';
+        }
+        output += "{\"name\":";
+        appendJsonString(output, *i->name);
+        appendJsonLabels(output, *i->labels);
+        output += ",\"value\":";
+        appendInteger(output, i->value);
+        output += '}';
+    }
+
+    output += "],\"histograms\":[";
+    for (std::vector<StatDocument::Histogram>::const_iterator i = document.histograms.begin();
+         i != document.histograms.end();
+         ++i)
+    {
+        if (i != document.histograms.begin())
+        {
+            output += ',';
+        }
+        output += "{\"name\":";
+        appendJsonString(output, *i->name);
+        appendJsonLabels(output, *i->labels);
+        if (!i->suffix->empty())
+        {
+            output += ",\"unit\":";
+            appendJsonString(output, i->suffix->substr(1u));
+        }
+        appendJsonMember(output, "count", i->count);
+        appendJsonMember(output, "sum", i->sum);
+        appendJsonMember(output, "max", i->max);
+        for (std::size_t j = 0u; j < StatDocument::PERCENTILES; ++j)
+        {
+            appendJsonMember(output, s_percentileNames[j] + 1, i->percentiles[j]);
+        }
+        output += '}';
+    }
+
+    output += "],\"rates\":[";
+    for (std::vector<StatDocument::Rate>::const_iterator i = document.rates.begin(); i != document.rates.end(); ++i)
+    {
+        if (i != document.rates.begin())
+        {
+            output += ',';
+        }
+        output += "{\"name\":";
+        appendJsonString(output, *i->name);
+        appendJsonLabels(output, *i->labels);
+        output += ",\"kind\":\"";
+        output += s_rateKinds[i->kind];
+        output += "\",\"value\":";
+        appendInteger(output, i->value);
+        output += ",\"windows\":{";
+        for (std::size_t j = 0u; j < StatRate::WINDOWS; ++j)
+        {
+            if (j != 0u)
+            {
+                output += ',';
+            }
+            output += '"';
+            appendWindow(output, j);
+            output += "\":";
+            appendDouble(output, i->rates[j]);
+        }
+        output += "}}";
+    }
+
+    output += "],\"groups\":{";
+    for (std::vector<StatDocument::Group>::const_iterator i = document.groups.begin(); i != document.groups.end(); ++i)
+    {
+        if (i != document.groups.begin())
+        {
+            output += ',';
+        }
+        appendJsonString(output, i->name);
+        output += ":{";
+        for (IStat::Parameters::const_iterator j = i->parameters.begin(); j != i->parameters.end(); ++j)
+        {
+            if (j != i->parameters.begin())
+            {
+                output += ',';
+            }
+            appendJsonString(output, j->first);
+            output += ':';
+            if (isNumber(j->second))
+            {
+                output += j->second;
+            }
+            else
+            {
+                appendJsonString(output, j->second);
+            }
+        }
+        output += '}';
+    }
+    output += "}}";
+}
+
+//--------------------------------------------------------------------------------------------------
+void StatDocument::addHistogram(const std::string &name,
+                                const IStat::Labels &labels,
+                                const std::string &suffix,
+                                const StatHistogram &histogram)
+{
+    StatHistogramSnapshot snapshot(histogram.getPrecision());
+    snapshot.add(histogram);
+
+    Histogram value;
+    value.name = &name;
+    value.labels = &labels;
+    value.suffix = &suffix;
+    value.count = snapshot.getCount();
+    value.sum = snapshot.getSum();
+    value.max = snapshot.getMax();
+    for (std::size_t i = 0u; i < PERCENTILES; ++i)
+    {
+        value.percentiles[i] = snapshot.getPercentile(s_percentiles[i]);
+    }
+    histograms.push_back(value);
+}
+
+//--------------------------------------------------------------------------------------------------
+void StatDocument::addRate(const std::string &name, const IStat::Labels &labels, const StatRate &rate)
+{
+    Rate value;
+    value.name = &name;
+    value.labels = &labels;
+    value.kind = rate.getKind();
+    value.value = rate.get();
+    for (std::size_t i = 0u; i < StatRate::WINDOWS; ++i)
+    {
+        value.rates[i] = rate.getRate(i);
+    }
+    rates.push_back(value);
+}
+
+//--------------------------------------------------------------------------------------------------
+void writeStatDocument(const StatDocument &document, StatFormat format, std::string &output)
+{
+    switch (format)
+    {
+    case SF_XML:
+        writeXml(document, output);
+        break;
+    case SF_PROMETHEUS:
+        writePrometheus(document, false, output);
+        break;
+    case SF_OPENMETRICS:
+        writePrometheus(document, true, output);
+        break;
+    case SF_JSON:
+        writeJson(document, output);
+        break;
+    default:
+        throw std::invalid_argument("Unknown stat format");
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+const char *getStatContentType(StatFormat format)
+{
+    return s_contentTypes[format < SF_COUNT ? format : SF_XML];
+}
+
+//--------------------------------------------------------------------------------------------------
+bool parseStatFormat(const std::string &name, StatFormat &format)
+{
+    for (std::size_t i = 0u; i < SF_COUNT; ++i)
+    {
+        if (name == s_formatNames[i])
+        {
+            format = static_cast<StatFormat>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+//--------------------------------------------------------------------------------------------------
+StatFormat negotiateStatFormat(const std::string &accept)
+{
+    // Prometheus asks for OpenMetrics first and for the text format as a fallback
+    if (accept.find("application/openmetrics-text") != std::string::npos)
+    {
+        return SF_OPENMETRICS;
+    }
+    if (accept.find("text/plain") != std::string::npos)
+    {
+        return SF_PROMETHEUS;
+    }
+    if (accept.find("application/json") != std::string::npos)
+    {
+        return SF_JSON;
+    }
+    return SF_XML;
+}
+
+} /* namespace WebServer */
+} /* namespace Tools */
@@ -0,0 +1,924 @@
+// C++
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+// BOOST
+#include <boost/algorithm/string.hpp>
+#include <boost/asio/placeholders.hpp>
+#include <boost/bind.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/locks.hpp>
+
+// PION
+#include <pion/http/response_writer.hpp>
+
+#include "Tools/CompressUtils/Compress.h"
+#include "Tools/WebServer/DirectoryWatcher.h"
+#include "Tools/WebServer/Errors.h"
+#include "Tools/WebServer/Histogram.h"
+#include "Tools/WebServer/StaticFileService.h"
+
+#ifdef _WIN32
+#include <boost/asio/windows/overlapped_ptr.hpp>
+#include <windows.h>
+#include <mswsock.h>
+#pragma comment(lib, "mswsock.lib")
+#elif defined(__linux__)
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+#endif
+
+namespace Tools
+{
+namespace WebServer
+{
+
+namespace
+{
+
+#if defined(_WIN32) && defined(BOOST_ASIO_HAS_WINDOWS_OVERLAPPED_PTR)
+#define STATICFILES_TRANSMITFILE
+#elif defined(__linux__)
+#define STATICFILES_SENDFILE
+#endif
+
+// Streams a file after the headers: plain connections get it by TransmitFile or sendfile
+// straight from the file cache, otherwise it is read by chunks on the reader threads
+// and written from the buffer, one chunk at a time
+class FileSender : public boost::enable_shared_from_this<FileSender>, boost::noncopyable
+{
+public:
+    FileSender(ConnectionContextPtr contextPtr,
+               const boost::filesystem::path &path,
+               boost::uintmax_t size,
+               std::size_t chunkSize,
+               boost::asio::io_service &readerService) :
+            m_contextPtr(contextPtr),
+            m_path(path),
+            m_remaining(size),
+            m_offset(0u),
+            m_chunkSize(chunkSize),
+            m_readerService(readerService),
+            m_isZeroCopy(false),
+#ifdef STATICFILES_TRANSMITFILE
+            m_fileHandle(INVALID_HANDLE_VALUE)
+#else
+            m_fileDescriptor(-1)
+#endif
+    {
+    }
+
+    ~FileSender()
+    {
+#ifdef STATICFILES_TRANSMITFILE
+        if (m_fileHandle != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(m_fileHandle);
+        }
+#elif defined(STATICFILES_SENDFILE)
+        if (m_fileDescriptor >= 0)
+        {
+            ::close(m_fileDescriptor);
+        }
+#endif
+    }
+
+    bool open()
+    {
+        // the data must pass through the TLS stream
+        m_isZeroCopy = !m_contextPtr->getTcpConn()->get_ssl_flag();
+#ifdef STATICFILES_TRANSMITFILE
+        if (m_isZeroCopy)
+        {
+            m_fileHandle = CreateFileW(m_path.wstring().c_str(),
+                                       GENERIC_READ,
+                                       FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                       NULL,
+                                       OPEN_EXISTING,
+                                       FILE_FLAG_SEQUENTIAL_SCAN,
+                                       NULL);
+            return m_fileHandle != INVALID_HANDLE_VALUE;
+        }
+#elif defined(STATICFILES_SENDFILE)
+        if (m_isZeroCopy)
+        {
+            m_fileDescriptor = ::open(m_path.string().c_str(), O_RDONLY | O_CLOEXEC);
+            return m_fileDescriptor >= 0;
+        }
+#else
+        m_isZeroCopy = false;
+#endif
+
+        m_file.open(m_path.string().c_str(), std::ios::in | std::ios::binary);
+        m_buffer.resize(m_chunkSize);
+        return m_file.is_open();
+    }
+
+    bool isZeroCopy() const
+    {
+        return m_isZeroCopy;
+    }
+
+    // called on a worker, the first chunk is read right here
+    void start(pion::http::response_ptr responsePtr)
+    {
+        m_writer = m_contextPtr->createResponseWriter(responsePtr);
+        if (m_isZeroCopy)
+        {
+            // only the headers, Content-Length is set by the caller
+            m_writer->send(boost::bind(&FileSender::onHeadersSent,
+                                       shared_from_this(),
+                                       boost::asio::placeholders::error));
+            return;
+        }
+        sendNextChunk();
+    }
+
+private:
+    void sendNextChunk()
+    {
+        const std::size_t length = static_cast<std::size_t>(
+                std::min<boost::uintmax_t>(m_remaining, m_buffer.size()));
+        if (!m_file.read(&m_buffer[0], length))
+        {
+            // the file was truncated under us, the client sees a short body
+            abort();
+            return;
+        }
+        m_remaining -= length;
+
+        m_writer->clear();
+        m_writer->write_no_copy(&m_buffer[0], length);
+        if (m_remaining == 0u)
+        {
+            m_writer->send();
+            m_contextPtr.reset();
+            return;
+        }
+        m_writer->send(boost::bind(&FileSender::onChunkSent,
+                                   shared_from_this(),
+                                   boost::asio::placeholders::error));
+    }
+
+    // called on the I/O thread, the disk is read by the reader threads
+    void onChunkSent(const boost::system::error_code &error)
+    {
+        if (error)
+        {
+            abort();
+            return;
+        }
+        m_readerService.post(boost::bind(&FileSender::sendNextChunk, shared_from_this()));
+    }
+
+    void onHeadersSent(const boost::system::error_code &error)
+    {
+        if (error)
+        {
+            abort();
+            return;
+        }
+        sendFileData();
+    }
+
+#ifdef STATICFILES_TRANSMITFILE
+    void sendFileData()
+    {
+        // TransmitFile sends less than 2 GB at once
+        static const boost::uintmax_t maxLength = 1024u * 1024u * 1024u;
+
+        pion::tcp::connection::socket_type &socket = m_writer->get_connection()->get_socket();
+        boost::asio::windows::overlapped_ptr overlapped(m_writer->get_connection()->get_io_service(),
+                boost::bind(&FileSender::onFileDataSent,
+                            shared_from_this(),
+                            boost::asio::placeholders::error,
+                            boost::asio::placeholders::bytes_transferred));
+        overlapped.get()->Offset = static_cast<DWORD>(m_offset & 0xFFFFFFFFu);
+        overlapped.get()->OffsetHigh = static_cast<DWORD>(m_offset >> 32);
+
+        const DWORD length = static_cast<DWORD>(std::min(m_remaining, maxLength));
+        if (!TransmitFile(socket.native_handle(), m_fileHandle, length, 0, overlapped.get(), NULL, 0))
+        {
+            const DWORD lastError = GetLastError();
+            if (lastError != ERROR_IO_PENDING)
+            {
+                overlapped.complete(boost::system::error_code(lastError, boost::asio::error::get_system_category()), 0);
+                return;
+            }
+        }
+        overlapped.release();
+    }
+
+    void onFileDataSent(const boost::system::error_code &error, std::size_t transferred)
+    {
+        if (error || transferred == 0u)
+        {
+            abort();
+            return;
+        }
+        m_offset += transferred;
+        m_remaining -= std::min<boost::uintmax_t>(m_remaining, transferred);
+        if (m_remaining != 0u)
+        {
+            sendFileData();
+            return;
+        }
+        finish();
+    }
+#elif defined(STATICFILES_SENDFILE)
+    void sendFileData()
+    {
+        pion::tcp::connection::socket_type &socket = m_writer->get_connection()->get_socket();
+        boost::system::error_code error;
+        socket.native_non_blocking(true, error);
+        if (error)
+        {
+            abort();
+            return;
+        }
+
+        while (m_remaining != 0u)
+        {
+            off_t offset = static_cast<off_t>(m_offset);
+            const ssize_t sent = ::sendfile(socket.native_handle(),
+                                            m_fileDescriptor,
+                                            &offset,
+                                            static_cast<std::size_t>(std::min<boost::uintmax_t>(m_remaining, m_chunkSize)));
+            if (sent > 0)
+            {
+                m_offset += static_cast<boost::uintmax_t>(sent);
+                m_remaining -= static_cast<boost::uintmax_t>(sent);
+                continue;
+            }
+            if (sent < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                // the socket buffer is full, go on when it can be written again
+                socket.async_write_some(boost::asio::null_buffers(),
+                                        boost::bind(&FileSender::onFileDataSent,
+                                                    shared_from_this(),
+                                                    boost::asio::placeholders::error));
+                return;
+            }
+            // 0 when the file was truncated under us
+            abort();
+            return;
+        }
+
+        socket.native_non_blocking(false, error);
+        finish();
+    }
+
+    void onFileDataSent(const boost::system::error_code &error)
+    {
+        if (error)
+        {
+            abort();
+            return;
+        }
+        sendFileData();
+    }
+#else
+    void sendFileData()
+    {
+        abort();
+    }
+#endif
+
+    void finish()
+    {
+        m_writer->get_connection()->finish();
+        m_contextPtr.reset();
+    }
+
+    void abort()
+    {
+        pion::tcp::connection_ptr tcpConnPtr = m_writer->get_connection();
+        tcpConnPtr->set_lifecycle(pion::tcp::connection::LIFECYCLE_CLOSE);
+        tcpConnPtr->finish();
+        m_contextPtr.reset();
+    }
+
+    // keeps the request active until the whole file is sent
+    ConnectionContextPtr m_contextPtr;
+    pion::http::response_writer_ptr m_writer;
+    boost::filesystem::path m_path;
+    boost::uintmax_t m_remaining;
+    boost::uintmax_t m_offset;
+    std::size_t m_chunkSize;
+    boost::asio::io_service &m_readerService;
+    bool m_isZeroCopy;
+#ifdef STATICFILES_TRANSMITFILE
+    HANDLE m_fileHandle;
+#else
+    int m_fileDescriptor;
+#endif
+    std::ifstream m_file;
+    std::vector<char> m_buffer;
+};
+
+} /* namespace */
+
+//--------------------------------------------------------------------------------------------------
+StaticFileService::Settings::Settings() :
+        indexFile("index.html"),
+        maxCachedFileSize(256u * 1024u),
+        maxCacheSize(16u * 1024u * 1024u),
+        chunkSize(64u * 1024u),
+        readerThreads(2u),
+        checkInterval(boost::posix_time::seconds(1))
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+StaticFileService::StaticFileService(const std::string &resource, const Settings &settings) :
+        m_resource(resource),
+        m_settings(settings),
+        m_cacheSize(0u),
+        m_changes(0u),
+        m_cacheHits(0u),
+        m_cacheMisses(0u),
+        m_notModified(0u),
+        m_streamed(0u),
+        m_zeroCopy(0u)
+{
+    if (m_settings.directory.empty())
+    {
+        throw WebServerError("Static file service directory is not set");
+    }
+    if (m_settings.chunkSize == 0u)
+    {
+        throw WebServerError("Static file service chunk size must be positive");
+    }
+    if (m_settings.readerThreads == 0u)
+    {
+        throw WebServerError("Static file service needs at least one reader thread");
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+StaticFileService::~StaticFileService()
+{
+    stop();
+}
+
+//--------------------------------------------------------------------------------------------------
+void StaticFileService::start()
+{
+    if (m_readerWorkPtr)
+    {
+        return;
+    }
+
+    m_readerWorkPtr.reset(new boost::asio::io_service::work(m_readerService));
+    for (std::size_t i = 0u; i < m_settings.readerThreads; ++i)
+    {
+        m_readerThreads.create_thread(boost::bind(&boost::asio::io_service::run, &m_readerService));
+    }
+
+    // without the notifications the cached files are compared with the disk every checkInterval
+    m_watcherPtr.reset(new DirectoryWatcher(m_settings.directory,
+                                            boost::bind(&StaticFileService::clearCache, this)));
+    if (!m_watcherPtr->start())
+    {
+        m_watcherPtr.reset();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+void StaticFileService::stop()
+{
+    if (m_watcherPtr)
+    {
+        m_watcherPtr->stop();
+        m_watcherPtr.reset();
+    }
+
+    if (m_readerWorkPtr)
+    {
+        // the chunks already queued are still read
+        m_readerWorkPtr.reset();
+        m_readerThreads.join_all();
+        m_readerService.reset();
+    }
+
+    clearCache();
+}
+
+//--------------------------------------------------------------------------------------------------
+void StaticFileService::clearCache()
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    m_changes.fetch_add(1u, boost::memory_order_relaxed);
+    m_cacheIndex.clear();
+    m_cachedFiles.clear();
+    m_cacheSize = 0u;
+}
+
+//--------------------------------------------------------------------------------------------------
+void StaticFileService::operator()(ConnectionContextPtr contextPtr)
+{
+    const pion::http::request &request = *contextPtr->getRequest();
+    if (request.get_method() != pion::http::types::REQUEST_METHOD_GET
+            && request.get_method() != pion::http::types::REQUEST_METHOD_HEAD)
+    {
+        pion::http::response_ptr responsePtr = createResponse(request,
+                pion::http::types::RESPONSE_CODE_METHOD_NOT_ALLOWED,
+                pion::http::types::RESPONSE_MESSAGE_METHOD_NOT_ALLOWED);
+        responsePtr->add_header("Allow", "GET, HEAD");
+        contextPtr->sendResponse(responsePtr);
+        return;
+    }
+
+    boost::filesystem::path path;
+    if (!getFilePath(request.get_resource(), path))
+    {
+        contextPtr->sendResponse(createResponse(request,
+                                                pion::http::types::RESPONSE_CODE_NOT_FOUND,
+                                                pion::http::types::RESPONSE_MESSAGE_NOT_FOUND));
+        return;
+    }
+
+    CachedFilePtr filePtr = findCached(path);
+    if (filePtr)
+    {
+        m_cacheHits.fetch_add(1u, boost::memory_order_relaxed);
+        sendCached(contextPtr, filePtr);
+        return;
+    }
+    m_cacheMisses.fetch_add(1u, boost::memory_order_relaxed);
+
+    // a change reported while the file is loaded keeps it out of the cache
+    const boost::uint64_t changes = m_changes.load(boost::memory_order_relaxed);
+    FileInfo info;
+    if (!getFileInfo(path, info))
+    {
+        contextPtr->sendResponse(createResponse(request,
+                                                pion::http::types::RESPONSE_CODE_NOT_FOUND,
+                                                pion::http::types::RESPONSE_MESSAGE_NOT_FOUND));
+        return;
+    }
+
+    if (info.size <= m_settings.maxCachedFileSize)
+    {
+        filePtr = loadCached(info, changes);
+        if (filePtr)
+        {
+            sendCached(contextPtr, filePtr);
+            return;
+        }
+    }
+    sendFile(contextPtr, info);
+}
+
+//--------------------------------------------------------------------------------------------------
+void StaticFileService::getStatistics(IStat::Parameters &parameters) const
+{
+    std::size_t files = 0u;
+    std::size_t size = 0u;
+    {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        files = m_cacheIndex.size();
+        size = m_cacheSize;
+    }
+
+    parameters.push_back(IStat::Parameter("cached_files", boost::lexical_cast<std::string>(files)));
+    parameters.push_back(IStat::Parameter("cache_size", boost::lexical_cast<std::string>(size)));
+    parameters.push_back(IStat::Parameter("cache_hits",
+            boost::lexical_cast<std::string>(m_cacheHits.load(boost::memory_order_relaxed))));
+    parameters.push_back(IStat::Parameter("cache_misses",
+            boost::lexical_cast<std::string>(m_cacheMisses.load(boost::memory_order_relaxed))));
+    parameters.push_back(IStat::Parameter("not_modified",
+            boost::lexical_cast<std::string>(m_notModified.load(boost::memory_order_relaxed))));
+    parameters.push_back(IStat::Parameter("streamed",
+            boost::lexical_cast<std::string>(m_streamed.load(boost::memory_order_relaxed))));
+    parameters.push_back(IStat::Parameter("zero_copy",
+            boost::lexical_cast<std::string>(m_zeroCopy.load(boost::memory_order_relaxed))));
+    parameters.push_back(IStat::Parameter("watched",
+            (m_watcherPtr && m_watcherPtr->isWatching()) ? "1" : "0"));
+}
+
+//--------------------------------------------------------------------------------------------------
+bool StaticFileService::getFilePath(const std::string &resource, boost::filesystem::path &path) const
+{
+    if (resource.compare(0u, m_resource.size(), m_resource) != 0)
+    {
+        return false;
+    }
+
+    std::vector<std::string> elements;
+    boost::algorithm::split(elements, resource.substr(m_resource.size()), boost::algorithm::is_any_of("/"));
+
+    path = m_settings.directory;
+    for (std::vector<std::string>::const_iterator i = elements.begin(); i != elements.end(); ++i)
+    {
+        if (i->empty() || *i == ".")
+        {
+            continue;
+        }
+        // never leave the directory
+        if (*i == ".." || i->find_first_of("\\:") != std::string::npos)
+        {
+            return false;
+        }
+        path /= *i;
+    }
+
+    boost::system::error_code error;
+    if (boost::filesystem::is_directory(path, error))
+    {
+        path /= m_settings.indexFile;
+    }
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+bool StaticFileService::getFileInfo(const boost::filesystem::path &path, FileInfo &info) const
+{
+    boost::system::error_code error;
+    if (!boost::filesystem::is_regular_file(path, error))
+    {
+        return false;
+    }
+
+    info.path = path;
+    info.size = boost::filesystem::file_size(path, error);
+    if (error)
+    {
+        return false;
+    }
+    info.modified = boost::filesystem::last_write_time(path, error);
+    if (error)
+    {
+        return false;
+    }
+
+    std::ostringstream etag;
+    etag << '"' << std::hex << info.size << '-' << info.modified << '"';
+    info.etag = etag.str();
+    info.lastModified = pion::http::types::get_date_string(info.modified);
+    info.contentType = getContentType(path);
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+StaticFileService::CachedFilePtr StaticFileService::findCached(const boost::filesystem::path &path)
+{
+    CachedFilePtr filePtr;
+    {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        CacheIndex::iterator i = m_cacheIndex.find(path.string());
+        if (i == m_cacheIndex.end())
+        {
+            return filePtr;
+        }
+        m_cachedFiles.splice(m_cachedFiles.begin(), m_cachedFiles, i->second);
+        filePtr = *i->second;
+    }
+
+    if (m_watcherPtr && m_watcherPtr->isWatching())
+    {
+        // the whole cache is dropped when anything changes
+        return filePtr;
+    }
+
+    // the file may have changed on the disk since it was loaded
+    const boost::uint64_t now = getTimestampNs();
+    const boost::uint64_t checkIntervalNs = static_cast<boost::uint64_t>(
+            m_settings.checkInterval.total_microseconds()) * 1000u;
+    boost::uint64_t checked = filePtr->checked.load(boost::memory_order_relaxed);
+    if (now - checked >= checkIntervalNs
+            && filePtr->checked.compare_exchange_strong(checked, now, boost::memory_order_relaxed))
+    {
+        FileInfo info;
+        if (!getFileInfo(path, info) || info.size != filePtr->info.size || info.modified != filePtr->info.modified)
+        {
+            eraseCached(path);
+            return CachedFilePtr();
+        }
+    }
+    return filePtr;
+}
+
+//--------------------------------------------------------------------------------------------------
+StaticFileService::CachedFilePtr StaticFileService::loadCached(const FileInfo &info, boost::uint64_t changes)
+{
+    CachedFilePtr filePtr(new CachedFile());
+    filePtr->info = info;
+    filePtr->checked = getTimestampNs();
+
+    std::ifstream file(info.path.string().c_str(), std::ios::in | std::ios::binary);
+    if (!file.is_open())
+    {
+        return CachedFilePtr();
+    }
+    filePtr->content.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    if (filePtr->content.size() != info.size)
+    {
+        // changed while being read, it will be picked up by the next request
+        return CachedFilePtr();
+    }
+
+    if (isCompressible(info.contentType) && !filePtr->content.empty())
+    {
+        try
+        {
+            std::string gzipContent = Tools::CompressUtils::gzipStringCompress(filePtr->content);
+            if (gzipContent.size() < filePtr->content.size())
+            {
+                filePtr->gzipContent.swap(gzipContent);
+                filePtr->gzipEtag = info.etag.substr(0u, info.etag.size() - 1u) + "-gz\"";
+            }
+        }
+        catch (const std::exception &)
+        {
+        }
+    }
+
+    const std::size_t size = filePtr->content.size() + filePtr->gzipContent.size();
+    if (size > m_settings.maxCacheSize)
+    {
+        return filePtr;
+    }
+
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    if (m_changes.load(boost::memory_order_relaxed) != changes)
+    {
+        return filePtr;
+    }
+
+    const std::string key = info.path.string();
+    CacheIndex::iterator i = m_cacheIndex.find(key);
+    if (i != m_cacheIndex.end())
+    {
+        m_cacheSize -= (*i->second)->content.size() + (*i->second)->gzipContent.size();
+        m_cachedFiles.erase(i->second);
+        m_cacheIndex.erase(i);
+    }
+
+    while (m_cacheSize + size > m_settings.maxCacheSize && !m_cachedFiles.empty())
+    {
+        const CachedFilePtr &lastPtr = m_cachedFiles.back();
+        m_cacheSize -= lastPtr->content.size() + lastPtr->gzipContent.size();
+        m_cacheIndex.erase(lastPtr->info.path.string());
+        m_cachedFiles.pop_back();
+    }
+
+    m_cachedFiles.push_front(filePtr);
+    m_cacheIndex[key] = m_cachedFiles.begin();
+    m_cacheSize += size;
+    return filePtr;
+}
+
+//--------------------------------------------------------------------------------------------------
+void StaticFileService::eraseCached(const boost::filesystem::path &path)
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    CacheIndex::iterator i = m_cacheIndex.find(path.string());
+    if (i != m_cacheIndex.end())
+    {
+        m_cacheSize -= (*i->second)->content.size() + (*i->second)->gzipContent.size();
+        m_cachedFiles.erase(i->second);
+        m_cacheIndex.erase(i);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+void StaticFileService::sendCached(ConnectionContextPtr contextPtr, const CachedFilePtr &filePtr)
+{
+    const CachedFile &file = *filePtr;
+    const pion::http::request &request = *contextPtr->getRequest();
+    const bool hasGzip = !file.gzipContent.empty();
+    const bool isGzip = hasGzip
+            && request.get_header(pion::http::types::HEADER_ACCEPT_ENCODING).find("gzip") != std::string::npos;
+    const std::string &etag = isGzip ? file.gzipEtag : file.info.etag;
+
+    if (isNotModified(request, etag, file.info.lastModified))
+    {
+        m_notModified.fetch_add(1u, boost::memory_order_relaxed);
+        pion::http::response_ptr responsePtr = createResponse(request,
+                pion::http::types::RESPONSE_CODE_NOT_MODIFIED,
+                pion::http::types::RESPONSE_MESSAGE_NOT_MODIFIED);
+        addValidators(*responsePtr, etag, file.info.lastModified);
+        if (hasGzip)
+        {
+            responsePtr->add_header("Vary", pion::http::types::HEADER_ACCEPT_ENCODING);
+        }
+        contextPtr->sendResponse(responsePtr);
+        return;
+    }
+
+    pion::http::response_ptr responsePtr = createResponse(request,
+                                                          pion::http::types::RESPONSE_CODE_OK,
+                                                          pion::http::types::RESPONSE_MESSAGE_OK);
+    responsePtr->set_content_type(file.info.contentType);
+    addValidators(*responsePtr, etag, file.info.lastModified);
+
+    const std::string *contentPtr = &file.content;
+    if (hasGzip)
+    {
+        responsePtr->add_header("Vary", pion::http::types::HEADER_ACCEPT_ENCODING);
+    }
+    if (isGzip)
+    {
+        responsePtr->add_header(pion::http::types::HEADER_CONTENT_ENCODING, "gzip");
+        contentPtr = &file.gzipContent;
+    }
+
+    if (request.get_method() == pion::http::types::REQUEST_METHOD_HEAD)
+    {
+        responsePtr->set_do_not_send_content_length();
+        responsePtr->add_header(pion::http::types::HEADER_CONTENT_LENGTH,
+                                boost::lexical_cast<std::string>(contentPtr->size()));
+    }
+    else
+    {
+        // the body shares the content with the cache
+        ResponseBodyPtr bodyPtr(new ResponseBody());
+        bodyPtr->append(ResponseBody::Buffer(filePtr, contentPtr));
+        contextPtr->sendResponse(responsePtr, bodyPtr);
+        return;
+    }
+    contextPtr->sendResponse(responsePtr);
+}
+
+//--------------------------------------------------------------------------------------------------
+void StaticFileService::sendFile(ConnectionContextPtr contextPtr, const FileInfo &info)
+{
+    const pion::http::request &request = *contextPtr->getRequest();
+    if (isNotModified(request, info.etag, info.lastModified))
+    {
+        m_notModified.fetch_add(1u, boost::memory_order_relaxed);
+        pion::http::response_ptr responsePtr = createResponse(request,
+                pion::http::types::RESPONSE_CODE_NOT_MODIFIED,
+                pion::http::types::RESPONSE_MESSAGE_NOT_MODIFIED);
+        addValidators(*responsePtr, info.etag, info.lastModified);
+        contextPtr->sendResponse(responsePtr);
+        return;
+    }
+
+    pion::http::response_ptr responsePtr = createResponse(request,
+                                                          pion::http::types::RESPONSE_CODE_OK,
+                                                          pion::http::types::RESPONSE_MESSAGE_OK);
+    responsePtr->set_content_type(info.contentType);
+    addValidators(*responsePtr, info.etag, info.lastModified);
+    // the body goes out in several writes, so the length is set up front
+    responsePtr->set_do_not_send_content_length();
+    responsePtr->add_header(pion::http::types::HEADER_CONTENT_LENGTH, boost::lexical_cast<std::string>(info.size));
+
+    if (request.get_method() == pion::http::types::REQUEST_METHOD_HEAD || info.size == 0u)
+    {
+        contextPtr->sendResponse(responsePtr);
+        return;
+    }
+
+    boost::shared_ptr<FileSender> senderPtr(
+            new FileSender(contextPtr, info.path, info.size, m_settings.chunkSize, m_readerService));
+    if (!senderPtr->open())
+    {
+        contextPtr->sendResponse(createResponse(request,
+                                                pion::http::types::RESPONSE_CODE_NOT_FOUND,
+                                                pion::http::types::RESPONSE_MESSAGE_NOT_FOUND));
+        return;
+    }
+
+    m_streamed.fetch_add(1u, boost::memory_order_relaxed);
+    if (senderPtr->isZeroCopy())
+    {
+        m_zeroCopy.fetch_add(1u, boost::memory_order_relaxed);
+    }
+    senderPtr->start(responsePtr);
+}
+
+//--------------------------------------------------------------------------------------------------
+bool StaticFileService::isNotModified(const pion::http::request &request,
+                                      const std::string &etag,
+                                      const std::string &lastModified)
+{
+    const std::string &ifNoneMatch = request.get_header(pion::http::types::HEADER_IF_NONE_MATCH);
+    if (!ifNoneMatch.empty())
+    {
+        return matchesEntityTag(ifNoneMatch, etag);
+    }
+    return request.get_header(pion::http::types::HEADER_IF_MODIFIED_SINCE) == lastModified;
+}
+
+//--------------------------------------------------------------------------------------------------
+bool StaticFileService::matchesEntityTag(const std::string &tags, const std::string &etag)
+{
+    // "*" or a list of entity tags: "a", W/"b"; If-None-Match compares the weak ones as well
+    std::string::size_type pos = 0u;
+    while (pos < tags.size())
+    {
+        const char c = tags[pos];
+        if (c == ' ' || c == '\t' || c == ',')
+        {
+            ++pos;
+            continue;
+        }
+        if (c == '*')
+        {
+            return true;
+        }
+        if (tags.compare(pos, 2u, "W/") == 0)
+        {
+            pos += 2u;
+        }
+        if (pos >= tags.size() || tags[pos] != '"')
+        {
+            // malformed list
+            return false;
+        }
+
+        const std::string::size_type end = tags.find('"', pos + 1u);
+        if (end == std::string::npos)
+        {
+            return false;
+        }
+        if (tags.compare(pos, end + 1u - pos, etag) == 0)
+        {
+            return true;
+        }
+        pos = end + 1u;
+    }
+    return false;
+}
+
+//--------------------------------------------------------------------------------------------------
+pion::http::response_ptr StaticFileService::createResponse(const pion::http::request &request,
+                                                           unsigned statusCode,
+                                                           const std::string &statusMessage)
+{
+    pion::http::response_ptr responsePtr(new pion::http::response(request));
+    responsePtr->set_status_code(statusCode);
+    responsePtr->set_status_message(statusMessage);
+    return responsePtr;
+}
+
+//--------------------------------------------------------------------------------------------------
+void StaticFileService::addValidators(pion::http::response &response,
+                                      const std::string &etag,
+                                      const std::string &lastModified)
+{
+    response.add_header(pion::http::types::HEADER_ETAG, etag);
+    response.add_header(pion::http::types::HEADER_LAST_MODIFIED, lastModified);
+}
+
+//--------------------------------------------------------------------------------------------------
+std::string StaticFileService::getContentType(const boost::filesystem::path &path)
+{
+    static const char *contentTypes[][2] =
+    {
+        { ".html", "text/html;charset=utf-8" },
+        { ".htm", "text/html;charset=utf-8" },
+        { ".css", "text/css" },
+        { ".js", "application/javascript" },
+        { ".json", "application/json" },
+        { ".map", "application/json" },
+        { ".xml", "text/xml" },
+        { ".txt", "text/plain;charset=utf-8" },
+        { ".svg", "image/svg+xml" },
+        { ".png", "image/png" },
+        { ".jpg", "image/jpeg" },
+        { ".jpeg", "image/jpeg" },
+        { ".gif", "image/gif" },
+        { ".ico", "image/x-icon" },
+        { ".woff", "font/woff" },
+        { ".woff2", "font/woff2" },
+        { ".ttf", "font/ttf" }
+    };
+
+    const std::string extension = boost::algorithm::to_lower_copy(path.extension().string());
+    for (std::size_t i = 0u; i < sizeof(contentTypes) / sizeof(contentTypes[0]); ++i)
+    {
+        if (extension == contentTypes[i][0])
+        {
+            return contentTypes[i][1];
+        }
+    }
+    return "application/octet-stream";
+}
+
+//--------------------------------------------------------------------------------------------------
+bool StaticFileService::isCompressible(const std::string &contentType)
+{
+    return boost::algorithm::starts_with(contentType, "text/")
+            || boost::algorithm::starts_with(contentType, "application/javascript")
+            || boost::algorithm::starts_with(contentType, "application/json")
+            || boost::algorithm::starts_with(contentType, "image/svg+xml")
+            || boost::algorithm::starts_with(contentType, "font/ttf");
+}
+
+} /* namespace WebServer */
+} /* namespace Tools */
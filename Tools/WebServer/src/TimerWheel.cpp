@@ -0,0 +1,356 @@
+// BOOST
+#include <boost/asio/error.hpp>
+#include <boost/assert.hpp>
+#include <boost/bind.hpp>
+
+// THIS
+#include "Tools/WebServer/TimerWheel.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+static const boost::uint32_t nil = 0xffffffffu;
+
+//--------------------------------------------------------------------------------------------------
+TimerWheel::Node::Node() :
+        expires(0u),
+        generation(0u),
+        slot(nil),
+        prev(nil),
+        next(nil)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+TimerWheel::TimerWheel(IScheduler &executor, const boost::posix_time::time_duration &tick) :
+        m_executor(executor),
+        m_tickMicroseconds(tick.total_microseconds() > 0 ? tick.total_microseconds() : 1),
+        m_startTime(boost::posix_time::microsec_clock::universal_time()),
+        m_isRunning(false),
+        m_currentTick(0u),
+        m_timersCount(0u),
+        m_freeNodes(nil)
+{
+    for (std::size_t i = 0u; i < LEVELS * SLOTS; ++i)
+    {
+        m_slots[i] = nil;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+TimerWheel::~TimerWheel()
+{
+    stop();
+}
+
+//--------------------------------------------------------------------------------------------------
+void TimerWheel::start()
+{
+    if (!isRunning())
+    {
+        m_isRunning.store(true, boost::memory_order_release);
+        m_tickThreadPtr.reset(new boost::thread(boost::bind(&TimerWheel::tickRunner, this)));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+void TimerWheel::stop()
+{
+    if (isRunning())
+    {
+        {
+            boost::lock_guard<boost::mutex> lock(m_mutex);
+            m_isRunning.store(false, boost::memory_order_release);
+            m_condition.notify_all();
+        }
+        m_tickThreadPtr->join();
+        m_tickThreadPtr.reset();
+    }
+
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+bool TimerWheel::isRunning() const
+{
+    return m_isRunning.load(boost::memory_order_acquire);
+}
+
+//--------------------------------------------------------------------------------------------------
+std::size_t TimerWheel::getTimersCount() const
+{
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    return m_timersCount;
+}
+
+//--------------------------------------------------------------------------------------------------
+void TimerWheel::execute(SchedulerHandler handler, ExecutionLane lane)
+{
+    m_executor.execute(handler, lane);
+}
+
+//--------------------------------------------------------------------------------------------------
+TimerHandle TimerWheel::executeOnTimer(SchedulerTimerHandler handler,
+                                       const boost::posix_time::time_duration &timeDuration)
+{
+    const boost::int64_t duration = timeDuration.total_microseconds();
+    const boost::uint64_t ticks = duration > m_tickMicroseconds
+            ? static_cast<boost::uint64_t>((duration + m_tickMicroseconds - 1) / m_tickMicroseconds)
+            : 1u;
+
+    boost::lock_guard<boost::mutex> lock(m_mutex);
+    const boost::uint64_t now = getCurrentTick();
+    if (m_timersCount == 0u)
+    {
+        // the wheel is empty, skip the ticks passed while idle
+        m_currentTick = now;
+    }
+
+    const boost::uint32_t index = allocateNode();
+    Node &node = m_nodes[index];
+    node.handler.swap(handler);
+    node.expires = now + ticks;
+    link(index);
+
+    if (++m_timersCount == 1u)
+    {
+        m_condition.notify_one();
+    }
+    return TimerHandle(index, node.generation);
+}
+
+//--------------------------------------------------------------------------------------------------
+bool TimerWheel::cancelTimer(const TimerHandle &timerHandle)
+{
+    SchedulerTimerHandler handler;
+    {
+        boost::lock_guard<boost::mutex> lock(m_mutex);
+        if (!timerHandle.isValid() || timerHandle.getIndex() >= m_nodes.size())
+        {
+            return false;
+        }
+
+        Node &node = m_nodes[timerHandle.getIndex()];
+        if (node.generation != timerHandle.getGeneration() || node.slot == nil)
+        {
+            // already fired or cancelled
+            return false;
+        }
+
+        unlink(timerHandle.getIndex());
+        handler.swap(node.handler);
+        releaseNode(timerHandle.getIndex());
+        --m_timersCount;
+    }
+
+    m_executor.execute(boost::bind(handler, boost::system::error_code(boost::asio::error::operation_aborted)));
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+void TimerWheel::tickRunner()
+{
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    while (isRunning())
+    {
+        if (m_timersCount == 0u)
+        {
+            m_condition.wait(lock);
+            continue;
+        }
+
+        const boost::uint64_t now = getCurrentTick();
+        while (m_currentTick <= now && m_timersCount > 0u)
+        {
+            advance();
+        }
+
+        if (!m_expired.empty())
+        {
+            m_dispatching.swap(m_expired);
+            lock.unlock();
+
+            for (std::vector<SchedulerTimerHandler>::iterator i = m_dispatching.begin(); i != m_dispatching.end(); ++i)
+            {
+                m_executor.execute(boost::bind(*i, boost::system::error_code()));
+            }
+            m_dispatching.clear();
+
+            lock.lock();
+            continue;
+        }
+
+        if (m_timersCount > 0u)
+        {
+            const boost::posix_time::ptime nextTick = m_startTime
+                    + boost::posix_time::microseconds(static_cast<boost::int64_t>(m_currentTick) * m_tickMicroseconds);
+            m_condition.timed_wait(lock, nextTick);
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+boost::uint64_t TimerWheel::getCurrentTick() const
+{
+    const boost::int64_t elapsed = (boost::posix_time::microsec_clock::universal_time() - m_startTime)
+            .total_microseconds();
+    return elapsed > 0 ? static_cast<boost::uint64_t>(elapsed / m_tickMicroseconds) : 0u;
+}
+
+//--------------------------------------------------------------------------------------------------
+void TimerWheel::advance()
+{
+    const boost::uint32_t index = static_cast<boost::uint32_t>(m_currentTick & SLOT_MASK);
+    if (index == 0u)
+    {
+        // the first level wrapped, move the timers of the next round down
+        for (std::size_t level = 1u; level < LEVELS; ++level)
+        {
+            cascade(level);
+            if (((m_currentTick >> (SLOT_BITS * level)) & SLOT_MASK) != 0u)
+            {
+                break;
+            }
+        }
+    }
+
+    boost::uint32_t i = m_slots[index];
+    m_slots[index] = nil;
+    while (i != nil)
+    {
+        Node &node = m_nodes[i];
+        const boost::uint32_t next = node.next;
+
+        m_expired.push_back(SchedulerTimerHandler());
+        m_expired.back().swap(node.handler);
+        node.slot = nil;
+        releaseNode(i);
+        --m_timersCount;
+
+        i = next;
+    }
+
+    ++m_currentTick;
+}
+
+//--------------------------------------------------------------------------------------------------
+void TimerWheel::cascade(std::size_t level)
+{
+    const std::size_t slot = level * SLOTS + ((m_currentTick >> (SLOT_BITS * level)) & SLOT_MASK);
+
+    boost::uint32_t i = m_slots[slot];
+    m_slots[slot] = nil;
+    while (i != nil)
+    {
+        const boost::uint32_t next = m_nodes[i].next;
+        link(i);
+        i = next;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+void TimerWheel::link(boost::uint32_t index)
+{
+    Node &node = m_nodes[index];
+
+    boost::uint32_t slot = static_cast<boost::uint32_t>(m_currentTick & SLOT_MASK);
+    if (node.expires >= m_currentTick)
+    {
+        const boost::uint64_t maxDelta = (static_cast<boost::uint64_t>(1u) << (SLOT_BITS * LEVELS)) - 1u;
+        if (node.expires - m_currentTick > maxDelta)
+        {
+            node.expires = m_currentTick + maxDelta;
+        }
+
+        const boost::uint64_t delta = node.expires - m_currentTick;
+        std::size_t level = 0u;
+        while (level + 1u < LEVELS && delta >= (static_cast<boost::uint64_t>(1u) << (SLOT_BITS * (level + 1u))))
+        {
+            ++level;
+        }
+        slot = static_cast<boost::uint32_t>(level * SLOTS + ((node.expires >> (SLOT_BITS * level)) & SLOT_MASK));
+    }
+
+    node.slot = slot;
+    node.prev = nil;
+    node.next = m_slots[slot];
+    if (node.next != nil)
+    {
+        m_nodes[node.next].prev = index;
+    }
+    m_slots[slot] = index;
+}
+
+//--------------------------------------------------------------------------------------------------
+void TimerWheel::unlink(boost::uint32_t index)
+{
+    Node &node = m_nodes[index];
+    BOOST_ASSERT(node.slot != nil);
+
+    if (node.prev != nil)
+    {
+        m_nodes[node.prev].next = node.next;
+    }
+    else
+    {
+        m_slots[node.slot] = node.next;
+    }
+
+    if (node.next != nil)
+    {
+        m_nodes[node.next].prev = node.prev;
+    }
+    node.slot = nil;
+}
+
+//--------------------------------------------------------------------------------------------------
+boost::uint32_t TimerWheel::allocateNode()
+{
+    if (m_freeNodes == nil)
+    {
+        m_nodes.push_back(Node());
+        return static_cast<boost::uint32_t>(m_nodes.size() - 1u);
+    }
+
+    const boost::uint32_t index = m_freeNodes;
+    m_freeNodes = m_nodes[index].next;
+    return index;
+}
+
+//--------------------------------------------------------------------------------------------------
+void TimerWheel::releaseNode(boost::uint32_t index)
+{
+    Node &node = m_nodes[index];
+    // invalidates the handles given out for this node
+    ++node.generation;
+    node.prev = nil;
+    node.next = m_freeNodes;
+    m_freeNodes = index;
+}
+
+//--------------------------------------------------------------------------------------------------
+void TimerWheel::clear()
+{
+    for (std::size_t i = 0u; i < LEVELS * SLOTS; ++i)
+    {
+        boost::uint32_t index = m_slots[i];
+        m_slots[i] = nil;
+        while (index != nil)
+        {
+            Node &node = m_nodes[index];
+            const boost::uint32_t next = node.next;
+            node.handler.clear();
+            node.slot = nil;
+            releaseNode(index);
+            index = next;
+        }
+    }
+    m_timersCount = 0u;
+    m_expired.clear();
+}
+
+} /* namespace WebServer */
+} /* namespace Tools */
@@ -1,20 +1,37 @@
+// C++
+#include <algorithm>
+#include <vector>
+
 // BOOST
 #include <boost/assert.hpp>
 #include <boost/bind.hpp>
 #include <boost/date_time/posix_time/ptime.hpp>
 #include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/thread.hpp>
 
 // PION
 #include <pion/scheduler.hpp>
 
 #include "Tools/Logger/Logger.h"
+#include "Tools/WebServer/AdminService.h"
+#include "Tools/WebServer/Histogram.h"
 #include "Tools/WebServer/IWebService.h"
 #include "Tools/WebServer/PionWebServerCore.h"
+#include "Tools/WebServer/RequestArena.h"
 #include "Tools/WebServer/WebServer.h"
 #include "Tools/WebServer/Scheduler.h"
 #include "Tools/WebServer/ServiceHandler.h"
 #include "Tools/WebServer/StatService.h"
 #include "Tools/WebServer/ConfService.h"
+#include "Tools/WebServer/WorkStealingScheduler.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 namespace Tools
 {
@@ -27,52 +44,264 @@ class StatStub : public IStat
 public:
     virtual ~StatStub() {}
 
-    virtual void registerParameter(const std::string &) {}
+    virtual CounterHandle registerParameter(const std::string &) { return CounterHandle(); }
+    virtual CounterHandle registerParameter(const std::string &, const Labels &) { return CounterHandle(); }
     virtual void set(const std::string &, const long) {}
     virtual void increment(const std::string &, const long) {}
+    virtual HistogramHandle registerHistogram(const std::string &, unsigned) { return HistogramHandle(); }
+    virtual HistogramHandle registerTimer(const std::string &, unsigned) { return HistogramHandle(); }
+    virtual RateHandle registerRate(const std::string &) { return RateHandle(); }
+    virtual RateHandle registerEwma(const std::string &) { return RateHandle(); }
+    virtual HistogramHandle registerHistogram(const std::string &, const Labels &, unsigned) { return HistogramHandle(); }
+    virtual HistogramHandle registerTimer(const std::string &, const Labels &, unsigned) { return HistogramHandle(); }
+    virtual RateHandle registerRate(const std::string &, const Labels &) { return RateHandle(); }
+    virtual RateHandle registerEwma(const std::string &, const Labels &) { return RateHandle(); }
     virtual void registerParametersProvider(const std::string &name,
     		                                const ParametersProvider &parametersProvider){};
     virtual void unregisterParametersProvider(const std::string &name){};
 };
 
+namespace
+{
+
+// binds the calling thread to a processor
+void pinCurrentThread(std::size_t processor)
+{
+#ifdef _WIN32
+    SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1u) << processor);
+#elif defined(__linux__)
+    cpu_set_t processors;
+    CPU_ZERO(&processors);
+    CPU_SET(processor, &processors);
+    pthread_setaffinity_np(pthread_self(), sizeof(processors), &processors);
+#endif
+}
+
+// an additional thread of the shared io_service, runs until it is asked to stop
+void runIoThread(boost::asio::io_service &ioService, boost::shared_ptr<boost::atomic<bool> > stopPtr)
+{
+    while (!stopPtr->load(boost::memory_order_acquire))
+    {
+        boost::system::error_code ec;
+        if (ioService.run_one(ec) == 0u)
+        {
+            break;
+        }
+    }
+}
+
+void wakeUpIoThread()
+{
+}
+
+// reconfigurations kept for the stat
+const std::size_t MAX_RECONFIGURATIONS = 32u;
+
+}
+
 struct WebServer::WebServerImpl
 {
     WebServerImpl(const boost::asio::ip::tcp::endpoint &endpoint,
          std::size_t threadCount,
          std::size_t timeout,
-         std::size_t connectionLimit)
+         std::size_t connectionLimit,
+         std::size_t idleTimeout,
+         std::size_t acceptorCount,
+         bool isIoShardingEnabled):
+        m_acceptorCount(acceptorCount),
+        m_threadCount(threadCount)
     {
-        m_pionScheduler.set_num_threads(threadCount);
-        m_pionScheduler.add_active_user();
-        m_pionWebServerCorePtr.reset(new Detail::PionWebServerCore(m_pionScheduler,
+        if (m_acceptorCount > 1u)
+        {
+            // every acceptor gets an own io_service and thread
+            m_ioServiceCount = m_acceptorCount;
+        }
+        else if (isIoShardingEnabled)
+        {
+            // pion assigns new connections to the io_services by turns
+            m_ioServiceCount = threadCount;
+        }
+        else
+        {
+            m_ioServiceCount = 1u;
+        }
+
+        if (m_ioServiceCount > 1u)
+        {
+            m_pionSchedulerPtr.reset(new pion::one_to_one_scheduler());
+            m_pionSchedulerPtr->set_num_threads(m_ioServiceCount);
+        }
+        else
+        {
+            // the other threads are added by setIoThreadCount() and may be changed while running
+            m_pionSchedulerPtr.reset(new pion::single_service_scheduler());
+            m_pionSchedulerPtr->set_num_threads(1u);
+        }
+        m_pionSchedulerPtr->add_active_user();
+        m_pionWebServerCorePtr.reset(new Detail::PionWebServerCore(*m_pionSchedulerPtr,
                                                                    endpoint,
                                                                    timeout,
-                                                                   connectionLimit));
+                                                                   connectionLimit,
+                                                                   idleTimeout));
     }
     ~WebServerImpl()
     {
-        m_pionWebServerCorePtr->stop();
+        stop();
         m_pionWebServerCorePtr->join();
         m_pionWebServerCorePtr.reset();
 
-        m_pionScheduler.remove_active_user();
-        m_pionScheduler.shutdown();
-        m_pionScheduler.join();
+        {
+            boost::lock_guard<boost::mutex> lock(m_ioThreadsMutex);
+            for (std::vector<IoThread>::iterator i = m_ioThreads.begin(); i != m_ioThreads.end(); ++i)
+            {
+                i->stopPtr->store(true, boost::memory_order_release);
+            }
+            m_retiredIoThreads.insert(m_retiredIoThreads.end(), m_ioThreads.begin(), m_ioThreads.end());
+            m_ioThreads.clear();
+        }
+
+        m_pionSchedulerPtr->remove_active_user();
+        m_pionSchedulerPtr->shutdown();
+        m_pionSchedulerPtr->join();
+
+        // the stopped io_service releases the threads
+        for (std::vector<IoThread>::iterator i = m_retiredIoThreads.begin(); i != m_retiredIoThreads.end(); ++i)
+        {
+            i->threadPtr->join();
+        }
+    }
+
+    void start()
+    {
+        std::vector<boost::asio::io_service *> ioServices;
+        if (m_ioServiceCount > 1u)
+        {
+            // a thread of every io_service is pinned to its own processor
+            pion::one_to_one_scheduler &scheduler = static_cast<pion::one_to_one_scheduler &>(*m_pionSchedulerPtr);
+            const std::size_t processorCount = std::max(boost::thread::hardware_concurrency(), 1u);
+            for (std::size_t i = 0u; i < m_ioServiceCount; ++i)
+            {
+                boost::asio::io_service &ioService = scheduler.get_io_service(static_cast<boost::uint32_t>(i));
+                ioService.post(boost::bind(&pinCurrentThread, i % processorCount));
+                ioServices.push_back(&ioService);
+            }
+        }
+
+        if (m_acceptorCount > 1u)
+        {
+            m_pionWebServerCorePtr->startAcceptors(ioServices);
+        }
+        else
+        {
+            m_pionWebServerCorePtr->start();
+        }
+
+        if (m_ioServiceCount == 1u)
+        {
+            // the io_service has work only after the pion scheduler started
+            setIoThreadCount(m_threadCount);
+        }
     }
 
+    void setIoThreadCount(std::size_t threadCount)
+    {
+        if (m_ioServiceCount > 1u)
+        {
+            throw WebServerError("The http thread count can't be changed when every thread runs an own io_service");
+        }
+
+        boost::lock_guard<boost::mutex> lock(m_ioThreadsMutex);
+        boost::asio::io_service &ioService = m_pionSchedulerPtr->get_io_service();
+        threadCount = std::max<std::size_t>(threadCount, 1u);
+
+        // the threads retired by the previous changes which have ended by now
+        for (std::vector<IoThread>::iterator i = m_retiredIoThreads.begin(); i != m_retiredIoThreads.end();)
+        {
+            if (i->threadPtr->timed_join(boost::posix_time::time_duration()))
+            {
+                i = m_retiredIoThreads.erase(i);
+            }
+            else
+            {
+                ++i;
+            }
+        }
+
+        // one of them is run by the pion scheduler
+        while (m_ioThreads.size() + 1u < threadCount)
+        {
+            IoThread ioThread;
+            ioThread.stopPtr.reset(new boost::atomic<bool>(false));
+            ioThread.threadPtr.reset(new boost::thread(boost::bind(&runIoThread,
+                                                                   boost::ref(ioService),
+                                                                   ioThread.stopPtr)));
+            m_ioThreads.push_back(ioThread);
+        }
+        while (m_ioThreads.size() + 1u > threadCount)
+        {
+            // the thread ends after its current handler, it is joined by a later change or when the server stops
+            m_ioThreads.back().stopPtr->store(true, boost::memory_order_release);
+            ioService.post(&wakeUpIoThread);
+            m_retiredIoThreads.push_back(m_ioThreads.back());
+            m_ioThreads.pop_back();
+        }
+        m_threadCount = threadCount;
+    }
+
+    // open connections are closed at once unless waitForConnections is set
+    void stop(bool waitForConnections = true)
+    {
+        if (m_acceptorCount > 1u)
+        {
+            m_pionWebServerCorePtr->stopAcceptors();
+        }
+        else
+        {
+            m_pionWebServerCorePtr->stop(waitForConnections);
+        }
+    }
+
+    struct IoThread
+    {
+        boost::shared_ptr<boost::thread> threadPtr;
+        boost::shared_ptr<boost::atomic<bool> > stopPtr;
+    };
+
+    std::size_t m_acceptorCount;
+    std::size_t m_threadCount;
+    std::size_t m_ioServiceCount;
     Detail::PionWebServerCorePtr m_pionWebServerCorePtr;
-    pion::single_service_scheduler m_pionScheduler;
+    boost::scoped_ptr<pion::scheduler> m_pionSchedulerPtr;
+
+    // threads of the single io_service besides the one of the pion scheduler
+    boost::mutex m_ioThreadsMutex;
+    std::vector<IoThread> m_ioThreads;
+    std::vector<IoThread> m_retiredIoThreads;
 };
 
 //--------------------------------------------------------------------------------------------------
 WebServer::WebServer():
         m_activeRequestsCount(0),
+        m_isDraining(false),
+        m_drainDeadline(0u),
+        m_drainCutOff(0u),
         m_port(80u),
         m_httpThreadCount(8u),
         m_timeout(1u),
+        m_idleTimeout(1u),
         m_connectionLimit(100u),
+        m_drainTimeout(0u),
+        m_acceptorCount(1u),
+        m_ioShardingEnabled(false),
         m_workerThreadCount(16u),
+        m_minWorkerThreadCount(0u),
+        m_workSchedulerType(WST_ASIO),
+        m_lanePolicy(LP_WEIGHTED),
+        m_adaptiveLimitEnabled(false),
+        m_queueDelaySheddingEnabled(false),
+        m_responseCacheEnabled(false),
         m_isRunning(false),
+        m_reconfigurationCount(0u),
         m_enableStat(false),
         m_statPtr(new StatStub())
 {
@@ -85,13 +314,28 @@ WebServer::WebServer(const std::string &host,
                              const std::size_t timeout,
                              const std::size_t connectionLimit,
                              const std::size_t workerThreadCount):
+        m_activeRequestsCount(0),
+        m_isDraining(false),
+        m_drainDeadline(0u),
+        m_drainCutOff(0u),
         m_host(host),
         m_port(port),
         m_httpThreadCount(httpThreadCount),
         m_timeout(timeout),
+        m_idleTimeout(timeout),
         m_connectionLimit(connectionLimit),
+        m_drainTimeout(0u),
+        m_acceptorCount(1u),
+        m_ioShardingEnabled(false),
         m_workerThreadCount(workerThreadCount),
+        m_minWorkerThreadCount(0u),
+        m_workSchedulerType(WST_ASIO),
+        m_lanePolicy(LP_WEIGHTED),
+        m_adaptiveLimitEnabled(false),
+        m_queueDelaySheddingEnabled(false),
+        m_responseCacheEnabled(false),
         m_isRunning(false),
+        m_reconfigurationCount(0u),
         m_enableStat(false),
         m_statPtr(new StatStub())
 {
@@ -115,9 +359,68 @@ std::size_t WebServer::getConnectionLimit() const
 //--------------------------------------------------------------------------------------------------
 void WebServer::setConnectionLimit(std::size_t connectionLimit)
 {
+    boost::lock_guard<boost::mutex> lock(m_reconfigurationMutex);
+    if (isRunning())
+    {
+        if (connectionLimit == 0u)
+        {
+            throw WebServerError("The connection limit of the running server must be positive");
+        }
+        // existing connections are kept, the limit is reached by evicting idle ones
+        m_pImpl->m_pionWebServerCorePtr->setConnectionLimit(connectionLimit);
+        for (ServiceHandlers::iterator i = m_serviceHandlers.begin(); i != m_serviceHandlers.end(); ++i)
+        {
+            i->second->setMaxActiveRequests(static_cast<boost::int32_t>(connectionLimit));
+        }
+        recordReconfiguration("connectionlimit", m_connectionLimit, connectionLimit);
+    }
     m_connectionLimit = connectionLimit;
 }
 
+//--------------------------------------------------------------------------------------------------
+std::size_t WebServer::getDrainTimeout() const
+{
+    return m_drainTimeout;
+}
+
+//--------------------------------------------------------------------------------------------------
+void WebServer::setDrainTimeout(std::size_t drainTimeout)
+{
+    m_drainTimeout = drainTimeout;
+}
+
+//--------------------------------------------------------------------------------------------------
+std::size_t WebServer::getAcceptorCount() const
+{
+    return m_acceptorCount;
+}
+
+//--------------------------------------------------------------------------------------------------
+void WebServer::setAcceptorCount(std::size_t acceptorCount)
+{
+    if (isRunning())
+    {
+        throw WebServerError("Can't modify parameters on running server");
+    }
+    m_acceptorCount = acceptorCount;
+}
+
+//--------------------------------------------------------------------------------------------------
+bool WebServer::isIoShardingEnabled() const
+{
+    return m_ioShardingEnabled;
+}
+
+//--------------------------------------------------------------------------------------------------
+void WebServer::setIoShardingEnabled(bool enabled)
+{
+    if (isRunning())
+    {
+        throw WebServerError("Can't modify parameters on running server");
+    }
+    m_ioShardingEnabled = enabled;
+}
+
 //--------------------------------------------------------------------------------------------------
 const std::string &WebServer::getHost() const
 {
@@ -137,13 +440,13 @@ void WebServer::setHost(const std::string& host)
 //--------------------------------------------------------------------------------------------------
 bool WebServer::isRunning() const
 {
-    return m_isRunning;
+    return m_isRunning.load(boost::memory_order_acquire);
 }
 
 //--------------------------------------------------------------------------------------------------
 void WebServer::setRunning(bool isRunning)
 {
-    m_isRunning = isRunning;
+    m_isRunning.store(isRunning, boost::memory_order_release);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -171,9 +474,15 @@ std::size_t WebServer::getHttpThreadCount() const
 //--------------------------------------------------------------------------------------------------
 void WebServer::setHttpThreadCount(std::size_t threadCount)
 {
+    boost::lock_guard<boost::mutex> lock(m_reconfigurationMutex);
     if (isRunning())
     {
-        throw WebServerError("Can't modify parameters on running server");
+        if (threadCount == 0u)
+        {
+            throw WebServerError("The running server needs at least one http thread");
+        }
+        m_pImpl->setIoThreadCount(threadCount);
+        recordReconfiguration("httpthreads", m_httpThreadCount, threadCount);
     }
     m_httpThreadCount = threadCount;
 }
@@ -195,7 +504,25 @@ void WebServer::setTimeout(std::size_t timeout)
 }
 
 //--------------------------------------------------------------------------------------------------
-void WebServer::addService(const std::string &resource, IWebServicePtr servicePtr)
+std::size_t WebServer::getIdleTimeout() const
+{
+    return m_idleTimeout;
+}
+
+//--------------------------------------------------------------------------------------------------
+void WebServer::setIdleTimeout(std::size_t idleTimeout)
+{
+    if (isRunning())
+    {
+        throw WebServerError("Can't modify parameters on running server");
+    }
+    m_idleTimeout = idleTimeout;
+}
+
+//--------------------------------------------------------------------------------------------------
+void WebServer::addService(const std::string &resource,
+                           IWebServicePtr servicePtr,
+                           const ServiceOptions &options)
 {
     if (isRunning())
     {
@@ -207,7 +534,7 @@ void WebServer::addService(const std::string &resource, IWebServicePtr servicePt
         throw WebServerError("Resource \"" + resource + "\" already in use");
     }
 
-    m_services[resource] = servicePtr;
+    m_services[resource] = std::make_pair(servicePtr, options);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -243,23 +570,62 @@ void WebServer::start()
     BOOST_ASSERT(m_pImpl.get() == NULL);
 
     m_activeRequestsCount = 0;
+    m_isDraining = false;
+    m_drainDeadline = 0u;
 
     boost::asio::ip::tcp::endpoint serverEndpoint(boost::asio::ip::tcp::v4(), m_port);
     serverEndpoint.address(boost::asio::ip::address::from_string(m_host));
 
-    m_pImpl.reset(new WebServerImpl(serverEndpoint, getHttpThreadCount(), getTimeout(), getConnectionLimit()));
+    m_pImpl.reset(new WebServerImpl(serverEndpoint, getHttpThreadCount(), getTimeout(), getConnectionLimit(),
+                                     getIdleTimeout(), getAcceptorCount(), isIoShardingEnabled()));
     try
     {
-        m_workSchedulerPtr.reset(new Scheduler(getWorkerThreadCount(), getWorkerThreadCount()));
+        m_workSchedulerPtr = createWorkScheduler();
+        if (isQueueDelaySheddingEnabled())
+        {
+            m_queueDelayShedderPtr.reset(new QueueDelayShedder(getQueueDelaySheddingSettings()));
+        }
+        if (isResponseCacheEnabled())
+        {
+            m_responseCachePtr.reset(new ResponseCache(getResponseCacheSettings()));
+        }
 
         for (Services::iterator i = m_services.begin(); i != m_services.end(); ++i)
         {
-            ServiceHandlerPtr handlerPtr(new ServiceHandler(i->second,
+            // one family of every metric, the services differ by the label
+            const IStat::Labels serviceLabels(1u, std::make_pair(std::string("service"), i->first));
+
+            AdaptiveConcurrencyLimiterPtr limiterPtr;
+            if (isAdaptiveLimitEnabled() && i->second.second.adaptiveLimit)
+            {
+                limiterPtr.reset(new AdaptiveConcurrencyLimiter(getAdaptiveLimitSettings()));
+            }
+            QueueDelayShedderPtr shedderPtr;
+            if (i->second.second.queueDelayShedding)
+            {
+                shedderPtr = m_queueDelayShedderPtr;
+            }
+            ResponseCachePtr cachePtr;
+            if (i->second.second.cacheTtl > boost::posix_time::time_duration())
+            {
+                cachePtr = m_responseCachePtr;
+            }
+
+            ServiceHandlerPtr handlerPtr(new ServiceHandler(i->second.first,
+                i->second.second,
                 m_workSchedulerPtr,
                 m_statPtr,
                 ServiceHandler::ErrorHandler(boost::bind(&WebServer::onHandlerError, this, _1, _2, _3)),
+                m_statPtr->registerTimer("service_handler_time", serviceLabels, StatHistogram::DEFAULT_PRECISION),
+                m_statPtr->registerRate("service_requests", serviceLabels),
+                m_statPtr->registerRate("service_errors", serviceLabels),
                 getConnectionLimit(),
-                m_activeRequestsCount));
+                m_activeRequestsCount,
+                m_isDraining,
+                limiterPtr,
+                shedderPtr,
+                cachePtr));
+            m_serviceHandlers[getStatName(i->first)] = handlerPtr;
 
             pion::http::server::request_handler_t handler = boost::bind(&ServiceHandler::operator(), handlerPtr, _1, _2);
 
@@ -290,7 +656,7 @@ void WebServer::start()
 
         for (Services::iterator i = m_services.begin(); i != m_services.end(); ++i)
         {
-            i->second->start();
+            i->second.first->start();
         }
     }
     catch (...)
@@ -303,12 +669,40 @@ void WebServer::start()
                 i->second.first = nullptr;
             }
         }
+        m_serviceHandlers.clear();
+        m_queueDelayShedderPtr.reset();
+        m_responseCachePtr.reset();
         m_pImpl.reset();
         throw;
     }
 
     m_workSchedulerPtr->start();
-    m_pImpl->m_pionWebServerCorePtr->start();
+    if (m_statServicePtr)
+    {
+        m_statServicePtr->attachTimerScheduler(m_workSchedulerPtr);
+    }
+    m_statPtr->registerParametersProvider("workscheduler",
+                                          boost::bind(&IWorkScheduler::getStatistics, m_workSchedulerPtr, _1));
+    m_statPtr->registerParametersProvider("services",
+                                          boost::bind(&WebServer::getServicesStatistics, this, _1));
+    m_statPtr->registerParametersProvider("connections",
+                                          boost::bind(&Detail::PionWebServerCore::getStatistics,
+                                                      m_pImpl->m_pionWebServerCorePtr, _1));
+    m_statPtr->registerParametersProvider("requestmemory", &WebServer::getRequestMemoryStatistics);
+    m_statPtr->registerParametersProvider("drain", boost::bind(&WebServer::getDrainStatistics, this, _1));
+    m_statPtr->registerParametersProvider("reconfiguration",
+                                          boost::bind(&WebServer::getReconfigurationStatistics, this, _1));
+    if (m_queueDelayShedderPtr)
+    {
+        m_statPtr->registerParametersProvider("queuedelay",
+                                              boost::bind(&QueueDelayShedder::getStatistics, m_queueDelayShedderPtr, _1));
+    }
+    if (m_responseCachePtr)
+    {
+        m_statPtr->registerParametersProvider("responsecache",
+                                              boost::bind(&ResponseCache::getStatistics, m_responseCachePtr, _1));
+    }
+    m_pImpl->start();
     setRunning(true);
 }
 
@@ -321,23 +715,52 @@ void WebServer::addRedirect(const std::string &from, const std::string &to)
 //--------------------------------------------------------------------------------------------------
 void WebServer::stop()
 {
-    if (!isRunning())
     {
-        throw WebServerError("WebServer is not running");
+        // the reconfigurations in flight finish first, the later ones only change the settings;
+        // the lock is not held further, the workers which wait for it are joined below
+        boost::lock_guard<boost::mutex> lock(m_reconfigurationMutex);
+        if (!isRunning())
+        {
+            throw WebServerError("WebServer is not running");
+        }
+        setRunning(false);
+    }
+    // connections are closed when the requests could not finish in time
+    m_pImpl->stop(drain());
+    if (m_responseCachePtr)
+    {
+        m_statPtr->unregisterParametersProvider("responsecache");
+    }
+    if (m_queueDelayShedderPtr)
+    {
+        m_statPtr->unregisterParametersProvider("queuedelay");
+    }
+    m_statPtr->unregisterParametersProvider("reconfiguration");
+    m_statPtr->unregisterParametersProvider("drain");
+    m_statPtr->unregisterParametersProvider("requestmemory");
+    m_statPtr->unregisterParametersProvider("connections");
+    m_statPtr->unregisterParametersProvider("services");
+    m_statPtr->unregisterParametersProvider("workscheduler");
+    if (m_statServicePtr)
+    {
+        m_statServicePtr->detachTimerScheduler();
     }
-    m_pImpl->m_pionWebServerCorePtr->stop(true);
     m_workSchedulerPtr->stop();
 
     m_pImpl.reset();
+    m_serviceHandlers.clear();
+    m_queueDelayShedderPtr.reset();
+    m_responseCachePtr.reset();
 
     Services::iterator i = m_services.begin();
     for(; i != m_services.end(); ++i)
     {
-        i->second->stop();
+        i->second.first->stop();
     }
 
     m_activeRequestsCount = 0;
-    setRunning(false);
+    m_isDraining = false;
+    m_drainDeadline = 0u;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -354,7 +777,8 @@ IStatPtr WebServer::getStatService()
 void WebServer::enableStatService(const std::string &serviceName,
                                   const std::string &resource,
                                   const std::string &version,
-                                  const std::string &revision)
+                                  const std::string &revision,
+                                  const boost::posix_time::time_duration &snapshotInterval)
 {
     m_enableStat = true;
     m_statServiceName = serviceName;
@@ -363,9 +787,15 @@ void WebServer::enableStatService(const std::string &serviceName,
     boost::shared_ptr<StatService> statServicePtr(new StatService(serviceName,
                                                                   resource,
                                                                   version,
-                                                                  revision));
-    addService(resource, statServicePtr);
+                                                                  revision,
+                                                                  snapshotInterval));
+    // monitoring must stay reachable when the services are shedding load
+    ServiceOptions options(EL_BULK);
+    options.adaptiveLimit = false;
+    options.queueDelayShedding = false;
+    addService(resource, statServicePtr, options);
     m_statPtr = statServicePtr;
+    m_statServicePtr = statServicePtr;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -373,8 +803,20 @@ void WebServer::enableConfService(boost::function<std::pair<std::string,std::str
                        const std::string &resource)
 {
     boost::shared_ptr<ConfService> confServicePtr(new ConfService(confCallback));
-    this->addService(resource, confServicePtr);
+    ServiceOptions options(EL_BULK);
+    options.adaptiveLimit = false;
+    options.queueDelayShedding = false;
+    this->addService(resource, confServicePtr, options);
+}
 
+//--------------------------------------------------------------------------------------------------
+void WebServer::enableAdminService(const std::string &resource, bool isRemoteAllowed)
+{
+    boost::shared_ptr<AdminService> adminServicePtr(new AdminService(*this, isRemoteAllowed));
+    ServiceOptions options(EL_BULK);
+    options.adaptiveLimit = false;
+    options.queueDelayShedding = false;
+    addService(resource, adminServicePtr, options);
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -386,7 +828,340 @@ std::size_t WebServer::getWorkerThreadCount() const
 //--------------------------------------------------------------------------------------------------
 void WebServer::setWorkerThreadCount(std::size_t workerThreadCount)
 {
+    boost::lock_guard<boost::mutex> lock(m_reconfigurationMutex);
+    if (isRunning() && workerThreadCount == 0u)
+    {
+        throw WebServerError("The running server needs at least one worker thread");
+    }
+    const std::size_t previous = m_workerThreadCount;
     m_workerThreadCount = workerThreadCount;
+    if (isRunning())
+    {
+        if (!m_workSchedulerPtr->setThreadLimits(getMinWorkerThreadCount(), getWorkerThreadCount()))
+        {
+            m_workerThreadCount = previous;
+            throw WebServerError("The worker thread count of this work scheduler can't be changed while running");
+        }
+        recordReconfiguration("workerthreads", previous, workerThreadCount);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+std::size_t WebServer::getMinWorkerThreadCount() const
+{
+    if (m_minWorkerThreadCount == 0u || m_minWorkerThreadCount > m_workerThreadCount)
+    {
+        return m_workerThreadCount;
+    }
+    return m_minWorkerThreadCount;
+}
+
+//--------------------------------------------------------------------------------------------------
+std::size_t WebServer::getConfiguredMinWorkerThreadCount() const
+{
+    return m_minWorkerThreadCount;
+}
+
+//--------------------------------------------------------------------------------------------------
+void WebServer::setMinWorkerThreadCount(std::size_t minWorkerThreadCount)
+{
+    boost::lock_guard<boost::mutex> lock(m_reconfigurationMutex);
+    const std::size_t previous = m_minWorkerThreadCount;
+    m_minWorkerThreadCount = minWorkerThreadCount;
+    if (isRunning())
+    {
+        if (!m_workSchedulerPtr->setThreadLimits(getMinWorkerThreadCount(), getWorkerThreadCount()))
+        {
+            m_minWorkerThreadCount = previous;
+            throw WebServerError("The worker thread count of this work scheduler can't be changed while running");
+        }
+        recordReconfiguration("minworkerthreads", previous, minWorkerThreadCount);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+WebServer::WorkSchedulerType WebServer::getWorkSchedulerType() const
+{
+    return m_workSchedulerType;
+}
+
+//--------------------------------------------------------------------------------------------------
+void WebServer::setWorkSchedulerType(WorkSchedulerType workSchedulerType)
+{
+    if (isRunning())
+    {
+        throw WebServerError("Can't modify parameters on running server");
+    }
+    m_workSchedulerType = workSchedulerType;
+}
+
+//--------------------------------------------------------------------------------------------------
+LanePolicy WebServer::getLanePolicy() const
+{
+    return m_lanePolicy;
+}
+
+//--------------------------------------------------------------------------------------------------
+void WebServer::setLanePolicy(LanePolicy lanePolicy)
+{
+    if (isRunning())
+    {
+        throw WebServerError("Can't modify parameters on running server");
+    }
+    m_lanePolicy = lanePolicy;
+}
+
+//--------------------------------------------------------------------------------------------------
+bool WebServer::isAdaptiveLimitEnabled() const
+{
+    return m_adaptiveLimitEnabled;
+}
+
+//--------------------------------------------------------------------------------------------------
+void WebServer::setAdaptiveLimitEnabled(bool enabled)
+{
+    if (isRunning())
+    {
+        throw WebServerError("Can't modify parameters on running server");
+    }
+    m_adaptiveLimitEnabled = enabled;
+}
+
+//--------------------------------------------------------------------------------------------------
+const AdaptiveConcurrencyLimiter::Settings &WebServer::getAdaptiveLimitSettings() const
+{
+    return m_adaptiveLimitSettings;
+}
+
+//--------------------------------------------------------------------------------------------------
+void WebServer::setAdaptiveLimitSettings(const AdaptiveConcurrencyLimiter::Settings &settings)
+{
+    if (isRunning())
+    {
+        throw WebServerError("Can't modify parameters on running server");
+    }
+    m_adaptiveLimitSettings = settings;
+}
+
+//--------------------------------------------------------------------------------------------------
+bool WebServer::isQueueDelaySheddingEnabled() const
+{
+    return m_queueDelaySheddingEnabled;
+}
+
+//--------------------------------------------------------------------------------------------------
+void WebServer::setQueueDelaySheddingEnabled(bool enabled)
+{
+    if (isRunning())
+    {
+        throw WebServerError("Can't modify parameters on running server");
+    }
+    m_queueDelaySheddingEnabled = enabled;
+}
+
+//--------------------------------------------------------------------------------------------------
+const QueueDelayShedder::Settings &WebServer::getQueueDelaySheddingSettings() const
+{
+    return m_queueDelaySheddingSettings;
+}
+
+//--------------------------------------------------------------------------------------------------
+void WebServer::setQueueDelaySheddingSettings(const QueueDelayShedder::Settings &settings)
+{
+    if (isRunning())
+    {
+        throw WebServerError("Can't modify parameters on running server");
+    }
+    m_queueDelaySheddingSettings = settings;
+}
+
+//--------------------------------------------------------------------------------------------------
+bool WebServer::isResponseCacheEnabled() const
+{
+    return m_responseCacheEnabled;
+}
+
+//--------------------------------------------------------------------------------------------------
+void WebServer::setResponseCacheEnabled(bool enabled)
+{
+    if (isRunning())
+    {
+        throw WebServerError("Can't modify parameters on running server");
+    }
+    m_responseCacheEnabled = enabled;
+}
+
+//--------------------------------------------------------------------------------------------------
+const ResponseCache::Settings &WebServer::getResponseCacheSettings() const
+{
+    return m_responseCacheSettings;
+}
+
+//--------------------------------------------------------------------------------------------------
+void WebServer::setResponseCacheSettings(const ResponseCache::Settings &settings)
+{
+    if (isRunning())
+    {
+        throw WebServerError("Can't modify parameters on running server");
+    }
+    m_responseCacheSettings = settings;
+}
+
+//--------------------------------------------------------------------------------------------------
+IWorkSchedulerPtr WebServer::createWorkScheduler() const
+{
+    switch (getWorkSchedulerType())
+    {
+    case WST_ASIO:
+        return IWorkSchedulerPtr(new Scheduler(getMinWorkerThreadCount(),
+                                                         getWorkerThreadCount(),
+                                                         Scheduler::ResizePolicy(),
+                                                         getLanePolicy()));
+    case WST_WORK_STEALING:
+        return IWorkSchedulerPtr(new WorkStealingScheduler(getWorkerThreadCount(), getLanePolicy()));
+    }
+    throw WebServerError("Unknown work scheduler type");
+}
+
+//--------------------------------------------------------------------------------------------------
+void WebServer::getServicesStatistics(IStat::Parameters &parameters) const
+{
+    for (ServiceHandlers::const_iterator i = m_serviceHandlers.begin(); i != m_serviceHandlers.end(); ++i)
+    {
+        i->second->getStatistics(i->first, parameters);
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+void WebServer::getRequestMemoryStatistics(IStat::Parameters &parameters)
+{
+    RequestArena::getStatistics(parameters);
+    ConnectionContext::getPoolStatistics(parameters);
+}
+
+//--------------------------------------------------------------------------------------------------
+bool WebServer::drain()
+{
+    if (getDrainTimeout() == 0u)
+    {
+        return true;
+    }
+
+    Logger::Logger &logger = Logger::Logger::getInstance();
+    const boost::uint64_t second = 1000000000u;
+    boost::uint64_t now = getTimestampNs();
+    const boost::uint64_t deadline = now + getDrainTimeout() * second;
+    m_drainDeadline = deadline;
+    m_isDraining = true;
+    m_pImpl->m_pionWebServerCorePtr->beginDrain();
+
+    boost::int32_t activeRequests = m_activeRequestsCount.load(boost::memory_order_acquire);
+    logger.info() << "Draining WebServer: " << activeRequests << " active requests, timeout "
+                  << getDrainTimeout() << " s.";
+
+    boost::uint64_t nextReport = now + second;
+    while (activeRequests > 0 && now < deadline)
+    {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+        activeRequests = m_activeRequestsCount.load(boost::memory_order_acquire);
+        now = getTimestampNs();
+        if (now >= nextReport && activeRequests > 0)
+        {
+            logger.info() << "Draining WebServer: " << activeRequests << " active requests left.";
+            nextReport += second;
+        }
+    }
+
+    if (activeRequests > 0)
+    {
+        m_drainCutOff.fetch_add(static_cast<boost::uint64_t>(activeRequests), boost::memory_order_relaxed);
+        logger.warning() << "WebServer drain timeout passed, " << activeRequests << " active requests are cut off.";
+        return false;
+    }
+
+    logger.info("WebServer drained.");
+    return true;
+}
+
+//--------------------------------------------------------------------------------------------------
+void WebServer::getDrainStatistics(IStat::Parameters &parameters) const
+{
+    const bool isDraining = m_isDraining.load(boost::memory_order_acquire);
+    const boost::uint64_t deadline = m_drainDeadline.load(boost::memory_order_relaxed);
+    const boost::uint64_t now = getTimestampNs();
+
+    parameters.push_back(IStat::Parameter("draining", isDraining ? "1" : "0"));
+    parameters.push_back(IStat::Parameter("active_requests",
+            boost::lexical_cast<std::string>(m_activeRequestsCount.load(boost::memory_order_relaxed))));
+    parameters.push_back(IStat::Parameter("remaining_ms",
+            boost::lexical_cast<std::string>(isDraining && deadline > now ? (deadline - now) / 1000000u : 0u)));
+    parameters.push_back(IStat::Parameter("cut_off",
+            boost::lexical_cast<std::string>(m_drainCutOff.load(boost::memory_order_relaxed))));
+}
+
+//--------------------------------------------------------------------------------------------------
+void WebServer::recordReconfiguration(const std::string &parameter, std::size_t from, std::size_t to)
+{
+    Reconfiguration reconfiguration;
+    reconfiguration.time = boost::posix_time::microsec_clock::universal_time();
+    reconfiguration.parameter = parameter;
+    reconfiguration.from = from;
+    reconfiguration.to = to;
+
+    m_reconfigurations.push_front(reconfiguration);
+    if (m_reconfigurations.size() > MAX_RECONFIGURATIONS)
+    {
+        m_reconfigurations.pop_back();
+    }
+    ++m_reconfigurationCount;
+
+    Logger::Logger::getInstance().info() << "WebServer reconfigured: " << parameter << " " << from << " -> " << to << ".";
+}
+
+//--------------------------------------------------------------------------------------------------
+void WebServer::getReconfigurationStatistics(IStat::Parameters &parameters) const
+{
+    boost::lock_guard<boost::mutex> lock(m_reconfigurationMutex);
+    parameters.push_back(IStat::Parameter("http_threads", boost::lexical_cast<std::string>(getHttpThreadCount())));
+    parameters.push_back(IStat::Parameter("worker_threads", boost::lexical_cast<std::string>(getWorkerThreadCount())));
+    parameters.push_back(IStat::Parameter("min_worker_threads",
+                                          boost::lexical_cast<std::string>(getMinWorkerThreadCount())));
+    parameters.push_back(IStat::Parameter("connection_limit", boost::lexical_cast<std::string>(getConnectionLimit())));
+    parameters.push_back(IStat::Parameter("count", boost::lexical_cast<std::string>(m_reconfigurationCount)));
+
+    // event_1 is the latest one
+    std::size_t number = 1u;
+    for (Reconfigurations::const_iterator i = m_reconfigurations.begin(); i != m_reconfigurations.end(); ++i, ++number)
+    {
+        parameters.push_back(IStat::Parameter("event_" + boost::lexical_cast<std::string>(number),
+                boost::posix_time::to_iso_extended_string(i->time) + " " + i->parameter + " "
+                + boost::lexical_cast<std::string>(i->from) + " -> " + boost::lexical_cast<std::string>(i->to)));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+std::string WebServer::getStatName(const std::string &resource)
+{
+    // resources become parts of stat tag names
+    std::string name;
+    for (std::string::const_iterator i = resource.begin(); i != resource.end(); ++i)
+    {
+        const bool isAlnum = (*i >= 'a' && *i <= 'z') || (*i >= 'A' && *i <= 'Z') || (*i >= '0' && *i <= '9');
+        if (isAlnum)
+        {
+            name += *i;
+        }
+        else if (!name.empty() && name[name.size() - 1u] != '_')
+        {
+            name += '_';
+        }
+    }
+
+    if (!name.empty() && name[name.size() - 1u] == '_')
+    {
+        name.erase(name.size() - 1u);
+    }
+    return name.empty() ? std::string("root") : name;
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -394,10 +1169,9 @@ void WebServer::onHandlerError(pion::http::request_ptr requestPtr,
                                pion::tcp::connection_ptr tcpConnPtr,
                                const std::exception &e)
 {
+    // the service handler answers the request, so that draining waits for the response
     Logger::Logger &logger = Logger::Logger::getInstance();
     logger.error("Processing request \"" + requestPtr->get_query_string() + "\". Error: " + e.what());
-
-    pion::http::server::handle_server_error(requestPtr, tcpConnPtr, e.what());
 }
 
 //--------------------------------------------------------------------------------------------------
@@ -0,0 +1,274 @@
+// BOOST
+#include <boost/assert.hpp>
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/tss.hpp>
+
+// THIS
+#include "Tools/Logger/Logger.h"
+#include "Tools/WebServer/WorkStealingScheduler.h"
+
+namespace Tools
+{
+namespace WebServer
+{
+
+//--------------------------------------------------------------------------------------------------
+WorkStealingScheduler::WorkStealingScheduler(const std::size_t threads, LanePolicy lanePolicy) :
+                m_threadsCount(threads > 0u ? threads : 1u),
+                m_isRunning(false),
+                m_nextWorker(0u),
+                m_pendingHandlers(0u),
+                m_sleepingWorkers(0u),
+                m_stolenHandlers(0u),
+                m_currentWorker(&WorkStealingScheduler::deleteWorkerStub),
+                m_timerWheel(*this)
+{
+    for (std::size_t i = 0u; i < m_threadsCount; ++i)
+    {
+        m_workers.push_back(WorkerPtr(new Worker(i, lanePolicy, m_laneStatistics)));
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+WorkStealingScheduler::~WorkStealingScheduler()
+{
+    stop();
+}
+
+//--------------------------------------------------------------------------------------------------
+void WorkStealingScheduler::start()
+{
+    if (!isRunning())
+    {
+        setRunning(true);
+
+        for (Workers::iterator i = m_workers.begin(); i != m_workers.end(); ++i)
+        {
+            (*i)->setThreadPtr(boost::shared_ptr<boost::thread>(
+                    new boost::thread(boost::bind(&WorkStealingScheduler::workerRunner, this, i->get()))));
+        }
+        m_timerWheel.start();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+void WorkStealingScheduler::stop()
+{
+    if (isRunning())
+    {
+        setRunning(false);
+
+        m_timerWheel.stop();
+
+        {
+            boost::lock_guard<boost::mutex> lock(m_idleMutex);
+            m_idleCondition.notify_all();
+        }
+
+        for (Workers::iterator i = m_workers.begin(); i != m_workers.end(); ++i)
+        {
+            (*i)->getThreadPtr()->join();
+            (*i)->setThreadPtr(boost::shared_ptr<boost::thread>());
+            (*i)->clear();
+        }
+        m_pendingHandlers = 0u;
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+bool WorkStealingScheduler::isRunning() const
+{
+    return m_isRunning.load(boost::memory_order_acquire);
+}
+
+//--------------------------------------------------------------------------------------------------
+void WorkStealingScheduler::setRunning(bool running)
+{
+    m_isRunning.store(running, boost::memory_order_release);
+}
+
+//--------------------------------------------------------------------------------------------------
+void WorkStealingScheduler::getStatistics(IStat::Parameters &parameters) const
+{
+    parameters.push_back(IStat::Parameter("threads",
+                                          boost::lexical_cast<std::string>(m_threadsCount)));
+    parameters.push_back(IStat::Parameter("idle_threads",
+                                          boost::lexical_cast<std::string>(m_sleepingWorkers.load())));
+    parameters.push_back(IStat::Parameter("pending_requests",
+                                          boost::lexical_cast<std::string>(m_pendingHandlers.load())));
+    parameters.push_back(IStat::Parameter("stolen_handlers",
+                                          boost::lexical_cast<std::string>(m_stolenHandlers.load())));
+    parameters.push_back(IStat::Parameter("timers",
+                                          boost::lexical_cast<std::string>(m_timerWheel.getTimersCount())));
+    m_laneStatistics.getStatistics(parameters);
+}
+
+//--------------------------------------------------------------------------------------------------
+bool WorkStealingScheduler::setThreadLimits(std::size_t, std::size_t)
+{
+    // every worker owns a deque, their number is fixed
+    return false;
+}
+
+//--------------------------------------------------------------------------------------------------
+void WorkStealingScheduler::execute(SchedulerHandler handler, ExecutionLane lane)
+{
+    Worker *pWorker = getCurrentWorker();
+    if (pWorker == NULL)
+    {
+        pWorker = m_workers[m_nextWorker.fetch_add(1u, boost::memory_order_relaxed) % m_workers.size()].get();
+    }
+
+    // counted before it can be taken, a thief must not see the count below its handler
+    m_pendingHandlers.fetch_add(1u);
+    pWorker->push(handler, lane);
+    wakeUpWorker();
+}
+
+//--------------------------------------------------------------------------------------------------
+TimerHandle WorkStealingScheduler::executeOnTimer(SchedulerTimerHandler handler,
+                                                  const boost::posix_time::time_duration &timeDuration)
+{
+    return m_timerWheel.executeOnTimer(handler, timeDuration);
+}
+
+//--------------------------------------------------------------------------------------------------
+bool WorkStealingScheduler::cancelTimer(const TimerHandle &timerHandle)
+{
+    return m_timerWheel.cancelTimer(timerHandle);
+}
+
+//--------------------------------------------------------------------------------------------------
+void WorkStealingScheduler::workerRunner(Worker *pWorker)
+{
+    m_currentWorker.reset(pWorker);
+
+    while (isRunning())
+    {
+        SchedulerHandler handler;
+        if (!takeHandler(pWorker, handler))
+        {
+            waitForWork();
+            continue;
+        }
+
+        try
+        {
+            handler();
+        }
+        catch (const std::exception &e)
+        {
+            Tools::Logger::Logger::getInstance().error() << "Work stealing scheduler handler failed: " << e.what();
+        }
+    }
+
+    m_currentWorker.reset();
+}
+
+//--------------------------------------------------------------------------------------------------
+bool WorkStealingScheduler::takeHandler(Worker *pWorker, SchedulerHandler &handler)
+{
+    bool found = pWorker->pop(handler);
+
+    const std::size_t workersCount = m_workers.size();
+    for (std::size_t i = 1u; !found && i < workersCount; ++i)
+    {
+        found = m_workers[(pWorker->getIndex() + i) % workersCount]->steal(handler);
+        if (found)
+        {
+            m_stolenHandlers.fetch_add(1u, boost::memory_order_relaxed);
+        }
+    }
+
+    if (found)
+    {
+        m_pendingHandlers.fetch_sub(1u);
+    }
+    return found;
+}
+
+//--------------------------------------------------------------------------------------------------
+void WorkStealingScheduler::waitForWork()
+{
+    boost::unique_lock<boost::mutex> lock(m_idleMutex);
+    m_sleepingWorkers.fetch_add(1u);
+    while (m_pendingHandlers.load() == 0u && isRunning())
+    {
+        m_idleCondition.wait(lock);
+    }
+    m_sleepingWorkers.fetch_sub(1u);
+}
+
+//--------------------------------------------------------------------------------------------------
+void WorkStealingScheduler::wakeUpWorker()
+{
+    if (m_sleepingWorkers.load() > 0u)
+    {
+        boost::lock_guard<boost::mutex> lock(m_idleMutex);
+        m_idleCondition.notify_one();
+    }
+}
+
+//--------------------------------------------------------------------------------------------------
+void WorkStealingScheduler::deleteWorkerStub(Worker *)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+WorkStealingScheduler::Worker *WorkStealingScheduler::getCurrentWorker()
+{
+    return m_currentWorker.get();
+}
+
+//--------------------------------------------------------------------------------------------------
+WorkStealingScheduler::Worker::Worker(std::size_t index, LanePolicy lanePolicy, LaneStatistics &laneStatistics) :
+        m_index(index),
+        m_handlers(lanePolicy, laneStatistics)
+{
+}
+
+//--------------------------------------------------------------------------------------------------
+void WorkStealingScheduler::Worker::push(const SchedulerHandler &handler, ExecutionLane lane)
+{
+    m_handlers.push(handler, lane);
+}
+
+//--------------------------------------------------------------------------------------------------
+bool WorkStealingScheduler::Worker::pop(SchedulerHandler &handler)
+{
+    return m_handlers.pop(handler);
+}
+
+//--------------------------------------------------------------------------------------------------
+bool WorkStealingScheduler::Worker::steal(SchedulerHandler &handler)
+{
+    return m_handlers.tryPop(handler);
+}
+
+//--------------------------------------------------------------------------------------------------
+void WorkStealingScheduler::Worker::clear()
+{
+    m_handlers.clear();
+}
+
+//--------------------------------------------------------------------------------------------------
+std::size_t WorkStealingScheduler::Worker::getIndex() const
+{
+    return m_index;
+}
+
+//--------------------------------------------------------------------------------------------------
+boost::shared_ptr<boost::thread> WorkStealingScheduler::Worker::getThreadPtr()
+{
+    return m_threadPtr;
+}
+
+//--------------------------------------------------------------------------------------------------
+void WorkStealingScheduler::Worker::setThreadPtr(boost::shared_ptr<boost::thread> threadPtr)
+{
+    m_threadPtr = threadPtr;
+}
+
+} /* namespace WebServer */
+} /* namespace Tools */
@@ -34,9 +34,11 @@ public:
         {
         }
 
-        void registerService(const std::string &resource, Tools::WebServer::IWebServicePtr servicePtr)
+        void registerService(const std::string &resource,
+                             Tools::WebServer::IWebServicePtr servicePtr,
+                             const Tools::WebServer::ServiceOptions &options = Tools::WebServer::ServiceOptions())
         {
-            m_webServerPtr->addService(resource, servicePtr);
+            m_webServerPtr->addService(resource, servicePtr, options);
             m_addedServices = true;
         }
 
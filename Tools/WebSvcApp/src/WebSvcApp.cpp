@@ -7,6 +7,7 @@
 #include <stdexcept>
 
 // Boost
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 #include <boost/program_options.hpp>
 #include <boost/scoped_array.hpp>
@@ -18,6 +19,7 @@
 #include "Tools/Logger/Logger.h"
 #include "Tools/MiscUtils/ShutdownManager.h"
 #include "Tools/WebServer/RedirectService.h"
+#include "Tools/WebServer/StaticFileService.h"
 
 // This
 #include "Tools/WebSvcApp/WebSvcApp.h"
@@ -68,9 +70,45 @@ class StatStub : public Tools::WebServer::IStat
 public:
     virtual ~StatStub() {}
 
-    virtual void registerParameter(const std::string &) {}
+    virtual Tools::WebServer::CounterHandle registerParameter(const std::string &) { return Tools::WebServer::CounterHandle(); }
+    virtual Tools::WebServer::CounterHandle registerParameter(const std::string &, const Labels &)
+    {
+        return Tools::WebServer::CounterHandle();
+    }
     virtual void set(const std::string &, const long) {}
     virtual void increment(const std::string &, const long) {}
+    virtual Tools::WebServer::HistogramHandle registerHistogram(const std::string &, unsigned)
+    {
+        return Tools::WebServer::HistogramHandle();
+    }
+    virtual Tools::WebServer::HistogramHandle registerTimer(const std::string &, unsigned)
+    {
+        return Tools::WebServer::HistogramHandle();
+    }
+    virtual Tools::WebServer::RateHandle registerRate(const std::string &)
+    {
+        return Tools::WebServer::RateHandle();
+    }
+    virtual Tools::WebServer::RateHandle registerEwma(const std::string &)
+    {
+        return Tools::WebServer::RateHandle();
+    }
+    virtual Tools::WebServer::HistogramHandle registerHistogram(const std::string &, const Labels &, unsigned)
+    {
+        return Tools::WebServer::HistogramHandle();
+    }
+    virtual Tools::WebServer::HistogramHandle registerTimer(const std::string &, const Labels &, unsigned)
+    {
+        return Tools::WebServer::HistogramHandle();
+    }
+    virtual Tools::WebServer::RateHandle registerRate(const std::string &, const Labels &)
+    {
+        return Tools::WebServer::RateHandle();
+    }
+    virtual Tools::WebServer::RateHandle registerEwma(const std::string &, const Labels &)
+    {
+        return Tools::WebServer::RateHandle();
+    }
     virtual void registerParametersProvider(const std::string &,
     		                                const ParametersProvider &){};
     virtual void unregisterParametersProvider(const std::string &){};
@@ -147,17 +185,89 @@ int WebSvcApp::run(Tools::Configuration::Configuration &conf)
             const std::string httpHost = httpConfig.get<std::string>("host", std::string("0.0.0.0"));
             const int httpPort = httpConfig.get<int>("port", 80);
             const std::size_t httpTimeout = httpConfig.get<std::size_t>("timeout", 1u);
+            const std::size_t httpIdleTimeout = httpConfig.get<std::size_t>("idletimeout", httpTimeout);
             const std::size_t httpConnectionLimit = httpConfig.get<int>("connectionlimit", 100u);
+            const std::size_t httpDrainTimeout = httpConfig.get<std::size_t>("draintimeout", 0u);
             const std::size_t httpThreads = httpConfig.get<std::size_t>("httpthreads", 8u);
+            const std::size_t acceptors = httpConfig.get<std::size_t>("acceptors", 1u);
+            const bool ioSharding = httpConfig.get<bool>("iosharding", false);
             const std::size_t workerThreads = httpConfig.get<std::size_t>("workerthreads", 16u);
+            const std::size_t minWorkerThreads = httpConfig.get<std::size_t>("minworkerthreads", workerThreads);
+            const std::string workScheduler = httpConfig.get<std::string>("scheduler", std::string("asio"));
+            const std::string lanePolicy = httpConfig.get<std::string>("lanepolicy", std::string("weighted"));
+            const bool adaptiveLimit = httpConfig.get<bool>("adaptivelimit", false);
+            const bool queueDelayShedding = httpConfig.get<bool>("queuedelayshedding", false);
+            const bool responseCache = httpConfig.get<bool>("responsecache", false);
 
             webServerPtr.reset(new Tools::WebServer::WebServer(httpHost, httpPort, httpThreads, httpTimeout, httpConnectionLimit, workerThreads));
+            webServerPtr->setMinWorkerThreadCount(minWorkerThreads);
+            webServerPtr->setIdleTimeout(httpIdleTimeout);
+            webServerPtr->setDrainTimeout(httpDrainTimeout);
+            webServerPtr->setAcceptorCount(acceptors);
+            webServerPtr->setIoShardingEnabled(ioSharding);
+
+            if (workScheduler == "asio")
+            {
+                webServerPtr->setWorkSchedulerType(Tools::WebServer::WebServer::WST_ASIO);
+            }
+            else if (workScheduler == "workstealing")
+            {
+                webServerPtr->setWorkSchedulerType(Tools::WebServer::WebServer::WST_WORK_STEALING);
+            }
+            else
+            {
+                throw std::runtime_error("Unknown work scheduler \"" + workScheduler + "\" (run.httpserver.scheduler)");
+            }
+
+            if (lanePolicy == "strict")
+            {
+                webServerPtr->setLanePolicy(Tools::WebServer::LP_STRICT);
+            }
+            else if (lanePolicy == "weighted")
+            {
+                webServerPtr->setLanePolicy(Tools::WebServer::LP_WEIGHTED);
+            }
+            else
+            {
+                throw std::runtime_error("Unknown lane policy \"" + lanePolicy + "\" (run.httpserver.lanepolicy)");
+            }
+
+            Tools::WebServer::AdaptiveConcurrencyLimiter::Settings adaptiveLimitSettings;
+            adaptiveLimitSettings.minLimit = httpConfig.get<std::size_t>("adaptivelimitmin", adaptiveLimitSettings.minLimit);
+            adaptiveLimitSettings.maxLimit = httpConfig.get<std::size_t>("adaptivelimitmax", httpConnectionLimit);
+            adaptiveLimitSettings.initialLimit = httpConfig.get<std::size_t>("adaptivelimitinitial",
+                                                                             adaptiveLimitSettings.initialLimit);
+            webServerPtr->setAdaptiveLimitEnabled(adaptiveLimit);
+            webServerPtr->setAdaptiveLimitSettings(adaptiveLimitSettings);
+
+            Tools::WebServer::QueueDelayShedder::Settings queueDelaySettings;
+            queueDelaySettings.target = boost::posix_time::milliseconds(
+                    httpConfig.get<long>("queuedelaytarget", queueDelaySettings.target.total_milliseconds()));
+            queueDelaySettings.interval = boost::posix_time::milliseconds(
+                    httpConfig.get<long>("queuedelayinterval", queueDelaySettings.interval.total_milliseconds()));
+            webServerPtr->setQueueDelaySheddingEnabled(queueDelayShedding);
+            webServerPtr->setQueueDelaySheddingSettings(queueDelaySettings);
+
+            Tools::WebServer::ResponseCache::Settings responseCacheSettings;
+            responseCacheSettings.maxSize = httpConfig.get<std::size_t>("responsecachesize", responseCacheSettings.maxSize);
+            webServerPtr->setResponseCacheEnabled(responseCache);
+            webServerPtr->setResponseCacheSettings(responseCacheSettings);
 
             logger.info() << "Host=" << httpHost << ":" << httpPort << ", "
                 << "httpThreads=" << httpThreads << ", "
+                << "acceptors=" << acceptors << ", "
+                << "ioSharding=" << ioSharding << ", "
                 << "workerThreads=" << workerThreads << ", "
+                << "minWorkerThreads=" << minWorkerThreads << ", "
+                << "scheduler=" << workScheduler << ", "
+                << "lanePolicy=" << lanePolicy << ", "
+                << "adaptiveLimit=" << adaptiveLimit << ", "
+                << "queueDelayShedding=" << queueDelayShedding << ", "
+                << "responseCache=" << responseCache << ", "
                 << "httpConnectionLimit=" << httpConnectionLimit << ", "
-                << "httpTimeout=" << httpTimeout << ".";
+                << "httpTimeout=" << httpTimeout << ", "
+                << "httpIdleTimeout=" << httpIdleTimeout << ", "
+                << "httpDrainTimeout=" << httpDrainTimeout << ".";
         }
 
         // настроить статистику
@@ -165,17 +275,21 @@ int WebSvcApp::run(Tools::Configuration::Configuration &conf)
         {
             const std::string statServiceName = httpConfig.get<std::string>("statservicename", m_project);
             const std::string statServiceResource = httpConfig.get<std::string>("statservice", std::string(""));
+            // 0 collects the document per request
+            const long statSnapshotInterval = httpConfig.get<long>("statsnapshotinterval", 0);
 
             if (!statServiceName.empty() && !statServiceResource.empty())
             {
                 webServerPtr->enableStatService(statServiceName,
                     "/" + statServiceResource,
                     m_version,
-                    m_revision);
+                    m_revision,
+                    boost::posix_time::milliseconds(statSnapshotInterval));
 
                 statPtr = webServerPtr->getStatService();
                 logger.info() << "Stat service enabled (statServiceName=" << statServiceName
-                    << ", statServiceResource=/" << statServiceResource << ").";
+                    << ", statServiceResource=/" << statServiceResource
+                    << ", statSnapshotInterval=" << statSnapshotInterval << ").";
             }
             else 
             {
@@ -184,6 +298,28 @@ int WebSvcApp::run(Tools::Configuration::Configuration &conf)
             }
         }
 
+        // настроить изменение параметров без перезапуска
+        {
+            const std::string adminServiceResource = httpConfig.get<std::string>("adminservice", std::string(""));
+            // the service is not authenticated, by default it answers the local clients only
+            const bool isAdminRemoteAllowed = httpConfig.get<bool>("adminserviceremote", false);
+            if (!adminServiceResource.empty())
+            {
+                webServerPtr->enableAdminService("/" + adminServiceResource, isAdminRemoteAllowed);
+                if (isAdminRemoteAllowed)
+                {
+                    logger.warning() << "Admin service enabled without authentication for remote clients "
+                                     << "(adminServiceResource=/" << adminServiceResource
+                                     << ", adminServiceRemote=1), keep the server on a local host.";
+                }
+                else
+                {
+                    logger.info() << "Admin service enabled for local clients (adminServiceResource=/"
+                                  << adminServiceResource << ").";
+                }
+            }
+        }
+
         logger.info("WebServer configured.");
 
         // Инициализация
@@ -222,6 +358,38 @@ int WebSvcApp::run(Tools::Configuration::Configuration &conf)
                 {
                     webServerPtr->addPluginService(resource, new pion::plugins::FileService(), opts);
                 }
+                else if (pluginName == "staticfiles")
+                {
+                    Tools::WebServer::StaticFileService::Settings settings;
+                    settings.directory = opts["directory"];
+                    if (opts.count("index") != 0u)
+                    {
+                        settings.indexFile = opts["index"];
+                    }
+                    if (opts.count("cachedfilesize") != 0u)
+                    {
+                        settings.maxCachedFileSize = boost::lexical_cast<std::size_t>(opts["cachedfilesize"]);
+                    }
+                    if (opts.count("cachesize") != 0u)
+                    {
+                        settings.maxCacheSize = boost::lexical_cast<std::size_t>(opts["cachesize"]);
+                    }
+                    if (opts.count("chunksize") != 0u)
+                    {
+                        settings.chunkSize = boost::lexical_cast<std::size_t>(opts["chunksize"]);
+                    }
+                    if (opts.count("readerthreads") != 0u)
+                    {
+                        settings.readerThreads = boost::lexical_cast<std::size_t>(opts["readerthreads"]);
+                    }
+
+                    boost::shared_ptr<Tools::WebServer::StaticFileService> servicePtr(
+                            new Tools::WebServer::StaticFileService(resource, settings));
+                    webServerPtr->addService(resource, servicePtr);
+                    statPtr->registerParametersProvider(
+                            "staticfiles_" + Tools::WebServer::WebServer::getStatName(resource),
+                            boost::bind(&Tools::WebServer::StaticFileService::getStatistics, servicePtr, _1));
+                }
             }
             logger.info("Plugin web-services initialized.");
         }
@@ -15,10 +15,36 @@ namespace fs = boost::filesystem;
 static const char s_presetsFileName[] = "userpresets.xml";
 static const char s_userPresetsGroupName[] = "user";
 
-//-------------------------------------------------------------------------------------------------
-Controller::Controller(const Tools::Configuration::ConfigurationView &config) :
+static const char *const s_actions[] = {
+    "get_controller_info",
+    "get_preset_groups",
+    "apply_preset_group",
+    "get_presets",
+    "get_processes",
+    "get_process_info",
+    "get_process_configs",
+    "get_process_config",
+    "get_process_option",
+    "set_process_option",
+    "remove_process_option",
+    "start_process",
+    "stop_process",
+    "get_process_log"
+};
+
+//-------------------------------------------------------------------------------------------------
+Controller::Controller(const Tools::Configuration::ConfigurationView &config, Tools::WebServer::IStatPtr statPtr) :
     m_config(config), m_logger(Tools::Logger::Logger::getInstance())
 {
+    if (statPtr)
+    {
+        for (std::size_t i = 0u; i < sizeof(s_actions) / sizeof(s_actions[0]); ++i)
+        {
+            m_actionTimers[s_actions[i]] = statPtr->registerTimer(std::string("controller_") + s_actions[i] + "_time",
+                Tools::WebServer::StatHistogram::DEFAULT_PRECISION);
+        }
+    }
+
     BOOST_FOREACH(const Tools::Configuration::ConfigurationView &processConf, getConf().getRangeOf("processes.process"))
     {
         ProcessBasePtr processPtr(new ProcessBase(processConf, m_scheduler));
@@ -103,6 +129,15 @@ void Controller::saveUserPresets()
     Tools::Configuration::Parsers::Xml::writeXml(m_userPresets.toConfiguration(), presetFile);
 }
 
+//-------------------------------------------------------------------------------------------------
+const Tools::WebServer::HistogramHandle &Controller::getActionTimer(const char *action) const
+{
+    static const Tools::WebServer::HistogramHandle noTimer;
+
+    ActionTimers::const_iterator i = m_actionTimers.find(action);
+    return i != m_actionTimers.end() ? i->second : noTimer;
+}
+
 //-------------------------------------------------------------------------------------------------
 const Tools::Configuration::ConfigurationView &Controller::getConf() const
 {
@@ -126,7 +161,9 @@ void Controller::startProcessImpl(const std::string &name, const StartProcessRes
 //-------------------------------------------------------------------------------------------------
 void Controller::startProcess(const std::string &name, const StartProcessResult::Handler &handler)
 {
-    safeActionCall<StartProcessResult>(boost::bind(&Controller::startProcessImpl, this, name, handler), handler);
+    safeActionCall<StartProcessResult>("start_process",
+        boost::bind(&Controller::startProcessImpl, this, name, handler),
+        handler);
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -145,7 +182,9 @@ void Controller::stopProcessImpl(const std::string &name, const StopProcessResul
 //-------------------------------------------------------------------------------------------------
 void Controller::stopProcess(const std::string &name, const StopProcessResult::Handler &handler)
 {
-    safeActionCall<StopProcessResult>(boost::bind(&Controller::stopProcessImpl, this, name, handler), handler);
+    safeActionCall<StopProcessResult>("stop_process",
+        boost::bind(&Controller::stopProcessImpl, this, name, handler),
+        handler);
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -172,7 +211,9 @@ void Controller::getProcessInfoImpl(const std::string &name, const GetProcessInf
 //-------------------------------------------------------------------------------------------------
 void Controller::getProcessInfo(const std::string &name, const GetProcessInfoResult::Handler &handler)
 {
-    safeActionCall<GetProcessInfoResult>(boost::bind(&Controller::getProcessInfoImpl, this, name, handler), handler);
+    safeActionCall<GetProcessInfoResult>("get_process_info",
+        boost::bind(&Controller::getProcessInfoImpl, this, name, handler),
+        handler);
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -195,7 +236,9 @@ void Controller::getProcessConfigsImpl(const std::string &name, const GetProcess
 //-------------------------------------------------------------------------------------------------
 void Controller::getProcessConfigs(const std::string &name, const GetProcessConfigsResult::Handler &handler)
 {
-    safeActionCall<GetProcessConfigsResult>(boost::bind(&Controller::getProcessConfigsImpl, this, name, handler), handler);
+    safeActionCall<GetProcessConfigsResult>("get_process_configs",
+        boost::bind(&Controller::getProcessConfigsImpl, this, name, handler),
+        handler);
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -216,7 +259,9 @@ void Controller::getProcessesImpl(const GetProcessesResult::Handler &handler)
 //-------------------------------------------------------------------------------------------------
 void Controller::getProcesses(const GetProcessesResult::Handler &handler)
 {
-    safeActionCall<GetProcessesResult>(boost::bind(&Controller::getProcessesImpl, this, handler), handler);
+    safeActionCall<GetProcessesResult>("get_processes",
+        boost::bind(&Controller::getProcessesImpl, this, handler),
+        handler);
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -231,7 +276,9 @@ void Controller::getControllerInfoImpl(const ControllerInfoResult::Handler &hand
 //-------------------------------------------------------------------------------------------------
 void Controller::getControllerInfo(const ControllerInfoResult::Handler &handler)
 {
-    safeActionCall<ControllerInfoResult>(boost::bind(&Controller::getControllerInfoImpl, this, handler), handler);
+    safeActionCall<ControllerInfoResult>("get_controller_info",
+        boost::bind(&Controller::getControllerInfoImpl, this, handler),
+        handler);
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -261,6 +308,7 @@ void Controller::getProcessConfig(const std::string &processName,
                                   const GetProcessConfigResult::Handler &handler)
 {
     safeActionCall<GetProcessConfigResult>(
+        "get_process_config",
         boost::bind(&Controller::getProcessConfigImpl, this, processName, configName, handler), 
         handler);
 }
@@ -292,6 +340,7 @@ void Controller::getProcessOption(const std::string &processName,
                                   const ProcessOptionResult::Handler &handler)
 {
     safeActionCall<ProcessOptionResult>(
+        "get_process_option",
         boost::bind(&Controller::getProcessOptionImpl, this, processName, configName, optionName, handler), 
         handler);
 }
@@ -357,6 +406,7 @@ void Controller::setProcessOption(const std::string &processName,
     const ProcessOptionResult::Handler &handler)
 {
     safeActionCall<ProcessOptionResult>(
+        "set_process_option",
         boost::bind(&Controller::setProcessOptionImpl, this, processName, configName, optionName, optionValue, handler),
         handler);
 }
@@ -379,6 +429,7 @@ void Controller::getPresetGroupsImpl(const PresetGroupsResult::Handler &handler)
 void Controller::getPresetGroups(const PresetGroupsResult::Handler &handler)
 {
     safeActionCall<PresetGroupsResult>(
+        "get_preset_groups",
         boost::bind(&Controller::getPresetGroupsImpl, this, handler),
         handler);
 }
@@ -448,6 +499,7 @@ void Controller::applyPresetGroupImpl(const std::string &name, const ApplyPreset
 void Controller::applyPresetGroup(const std::string &name, const ApplyPresetGroupResult::Handler &handler)
 {
     safeActionCall<ApplyPresetGroupResult>(
+        "apply_preset_group",
         boost::bind(&Controller::applyPresetGroupImpl, this, name, handler),
         handler);
 }
@@ -490,6 +542,7 @@ void Controller::getPresetsImpl(const std::string &name, const PresetsResult::Ha
 void Controller::getPresets(const std::string &name, const PresetsResult::Handler &handler)
 {
     safeActionCall<PresetsResult>(
+        "get_presets",
         boost::bind(&Controller::getPresetsImpl, this, name, handler),
         handler);
 }
@@ -507,7 +560,7 @@ void Controller::getProcessLogImpl(const std::string &name, const GetProcessLogR
 
     GetProcessLogResult result;
     IProcessPtr processPtr = i->second;
-    LogLineHandler h = [&result](const std::string &line) -> void { result.m_log.push_back(line); };
+    LogLineHandler h = [&result](const std::string &line) -> void { result.m_logPtr->push_back(line); };
     processPtr->getLog(h);
     scheduleActionHandler<>(handler, result);
 }
@@ -516,6 +569,7 @@ void Controller::getProcessLogImpl(const std::string &name, const GetProcessLogR
 void Controller::getProcessLog(const std::string &name, const GetProcessLogResult::Handler &handler)
 {
     safeActionCall<GetProcessLogResult>(
+        "get_process_log",
         boost::bind(&Controller::getProcessLogImpl, this, name, handler),
         handler);
 }
@@ -596,6 +650,7 @@ void Controller::removeProcessOption(const std::string &processName,
     const ProcessOptionResult::Handler &handler)
 {
     safeActionCall<ProcessOptionResult>(
+        "remove_process_option",
         boost::bind(&Controller::removeProcessOptionImpl, this, processName, configName, optionName, handler),
         handler);
 }
\ No newline at end of file
@@ -17,6 +17,7 @@
 
 #include "Tools/Configuration/ConfigurationView.h"
 #include "Tools/Logger/Logger.h"
+#include "Tools/WebServer/IStat.h"
 
 #include "Controller/ControllerActions.h"
 #include "Controller/ControllerErrors.h"
@@ -26,7 +27,9 @@
 class Controller : private boost::noncopyable
 {
 public:
-    explicit Controller(const Tools::Configuration::ConfigurationView &config);
+    // the actions are timed by "controller_<action>_time" timers of statPtr
+    explicit Controller(const Tools::Configuration::ConfigurationView &config,
+                        Tools::WebServer::IStatPtr statPtr = Tools::WebServer::IStatPtr());
     virtual ~Controller();
 
     void start();
@@ -101,9 +104,15 @@ private:
     void startProcessHandler(const StartProcessResult::Handler &handler, const ErrorCode &ec);
     void stopProcessHandler(const StopProcessResult::Handler &handler, const ErrorCode &ec, const ExitStatus &es);
 
+    const Tools::WebServer::HistogramHandle &getActionTimer(const char *action) const;
+
+    // the timer covers the part of the action made before it returns
     template<typename ActionResultType>
-    void safeActionCall(const boost::function0<void> &call, const typename ActionResultType::Handler &handler)
+    void safeActionCall(const char *action,
+                        const boost::function0<void> &call,
+                        const typename ActionResultType::Handler &handler)
     {
+        Tools::WebServer::ScopedTimer timer(getActionTimer(action));
         ErrorCode errorCode;
 
         try
@@ -148,6 +157,9 @@ private:
     
     Tools::Logger::Logger &m_logger;
 
+    typedef std::map<std::string, Tools::WebServer::HistogramHandle> ActionTimers;
+    ActionTimers m_actionTimers;
+
     mutable MutexType m_access;
 };
 
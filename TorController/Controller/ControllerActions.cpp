@@ -424,10 +424,14 @@ Json::Value PresetsResult::toJson() const
 }
 
 //==============================================================================================================================================
-GetProcessLogResult::GetProcessLogResult() {}
+GetProcessLogResult::GetProcessLogResult() :
+    m_logPtr(new Log())
+{
+}
 
 GetProcessLogResult::GetProcessLogResult(const ErrorCode &ec) :
-    ActionResult(ec)
+    ActionResult(ec),
+    m_logPtr(new Log())
 {
 }
 
@@ -437,7 +441,7 @@ Json::Value GetProcessLogResult::toJson() const
 {
     Json::Value root(Json::arrayValue);
 
-    for (const std::string &line : m_log)
+    for (const std::string &line : *m_logPtr)
     {
         root.append(line);
     }
@@ -8,6 +8,7 @@
 
 #include <boost/assert.hpp>
 #include <boost/function/function1.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include "Options/IConfigScheme.h"
 #include "Options/Option.h"
@@ -239,6 +240,8 @@ public:
     typedef boost::function1<void, GetProcessLogResult> Handler;
 
     typedef std::list<std::string> Log;
+    typedef boost::shared_ptr<Log> LogPtr;
 
-    Log m_log;
+    // shared by the copies of the result, the log may be large
+    LogPtr m_logPtr;
 };
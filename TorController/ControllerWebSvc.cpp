@@ -15,7 +15,18 @@ ControllerWebSvc::~ControllerWebSvc()
 //-------------------------------------------------------------------------------------------------
 void ControllerWebSvc::initialize(WebServiceRegistrar &webServiceRegistrar, Tools::WebServer::IStatPtr statPtr)
 {
-    m_controller.reset(new Controller(getConf().branch("serviceconfig.controller")));
+    m_controller.reset(new Controller(getConf().branch("serviceconfig.controller"), statPtr));
 
-    webServiceRegistrar.registerService("/api/controller", Tools::WebServer::IWebServicePtr(new ControllerAPIWebService(m_controller)));
+    boost::shared_ptr<ControllerAPIWebService> servicePtr(new ControllerAPIWebService(m_controller));
+
+    // GET responses are cached only when run.httpserver.responsecache is on
+    Tools::WebServer::ServiceOptions options(Tools::WebServer::EL_INTERACTIVE);
+    options.cacheTtl = boost::posix_time::milliseconds(getConf().get<long>("serviceconfig.controller.cachettl", 1000));
+    options.cacheVersionPtr = servicePtr->getCacheVersion();
+    // dashboards poll the same resources at the same moments
+    options.coalesceRequests = true;
+    options.coalesceWindow = boost::posix_time::milliseconds(
+            getConf().get<long>("serviceconfig.controller.coalescewindow", 20));
+
+    webServiceRegistrar.registerService("/api/controller", servicePtr, options);
 }
\ No newline at end of file
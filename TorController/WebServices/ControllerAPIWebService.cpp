@@ -92,7 +92,7 @@ static const char *s_resourceScheme =
 
 //-------------------------------------------------------------------------------------------------
 ControllerAPIWebService::ControllerAPIWebService(ControllerPtr controller) :
-    m_controller(controller), m_parser(s_resourceScheme)
+    m_controller(controller), m_cacheVersionPtr(new Tools::WebServer::CacheVersion()), m_parser(s_resourceScheme)
 {
     m_handlers[ResourceActions::nodeControllerInfo] = boost::bind(&ControllerAPIWebService::controllerInfoAction, this, _1, ResourceActions::nodeControllerInfo, _2);
     m_handlers[ResourceActions::nodePresets] = boost::bind(&ControllerAPIWebService::presetsAction, this, _1, ResourceActions::nodePresets, _2);
@@ -204,6 +204,12 @@ void ControllerAPIWebService::operator()(Tools::WebServer::ConnectionContextPtr
             return;
         }
         
+        if (contextPtr->getRequest()->get_method() != pion::http::types::REQUEST_METHOD_GET)
+        {
+            // the state is changed by the time the response is sent
+            contextPtr->addFinishHandler(boost::bind(&Tools::WebServer::CacheVersion::bump, m_cacheVersionPtr));
+        }
+
         ResourceParameters resourceParameters;
 
         const std::string action = resourceParser().mapToAction(contextPtr->getRequest()->get_resource(), resourceParameters);
@@ -241,6 +247,12 @@ void ControllerAPIWebService::stop(void)
     m_controller->stop();
 }
 
+//-------------------------------------------------------------------------------------------------
+Tools::WebServer::CacheVersionPtr ControllerAPIWebService::getCacheVersion() const
+{
+    return m_cacheVersionPtr;
+}
+
 //-------------------------------------------------------------------------------------------------
 const std::string &ControllerAPIWebService::getStatusMessage(unsigned statusCode) const
 {
@@ -292,6 +304,44 @@ pion::http::response_ptr ControllerAPIWebService::createResponse(unsigned status
     return responsePtr;
 }
 
+//-------------------------------------------------------------------------------------------------
+pion::http::response_ptr ControllerAPIWebService::createResponse(unsigned statusCode,
+    const std::string &method,
+    const std::string &contentType,
+    std::string &content,
+    bool compress,
+    Tools::WebServer::ResponseBody &body) const
+{
+    pion::http::response_ptr responsePtr(new pion::http::response(method));
+    responsePtr->set_status_code(statusCode);
+    responsePtr->set_status_message(getStatusMessage(statusCode));
+
+    if (!content.empty())
+        responsePtr->set_content_type(contentType);
+
+    if (compress && !content.empty())
+    {
+        try
+        {
+            std::string compressed = Tools::CompressUtils::gzipStringCompress(content);
+            body.append(compressed);
+            responsePtr->add_header(pion::http::types::HEADER_CONTENT_ENCODING, "gzip");
+        }
+        catch (...)
+        {
+            body.append(content);
+        }
+    }
+    else
+    {
+        body.append(content);
+    }
+
+    responsePtr->add_header("Access-Control-Allow-Origin", "*");
+
+    return responsePtr;
+}
+
 //-------------------------------------------------------------------------------------------------
 bool ControllerAPIWebService::isStatusCodeValid(unsigned statusCode) const
 {
@@ -305,17 +355,19 @@ const ResourceParser &ControllerAPIWebService::resourceParser() const
 }
 
 //-------------------------------------------------------------------------------------------------
-void ControllerAPIWebService::sendResponse(Tools::WebServer::ConnectionContextPtr contextPtr, const std::string &message)
+void ControllerAPIWebService::sendResponse(Tools::WebServer::ConnectionContextPtr contextPtr, std::string message)
 {
     const bool isGzipEnabled = (contextPtr->getRequest()->get_header("Accept-Encoding").find("gzip") != std::string::npos);
 
+    Tools::WebServer::ResponseBodyPtr bodyPtr(new Tools::WebServer::ResponseBody());
     pion::http::response_ptr response = createResponse(pion::http::types::RESPONSE_CODE_OK,
         contextPtr->getRequest()->get_method(),
         "application/json;charset=utf-8",
         message,
-        isGzipEnabled);
+        isGzipEnabled,
+        *bodyPtr);
 
-    contextPtr->sendResponse(response);
+    contextPtr->sendResponse(response, bodyPtr);
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -328,13 +380,14 @@ void ControllerAPIWebService::sendErrorResponse(Tools::WebServer::ConnectionCont
     Json::Value error(Json::objectValue);
     error["error"] = errorMessage;
     
-    const std::string responseBody = Json::FastWriter().write(error);
-    pion::http::response_ptr response = createResponse(statusCode, contextPtr->getRequest()->get_method(), "application/json", responseBody, isGzipEnabled);
+    std::string responseBody = Json::FastWriter().write(error);
+    Tools::WebServer::ResponseBodyPtr bodyPtr(new Tools::WebServer::ResponseBody());
+    pion::http::response_ptr response = createResponse(statusCode, contextPtr->getRequest()->get_method(), "application/json", responseBody, isGzipEnabled, *bodyPtr);
 
     response->change_header(pion::http::types::HEADER_CONNECTION,
         contextPtr->getRequest()->check_keep_alive() ? "Keep-Alive" : "close");
 
-    contextPtr->sendResponse(response);
+    contextPtr->sendResponse(response, bodyPtr);
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -615,18 +668,20 @@ void ControllerAPIWebService::sendErrorResponse(Tools::WebServer::ConnectionCont
     error["category"] = ec.category();
     error["value"] = ec.value();
 
-    const std::string responseBody = Json::FastWriter().write(error);
+    std::string responseBody = Json::FastWriter().write(error);
 
+    Tools::WebServer::ResponseBodyPtr bodyPtr(new Tools::WebServer::ResponseBody());
     pion::http::response_ptr response = createResponse(httpStatusCode,
         contextPtr->getRequest()->get_method(), 
         "application/json", 
         responseBody, 
-        isGzipEnabled);
+        isGzipEnabled,
+        *bodyPtr);
 
     response->change_header(pion::http::types::HEADER_CONNECTION,
         contextPtr->getRequest()->check_keep_alive() ? "Keep-Alive" : "close");
 
-    contextPtr->sendResponse(response);
+    contextPtr->sendResponse(response, bodyPtr);
 }
 
 //-------------------------------------------------------------------------------------------------
@@ -730,10 +785,86 @@ void ControllerAPIWebService::processLog(Tools::WebServer::ConnectionContextPtr
 
     try
     {
-        m_controller->getProcessLog(i->second, boost::bind(&ControllerAPIWebService::defaultResponseHandler, this, contextPtr, action, _1));
+        m_controller->getProcessLog(i->second, boost::bind(&ControllerAPIWebService::onProcessLogResponse, this, contextPtr, action, _1));
     }
     catch (const std::exception &e)
     {
         sendErrorResponse(contextPtr, pion::http::types::RESPONSE_CODE_SERVER_ERROR, e.what());
     }
-}
\ No newline at end of file
+}
+
+//-------------------------------------------------------------------------------------------------
+struct ControllerAPIWebService::ProcessLogStream
+{
+    explicit ProcessLogStream(const GetProcessLogResult::LogPtr &logPtr) :
+        logPtr(logPtr), log(*logPtr), position(log.begin()), isClosed(false)
+    {
+    }
+
+    // shared with the result, not copied
+    boost::shared_ptr<const GetProcessLogResult::Log> logPtr;
+    const GetProcessLogResult::Log &log;
+    GetProcessLogResult::Log::const_iterator position;
+    bool isClosed;
+};
+
+//-------------------------------------------------------------------------------------------------
+void ControllerAPIWebService::onProcessLogResponse(Tools::WebServer::ConnectionContextPtr contextPtr, const std::string &action, const GetProcessLogResult &result)
+{
+    if (result.getError())
+    {
+        sendErrorResponse(contextPtr, m_errorsMapping.getHttpStatusCode(action, contextPtr->getRequest()->get_method(), result.getError()), result.getError());
+        return;
+    }
+
+    // logs may be large, the JSON array is streamed instead of being built as a whole
+    pion::http::response_ptr responsePtr(new pion::http::response(*contextPtr->getRequest()));
+    responsePtr->set_status_code(pion::http::types::RESPONSE_CODE_OK);
+    responsePtr->set_status_message(getStatusMessage(pion::http::types::RESPONSE_CODE_OK));
+    responsePtr->set_content_type("application/json;charset=utf-8");
+    responsePtr->add_header("Access-Control-Allow-Origin", "*");
+    contextPtr->beginResponse(responsePtr, true);
+
+    boost::shared_ptr<ProcessLogStream> streamPtr(new ProcessLogStream(result.m_logPtr));
+    writeProcessLog(contextPtr, streamPtr, boost::system::error_code());
+}
+
+//-------------------------------------------------------------------------------------------------
+void ControllerAPIWebService::writeProcessLog(Tools::WebServer::ConnectionContextPtr contextPtr,
+    boost::shared_ptr<ProcessLogStream> streamPtr,
+    const boost::system::error_code &error)
+{
+    static const std::size_t chunkSize = 16 * 1024;
+
+    if (error)
+    {
+        return;
+    }
+
+    if (streamPtr->isClosed)
+    {
+        contextPtr->finishResponse();
+        return;
+    }
+
+    std::string chunk;
+    if (streamPtr->position == streamPtr->log.begin())
+    {
+        chunk += '[';
+    }
+    for (; streamPtr->position != streamPtr->log.end() && chunk.size() < chunkSize; ++streamPtr->position)
+    {
+        if (streamPtr->position != streamPtr->log.begin())
+        {
+            chunk += ',';
+        }
+        chunk += Json::valueToQuotedString(streamPtr->position->c_str());
+    }
+    if (streamPtr->position == streamPtr->log.end())
+    {
+        chunk += ']';
+        streamPtr->isClosed = true;
+    }
+
+    contextPtr->writeChunk(chunk, boost::bind(&ControllerAPIWebService::writeProcessLog, this, contextPtr, streamPtr, _1));
+}
@@ -3,6 +3,7 @@
 #include <boost/function/function2.hpp>
 
 #include "Tools/WebServer/IWebService.h"
+#include "Tools/WebServer/ResponseCache.h"
 
 #include "Controller/Controller.h"
 #include "WebServices/ErrorsMapping.h"
@@ -25,8 +26,12 @@ public:
     
     void stop(void) override;
 
+    // bumped after every request that may change the controller state
+    Tools::WebServer::CacheVersionPtr getCacheVersion() const;
+
 private:
     ControllerPtr m_controller;
+    Tools::WebServer::CacheVersionPtr m_cacheVersionPtr;
     // Helpers
     std::map<unsigned, std::string> m_httpStatusMessage;
     ErrorsMapping m_errorsMapping;
@@ -40,7 +45,15 @@ private:
         const std::string &response, 
         bool compress) const;
 
-    void sendResponse(Tools::WebServer::ConnectionContextPtr contextPtr, const std::string &message);
+    // the content is taken over by the body
+    pion::http::response_ptr createResponse(unsigned statusCode,
+        const std::string &method,
+        const std::string &contentType,
+        std::string &content,
+        bool compress,
+        Tools::WebServer::ResponseBody &body) const;
+
+    void sendResponse(Tools::WebServer::ConnectionContextPtr contextPtr, std::string message);
 
     void sendErrorResponse(Tools::WebServer::ConnectionContextPtr contextPtr,
         unsigned statusCode,
@@ -76,6 +89,9 @@ private:
     void processAction(Tools::WebServer::ConnectionContextPtr contextPtr, const std::string &action, const ResourceParameters &parameters);
 
     void processLog(Tools::WebServer::ConnectionContextPtr contextPtr, const std::string &action, const ResourceParameters &parameters);
+    void onProcessLogResponse(Tools::WebServer::ConnectionContextPtr contextPtr, const std::string &action, const GetProcessLogResult &result);
+    struct ProcessLogStream;
+    void writeProcessLog(Tools::WebServer::ConnectionContextPtr contextPtr, boost::shared_ptr<ProcessLogStream> streamPtr, const boost::system::error_code &error);
 
     void defaultResponseHandler(Tools::WebServer::ConnectionContextPtr contextPtr, const std::string &action, const ActionResult &result);
 };